@@ -0,0 +1,1700 @@
+/*
+  ==============================================================================
+
+    Benchmarks.cpp
+
+  ==============================================================================
+*/
+
+#include <thread>
+#include "Benchmarks.h"
+#include "PluginProcessor.h"
+#include "BlockFifo.h"
+#include "SpectralKernels.h"
+#include "HrtfInterpolator.h"
+#include "MinimumPhase.h"
+#include "HrtfCache.h"
+#include "SphericalHarmonics.h"
+
+// blocks processed before / while measuring
+static const int warmup_blocks = 20;
+static const int timed_blocks = 200;
+
+// results the engines guarantee that did not hold, returned by run_benchmarks()
+static int failed_checks = 0;
+
+// log and count a guarantee that did not hold
+static void check(bool passed, const juce::String& what) {
+
+    jassert(passed);
+    if (!passed) {
+        failed_checks++;
+        juce::Logger::writeToLog("check failed: " + what);
+    }
+}
+
+// relative error of float results that are only summed in another order or with fused multiply-adds
+static const float float_tolerance = 1e-5f;
+// relative error of float transforms of different algorithms or sizes, a few ulp per radix stage
+static const float transform_tolerance = 1e-4f;
+
+// largest difference of results to their reference values, checked relative to the largest reference value
+struct max_error {
+
+    void add(float value, float reference) {
+
+        error = juce::jmax(error, std::abs(value - reference));
+        magnitude = juce::jmax(magnitude, std::abs(reference));
+    }
+
+    bool within(float tolerance) const { return error <= tolerance * magnitude; }
+
+    float error = 0.f;
+    float magnitude = 0.f;
+};
+
+static void fill_random(float* data, int count) {
+
+    juce::Random random(1234);
+    for (int i = 0; i < count; i++)
+        data[i] = random.nextFloat() - 0.5f;
+}
+
+// mean time of one call of process in microseconds
+template <typename Function>
+static double time_per_block(Function&& process) {
+
+    for (int i = 0; i < warmup_blocks; i++)
+        process();
+
+    juce::int64 start = juce::Time::getHighResolutionTicks();
+    for (int i = 0; i < timed_blocks; i++)
+        process();
+    juce::int64 stop = juce::Time::getHighResolutionTicks();
+
+    return 1.e6 * juce::Time::highResolutionTicksToSeconds(stop - start) / timed_blocks;
+}
+
+// padding size of the overlap-add path, same as BinauralizationAudioProcessor::set_padding_size
+static int padding_size(const FFTPlanCache& plans, int n, int m) {
+
+    return plans.get_efficient_size(m + n - 1);
+}
+
+// padding size set_padding_size used before it took mixed-radix sizes
+static int power_of_2_padding_size(int n, int m) {
+
+    int p = log2(m + n - 1);
+    return 1 << (p + 1);
+}
+
+// num random stereo HRIRs in time and frequency domain, in the layout the loader produces
+struct benchmark_hrtf_set {
+
+    benchmark_hrtf_set(FFTPlanCache& plans, int m, int k, int num = 1) : num(num) {
+
+        hrtfs.num_hrtfs = num;
+        hrtfs.allocate_spectra(k);
+
+        juce::Random random(4321);
+        for (int i = 0; i < num; i++) {
+            time_left[i] = fft_alloc_real(m);
+            time_right[i] = fft_alloc_real(m);
+            for (int j = 0; j < m; j++) {
+                time_left[i][j] = random.nextFloat() - 0.5f;
+                time_right[i][j] = random.nextFloat() - 0.5f;
+            }
+            ConvolutionEngine::transform_hrir(plans, k, time_left[i], m, hrtfs.get_spectrum(i, 0));
+            ConvolutionEngine::transform_hrir(plans, k, time_right[i], m, hrtfs.get_spectrum(i, 1));
+        }
+
+        hrtfs.time_left = time_left;
+        hrtfs.time_right = time_right;
+        hrtfs.num_samples = m;
+        hrtfs.prescaled = true;
+    }
+
+    ~benchmark_hrtf_set() {
+
+        for (int i = 0; i < num; i++) {
+            fft_free(time_left[i]);
+            fft_free(time_right[i]);
+        }
+        hrtfs.free_spectra();
+    }
+
+    static constexpr int max_hrtfs = 4;
+    int num = 0;
+    float* time_left[max_hrtfs] = {};
+    float* time_right[max_hrtfs] = {};
+    hrtf_buffer_sc hrtfs;
+};
+
+// HRIRs on a 30 degree grid from -60 to 90 degrees elevation with their directions, the 12 directions of the
+// top ring all are the pole
+struct benchmark_sphere_set {
+
+    benchmark_sphere_set(FFTPlanCache& plans, int m, int k) : azimuth(num), elevation(num), hrirs(2 * num * m, true),
+                                                             time_left(num), time_right(num) {
+
+        const double pi = 3.14159265358979323846;
+
+        // an impulse delayed by the path difference to each ear and a tail that only depends on the direction,
+        // so the repeated directions at the pole get the same HRIRs
+        for (int i = 0; i < num; i++) {
+            azimuth[i] = 30.f * (i % num_azimuths);
+            elevation[i] = -60.f + 30.f * (i / num_azimuths);
+            double az = azimuth[i] * pi / 180.;
+            double el = elevation[i] * pi / 180.;
+            double y = cos(el) * sin(az);
+
+            time_left[i] = hrirs + 2 * i * m;
+            time_right[i] = hrirs + (2 * i + 1) * m;
+            time_left[i][(int)std::lround(20. - 12. * y)] = 1.f;
+            time_right[i][(int)std::lround(20. + 12. * y)] = 1.f;
+            for (int j = 40; j < m; j++) {
+                float tail = 0.1f * (float)(std::exp(-(j - 40) / 30.) * std::sin(j * (1. + cos(el) * cos(az)) + 3. * sin(el)));
+                time_left[i][j] = tail;
+                time_right[i][j] = -tail;
+            }
+        }
+
+        hrtfs.num_hrtfs = num;
+        hrtfs.num_samples = m;
+        hrtfs.time_left = time_left;
+        hrtfs.time_right = time_right;
+        hrtfs.azimuth = azimuth;
+        hrtfs.elevation = elevation;
+        hrtfs.allocate_spectra(k);
+        for (int i = 0; i < num; i++) {
+            ConvolutionEngine::transform_hrir(plans, k, time_left[i], m, hrtfs.get_spectrum(i, 0));
+            ConvolutionEngine::transform_hrir(plans, k, time_right[i], m, hrtfs.get_spectrum(i, 1));
+        }
+        hrtfs.prescaled = true;
+    }
+
+    ~benchmark_sphere_set() {
+
+        hrtfs.free_spectra();
+    }
+
+    static constexpr int num_elevations = 6;
+    static constexpr int num_azimuths = 12;
+    static constexpr int num = num_elevations * num_azimuths;
+    juce::HeapBlock<float> azimuth, elevation, hrirs;
+    juce::HeapBlock<float*> time_left, time_right;
+    hrtf_buffer_sc hrtfs;
+};
+
+// overlap-add history as it used to be kept in processBlock: MEM results of k samples, shifted by one slot every block
+struct shuffled_overlap_add {
+
+    shuffled_overlap_add(int n, int k) : n(n), k(k) {
+
+        MEM = (k / n > 2) ? k / n : 2;
+
+        overlap_left = (float**)malloc(sizeof(float*) * MEM);
+        overlap_right = (float**)malloc(sizeof(float*) * MEM);
+        for (int i = 0; i < MEM; i++) {
+            overlap_left[i] = (float*)calloc(k + 2, sizeof(float));
+            overlap_right[i] = (float*)calloc(k + 2, sizeof(float));
+        }
+    }
+
+    ~shuffled_overlap_add() {
+
+        for (int i = 0; i < MEM; i++) {
+            free(overlap_left[i]);
+            free(overlap_right[i]);
+        }
+        free(overlap_left);
+        free(overlap_right);
+    }
+
+    // result_left/right hold the current block's k-point convolution result
+    void process(const float* result_left, const float* result_right, float* left, float* right) {
+
+        memcpy(overlap_left[0], result_left, sizeof(float) * k);
+        memcpy(overlap_right[0], result_right, sizeof(float) * k);
+        memcpy(left, overlap_left[0], sizeof(float) * n);
+        memcpy(right, overlap_right[0], sizeof(float) * n);
+
+        for (int i = 1; i < MEM; i++) {
+            for (int j = 0; j < n && j + n * i < k; j++) {
+                left[j] += overlap_left[i][j + (n * i)];
+                right[j] += overlap_right[i][j + (n * i)];
+            }
+        }
+
+        for (int i = MEM - 1; i > 0; i--) {
+            memcpy(overlap_left[i], overlap_left[i - 1], sizeof(float) * k);
+            memcpy(overlap_right[i], overlap_right[i - 1], sizeof(float) * k);
+        }
+    }
+
+    int n = 0;
+    int k = 0;
+    int MEM = 0;
+    float** overlap_left = NULL;
+    float** overlap_right = NULL;
+};
+
+// overlap-add history as an accumulating ring, like ConvolutionEngine does it
+struct ring_overlap_add {
+
+    ring_overlap_add(int n, int k, int tail_length) : n(n), tail_length(tail_length) {
+
+        while (ring_size < k + n)
+            ring_size <<= 1;
+        ring_left = (float*)calloc(ring_size, sizeof(float));
+        ring_right = (float*)calloc(ring_size, sizeof(float));
+    }
+
+    ~ring_overlap_add() {
+
+        free(ring_left);
+        free(ring_right);
+    }
+
+    void process(const float* result_left, const float* result_right, float* left, float* right) {
+
+        int mask = ring_size - 1;
+        for (int i = 0; i < tail_length; i++) {
+            ring_left[(head + i) & mask] += result_left[i];
+            ring_right[(head + i) & mask] += result_right[i];
+        }
+        for (int i = 0; i < n; i++) {
+            int pos = (head + i) & mask;
+            left[i] = ring_left[pos];
+            right[i] = ring_right[pos];
+            ring_left[pos] = 0.f;
+            ring_right[pos] = 0.f;
+        }
+        head = (head + n) & mask;
+    }
+
+    int n = 0;
+    int tail_length = 0;
+    int ring_size = 1;
+    int head = 0;
+    float* ring_left = NULL;
+    float* ring_right = NULL;
+};
+
+juce::String benchmark_ir_length(int block_size) {
+
+    const int ir_lengths[] = { 128, 512, 2048, 8192, 48000, 96000 };
+
+    juce::String table;
+    table << "CPU per block [us], block size " << block_size << "\n";
+    table << "ir length | overlap-add | uniform | non-uniform\n";
+
+    FFTPlanCache plans;
+
+    for (int m : ir_lengths) {
+
+        juce::HeapBlock<float> input(block_size), out_left(block_size), out_right(block_size);
+        fill_random(input, block_size);
+
+        int k = padding_size(plans, block_size, m);
+        benchmark_hrtf_set set(plans, m, k);
+
+        ConvolutionEngine engine(plans);
+        engine.prepare(block_size, k, set.hrtfs);
+
+        engine.mode = ConvolutionEngine::overlap_add;
+        double t_overlap_add = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+        engine.mode = ConvolutionEngine::uniform_partitioned;
+        double t_uniform = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+        engine.mode = ConvolutionEngine::non_uniform_partitioned;
+        double t_non_uniform = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+
+        table << m << " | " << juce::String(t_overlap_add, 1) << " | " << juce::String(t_uniform, 1)
+              << " | " << juce::String(t_non_uniform, 1) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_overlap_memory(int block_size) {
+
+    const int ir_lengths[] = { 128, 512, 2048, 8192, 48000 };
+
+    juce::String table;
+    table << "overlap-add history, block size " << block_size << "\n";
+    table << "ir length | k | shuffle [us] | shuffle [kB/block] | ring [us] | ring [kB/block]\n";
+
+    FFTPlanCache plans;
+
+    for (int m : ir_lengths) {
+
+        int k = padding_size(plans, block_size, m);
+        int tail_length = (block_size + m - 1 < k) ? block_size + m - 1 : k;
+
+        juce::HeapBlock<float> result_left(k), result_right(k), out_left(block_size), out_right(block_size);
+        fill_random(result_left, k);
+        fill_random(result_right, k);
+
+        shuffled_overlap_add shuffle(block_size, k);
+        double t_shuffle = time_per_block([&] { shuffle.process(result_left, result_right, out_left, out_right); });
+
+        ring_overlap_add ring(block_size, k, tail_length);
+        double t_ring = time_per_block([&] { ring.process(result_left, result_right, out_left, out_right); });
+
+        // bytes read + written per ear: the shuffle copies MEM - 1 slots of k samples plus the new result,
+        // the ring updates tail_length samples and reads / clears n of them
+        double kb_shuffle = 2. * sizeof(float) * (2. * shuffle.MEM * k + 2. * block_size) / 1024.;
+        double kb_ring = 2. * sizeof(float) * (3. * tail_length + 2. * block_size) / 1024.;
+
+        table << m << " | " << k << " | " << juce::String(t_shuffle, 2) << " | " << juce::String(kb_shuffle, 1)
+              << " | " << juce::String(t_ring, 2) << " | " << juce::String(kb_ring, 1) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_packed_ifft(int block_size) {
+
+    const int ir_lengths[] = { 128, 2048, 48000 };
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned };
+    const int num_blocks = 64;
+
+    juce::String table;
+    table << "two-for-one inverse FFT, block size " << block_size << "\n";
+    table << "ir length | mode | ifft size | 2 x real ifft [us] | packed ifft [us] | separate [us/block] | packed [us/block]"
+          << " | block saving [%] | max difference\n";
+
+    FFTPlanCache plans;
+    // configurations where the packed synthesis made the whole block faster, out of all timed ones
+    int faster = 0, timed = 0;
+
+    for (int m : ir_lengths) {
+
+        int k = padding_size(plans, block_size, m);
+        benchmark_hrtf_set set(plans, m, k);
+
+        juce::HeapBlock<float> input(block_size * num_blocks);
+        juce::HeapBlock<float> ref_left(block_size * num_blocks), ref_right(block_size * num_blocks);
+        juce::HeapBlock<float> out_left(block_size), out_right(block_size);
+        fill_random(input, block_size * num_blocks);
+
+        ConvolutionEngine engine(plans);
+        engine.prepare(block_size, k, set.hrtfs);
+
+        for (int mode : modes) {
+
+            engine.mode = mode;
+            int n = (mode == ConvolutionEngine::overlap_add) ? k : 2 * block_size;
+
+            // correctness: both synthesis modes have to produce the same output from a cleared state
+            engine.set_synthesis(ConvolutionEngine::separate_ifft);
+            engine.reset();
+            for (int b = 0; b < num_blocks; b++)
+                engine.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, 0);
+
+            engine.set_synthesis(ConvolutionEngine::packed_ifft);
+            engine.reset();
+            max_error difference;
+            for (int b = 0; b < num_blocks; b++) {
+                engine.process(input + b * block_size, out_left, out_right, block_size, 0);
+                for (int i = 0; i < block_size; i++) {
+                    difference.add(out_left[i], ref_left[b * block_size + i]);
+                    difference.add(out_right[i], ref_right[b * block_size + i]);
+                }
+            }
+            // one complex transform instead of two real ones, rounded differently
+            check(difference.within(transform_tolerance), "packed inverse FFT differs from two real ones, ir length "
+                  + juce::String(m) + ", " + ConvolutionEngine::get_mode_name(mode));
+
+            // the inverse transforms alone
+            int stride = split_stride(n / 2 + 1);
+            juce::HeapBlock<float> spectra(4 * stride), time(n + 2);
+            juce::HeapBlock<fft_complex> packed(n), result(n), scratch(n / 2 + 1);
+            split_complex spec_left = { spectra, spectra + stride };
+            split_complex spec_right = { spectra + 2 * stride, spectra + 3 * stride };
+            fill_random(spectra, 4 * stride);
+            plans.prepare(n);
+
+            // c2r destroys its input, the split versions run on the interleaved scratch like the engines do
+            double t_real = time_per_block([&] {
+                plans.perform_ifft(n, spec_left, scratch, time);
+                plans.perform_ifft(n, spec_right, scratch, time);
+            });
+            double t_packed = time_per_block([&] {
+                plans.perform_ifft_pair<float>(n, spec_left, spec_right, packed, result, out_left, out_right, 0, block_size, 1.f);
+            });
+
+            engine.set_synthesis(ConvolutionEngine::separate_ifft);
+            double t_separate_block = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+            engine.set_synthesis(ConvolutionEngine::packed_ifft);
+            double t_packed_block = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+
+            double saving = 100. * (1. - t_packed_block / t_separate_block);
+            timed++;
+            if (saving > 0.)
+                faster++;
+
+            table << m << " | " << ((mode == ConvolutionEngine::overlap_add) ? "overlap-add" : "uniform") << " | " << n
+                  << " | " << juce::String(t_real, 2) << " | " << juce::String(t_packed, 2)
+                  << " | " << juce::String(t_separate_block, 2) << " | " << juce::String(t_packed_block, 2)
+                  << " | " << juce::String(saving, 1) << " | " << juce::String(difference.error, 9) << "\n";
+        }
+    }
+
+    // the plugin only runs separate_ifft, see ConvolutionEngine::synthesis_modes
+    table << "packed synthesis faster in " << faster << " of " << timed << " configurations on the "
+          << get_fft_backend_name(plans.get_backend()) << " backend\n";
+
+    return table;
+}
+
+juce::String benchmark_complex_mac() {
+
+    const int timed_bins[] = { 65, 257, 1025, 4097 };
+    const int partitions = 16;
+
+    juce::String table;
+    table << "complex multiply-accumulate kernels, best on this CPU: " << get_kernel_name(get_best_kernel()) << "\n";
+
+    // the kernels against the scalar one are checked in Tests/SpectralKernelsTest.cpp
+    const int max_bins = 4097;
+    juce::HeapBlock<fft_complex> a(max_bins * partitions), b(max_bins * partitions), out(max_bins);
+    fill_random((float*)a.get(), 2 * max_bins * partitions);
+    fill_random((float*)b.get(), 2 * max_bins * partitions);
+
+    // the same data in split layout, one [re | im] block per partition like the FDL and the filters
+    const int stride = split_stride(max_bins);
+    juce::HeapBlock<float> split_a(2 * stride * partitions), split_b(2 * stride * partitions), split_out(2 * stride);
+    auto split_at = [stride](float* data, int p) { return split_complex{ data + 2 * p * stride, data + (2 * p + 1) * stride }; };
+    for (int p = 0; p < partitions; p++) {
+        deinterleave(a + p * max_bins, split_at(split_a, p), max_bins);
+        deinterleave(b + p * max_bins, split_at(split_b, p), max_bins);
+    }
+    split_complex out_split = split_at(split_out, 0);
+    split_complex split_inputs[partitions], split_filters[partitions];
+    for (int p = 0; p < partitions; p++) {
+        split_inputs[p] = split_at(split_a, p);
+        split_filters[p] = split_at(split_b, p);
+    }
+
+    // throughput: one call accumulates all partitions like UniformConvolver::multiply_accumulate,
+    // on interleaved and on split spectra
+    table << "bins | partitions";
+    for (int type = 0; type < num_kernel_types; type++) {
+        if (is_kernel_supported(type))
+            table << " | " << get_kernel_name(type) << " interleaved [ns/bin] | " << get_kernel_name(type) << " split [ns/bin] | "
+                  << get_kernel_name(type) << " split sum [ns/bin]";
+    }
+    table << "\n";
+
+    for (int bins : timed_bins) {
+
+        table << bins << " | " << partitions;
+
+        for (int type = 0; type < num_kernel_types; type++) {
+
+            if (!is_kernel_supported(type))
+                continue;
+
+            double t = time_per_block([&] {
+                memset(out, 0, sizeof(fft_complex) * bins);
+                for (int p = 0; p < partitions; p++)
+                    complex_mac(type, a + p * bins, b + p * bins, out, bins);
+            });
+
+            double t_split = time_per_block([&] {
+                memset(split_out, 0, sizeof(float) * 2 * stride);
+                for (int p = 0; p < partitions; p++)
+                    complex_mac(type, split_at(split_a, p), split_at(split_b, p), out_split, bins);
+            });
+
+            // all partitions in one call, the way UniformConvolver accumulates
+            double t_sum = time_per_block([&] { complex_mac_sum(type, split_inputs, split_filters, partitions, out_split, bins); });
+
+            table << " | " << juce::String(1.e3 * t / (bins * partitions), 3) << " | " << juce::String(1.e3 * t_split / (bins * partitions), 3)
+                  << " | " << juce::String(1.e3 * t_sum / (bins * partitions), 3);
+        }
+        table << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_direct_form(int block_size) {
+
+    const int ir_lengths[] = { 32, 64, 128, 256, 512, 1024 };
+    const int num_blocks = 16;
+
+    juce::String table;
+    table << "direct-form FIR vs. uniform partitioned FFT, block size " << block_size << ", kernel " << get_kernel_name(get_kernel()) << "\n";
+    table << "ir length | FIR [us/block] | FFT [us/block] | estimated FIR | estimated FFT | automatic | measured faster | max difference\n";
+
+    FFTPlanCache plans;
+
+    for (int m : ir_lengths) {
+
+        int k = padding_size(plans, block_size, m);
+        benchmark_hrtf_set set(plans, m, k);
+
+        juce::HeapBlock<float> input(block_size * num_blocks);
+        juce::HeapBlock<float> ref_left(block_size * num_blocks), ref_right(block_size * num_blocks);
+        juce::HeapBlock<float> out_left(block_size), out_right(block_size);
+        fill_random(input, block_size * num_blocks);
+
+        ConvolutionEngine engine(plans);
+        engine.prepare(block_size, k, set.hrtfs);
+
+        // correctness: both engines are exact convolutions, so they have to agree from a cleared state
+        engine.mode = ConvolutionEngine::uniform_partitioned;
+        engine.reset();
+        for (int b = 0; b < num_blocks; b++)
+            engine.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, 0);
+
+        engine.mode = ConvolutionEngine::direct_form;
+        engine.reset();
+        float max_difference = 0.f;
+        for (int b = 0; b < num_blocks; b++) {
+            engine.process(input + b * block_size, out_left, out_right, block_size, 0);
+            for (int i = 0; i < block_size; i++) {
+                max_difference = juce::jmax(max_difference, std::abs(out_left[i] - ref_left[b * block_size + i]),
+                                            std::abs(out_right[i] - ref_right[b * block_size + i]));
+            }
+        }
+
+        double t_direct = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+        engine.mode = ConvolutionEngine::uniform_partitioned;
+        double t_fft = time_per_block([&] { engine.process(input, out_left, out_right, block_size, 0); });
+
+        table << m << " | " << juce::String(t_direct, 2) << " | " << juce::String(t_fft, 2)
+              << " | " << juce::String(ConvolutionEngine::estimate_direct_cost(block_size, m), 1)
+              << " | " << juce::String(ConvolutionEngine::estimate_fft_cost(block_size, m), 1)
+              << " | " << ConvolutionEngine::get_mode_name(engine.get_auto_mode())
+              << " | " << ((t_direct <= t_fft) ? "FIR" : "FFT")
+              << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_fft_backends() {
+
+    const int sizes[] = { 64, 96, 128, 256, 480, 512, 1024, 1536, 2048, 4096, 8192, 16384, 32768, 65536 };
+
+    FFTBackend* backends[num_fft_backends];
+    for (int b = 0; b < num_fft_backends; b++)
+        backends[b] = create_fft_backend(b);
+
+    juce::String table;
+    table << "FFT backends, forward + inverse real transform\n";
+    table << "size";
+    for (int b = 0; b < num_fft_backends; b++) {
+        if (backends[b] != NULL)
+            table << " | " << get_fft_backend_name(b) << " [us] | " << get_fft_backend_name(b) << " [ns/point]";
+    }
+    table << " | max deviation\n";
+
+    for (int n : sizes) {
+
+        float* input = fft_alloc_real(n + 2);
+        float* output = fft_alloc_real(n + 2);
+        fft_complex* spectrum = fft_alloc_complex(n / 2 + 1);
+        fft_complex* reference = fft_alloc_complex(n / 2 + 1);
+        fill_random(input, n);
+
+        table << n;
+        int reference_backend = -1;
+        max_error deviation;
+
+        for (int b = 0; b < num_fft_backends; b++) {
+
+            if (backends[b] == NULL)
+                continue;
+
+            if (!backends[b]->supports_size(n, false)) {
+                table << " | - | -";
+                continue;
+            }
+
+            backends[b]->prepare(n);
+
+            // correctness: the spectrum has to match the first backend, the round trip has to give n * input
+            backends[b]->forward(n, input, spectrum);
+            if (reference_backend < 0) {
+                memcpy(reference, spectrum, sizeof(fft_complex) * (n / 2 + 1));
+                reference_backend = b;
+            }
+            for (int i = 0; i < n / 2 + 1; i++) {
+                deviation.add(spectrum[i][0] / n, reference[i][0] / n);
+                deviation.add(spectrum[i][1] / n, reference[i][1] / n);
+            }
+
+            backends[b]->inverse(n, spectrum, output);
+            for (int i = 0; i < n; i++)
+                deviation.add(output[i] / n, input[i]);
+
+            double t = time_per_block([&] {
+                backends[b]->forward(n, input, spectrum);
+                backends[b]->inverse(n, spectrum, output);
+            });
+
+            table << " | " << juce::String(t, 2) << " | " << juce::String(1.e3 * t / n, 3);
+        }
+
+        table << " | " << juce::String(deviation.error, 9) << "\n";
+        check(deviation.within(transform_tolerance), "FFT backends disagree at size " + juce::String(n));
+
+        fft_free(input);
+        fft_free(output);
+        fft_free(spectrum);
+        fft_free(reference);
+    }
+
+    for (int b = 0; b < num_fft_backends; b++)
+        delete backends[b];
+
+    return table;
+}
+
+juce::String benchmark_padding_size(int block_size) {
+
+    const int ir_lengths[] = { 128, 256, 512, 2048, 48000 };
+
+    juce::String table;
+    table << "overlap-add padding size, block size " << block_size << ", " << get_fft_backend_name(FFTPlanCache().get_backend()) << "\n";
+    table << "ir length | n + m - 1 | power of 2 k | power of 2 [us] | mixed-radix k | mixed-radix [us] | saved [%] | max difference\n";
+
+    FFTPlanCache plans;
+
+    for (int m : ir_lengths) {
+
+        juce::HeapBlock<float> input(block_size);
+        juce::HeapBlock<float> left_2(block_size), right_2(block_size), left_mixed(block_size), right_mixed(block_size);
+
+        int k_2 = power_of_2_padding_size(block_size, m);
+        int k_mixed = padding_size(plans, block_size, m);
+
+        benchmark_hrtf_set set_2(plans, m, k_2);
+        benchmark_hrtf_set set_mixed(plans, m, k_mixed);
+
+        ConvolutionEngine engine_2(plans);
+        ConvolutionEngine engine_mixed(plans);
+        engine_2.mode = ConvolutionEngine::overlap_add;
+        engine_mixed.mode = ConvolutionEngine::overlap_add;
+        engine_2.prepare(block_size, k_2, set_2.hrtfs);
+        engine_mixed.prepare(block_size, k_mixed, set_mixed.hrtfs);
+
+        // both sizes have to give the same output, block after block
+        float max_difference = 0.f;
+        juce::Random random(1234);
+        for (int block = 0; block < 4 + m / block_size; block++) {
+            for (int i = 0; i < block_size; i++)
+                input[i] = random.nextFloat() - 0.5f;
+            engine_2.process(input, left_2, right_2, block_size, 0);
+            engine_mixed.process(input, left_mixed, right_mixed, block_size, 0);
+            for (int i = 0; i < block_size; i++)
+                max_difference = juce::jmax(max_difference, std::abs(left_2[i] - left_mixed[i]), std::abs(right_2[i] - right_mixed[i]));
+        }
+
+        double t_2 = time_per_block([&] { engine_2.process(input, left_2, right_2, block_size, 0); });
+        double t_mixed = time_per_block([&] { engine_mixed.process(input, left_mixed, right_mixed, block_size, 0); });
+
+        table << m << " | " << (block_size + m - 1) << " | " << k_2 << " | " << juce::String(t_2, 1)
+              << " | " << k_mixed << " | " << juce::String(t_mixed, 1) << " | " << juce::String(100. * (1. - t_mixed / t_2), 1)
+              << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_specialized_kernels(int ir_length) {
+
+    const int block_sizes[] = { 32, 64, 128, 256, 512, 1024 };
+    const int num_blocks = 8;
+
+    juce::String table;
+    table << "uniform partitioned engine, specialized vs. generic process, ir length " << ir_length
+          << ", kernel " << get_kernel_name(get_kernel()) << "\n";
+    table << "block size | generic [us/block] | specialized [us/block] | specialized mono [us/block] | speedup | max difference\n";
+
+    FFTPlanCache plans;
+
+    juce::HeapBlock<float> hrir_left(ir_length), hrir_right(ir_length);
+    fill_random(hrir_left, ir_length);
+    fill_random(hrir_right, ir_length);
+
+    for (int block_size : block_sizes) {
+
+        juce::HeapBlock<float> input(block_size * num_blocks);
+        juce::HeapBlock<float> ref_left(block_size), ref_right(block_size);
+        juce::HeapBlock<float> out_left(block_size), out_right(block_size), out_mono(block_size);
+        fill_random(input, block_size * num_blocks);
+
+        UniformConvolver generic(plans);
+        UniformConvolver fixed(plans);
+        UniformConvolver mono(plans);
+        generic.specialized = false;
+        generic.prepare(block_size, 1, ir_length);
+        fixed.prepare(block_size, 1, ir_length);
+        mono.prepare(block_size, 1, ir_length);
+        generic.set_filter(0, hrir_left, hrir_right, ir_length);
+        fixed.set_filter(0, hrir_left, hrir_right, ir_length);
+        mono.set_filter(0, hrir_left, hrir_right, ir_length);
+
+        // correctness: same engine, same spectra, so only the summation order of the MAC may differ
+        max_error difference;
+        for (int packed = 0; packed < 2; packed++) {
+            generic.packed_ifft = fixed.packed_ifft = (packed == 1);
+            generic.reset();
+            fixed.reset();
+            mono.reset();
+
+            for (int b = 0; b < num_blocks; b++) {
+                generic.process(input + b * block_size, ref_left, ref_right, 0);
+                fixed.process(input + b * block_size, out_left, out_right, 0);
+                mono.process(input + b * block_size, out_mono, NULL, 0);
+                for (int i = 0; i < block_size; i++) {
+                    difference.add(out_left[i], ref_left[i]);
+                    difference.add(out_right[i], ref_right[i]);
+                    difference.add(out_mono[i], ref_left[i]);
+                }
+            }
+        }
+        generic.packed_ifft = fixed.packed_ifft = false;
+        // the mono version always synthesizes with a real inverse FFT, also against the packed generic one
+        check(difference.within(transform_tolerance), "specialized process differs from the generic one, block size " + juce::String(block_size));
+
+        double t_generic = time_per_block([&] { generic.process(input, out_left, out_right, 0); });
+        double t_fixed = time_per_block([&] { fixed.process(input, out_left, out_right, 0); });
+        double t_mono = time_per_block([&] { mono.process(input, out_mono, NULL, 0); });
+
+        table << block_size << " | " << juce::String(t_generic, 2) << " | " << juce::String(t_fixed, 2)
+              << (fixed.is_specialized() ? "" : " (generic)")
+              << " | " << juce::String(t_mono, 2) << " | " << juce::String(t_generic / t_fixed, 2)
+              << " | " << juce::String(difference.error, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_precision(int block_size) {
+
+    const int m = 512;
+    const int num_blocks = 16;
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned,
+                          ConvolutionEngine::non_uniform_partitioned, ConvolutionEngine::direct_form };
+
+    juce::String table;
+    table << "64-bit processing, block size " << block_size << ", ir length " << m << "\n";
+
+    FFTPlanCache plans;
+
+    if (!plans.supports_double())
+        return table << "no double precision FFT backend compiled in (needs libfftw3)\n";
+
+    table << "mode | float [us/block] | float + conversion [us/block] | double [us/block] | max |float - double|\n";
+
+    int k = padding_size(plans, block_size, m);
+    benchmark_hrtf_set set(plans, m, k);
+
+    juce::HeapBlock<float> input(block_size * num_blocks);
+    juce::HeapBlock<double> input_double(block_size * num_blocks);
+    fill_random(input, block_size * num_blocks);
+    for (int i = 0; i < block_size * num_blocks; i++)
+        input_double[i] = input[i];
+
+    juce::HeapBlock<float> left(block_size), right(block_size);
+    juce::HeapBlock<double> left_double(block_size), right_double(block_size);
+
+    ConvolutionEngine engine(plans);
+    ConvolutionEngineT<double> engine_double(plans);
+    engine.prepare(block_size, k, set.hrtfs);
+    engine_double.prepare(block_size, k, set.hrtfs);
+
+    for (int mode : modes) {
+
+        engine.mode = engine_double.mode = mode;
+        engine.reset();
+        engine_double.reset();
+
+        // correctness: same input and HRIRs, the difference is the rounding error of the float engine
+        double max_difference = 0.;
+        for (int b = 0; b < num_blocks; b++) {
+            engine.process(input + b * block_size, left, right, block_size, 0);
+            engine_double.process(input_double + b * block_size, left_double, right_double, block_size, 0);
+            for (int i = 0; i < block_size; i++)
+                max_difference = juce::jmax(max_difference, std::abs(left[i] - left_double[i]), std::abs(right[i] - right_double[i]));
+        }
+
+        double t_float = time_per_block([&] { engine.process(input, left, right, block_size, 0); });
+        // what the host does for a float-only plugin
+        double t_convert = time_per_block([&] {
+            for (int i = 0; i < block_size; i++)
+                left[i] = (float)input_double[i];
+            engine.process(left, left, right, block_size, 0);
+            for (int i = 0; i < block_size; i++) {
+                left_double[i] = left[i];
+                right_double[i] = right[i];
+            }
+        });
+        double t_double = time_per_block([&] { engine_double.process(input_double, left_double, right_double, block_size, 0); });
+
+        table << ConvolutionEngine::get_mode_name(mode) << " | " << juce::String(t_float, 2) << " | " << juce::String(t_convert, 2)
+              << " | " << juce::String(t_double, 2) << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_block_fifo(int block_size) {
+
+    const int m = 512;
+    const int num_blocks = 16;
+    const int total = block_size * num_blocks;
+    // host block lengths the FIFO is fed with, in turn
+    const int host_sizes[] = { 1, 7, block_size - 1, 3 * block_size / 2 + 1, 13, block_size, 2 * block_size + 5 };
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned };
+
+    juce::String table;
+    table << "irregular host blocks through BlockFifo, internal block size " << block_size << ", ir length " << m << "\n";
+    table << "mode | latency [samples] | fixed blocks [us/sample] | irregular blocks [us/sample] | max difference\n";
+
+    FFTPlanCache plans;
+    int k = padding_size(plans, block_size, m);
+    benchmark_hrtf_set set(plans, m, k);
+
+    juce::HeapBlock<float> input(total);
+    juce::HeapBlock<float> ref_left(total), ref_right(total), out_left(total), out_right(total);
+    fill_random(input, total);
+
+    ConvolutionEngine engine(plans);
+    engine.prepare(block_size, k, set.hrtfs);
+    BlockFifo fifo;
+    fifo.prepare(block_size);
+
+    for (int mode : modes) {
+
+        engine.mode = mode;
+        int latency = fifo.get_latency();
+
+        // reference: whole blocks straight into the engine
+        engine.reset();
+        for (int b = 0; b < num_blocks; b++)
+            engine.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, 0);
+
+        // the same signal in pieces of changing length, in place like processBlock does it
+        auto run_irregular = [&] {
+            memcpy(out_left, input, sizeof(float) * total);
+            int pos = 0;
+            for (int h = 0; pos < total; h++) {
+                int count = juce::jmin(host_sizes[h % juce::numElementsInArray(host_sizes)], total - pos);
+                fifo.process(&engine, out_left + pos, out_left + pos, out_right + pos, count, 0);
+                pos += count;
+            }
+        };
+
+        engine.reset();
+        fifo.reset();
+        run_irregular();
+
+        // output sample i + latency of the FIFO is sample i of the reference
+        float max_difference = 0.f;
+        for (int i = 0; i + latency < total; i++)
+            max_difference = juce::jmax(max_difference, std::abs(out_left[i + latency] - ref_left[i]),
+                                        std::abs(out_right[i + latency] - ref_right[i]));
+        for (int i = 0; i < latency; i++)
+            max_difference = juce::jmax(max_difference, std::abs(out_left[i]), std::abs(out_right[i]));
+        check(max_difference == 0.f, "BlockFifo output differs from whole blocks, " + juce::String(ConvolutionEngine::get_mode_name(mode)));
+
+        double t_fixed = time_per_block([&] {
+            for (int b = 0; b < num_blocks; b++)
+                engine.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, 0);
+        }) / total;
+        double t_irregular = time_per_block(run_irregular) / total;
+
+        table << ConvolutionEngine::get_mode_name(mode) << " | " << latency << " | " << juce::String(t_fixed, 4)
+              << " | " << juce::String(t_irregular, 4) << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_time_distributed(int block_size) {
+
+    const int ir_lengths[] = { 8192, 32768, 131072 };
+    // about one second of audio at 48 kHz
+    const int num_blocks = 48000 / block_size;
+    const int total = block_size * num_blocks;
+    const double block_period = block_size / 48000.;
+
+    juce::String table;
+    table << "late partitions on a worker thread, block size " << block_size << ", real-time pacing at 48 kHz\n";
+    table << "ir length | threaded stages | inline mean / max [us/block] | threaded mean / max [us/block] | deadline misses | max difference\n";
+
+    FFTPlanCache plans;
+
+    juce::HeapBlock<float> input(total), ref_left(total), ref_right(total), out_left(total), out_right(total);
+    fill_random(input, total);
+
+    for (int m : ir_lengths) {
+
+        juce::HeapBlock<float> hrir_left(m), hrir_right(m);
+        fill_random(hrir_left, m);
+        fill_random(hrir_right, m);
+
+        NonUniformConvolver inline_conv(plans), threaded_conv(plans);
+        inline_conv.prepare(block_size, 1, m);
+        threaded_conv.prepare(block_size, 1, m, true);
+        inline_conv.set_filter(0, hrir_left, hrir_right, m);
+        threaded_conv.set_filter(0, hrir_left, hrir_right, m);
+
+        // every block gets its own period, like from an audio callback, and is timed on its own
+        auto run = [&](NonUniformConvolver& conv, float* left, float* right, double& mean, double& worst) {
+            juce::int64 next = juce::Time::getHighResolutionTicks();
+            juce::int64 period = (juce::int64)(block_period * juce::Time::getHighResolutionTicksPerSecond());
+            mean = worst = 0.;
+            for (int b = 0; b < num_blocks; b++) {
+                while (juce::Time::getHighResolutionTicks() < next)
+                    std::this_thread::yield();
+                next += period;
+
+                juce::int64 start = juce::Time::getHighResolutionTicks();
+                conv.process(input + b * block_size, left + b * block_size, right + b * block_size, block_size, 0);
+                double t = 1.e6 * juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+                mean += t / num_blocks;
+                worst = juce::jmax(worst, t);
+            }
+        };
+
+        double inline_mean, inline_max, threaded_mean, threaded_max;
+        run(inline_conv, ref_left, ref_right, inline_mean, inline_max);
+        run(threaded_conv, out_left, out_right, threaded_mean, threaded_max);
+
+        // the worker computes the same partitions, only the summation order into the ring can differ
+        float max_difference = 0.f;
+        for (int i = 0; i < total; i++)
+            max_difference = juce::jmax(max_difference, std::abs(out_left[i] - ref_left[i]), std::abs(out_right[i] - ref_right[i]));
+
+        table << m << " | " << threaded_conv.get_num_threaded_stages() << " | " << juce::String(inline_mean, 1) << " / "
+              << juce::String(inline_max, 1) << " | " << juce::String(threaded_mean, 1) << " / " << juce::String(threaded_max, 1)
+              << " | " << threaded_conv.get_deadline_misses() << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_silence_bypass(int block_size) {
+
+    const int m = 1024;
+    // burst, silence long enough for the bypass, burst; repeated with odd lengths so the partitions do not line up
+    const int segments[] = { 3000, 40000, 2500, 30011, 4096 };
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned,
+                          ConvolutionEngine::non_uniform_partitioned, ConvolutionEngine::direct_form };
+
+    int total = 0;
+    for (int length : segments)
+        total += length;
+    int num_blocks = total / block_size;
+    total = num_blocks * block_size;
+
+    juce::String table;
+    table << "silence bypass, block size " << block_size << ", ir length " << m << "\n";
+    table << "mode | silence, full [us/block] | silence, bypass [us/block] | bypassed blocks | max difference\n";
+
+    FFTPlanCache plans;
+    int k = padding_size(plans, block_size, m);
+    benchmark_hrtf_set set(plans, m, k);
+
+    juce::HeapBlock<float> input(total), silence(block_size, true);
+    juce::HeapBlock<float> ref_left(total), ref_right(total), out_left(total), out_right(total);
+    fill_random(input, total);
+
+    // every other segment is silent
+    int pos = 0;
+    for (int s = 0; s < juce::numElementsInArray(segments) && pos < total; s++) {
+        int length = juce::jmin(segments[s], total - pos);
+        if (s % 2 == 1)
+            memset(input + pos, 0, sizeof(float) * length);
+        pos += length;
+    }
+
+    ConvolutionEngine full(plans), bypass(plans);
+    full.prepare(block_size, k, set.hrtfs);
+    bypass.prepare(block_size, k, set.hrtfs);
+    full.bypass_silence = false;
+
+    for (int mode : modes) {
+
+        full.mode = bypass.mode = mode;
+        full.reset();
+        bypass.reset();
+
+        int bypassed_blocks = 0;
+        for (int b = 0; b < num_blocks; b++) {
+            full.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, 0);
+            bypass.process(input + b * block_size, out_left + b * block_size, out_right + b * block_size, block_size, 0);
+            bypassed_blocks += bypass.is_bypassed() ? 1 : 0;
+        }
+
+        float max_difference = 0.f;
+        for (int i = 0; i < total; i++)
+            max_difference = juce::jmax(max_difference, std::abs(out_left[i] - ref_left[i]), std::abs(out_right[i] - ref_right[i]));
+        check(max_difference == 0.f, "silence bypass is not bit-exact, " + juce::String(ConvolutionEngine::get_mode_name(mode)));
+
+        // both engines have decayed after the last segment of the loop above is followed by enough silence
+        double t_full = time_per_block([&] { full.process(silence, ref_left, ref_right, block_size, 0); });
+        double t_bypass = time_per_block([&] { bypass.process(silence, out_left, out_right, block_size, 0); });
+
+        table << ConvolutionEngine::get_mode_name(mode) << " | " << juce::String(t_full, 2) << " | " << juce::String(t_bypass, 2)
+              << " | " << bypassed_blocks << " / " << num_blocks << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_hrtf_crossfade(int block_size) {
+
+    const int m = 512;
+    const int num_blocks = 64;
+    // the direction alternates between two HRTFs every switch_blocks blocks
+    const int switch_blocks = 8;
+    const int total = num_blocks * block_size;
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned,
+                          ConvolutionEngine::non_uniform_partitioned, ConvolutionEngine::direct_form };
+
+    juce::String table;
+    table << "HRTF switching, block size " << block_size << ", ir length " << m << "\n";
+    table << "mode | steady, abrupt [us/block] | steady, crossfade [us/block] | switching every block [us/block]"
+          << " | largest step abrupt / crossfade | steady max difference\n";
+
+    FFTPlanCache plans;
+    int k = padding_size(plans, block_size, m);
+    benchmark_hrtf_set set(plans, m, k, 2);
+
+    // a sine makes the discontinuity of an abrupt switch stand out against the sample-to-sample change of the signal
+    juce::HeapBlock<float> input(total), left(total), right(total), ref_left(total), ref_right(total);
+    for (int i = 0; i < total; i++)
+        input[i] = (float)std::sin(2. * 3.14159265358979323846 * 441. * i / 48000.);
+
+    ConvolutionEngine abrupt(plans), faded(plans);
+    abrupt.set_crossfade(false);
+    abrupt.prepare(block_size, k, set.hrtfs);
+    faded.prepare(block_size, k, set.hrtfs);
+
+    // largest change between two output samples after the first switch_blocks blocks (the IR still builds up there)
+    auto largest_step = [&](ConvolutionEngine& engine) {
+        engine.reset();
+        for (int b = 0; b < num_blocks; b++) {
+            int sel = (b / switch_blocks) % 2;
+            engine.process(input + b * block_size, left + b * block_size, right + b * block_size, block_size, sel);
+        }
+        float step = 0.f;
+        for (int i = switch_blocks * block_size + 1; i < total; i++)
+            step = juce::jmax(step, std::abs(left[i] - left[i - 1]), std::abs(right[i] - right[i - 1]));
+        return step;
+    };
+
+    for (int mode : modes) {
+
+        abrupt.mode = faded.mode = mode;
+
+        // without a change of direction both engines have to give the same output
+        abrupt.reset();
+        faded.reset();
+        float max_difference = 0.f;
+        for (int b = 0; b < num_blocks; b++) {
+            abrupt.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, 1);
+            faded.process(input + b * block_size, left + b * block_size, right + b * block_size, block_size, 1);
+        }
+        for (int i = 0; i < total; i++)
+            max_difference = juce::jmax(max_difference, std::abs(left[i] - ref_left[i]), std::abs(right[i] - ref_right[i]));
+        check(max_difference == 0.f, "crossfade changes the output of a steady direction, " + juce::String(ConvolutionEngine::get_mode_name(mode)));
+
+        double t_abrupt = time_per_block([&] { abrupt.process(input, left, right, block_size, 0); });
+        double t_faded = time_per_block([&] { faded.process(input, left, right, block_size, 0); });
+        int sel = 0;
+        double t_switching = time_per_block([&] { faded.process(input, left, right, block_size, sel ^= 1); });
+
+        float step_abrupt = largest_step(abrupt);
+        float step_faded = largest_step(faded);
+
+        table << ConvolutionEngine::get_mode_name(mode) << " | " << juce::String(t_abrupt, 2) << " | " << juce::String(t_faded, 2)
+              << " | " << juce::String(t_switching, 2) << " | " << juce::String(step_abrupt, 4) << " / " << juce::String(step_faded, 4)
+              << " | " << juce::String(max_difference, 9) << "\n";
+    }
+
+    return table;
+}
+
+juce::String benchmark_hrtf_interpolation(int block_size) {
+
+    const int m = 256;
+    const int num_directions = 1000;
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned,
+                          ConvolutionEngine::non_uniform_partitioned, ConvolutionEngine::direct_form };
+
+    FFTPlanCache plans;
+    int k = padding_size(plans, block_size, m);
+
+    benchmark_sphere_set sphere(plans, m, k);
+    hrtf_buffer_sc& hrtfs = sphere.hrtfs;
+    const int num = sphere.num;
+    float* azimuth = sphere.azimuth;
+    float* elevation = sphere.elevation;
+    float** time_left = sphere.time_left;
+    float** time_right = sphere.time_right;
+
+    HrtfInterpolator interpolator;
+    interpolator.prepare(hrtfs);
+
+    // the weights of any direction are positive and sum up to 1
+    juce::Random random(4321);
+    float max_sum_error = 0.f;
+    float min_weight = 1.f;
+    for (int d = 0; d < num_directions; d++) {
+        int indices[3];
+        float weights[3];
+        int count = interpolator.get_weights(360.f * random.nextFloat(), 180.f * random.nextFloat() - 90.f, indices, weights);
+        float sum = 0.f;
+        for (int j = 0; j < count; j++) {
+            sum += weights[j];
+            min_weight = juce::jmin(min_weight, weights[j]);
+        }
+        max_sum_error = juce::jmax(max_sum_error, std::abs(sum - 1.f));
+    }
+    check(max_sum_error <= float_tolerance, "interpolation weights do not sum up to 1");
+    check(min_weight >= -float_tolerance, "negative interpolation weight");
+
+    // a measured direction gives back its own HRIRs
+    juce::HeapBlock<float> left(m), right(m);
+    max_error measured;
+    for (int i = 0; i < num; i++) {
+        interpolator.interpolate(azimuth[i], elevation[i], left, right);
+        for (int j = 0; j < m; j++) {
+            measured.add(left[j], time_left[i][j]);
+            measured.add(right[j], time_right[i][j]);
+        }
+    }
+    // magnitude and phase go through a transform and back
+    check(measured.within(transform_tolerance), "interpolated HRIRs differ from the measured ones at their directions");
+
+    float direction = 0.f;
+    double t_interpolate = time_per_block([&] { interpolator.interpolate(direction += 7.f, 15.f, left, right); });
+
+    juce::String table;
+    table << "HRTF interpolation, block size " << block_size << ", ir length " << m << ", " << num << " directions, "
+          << interpolator.get_num_triangles() << " triangles\n";
+    table << "max |sum of weights - 1| " << juce::String(max_sum_error, 9) << ", smallest weight " << juce::String(min_weight, 6)
+          << ", max difference at the measured directions " << juce::String(measured.error, 9) << "\n";
+    table << "interpolation on the worker: " << juce::String(t_interpolate, 2) << " us per direction\n";
+    table << "mode | static source [us/block] | moving source [us/block] | filters loaded while moving\n";
+
+    ConvolutionEngine engine(plans);
+    engine.extra_filters = HrtfInterpolator::num_slots;
+    engine.prepare(block_size, k, hrtfs);
+
+    juce::HeapBlock<float> input(block_size), out_left(block_size), out_right(block_size);
+    fill_random(input, block_size);
+
+    interpolator.set_direction(45.f, 15.f);
+    interpolator.start(&engine, NULL, num);
+    while (interpolator.begin_block() < 0)
+        std::this_thread::yield();
+
+    // the audio thread side of PluginProcessor::render()
+    int loaded = 0;
+    int last_filter = -1;
+    auto process = [&] {
+        int filter = interpolator.begin_block();
+        loaded += (filter != last_filter) ? 1 : 0;
+        last_filter = filter;
+        engine.process(input, out_left, out_right, block_size, filter);
+        interpolator.end_block(engine, filter);
+    };
+
+    for (int mode : modes) {
+
+        engine.mode = mode;
+        engine.reset();
+
+        double t_static = time_per_block(process);
+
+        // a new direction every block, the worker takes the newest one whenever it is done with a filter
+        loaded = 0;
+        double t_moving = time_per_block([&] {
+            interpolator.set_direction(direction += 1.f, 15.f);
+            process();
+        });
+
+        table << ConvolutionEngine::get_mode_name(mode) << " | " << juce::String(t_static, 2) << " | " << juce::String(t_moving, 2)
+              << " | " << loaded << " / " << (warmup_blocks + timed_blocks) << "\n";
+    }
+
+    interpolator.stop();
+
+    return table;
+}
+
+juce::String benchmark_minimum_phase(int block_size) {
+
+    const int m = 512;
+    const int num = 4;
+    const int num_blocks = 64;
+    const int total = num_blocks * block_size;
+    const double pi = 3.14159265358979323846;
+    // onset of each ear, the leading zeros of a measured HRIR
+    const double delays[num][2] = { { 30.0, 52.3 }, { 41.7, 33.25 }, { 25.5, 25.5 }, { 60.9, 28.1 } };
+    const int modes[] = { ConvolutionEngine::overlap_add, ConvolutionEngine::uniform_partitioned,
+                          ConvolutionEngine::non_uniform_partitioned, ConvolutionEngine::direct_form };
+
+    FFTPlanCache plans;
+
+    // decaying resonances (all-pole, so minimum phase) moved to the onset by a windowed sinc
+    juce::HeapBlock<float> response(m, true), hrirs(2 * num * m, true), original(2 * num * m);
+    juce::HeapBlock<float*> time_left(num), time_right(num), original_left(num), original_right(num);
+
+    response[0] = 1.f;
+    const double resonances[3][2] = { { 0.05, 0.97 }, { 0.17, 0.93 }, { 0.31, 0.9 } };
+    for (int r = 0; r < 3; r++) {
+        double a1 = 2. * resonances[r][1] * cos(2. * pi * resonances[r][0]);
+        double a2 = -resonances[r][1] * resonances[r][1];
+        double y1 = 0., y2 = 0.;
+        for (int j = 0; j < m; j++) {
+            double y = response[j] + a1 * y1 + a2 * y2;
+            y2 = y1;
+            y1 = y;
+            response[j] = (float)(0.2 * y);
+        }
+    }
+
+    for (int i = 0; i < num; i++) {
+        for (int ear = 0; ear < 2; ear++) {
+            float* hrir = hrirs + (2 * i + ear) * m;
+            for (int j = 0; j < m; j++) {
+                for (int t = -16; t <= 16; t++) {
+                    int n = (int)std::floor(j + delays[i][ear]) + t;
+                    if (n < 0 || n >= m)
+                        continue;
+                    double x = n - j - delays[i][ear];
+                    double sinc = (std::abs(x) < 1e-9) ? 1. : std::sin(pi * x) / (pi * x);
+                    double window = 0.5 + 0.5 * std::cos(pi * x / 17.);
+                    hrir[n] += (float)(response[j] * sinc * window);
+                }
+            }
+        }
+        time_left[i] = hrirs + 2 * i * m;
+        time_right[i] = hrirs + (2 * i + 1) * m;
+        original_left[i] = original + 2 * i * m;
+        original_right[i] = original + (2 * i + 1) * m;
+    }
+    memcpy(original, hrirs, sizeof(float) * 2 * num * m);
+
+    hrtf_buffer_sc measured;
+    measured.num_hrtfs = num;
+    measured.num_samples = m;
+    measured.time_left = original_left;
+    measured.time_right = original_right;
+
+    hrtf_buffer_sc decomposed;
+    decomposed.num_hrtfs = num;
+    decomposed.num_samples = m;
+    decomposed.time_left = time_left;
+    decomposed.time_right = time_right;
+
+    juce::int64 start = juce::Time::getHighResolutionTicks();
+    int length = make_minimum_phase(decomposed, plans);
+    double t_decompose = 1.e3 * juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+    float delay_error = 0.f;
+    for (int i = 0; i < num; i++) {
+        delay_error = juce::jmax(delay_error, (float)std::abs(decomposed.delay_left[i] - delays[i][0]));
+        delay_error = juce::jmax(delay_error, (float)std::abs(decomposed.delay_right[i] - delays[i][1]));
+    }
+
+    int k_measured = padding_size(plans, block_size, m);
+    int k_decomposed = padding_size(plans, block_size, length);
+
+    // both sets like the loader leaves them
+    auto transform = [&](hrtf_buffer_sc& hrtfs, int k) {
+        hrtfs.allocate_spectra(k);
+        for (int i = 0; i < num; i++) {
+            ConvolutionEngine::transform_hrir(plans, k, hrtfs.time_left[i], hrtfs.num_samples, hrtfs.get_spectrum(i, 0));
+            ConvolutionEngine::transform_hrir(plans, k, hrtfs.time_right[i], hrtfs.num_samples, hrtfs.get_spectrum(i, 1));
+        }
+        hrtfs.prescaled = true;
+    };
+    transform(measured, k_measured);
+    transform(decomposed, k_decomposed);
+
+    juce::String table;
+    table << "minimum phase HRIRs, block size " << block_size << ": ir length " << m << " -> " << length << ", k "
+          << k_measured << " -> " << k_decomposed << ", decomposition of " << num << " HRTFs " << juce::String(t_decompose, 2)
+          << " ms, largest delay error " << juce::String(delay_error, 3) << " samples\n";
+    table << "mode | measured HRIRs [us/block] | minimum phase + delay [us/block] | output difference [dB]\n";
+
+    juce::HeapBlock<float> input(total), ref_left(total), ref_right(total), out_left(total), out_right(total);
+    fill_random(input, total);
+
+    ConvolutionEngine engine_measured(plans), engine_decomposed(plans);
+    engine_measured.prepare(block_size, k_measured, measured);
+    engine_decomposed.prepare(block_size, k_decomposed, decomposed);
+
+    for (int mode : modes) {
+
+        engine_measured.mode = engine_decomposed.mode = mode;
+
+        // each HRTF on its own: while the direction changes the measured HRIRs crossfade and the delays glide,
+        // which is meant to sound alike but not to be the same signal
+        double signal = 0., error = 0.;
+        for (int sel = 0; sel < num; sel++) {
+            engine_measured.reset();
+            engine_decomposed.reset();
+            for (int b = 0; b < num_blocks; b++) {
+                engine_measured.process(input + b * block_size, ref_left + b * block_size, ref_right + b * block_size, block_size, sel);
+                engine_decomposed.process(input + b * block_size, out_left + b * block_size, out_right + b * block_size, block_size, sel);
+            }
+            for (int i = 0; i < total; i++) {
+                signal += (double)ref_left[i] * ref_left[i] + (double)ref_right[i] * ref_right[i];
+                error += (double)(out_left[i] - ref_left[i]) * (out_left[i] - ref_left[i])
+                       + (double)(out_right[i] - ref_right[i]) * (out_right[i] - ref_right[i]);
+            }
+        }
+
+        double t_measured = time_per_block([&] { engine_measured.process(input, ref_left, ref_right, block_size, 1); });
+        double t_decomposed = time_per_block([&] { engine_decomposed.process(input, out_left, out_right, block_size, 1); });
+
+        table << ConvolutionEngine::get_mode_name(mode) << " | " << juce::String(t_measured, 2) << " | " << juce::String(t_decomposed, 2)
+              << " | " << juce::String(10. * std::log10(error / signal + 1e-30), 1) << "\n";
+    }
+
+    // what the delay lines add to every block
+    FractionalDelay line_left, line_right;
+    line_left.prepare(64, block_size);
+    line_right.prepare(64, block_size);
+    double t_delay = time_per_block([&] { line_left.process(out_left, block_size, 37.4f); line_right.process(out_right, block_size, 52.9f); });
+    table << "fractional delay of both ears: " << juce::String(t_delay, 2) << " us/block\n";
+
+    measured.free_spectra();
+    decomposed.free_spectra();
+    free(decomposed.delay_left);
+    free(decomposed.delay_right);
+
+    return table;
+}
+
+juce::String benchmark_hrtf_cache(size_t memory_budget) {
+
+    const int m = 256;
+    const int block_size = 512;
+    const int num_updates = 2000;
+    const int num_sources = 4;
+    const int num_torture = 24;
+
+    FFTPlanCache plans;
+    const int k = plans.get_efficient_size(m + block_size - 1);
+    benchmark_sphere_set sphere(plans, m, k);
+
+    HrtfInterpolator interpolator;
+    interpolator.prepare(sphere.hrtfs);
+
+    // the worker loads into the extra filters after the set, see HrtfInterpolator::start()
+    ConvolutionEngine engine(plans);
+    engine.extra_filters = HrtfInterpolator::num_slots;
+    engine.prepare(block_size, k, sphere.hrtfs);
+    const int filter = sphere.hrtfs.num_hrtfs;
+    const size_t entry_size = HrtfInterpolator::get_cache_entry_size(engine, NULL);
+
+    HrtfCache cache;
+    cache.prepare(entry_size, memory_budget);
+
+    juce::HeapBlock<float> left(m), right(m);
+    juce::HeapBlock<unsigned char> entry(entry_size), fresh(entry_size);
+    float delays[2];
+
+    // a few sources that drift slowly, seen through a head tracker that jitters by a couple of degrees
+    juce::Random random(2468);
+    juce::HeapBlock<float> trajectory(2 * num_updates);
+    for (int i = 0; i < num_updates; i++) {
+        int source = i % num_sources;
+        trajectory[2 * i] = 90.f * source + 0.02f * i + 4.f * (random.nextFloat() - 0.5f);
+        trajectory[2 * i + 1] = 20.f * source - 30.f + 4.f * (random.nextFloat() - 0.5f);
+    }
+
+    // what a miss costs: the interpolation alone, and with the transforms of all partitions of the engine
+    int update = 0;
+    double t_interpolate = time_per_block([&] {
+        interpolator.interpolate(trajectory[2 * update], trajectory[2 * update + 1], left, right);
+        update = (update + 1) % num_updates;
+    });
+
+    update = 0;
+    double t_load = time_per_block([&] {
+        interpolator.interpolate(trajectory[2 * update], trajectory[2 * update + 1], left, right, delays);
+        engine.load_filter(filter, left, right, plans, delays[0], delays[1]);
+        update = (update + 1) % num_updates;
+    });
+
+    // what the worker does, see HrtfInterpolator::worker_loop()
+    auto synthesize = [&](int i) {
+        float az = trajectory[2 * i], el = trajectory[2 * i + 1], dist = 1.f;
+        cache.quantize(az, el, dist);
+        if (cache.lookup(az, el, dist, entry)) {
+            engine.restore_filter(filter, (const float*)entry.getData());
+        }
+        else {
+            interpolator.interpolate(az, el, left, right, delays);
+            engine.load_filter(filter, left, right, plans, delays[0], delays[1]);
+            engine.save_filter(filter, (float*)entry.getData());
+            cache.insert(az, el, dist, entry);
+        }
+    };
+
+    for (int i = 0; i < num_updates; i++)
+        synthesize(i);
+    float hit_rate = cache.get_hit_rate();
+    unsigned long long evictions = cache.get_evictions();
+
+    update = 0;
+    double t_cached = time_per_block([&] {
+        synthesize(update);
+        update = (update + 1) % num_updates;
+    });
+
+    // a hit alone, the copy out of the cache and into the engine
+    float hit_az = trajectory[0], hit_el = trajectory[1], hit_dist = 1.f;
+    cache.quantize(hit_az, hit_el, hit_dist);
+    synthesize(0);
+    double t_hit = time_per_block([&] {
+        if (cache.lookup(hit_az, hit_el, hit_dist, entry))
+            engine.restore_filter(filter, (const float*)entry.getData());
+    });
+
+    // every entry still in the cache is exactly the filter the engine gets for its quantized direction
+    int mismatches = 0;
+    for (int i = 0; i < num_updates; i++) {
+        float az = trajectory[2 * i], el = trajectory[2 * i + 1], dist = 1.f;
+        cache.quantize(az, el, dist);
+        if (!cache.lookup(az, el, dist, entry))
+            continue;
+        interpolator.interpolate(az, el, left, right, delays);
+        engine.load_filter(filter, left, right, plans, delays[0], delays[1]);
+        engine.save_filter(filter, (float*)fresh.getData());
+        if (memcmp(entry, fresh, entry_size) != 0)
+            mismatches++;
+    }
+
+    // lock-free readers against a writer that keeps evicting: more directions than one set holds, every hit
+    // must return the entry of the direction asked for and never a half written one
+    const size_t pair_size = 2 * m * sizeof(float);
+    HrtfCache small;
+    small.prepare(pair_size, HrtfCache::num_ways * (pair_size + 64));
+    juce::HeapBlock<float> expected(2 * num_torture * m);
+    for (int i = 0; i < num_torture; i++)
+        interpolator.interpolate(15.f * i, 0.f, expected + 2 * i * m, expected + (2 * i + 1) * m);
+
+    std::atomic<bool> done{ false };
+    std::atomic<int> torn{ 0 };
+    std::atomic<int> reader_hits{ 0 };
+    auto reader = [&] {
+        juce::HeapBlock<float> pair(2 * m);
+        juce::Random reader_random(1357);
+        while (!done.load()) {
+            int i = reader_random.nextInt(num_torture);
+            if (!small.lookup(15.f * i, 0.f, 1.f, pair))
+                continue;
+            reader_hits++;
+            if (memcmp(pair, expected + 2 * i * m, pair_size) != 0)
+                torn++;
+        }
+    };
+    std::thread reader_a(reader), reader_b(reader);
+    for (int pass = 0; pass < 2000; pass++)
+        for (int i = 0; i < num_torture; i++)
+            small.insert(15.f * i, 0.f, 1.f, expected + 2 * i * m);
+    done = true;
+    reader_a.join();
+    reader_b.join();
+
+    check(mismatches == 0, "cached filters differ from the loaded ones");
+    check(torn.load() == 0, "torn reads of the HRTF cache while evicting");
+
+    juce::String table;
+    table << "HRTF cache, budget " << (int)(memory_budget >> 10) << " KB, ir length " << m << ", block size " << block_size
+          << ", " << (int)(entry_size >> 10) << " KB per filter, " << cache.get_capacity() << " entries in "
+          << (int)(cache.get_memory() >> 10) << " KB, " << num_sources << " jittering sources\n";
+    table << "hit rate " << juce::String(100.f * hit_rate, 1) << " %, " << (int)evictions << " evictions in "
+          << num_updates << " updates, " << cache.get_num_entries() << " entries used\n";
+    table << "us per update: interpolated " << juce::String(t_interpolate, 2) << ", interpolated and loaded "
+          << juce::String(t_load, 2) << ", through the cache " << juce::String(t_cached, 2) << ", a hit "
+          << juce::String(t_hit, 2) << "\n";
+    table << "cached filters that differ from the loaded ones " << mismatches << ", torn reads " << torn.load()
+          << " of " << reader_hits.load() << " hits while evicting\n";
+
+    return table;
+}
+
+juce::String benchmark_spherical_harmonics() {
+
+    const int num_directions = 200;
+    const int orders[] = { 1, 2, 3, 4, 5, 6 };
+
+    // minimum phase like the loader makes it, the phase of the measured HRIRs winds too much between directions
+    // to be smooth on the sphere
+    FFTPlanCache plans;
+    benchmark_sphere_set sphere(plans, 256, padding_size(plans, 512, 256));
+    make_minimum_phase(sphere.hrtfs, plans);
+    const int m = sphere.hrtfs.num_samples;
+    const int k = padding_size(plans, 512, m);
+    const int num = sphere.num;
+
+    HrtfInterpolator table;
+    table.prepare(sphere.hrtfs);
+
+    // triangle interpolation of random directions, the reference between the measured ones
+    juce::Random random(8642);
+    juce::HeapBlock<float> directions(2 * num_directions), reference(2 * num_directions * m);
+    for (int d = 0; d < num_directions; d++) {
+        directions[2 * d] = 360.f * random.nextFloat();
+        directions[2 * d + 1] = 150.f * random.nextFloat() - 60.f;
+        table.interpolate(directions[2 * d], directions[2 * d + 1], reference + 2 * d * m, reference + (2 * d + 1) * m);
+    }
+
+    juce::HeapBlock<float> left(m), right(m);
+    int direction = 0;
+    double t_table = time_per_block([&] {
+        table.interpolate(directions[2 * direction], directions[2 * direction + 1], left, right);
+        direction = (direction + 1) % num_directions;
+    });
+
+    size_t spectra_bytes = (size_t)num * 2 * k * sizeof(float);
+
+    juce::String result;
+    result << "spherical harmonic HRTFs, minimum phase ir length " << m << ", " << num << " directions on a 30 degree grid, kernel "
+           << get_kernel_name(get_kernel()) << "\n";
+    result << "measured table: " << (int)(table.get_memory() >> 10) << " KB of magnitude / phase, " << (int)(spectra_bytes >> 10)
+           << " KB of engine spectra (k = " << k << "), " << juce::String(t_table, 2) << " us per interpolated direction\n";
+    result << "order | coefficients | memory [KB] | error at the measured directions [dB] | difference to the triangles [dB]"
+              " | evaluation [us] best / scalar kernel | per direction [us]\n";
+
+    for (int order : orders) {
+
+        HrtfInterpolator fitted;
+        fitted.sh_order = order;
+        fitted.prepare(sphere.hrtfs);
+        if (!fitted.is_spherical())
+            continue;
+
+        // relative error energy of the HRIRs against the measured ones and against the triangle interpolation
+        double error = 0., signal = 0.;
+        for (int i = 0; i < num; i++) {
+            fitted.interpolate(sphere.azimuth[i], sphere.elevation[i], left, right);
+            for (int j = 0; j < m; j++) {
+                error += (left[j] - sphere.time_left[i][j]) * (left[j] - sphere.time_left[i][j])
+                       + (right[j] - sphere.time_right[i][j]) * (right[j] - sphere.time_right[i][j]);
+                signal += sphere.time_left[i][j] * sphere.time_left[i][j] + sphere.time_right[i][j] * sphere.time_right[i][j];
+            }
+        }
+
+        double difference = 0., reference_signal = 0.;
+        for (int d = 0; d < num_directions; d++) {
+            fitted.interpolate(directions[2 * d], directions[2 * d + 1], left, right);
+            const float* ref_left = reference + 2 * d * m;
+            const float* ref_right = reference + (2 * d + 1) * m;
+            for (int j = 0; j < m; j++) {
+                difference += (left[j] - ref_left[j]) * (left[j] - ref_left[j]) + (right[j] - ref_right[j]) * (right[j] - ref_right[j]);
+                reference_signal += ref_left[j] * ref_left[j] + ref_right[j] * ref_right[j];
+            }
+        }
+
+        // the dot products alone on a fit of the same shape, with the best and with the scalar kernel
+        SphericalHarmonicFit fit;
+        int num_values = 4 * (plans.get_efficient_size(2 * m) / 2 + 1) + 2;
+        juce::HeapBlock<float> values((size_t)num * num_values), evaluated(num_values);
+        for (int i = 0; i < num * num_values; i++)
+            values[i] = random.nextFloat();
+        fit.fit(sphere.azimuth, sphere.elevation, num, values, num_values, order, 1e-4f);
+
+        auto evaluate = [&] {
+            fit.evaluate(directions[2 * direction], directions[2 * direction + 1], evaluated);
+            direction = (direction + 1) % num_directions;
+        };
+        int type = get_kernel();
+        double t_best = time_per_block(evaluate);
+        set_kernel(kernel_scalar);
+        double t_scalar = time_per_block(evaluate);
+        set_kernel(type);
+
+        double t_direction = time_per_block([&] {
+            fitted.interpolate(directions[2 * direction], directions[2 * direction + 1], left, right);
+            direction = (direction + 1) % num_directions;
+        });
+
+        result << order << " | " << sh_num_coefficients(order) << " | " << juce::String(fitted.get_memory() / 1024., 1)
+               << " | " << juce::String(10. * std::log10(error / signal + 1e-30), 1)
+               << " | " << juce::String(10. * std::log10(difference / reference_signal + 1e-30), 1)
+               << " | " << juce::String(t_best, 2) << " / " << juce::String(t_scalar, 2)
+               << " | " << juce::String(t_direction, 2) << "\n";
+    }
+
+    free(sphere.hrtfs.delay_left);
+    free(sphere.hrtfs.delay_right);
+
+    return result;
+}
+
+int run_benchmarks() {
+
+    failed_checks = 0;
+
+    juce::Logger::writeToLog(benchmark_fft_backends());
+
+    juce::Logger::writeToLog(benchmark_complex_mac());
+
+    juce::Logger::writeToLog(benchmark_specialized_kernels(512));
+    juce::Logger::writeToLog(benchmark_specialized_kernels(8192));
+
+    const int block_sizes[] = { 64, 128, 512 };
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_ir_length(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_overlap_memory(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_packed_ifft(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_direct_form(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_padding_size(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_precision(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_block_fifo(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_time_distributed(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_silence_bypass(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_hrtf_crossfade(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_hrtf_interpolation(block_size));
+
+    for (int block_size : block_sizes)
+        juce::Logger::writeToLog(benchmark_minimum_phase(block_size));
+
+    juce::Logger::writeToLog(benchmark_hrtf_cache(1 << 20));
+    juce::Logger::writeToLog(benchmark_hrtf_cache(16 << 20));
+
+    juce::Logger::writeToLog(benchmark_spherical_harmonics());
+
+    juce::Logger::writeToLog(juce::String(failed_checks) + " checks failed");
+    return failed_checks;
+}
@@ -0,0 +1,85 @@
+/*
+  ==============================================================================
+
+    Benchmarks.h
+
+    Timing of the convolution engines on the host CPU. Only used when the
+    plugin is built with BINAURALIZATION_BENCHMARKS=1, which adds a
+    "Benchmark" button to the editor. Results are written to the JUCE log.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// run every benchmark below and write the result tables to the log, returns the number of failed checks of what
+// the engines guarantee (bit-exact FIFO, silence bypass, steady crossfade and cache), each also stops at a jassert
+int run_benchmarks();
+
+// CPU time per block of the overlap-add, uniform and non-uniform engines over the HRIR length
+juce::String benchmark_ir_length(int block_size);
+
+// time and memory traffic of the overlap-add history: MEM * k shuffle vs. accumulating ring
+juce::String benchmark_overlap_memory(int block_size);
+
+// output difference and inverse transform cost of packed vs. separate ear synthesis
+juce::String benchmark_packed_ifft(int block_size);
+
+// SIMD complex multiply-accumulate kernels: time per bin on interleaved and on split spectra
+// (their deviation from the scalar kernel is checked in Tests/SpectralKernelsTest.cpp)
+juce::String benchmark_complex_mac();
+
+// CPU time and output difference of the direct-form FIR and the uniform FFT engine over short HRIR lengths,
+// next to the cost model estimates and the mode it picks
+juce::String benchmark_direct_form(int block_size);
+
+// time of a forward + inverse real FFT per size on every compiled-in backend, and the deviation between them
+juce::String benchmark_fft_backends();
+
+// CPU time per block of the overlap-add engine with the mixed-radix padding size against the power of 2 it replaced
+juce::String benchmark_padding_size(int block_size);
+
+// CPU time per block of the uniform engine with the process functions specialized for the block size against
+// the generic one, and the output difference between them (ir_length samples, separate and packed synthesis)
+juce::String benchmark_specialized_kernels(int ir_length);
+
+// CPU time per block of the double precision engine against the float engine with and without the
+// double <-> float conversion a 64-bit host needs around it, and the output difference between both precisions
+juce::String benchmark_precision(int block_size);
+
+// BlockFifo with host blocks of irregular length (1 sample, odd sizes, longer than the internal block) against the
+// engine fed with whole blocks: output difference after the reported latency, and CPU time per sample
+juce::String benchmark_block_fifo(int block_size);
+
+// audio thread time per block (mean and worst) of the non-uniform engine with all stages inline against the
+// late stages on the worker thread, fed in real time at 48 kHz, with the deadline misses and the output difference
+juce::String benchmark_time_distributed(int block_size);
+
+// CPU time per block on silent input with the silence bypass against full processing, and the output difference
+// between both over signal bursts separated by silence (must be zero, the bypass is bit-exact)
+juce::String benchmark_silence_bypass(int block_size);
+
+// CPU time per block with and without the HRTF crossfade while the direction stays the same (must not change) and
+// while it changes every block, and the largest sample-to-sample step of a sine with abrupt and crossfaded switching
+juce::String benchmark_hrtf_crossfade(int block_size);
+
+// HRTF interpolation on a sphere grid: sum of the weights over random directions (must be 1), output difference at the
+// measured directions (must be ~0), time per interpolated direction on the worker and audio thread time per block
+// for a static against a moving source
+juce::String benchmark_hrtf_interpolation(int block_size);
+
+// minimum phase HRIRs plus a fractional delay per ear against the measured HRIRs: length and FFT size before and
+// after, error of the estimated delays, output difference in dB and CPU time per block of each mode
+juce::String benchmark_minimum_phase(int block_size);
+
+// cache of loaded filters for head-tracked sources: hit rate and evictions for a memory budget, time per direction
+// update for the interpolation, the interpolation and load_filter() and through the cache, difference to the loaded
+// filters (must be zero) and torn reads of lock-free lookups while a writer evicts (must be zero)
+juce::String benchmark_hrtf_cache(size_t memory_budget);
+
+// spherical harmonic fits of a sphere grid set over the order: memory against the measured table and the engine
+// spectra, error at the measured directions, difference to the triangle interpolation at random directions, time of
+// the dot products with the best and the scalar kernel and per synthesized direction
+juce::String benchmark_spherical_harmonics();
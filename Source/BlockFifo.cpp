@@ -0,0 +1,109 @@
+/*
+  ==============================================================================
+
+    BlockFifo.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "BlockFifo.h"
+
+template <typename Sample>
+BlockFifoT<Sample>::BlockFifoT() {
+}
+
+template <typename Sample>
+BlockFifoT<Sample>::~BlockFifoT() {
+
+    release();
+}
+
+template <typename Sample>
+void BlockFifoT<Sample>::prepare(int new_block_size) {
+
+    release();
+
+    if (new_block_size <= 0)
+        return;
+
+    block_size = new_block_size;
+    input_block = (Sample*)calloc(block_size, sizeof(Sample));
+    output_left = (Sample*)calloc(block_size, sizeof(Sample));
+    output_right = (Sample*)calloc(block_size, sizeof(Sample));
+    fill = 0;
+}
+
+template <typename Sample>
+void BlockFifoT<Sample>::release() {
+
+    free(input_block);
+    free(output_left);
+    free(output_right);
+
+    input_block = NULL;
+    output_left = NULL;
+    output_right = NULL;
+
+    block_size = 0;
+    fill = 0;
+}
+
+template <typename Sample>
+void BlockFifoT<Sample>::reset() {
+
+    if (input_block == NULL)
+        return;
+
+    memset(input_block, 0, sizeof(Sample) * block_size);
+    memset(output_left, 0, sizeof(Sample) * block_size);
+    memset(output_right, 0, sizeof(Sample) * block_size);
+    fill = 0;
+}
+
+template <typename Sample>
+bool BlockFifoT<Sample>::process(ConvolutionEngineT<Sample>* engine, const Sample* input, Sample* left, Sample* right, int count, int sel) {
+
+    if (input_block == NULL)
+        return false;
+
+    bool processed = true;
+    int pos = 0;
+    convolved_blocks = 0;
+
+    while (pos < count) {
+        int take = block_size - fill;
+        if (take > count - pos)
+            take = count - pos;
+
+        // sample i of the internal block comes out block_size samples later at the same position,
+        // the input is read before the output overwrites it, as both may alias
+        memcpy(input_block + fill, input + pos, sizeof(Sample) * take);
+        memcpy(left + pos, output_left + fill, sizeof(Sample) * take);
+        if (right != NULL)
+            memcpy(right + pos, output_right + fill, sizeof(Sample) * take);
+
+        fill += take;
+        pos += take;
+
+        if (fill < block_size)
+            break;
+
+        fill = 0;
+
+        if (engine != NULL && engine->process(input_block, output_left, (right != NULL) ? output_right : NULL, block_size, sel)) {
+            convolved_blocks++;
+            continue;
+        }
+
+        processed = processed && engine == NULL;
+        memcpy(output_left, input_block, sizeof(Sample) * block_size);
+        memcpy(output_right, input_block, sizeof(Sample) * block_size);
+    }
+
+    return processed;
+}
+
+template class BlockFifoT<float>;
+template class BlockFifoT<double>;
@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    BlockFifo.h
+
+    Input / output FIFO in front of the engines that only take blocks of a
+    fixed size (overlap-add and uniform partitioned). Host blocks of any
+    length, including single samples, are collected until a full internal
+    block of block_size samples is there, which then gets convolved at once.
+    The output is read from the result of the previous internal block, so
+    the FIFO adds exactly block_size samples of latency.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "ConvolutionEngine.h"
+
+template <typename Sample>
+class BlockFifoT
+{
+public:
+    BlockFifoT();
+    ~BlockFifoT();
+
+    // internal block size, usually the samplesPerBlock of prepareToPlay
+    void prepare(int block_size);
+    void release();
+    // clear the collected input and the pending output
+    void reset();
+
+    // push count samples of any length and read the same number of delayed output samples,
+    // input may alias left, right may be NULL (only the left ear is written then)
+    // every full block is convolved by engine with HRTF sel, engine NULL only delays the input
+    // returns false if engine refused a block, the dry input is delayed in its place then
+    bool process(ConvolutionEngineT<Sample>* engine, const Sample* input, Sample* left, Sample* right, int count, int sel);
+
+    int get_block_size() const { return block_size; }
+    int get_latency() const { return block_size; }
+    // internal blocks the engine convolved in the last process() call, a short host block may not complete any
+    int get_convolved_blocks() const { return convolved_blocks; }
+
+private:
+    int block_size = 0;
+    // samples collected in input_block, also the read position in the output blocks
+    int fill = 0;
+    int convolved_blocks = 0;
+
+    Sample* input_block = NULL;
+    // result of the last full block, read while the next one is collected
+    Sample* output_left = NULL;
+    Sample* output_right = NULL;
+};
+
+typedef BlockFifoT<float> BlockFifo;
@@ -0,0 +1,885 @@
+/*
+  ==============================================================================
+
+    ConvolutionEngine.cpp
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "ConvolutionEngine.h"
+#include "SpectralKernels.h"
+
+split_complex hrtf_buffer_sc::get_spectrum(int hrtf, int ear) const {
+
+    float* re = spectra + ((size_t)hrtf * 2 + ear) * 2 * spectrum_stride;
+    return { re, re + spectrum_stride };
+}
+
+void hrtf_buffer_sc::allocate_spectra(int k) {
+
+    free_spectra();
+
+    spectrum_stride = split_stride(k / 2 + 1);
+    size_t floats = (size_t)num_hrtfs * 4 * spectrum_stride;
+    spectra = fft_alloc_real(floats);
+    memset(spectra, 0, sizeof(float) * floats);
+}
+
+void hrtf_buffer_sc::free_spectra() {
+
+    fft_free(spectra);
+    spectra = NULL;
+    spectrum_stride = 0;
+}
+
+void hrtf_buffer_sc::release() {
+
+    free_spectra();
+
+    if (time_left != NULL) {
+        for (int i = 0; i < num_hrtfs; i++) {
+            free(time_left[i]);
+            free(time_right[i]);
+        }
+    }
+    free(time_left);
+    free(time_right);
+    free(azimuth);
+    free(elevation);
+    free(delay_left);
+    free(delay_right);
+
+    time_left = time_right = NULL;
+    azimuth = elevation = NULL;
+    delay_left = delay_right = NULL;
+    num_hrtfs = 0;
+    num_samples = 0;
+    prescaled = false;
+}
+
+template <typename Sample>
+ConvolutionEngineT<Sample>::ConvolutionEngineT(FFTPlanCache& plans)
+    : fft_plans(plans), uniform_conv(plans), nonuniform_conv(plans) {
+}
+
+template <typename Sample>
+ConvolutionEngineT<Sample>::~ConvolutionEngineT() {
+
+    release();
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::prepare(int new_block_size, int new_k, const hrtf_buffer_sc& new_hrtfs, FFTPlanCache* transform_plans) {
+
+    release();
+
+    if (new_block_size <= 0 || new_k <= 0 || new_hrtfs.num_hrtfs <= 0 || new_hrtfs.time_left == NULL)
+        return false;
+
+    block_size = new_block_size;
+    k = new_k;
+    num_filters = new_hrtfs.num_hrtfs + extra_filters;
+
+    // overlap-add buffers, these used to be (re)allocated inside processBlock
+    conv_buffer_left = fft_alloc<Sample>(k + 2);
+    conv_buffer_right = fft_alloc<Sample>(k + 2);
+    fade_buffer_left = fft_alloc<Sample>(k + 2);
+    fade_buffer_right = fft_alloc<Sample>(k + 2);
+
+    ring_size = 1;
+    while (ring_size < k + block_size)
+        ring_size <<= 1;
+    ring_left = (Sample*)calloc(ring_size, sizeof(Sample));
+    ring_right = (Sample*)calloc(ring_size, sizeof(Sample));
+    ring_head = 0;
+
+    tail_length = block_size + new_hrtfs.num_samples - 1;
+    if (tail_length > k)
+        tail_length = k;
+    discard = (Sample*)malloc(sizeof(Sample) * block_size);
+
+    int stride = split_stride(k / 2 + 1);
+    split_buffer = fft_alloc<Sample>(6 * stride);
+    input_spectrum = { split_buffer, split_buffer + stride };
+    result_left = { split_buffer + 2 * stride, split_buffer + 3 * stride };
+    result_right = { split_buffer + 4 * stride, split_buffer + 5 * stride };
+
+    // FFTW gives N/2+1 complex values as a result of a N-sized real-valued FFT
+    scratch_spec1 = fft_alloc<bin_type>(k / 2 + 1);
+    scratch_spec2 = fft_alloc<bin_type>(k / 2 + 1);
+    scratch_result = fft_alloc<bin_type>(k / 2 + 1);
+    packed = fft_alloc<bin_type>(k);
+    packed_result = fft_alloc<bin_type>(k);
+
+    FFTPlanCache& plans = (transform_plans != NULL) ? *transform_plans : fft_plans;
+
+    // the transforms only give zeros for a size that is not prepared, so the engine is not used without all of them
+    int uniform_size = (partition_size > 0 && block_size % partition_size == 0) ? partition_size : block_size;
+
+    if (!fft_plans.prepare_for<Sample>(k) || !plans.prepare_for<Sample>(k)
+        // both partitioned engines are kept ready, so the mode can be switched while playing
+        || !uniform_conv.prepare(uniform_size, num_filters, new_hrtfs.num_samples)
+        // the worker thread is only started for time_distributed, switching to or from it needs a new prepare()
+        || !nonuniform_conv.prepare(block_size, num_filters, new_hrtfs.num_samples, mode == time_distributed)
+        || !uniform_conv.prepare_plans(plans) || !nonuniform_conv.prepare_plans(plans)) {
+        release();
+        return false;
+    }
+
+    prepare_spectra(new_hrtfs, plans);
+
+    // the FIR taps are only kept for HRIRs short enough to ever be convolved directly
+    if (new_hrtfs.num_samples <= max_direct_taps)
+        direct_conv.prepare(block_size, num_filters, new_hrtfs.num_samples);
+
+    // minimum phase HRIRs: the delay lines reach the largest delay of the set, the extra filters start without one
+    if (new_hrtfs.delay_left != NULL && new_hrtfs.delay_right != NULL) {
+        filter_delays = (float*)calloc(2 * num_filters, sizeof(float));
+        float max_delay = 0.f;
+        for (int i = 0; i < new_hrtfs.num_hrtfs; i++) {
+            filter_delays[2 * i] = new_hrtfs.delay_left[i];
+            filter_delays[2 * i + 1] = new_hrtfs.delay_right[i];
+            max_delay = std::fmax(max_delay, std::fmax(new_hrtfs.delay_left[i], new_hrtfs.delay_right[i]));
+        }
+        delay_line_left.prepare((int)std::ceil(max_delay), block_size);
+        delay_line_right.prepare((int)std::ceil(max_delay), block_size);
+    }
+
+    for (int i = 0; i < new_hrtfs.num_hrtfs; i++) {
+        uniform_conv.load_filter(i, new_hrtfs.time_left[i], new_hrtfs.time_right[i], new_hrtfs.num_samples, plans);
+        nonuniform_conv.load_filter(i, new_hrtfs.time_left[i], new_hrtfs.time_right[i], new_hrtfs.num_samples, plans);
+        direct_conv.set_filter(i, new_hrtfs.time_left[i], new_hrtfs.time_right[i], new_hrtfs.num_samples);
+    }
+    uniform_conv.reset();
+    nonuniform_conv.reset();
+
+    // the longest history of all engines, so switching the mode while bypassed does not matter
+    bypass_length = k + block_size;
+    int uniform_history = (uniform_conv.get_num_partitions() + 1) * uniform_conv.get_block_size() + block_size;
+    if (uniform_history > bypass_length)
+        bypass_length = uniform_history;
+    if (direct_conv.get_num_taps() + block_size > bypass_length)
+        bypass_length = direct_conv.get_num_taps() + block_size;
+    if (nonuniform_conv.get_history_length() > bypass_length)
+        bypass_length = nonuniform_conv.get_history_length();
+    // the delay lines come after the convolution
+    bypass_length += delay_line_left.get_history_length();
+    // all buffers are cleared
+    silent_samples = bypass_length;
+    bypassed = false;
+
+    auto_mode = uniform_partitioned;
+    if (direct_conv.get_num_taps() > 0
+        && estimate_direct_cost(block_size, new_hrtfs.num_samples) <= estimate_fft_cost(block_size, new_hrtfs.num_samples))
+        auto_mode = direct_form;
+
+    set_synthesis(synthesis);
+    set_crossfade(crossfade);
+    current_sel = -1;
+    last_active = -1;
+
+    hrtfs = &new_hrtfs;
+
+    return true;
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::release() {
+
+    hrtfs = NULL;
+
+    fft_free(conv_buffer_left);
+    fft_free(conv_buffer_right);
+    fft_free(fade_buffer_left);
+    fft_free(fade_buffer_right);
+    free(ring_left);
+    free(ring_right);
+    free(discard);
+
+    fft_free(split_buffer);
+    fft_free(scratch_spec1);
+    fft_free(scratch_spec2);
+    fft_free(scratch_result);
+    fft_free(packed);
+    fft_free(packed_result);
+    fft_free(hrtf_spectra);
+
+    conv_buffer_left = NULL;
+    conv_buffer_right = NULL;
+    fade_buffer_left = NULL;
+    fade_buffer_right = NULL;
+    ring_left = NULL;
+    ring_right = NULL;
+    discard = NULL;
+    split_buffer = NULL;
+    input_spectrum = {};
+    result_left = {};
+    result_right = {};
+    scratch_spec1 = NULL;
+    scratch_spec2 = NULL;
+    scratch_result = NULL;
+    packed = NULL;
+    packed_result = NULL;
+    hrtf_spectra = NULL;
+    hrtf_stride = 0;
+
+    uniform_conv.release();
+    nonuniform_conv.release();
+    direct_conv.release();
+
+    free(filter_delays);
+    filter_delays = NULL;
+    delay_line_left.release();
+    delay_line_right.release();
+
+    ring_size = 0;
+    ring_head = 0;
+    tail_length = 0;
+    block_size = 0;
+    k = 0;
+    num_filters = 0;
+    bypass_length = 0;
+    silent_samples = 0;
+    bypassed = false;
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::reset() {
+
+    if (ring_left != NULL) {
+        memset(ring_left, 0, sizeof(Sample) * ring_size);
+        memset(ring_right, 0, sizeof(Sample) * ring_size);
+        ring_head = 0;
+    }
+
+    uniform_conv.reset();
+    nonuniform_conv.reset();
+    direct_conv.reset();
+    delay_line_left.reset();
+    delay_line_right.reset();
+
+    silent_samples = bypass_length;
+    bypassed = false;
+    current_sel = -1;
+    last_active = -1;
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::set_crossfade(bool new_crossfade) {
+
+    crossfade = new_crossfade;
+    uniform_conv.crossfade = crossfade;
+    nonuniform_conv.set_crossfade(crossfade);
+    direct_conv.crossfade = crossfade;
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::set_synthesis(int new_synthesis) {
+
+    synthesis = new_synthesis;
+    uniform_conv.packed_ifft = (synthesis == packed_ifft);
+    nonuniform_conv.set_packed_ifft(synthesis == packed_ifft);
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::needs_fixed_blocks() const {
+
+    int active = (mode == automatic) ? auto_mode : mode;
+
+    // same fallback as in process()
+    if (active == direct_form)
+        return direct_conv.get_num_taps() == 0;
+
+    return active != non_uniform_partitioned && active != time_distributed;
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::process(const Sample* input, Sample* left, Sample* right, int n, int sel) {
+
+    if (!convolve(input, left, right, n, sel))
+        return false;
+
+    if (filter_delays == NULL)
+        return true;
+
+    // the interaural delay of minimum phase HRIRs, the delay lines are silent as well while the engine is bypassed
+    if (bypassed) {
+        delay_line_left.set_delay(filter_delays[2 * sel]);
+        delay_line_right.set_delay(filter_delays[2 * sel + 1]);
+        return true;
+    }
+
+    delay_line_left.process(left, n, filter_delays[2 * sel]);
+    if (right != NULL)
+        delay_line_right.process(right, n, filter_delays[2 * sel + 1]);
+    return true;
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::convolve(const Sample* input, Sample* left, Sample* right, int n, int sel) {
+
+    if (hrtfs == NULL || sel < 0 || sel >= num_filters)
+        return false;
+
+    int active = (mode == automatic) ? auto_mode : mode;
+    // the non-uniform engine was prepared with its worker thread for this mode
+    if (active == time_distributed)
+        active = non_uniform_partitioned;
+
+    // only the uniform engine can skip the right ear, the others write it to scratch (n <= block_size for all of them)
+    Sample* right_out = (right != NULL) ? right : discard;
+
+    // the state was already all zero before this silent block, so is the output. only the non-uniform engine
+    // depends on the absolute position (its partition boundaries) and is advanced, the others are shift invariant
+    bool silent = bypass_silence && n <= block_size && is_silent(input, n);
+    bypassed = silent && silent_samples >= bypass_length && (n == block_size || !needs_fixed_blocks());
+    silent_samples = silent ? ((silent_samples + n < bypass_length) ? silent_samples + n : bypass_length) : 0;
+
+    if (bypassed) {
+        memset(left, 0, sizeof(Sample) * n);
+        if (right != NULL)
+            memset(right, 0, sizeof(Sample) * n);
+        if (active == non_uniform_partitioned)
+            nonuniform_conv.skip(n);
+
+        // a change of direction during silence has nothing to fade, the engines continue with the new HRTF
+        if (sel != current_sel) {
+            uniform_conv.set_current_filter(sel);
+            nonuniform_conv.set_current_filter(sel);
+            direct_conv.set_current_filter(sel);
+            current_sel = sel;
+        }
+        return true;
+    }
+
+    // HRIRs longer than max_direct_taps have no FIR taps, the uniform engine takes over
+    if (active == direct_form) {
+        if (n <= direct_conv.get_max_block_size() && direct_conv.get_num_taps() > 0) {
+            switch_to(direct_form, sel);
+            direct_conv.process(input, left, right_out, n, sel);
+            return true;
+        }
+        active = uniform_partitioned;
+    }
+
+    // the uniform and overlap-add paths run on fixed blocks of the size announced in prepareToPlay
+    // the uniform engine processes the block in partitions, each one reads its input before writing its output
+    if (active == uniform_partitioned && n == block_size && uniform_conv.get_block_size() > 0) {
+        switch_to(uniform_partitioned, sel);
+        int p = uniform_conv.get_block_size();
+        for (int i = 0; i < n; i += p)
+            uniform_conv.process(input + i, left + i, (right != NULL) ? right + i : NULL, sel);
+        return true;
+    }
+
+    if (active == non_uniform_partitioned && n <= nonuniform_conv.get_max_block_size()) {
+        switch_to(non_uniform_partitioned, sel);
+        nonuniform_conv.process(input, left, right_out, n, sel);
+        return true;
+    }
+
+    if (n == block_size && block_size <= k) {
+        switch_to(overlap_add, sel);
+        process_overlap_add(input, left, right_out, sel, silent);
+        return true;
+    }
+
+    return false;
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::switch_to(int active, int sel) {
+
+    if (active == last_active)
+        return;
+
+    // its history and current filter are left from the last time it was active, the old input would ring out into
+    // this block and the filter may have been loaded again since. it starts from silence, the non-uniform engine
+    // with its partition boundaries at this block (the position reset() leaves it at)
+    switch (active) {
+    case direct_form:
+        direct_conv.reset();
+        direct_conv.set_current_filter(sel);
+        break;
+    case uniform_partitioned:
+        uniform_conv.reset();
+        uniform_conv.set_current_filter(sel);
+        break;
+    case non_uniform_partitioned:
+        nonuniform_conv.reset();
+        nonuniform_conv.set_current_filter(sel);
+        break;
+    default:
+        if (ring_left != NULL) {
+            memset(ring_left, 0, sizeof(Sample) * ring_size);
+            memset(ring_right, 0, sizeof(Sample) * ring_size);
+            ring_head = 0;
+        }
+        current_sel = sel;
+        break;
+    }
+    last_active = active;
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::uses_filter(int index) const {
+
+    switch (last_active) {
+    case direct_form: return direct_conv.uses_filter(index);
+    case uniform_partitioned: return uniform_conv.uses_filter(index);
+    case non_uniform_partitioned: return nonuniform_conv.uses_filter(index);
+    case overlap_add: return current_sel == index;
+    default: return false;
+    }
+}
+
+const char* ConvolutionEngineBase::get_mode_name(int mode) {
+
+    switch (mode) {
+    case overlap_add: return "overlap-add";
+    case uniform_partitioned: return "uniform partitioned";
+    case non_uniform_partitioned: return "non-uniform partitioned";
+    case direct_form: return "direct-form FIR";
+    case automatic: return "automatic";
+    case time_distributed: return "time-distributed";
+    default: return "unknown";
+    }
+}
+
+// rough cycle counts per output sample, only the ratio between both estimates matters
+float ConvolutionEngineBase::estimate_direct_cost(int block_size, int ir_length) {
+
+    float width = (float)get_kernel_width(get_kernel());
+
+    // one fused multiply-add per tap and ear on full vectors, two of them per cycle
+    float taps = ir_length / width;
+    // the block is copied into the history and the last ir_length - 1 samples are moved back, once per block
+    float history = (ir_length - 1 + block_size) / (width * block_size);
+
+    return taps + history;
+}
+
+float ConvolutionEngineBase::estimate_fft_cost(int block_size, int ir_length) {
+
+    float fft_size = 2.f * block_size;
+    float num_partitions = (float)((ir_length + block_size - 1) / block_size);
+
+    // about 2.5 N log2(N) flops per real FFT: one forward and two inverse transforms per block
+    float transforms = 3.f * 2.5f * fft_size * std::log2(fft_size);
+    // one complex multiply-add (8 flops) per bin, partition and ear
+    float spectral = 2.f * num_partitions * (block_size + 1) * 8.f;
+    // FDL bookkeeping, copies and overlap-save cropping
+    float overhead = 4.f * fft_size;
+
+    // small FFTs and the spectral loops are bound by loads and shuffles,
+    // FFTW reaches roughly 0.7 flops per cycle and vector lane there
+    float flops_per_cycle = 0.7f * get_kernel_width(get_kernel());
+
+    return (transforms + spectral + overhead) / (flops_per_cycle * block_size);
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::process_overlap_add(const Sample* input, Sample* left, Sample* right, int sel, bool silent) {
+
+    int n = block_size;
+    int mask = ring_size - 1;
+
+    // a silent block adds nothing to the ring, the tails of the previous blocks are still read out below
+    if (!silent) {
+        // zero padded input block
+        memcpy(conv_buffer_left, input, (sizeof(Sample) * n));
+
+        // fill space from n to k with zeroes
+        for (int i = n; i < k; i++) {
+            conv_buffer_left[i] = 0.;
+        }
+
+        // both ears hear the same input, so it is transformed only once
+        fft_plans.perform_fft(k, conv_buffer_left, scratch_spec1, input_spectrum);
+
+        multiply(k / 2 + 1, input_spectrum, get_hrtf_spectrum(sel, 0), result_left);
+        multiply(k / 2 + 1, input_spectrum, get_hrtf_spectrum(sel, 1), result_right);
+        synthesize(conv_buffer_left, conv_buffer_right);
+
+        // the old HRTF's result of this block fades out over the first n samples, the tails of the
+        // previous blocks in the ring stay as they are
+        if (crossfade && current_sel >= 0 && current_sel != sel && current_sel < num_filters) {
+            multiply(k / 2 + 1, input_spectrum, get_hrtf_spectrum(current_sel, 0), result_left);
+            multiply(k / 2 + 1, input_spectrum, get_hrtf_spectrum(current_sel, 1), result_right);
+            synthesize(fade_buffer_left, fade_buffer_right);
+            ::crossfade(fade_buffer_left, conv_buffer_left, n);
+            ::crossfade(fade_buffer_right, conv_buffer_right, n);
+        }
+
+        // overlap and add: the new result starts at the ring head, where the tails of the previous blocks are already waiting
+        for (int i = 0; i < tail_length; i++) {
+            ring_left[(ring_head + i) & mask] += conv_buffer_left[i];
+            ring_right[(ring_head + i) & mask] += conv_buffer_right[i];
+        }
+    }
+
+    // the first n samples are complete now, write them out and clear them for future blocks
+    for (int i = 0; i < n; i++) {
+        int pos = (ring_head + i) & mask;
+        left[i] = ring_left[pos];
+        right[i] = ring_right[pos];
+        ring_left[pos] = 0;
+        ring_right[pos] = 0;
+    }
+
+    ring_head = (ring_head + n) & mask;
+    current_sel = sel;
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::synthesize(Sample* out_left, Sample* out_right) {
+
+    if (synthesis == packed_ifft) {
+        // only the samples that reach the ring are written, 1/k is applied while unpacking unless the spectra carry it
+        Sample scale = spectra_prescaled() ? (Sample)1 : (Sample)1 / k;
+        fft_plans.perform_ifft_pair(k, result_left, result_right, packed, packed_result,
+                                    out_left, out_right, 0, tail_length, scale);
+        return;
+    }
+
+    fft_plans.perform_ifft(k, result_left, scratch_spec1, out_left);
+    fft_plans.perform_ifft(k, result_right, scratch_spec1, out_right);
+    if (!spectra_prescaled()) {
+        Sample scale = (Sample)1 / k;
+        for (int i = 0; i < tail_length; i++) {
+            out_left[i] *= scale;
+            out_right[i] *= scale;
+        }
+    }
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::fftw_convolution(int n, Sample* input1, Sample* input2, Sample* output) {
+
+    if (scratch_result == NULL || n > k)
+        return;
+
+    // FFTW gives N/2+1 complex values as a result of a N-sized real-valued FFT
+    int m = n / 2 + 1;
+
+    fft_plans.perform_fft(n, input1, scratch_spec1);
+    fft_plans.perform_fft(n, input2, scratch_spec2);
+
+    complex_multiply(scratch_spec1, scratch_spec2, scratch_result, m);
+
+    fft_plans.perform_ifft(n, scratch_result, output);
+
+    normalize(n, output);
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::fftw_convolution(int n, Sample* input1, bin_type* input2, Sample* output) {
+
+    if (scratch_result == NULL || n > k)
+        return;
+
+    int m = n / 2 + 1;
+
+    fft_plans.perform_fft(n, input1, scratch_spec1);
+
+    complex_multiply(scratch_spec1, input2, scratch_result, m);
+
+    fft_plans.perform_ifft(n, scratch_result, output);
+
+    normalize(n, output);
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::fftw_convolution(int n, bin_type* input1, bin_type* input2, Sample* output, bool prescaled) {
+
+    if (scratch_result == NULL || n > k)
+        return;
+
+    int m = n / 2 + 1;
+
+    complex_multiply(input1, input2, scratch_result, m);
+
+    fft_plans.perform_ifft(n, scratch_result, output);
+
+    if (!prescaled)
+        normalize(n, output);
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::fftw_convolution(int n, bin_type* spectrum, bin_type** filters, Sample** outputs, int num_outputs, bool prescaled) {
+
+    for (int i = 0; i < num_outputs; i++)
+        fftw_convolution(n, spectrum, filters[i], outputs[i], prescaled);
+}
+
+template <typename Sample>
+void ConvolutionEngineT<Sample>::multiply(int m, spectrum_type input1, spectrum_type input2, spectrum_type output) {
+
+    complex_multiply(input1, input2, output, m);
+}
+
+void ConvolutionEngineBase::normalize(int n, float* data) {
+
+    for (int i = 0; i < n; i++) {
+        data[i] /= n;
+    }
+}
+
+void ConvolutionEngineBase::normalize(int n, double* data) {
+
+    for (int i = 0; i < n; i++) {
+        data[i] /= n;
+    }
+}
+
+void ConvolutionEngineBase::prescale(int n, fft_complex* spectrum) {
+
+    float scale = 1.f / n;
+    float* data = (float*)spectrum;
+
+    for (int i = 0; i < 2 * (n / 2 + 1); i++)
+        data[i] *= scale;
+}
+
+void ConvolutionEngineBase::prescale(int n, split_complex spectrum) {
+
+    float scale = 1.f / n;
+
+    for (int i = 0; i < n / 2 + 1; i++) {
+        spectrum.re[i] *= scale;
+        spectrum.im[i] *= scale;
+    }
+}
+
+void ConvolutionEngineBase::prescale(int n, split_complex_d spectrum) {
+
+    double scale = 1. / n;
+
+    for (int i = 0; i < n / 2 + 1; i++) {
+        spectrum.re[i] *= scale;
+        spectrum.im[i] *= scale;
+    }
+}
+
+bool ConvolutionEngineBase::transform_hrir(FFTPlanCache& plans, int k, const float* hrir, int length, split_complex spectrum) {
+
+    if (!plans.prepare(k))
+        return false;
+
+    float* padded = fft_alloc_real(k + 2);
+    fft_complex* scratch = fft_alloc_complex(k / 2 + 1);
+
+    int count = (length < k) ? length : k;
+    memcpy(padded, hrir, sizeof(float) * count);
+    memset(padded + count, 0, sizeof(float) * (k - count));
+
+    plans.perform_fft(k, padded, scratch, spectrum);
+    prescale(k, spectrum);
+
+    fft_free(padded);
+    fft_free(scratch);
+
+    return true;
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::load_filter(int index, const float* left, const float* right, FFTPlanCache& plans,
+                                             float delay_left, float delay_right) {
+
+    // the filters of the HRTF set belong to prepare()
+    if (hrtfs == NULL || index < hrtfs->num_hrtfs || index >= num_filters)
+        return false;
+
+    // the transforms do not plan, plans other than the engine's own may not have seen the sizes yet
+    if (!plans.prepare_for<Sample>(k) || !uniform_conv.prepare_plans(plans) || !nonuniform_conv.prepare_plans(plans))
+        return false;
+
+    if (filter_delays != NULL) {
+        filter_delays[2 * index] = delay_left;
+        filter_delays[2 * index + 1] = delay_right;
+    }
+
+    int m = hrtfs->num_samples;
+
+    uniform_conv.load_filter(index, left, right, m, plans);
+    nonuniform_conv.load_filter(index, left, right, m, plans);
+    direct_conv.load_filter(index, left, right, m);
+    load_spectra(index, left, right, plans);
+
+    return true;
+}
+
+template <typename Sample>
+int ConvolutionEngineT<Sample>::get_filter_values() const {
+
+    if (!is_prepared())
+        return 0;
+
+    // what load_filter() writes: the sub-engines, the overlap-add spectra of both ears and the delays
+    return uniform_conv.get_filter_values() + nonuniform_conv.get_filter_values() + direct_conv.get_filter_values()
+           + ((hrtf_spectra != NULL) ? 4 * hrtf_stride : 0) + ((filter_delays != NULL) ? 2 : 0);
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::save_filter(int index, Sample* values) const {
+
+    if (hrtfs == NULL || index < hrtfs->num_hrtfs || index >= num_filters)
+        return false;
+
+    uniform_conv.save_filter(index, values);
+    values += uniform_conv.get_filter_values();
+    nonuniform_conv.save_filter(index, values);
+    values += nonuniform_conv.get_filter_values();
+    direct_conv.save_filter(index, values);
+    values += direct_conv.get_filter_values();
+
+    // both ears of a filter are one block, see get_hrtf_spectrum()
+    if (hrtf_spectra != NULL) {
+        memcpy(values, get_hrtf_spectrum(index, 0).re, sizeof(Sample) * 4 * hrtf_stride);
+        values += 4 * hrtf_stride;
+    }
+    if (filter_delays != NULL) {
+        values[0] = filter_delays[2 * index];
+        values[1] = filter_delays[2 * index + 1];
+    }
+
+    return true;
+}
+
+template <typename Sample>
+bool ConvolutionEngineT<Sample>::restore_filter(int index, const Sample* values) {
+
+    if (hrtfs == NULL || index < hrtfs->num_hrtfs || index >= num_filters)
+        return false;
+
+    uniform_conv.restore_filter(index, values);
+    values += uniform_conv.get_filter_values();
+    nonuniform_conv.restore_filter(index, values);
+    values += nonuniform_conv.get_filter_values();
+    direct_conv.restore_filter(index, values);
+    values += direct_conv.get_filter_values();
+
+    if (hrtf_spectra != NULL) {
+        memcpy(get_hrtf_spectrum(index, 0).re, values, sizeof(Sample) * 4 * hrtf_stride);
+        values += 4 * hrtf_stride;
+    }
+    if (filter_delays != NULL) {
+        filter_delays[2 * index] = (float)values[0];
+        filter_delays[2 * index + 1] = (float)values[1];
+    }
+
+    return true;
+}
+
+template <>
+void ConvolutionEngineT<float>::prepare_spectra(const hrtf_buffer_sc&, FFTPlanCache&) {
+
+    // the HRTF set has no room for the extra filters
+    if (extra_filters <= 0)
+        return;
+
+    hrtf_stride = split_stride(k / 2 + 1);
+    size_t values = (size_t)extra_filters * 4 * hrtf_stride;
+    hrtf_spectra = fft_alloc<float>(values);
+    memset(hrtf_spectra, 0, sizeof(float) * values);
+}
+
+template <>
+void ConvolutionEngineT<double>::prepare_spectra(const hrtf_buffer_sc& new_hrtfs, FFTPlanCache& plans) {
+
+    // same layout and scaling as hrtf_buffer_sc::spectra, transformed from the float HRIRs in double precision
+    hrtf_stride = split_stride(k / 2 + 1);
+    size_t values = (size_t)num_filters * 4 * hrtf_stride;
+    hrtf_spectra = fft_alloc<double>(values);
+    memset(hrtf_spectra, 0, sizeof(double) * values);
+
+    int count = (new_hrtfs.num_samples < k) ? new_hrtfs.num_samples : k;
+
+    for (int i = 0; i < new_hrtfs.num_hrtfs; i++) {
+        for (int ear = 0; ear < 2; ear++) {
+            const float* hrir = (ear == 0) ? new_hrtfs.time_left[i] : new_hrtfs.time_right[i];
+            double* re = hrtf_spectra + ((size_t)i * 2 + ear) * 2 * hrtf_stride;
+
+            for (int j = 0; j < count; j++)
+                conv_buffer_left[j] = hrir[j];
+            memset(conv_buffer_left + count, 0, sizeof(double) * (k - count));
+
+            plans.perform_fft(k, conv_buffer_left, scratch_spec1, split_complex_d{ re, re + hrtf_stride });
+            prescale(k, split_complex_d{ re, re + hrtf_stride });
+        }
+    }
+}
+
+template <>
+split_complex ConvolutionEngineT<float>::get_hrtf_spectrum(int hrtf, int ear) const {
+
+    if (hrtf < hrtfs->num_hrtfs)
+        return hrtfs->get_spectrum(hrtf, ear);
+
+    float* re = hrtf_spectra + ((size_t)(hrtf - hrtfs->num_hrtfs) * 2 + ear) * 2 * hrtf_stride;
+    return { re, re + hrtf_stride };
+}
+
+template <>
+split_complex_d ConvolutionEngineT<double>::get_hrtf_spectrum(int hrtf, int ear) const {
+
+    double* re = hrtf_spectra + ((size_t)hrtf * 2 + ear) * 2 * hrtf_stride;
+    return { re, re + hrtf_stride };
+}
+
+template <>
+bool ConvolutionEngineT<float>::spectra_prescaled() const {
+
+    return hrtfs->prescaled;
+}
+
+template <>
+bool ConvolutionEngineT<double>::spectra_prescaled() const {
+
+    return true;
+}
+
+template <>
+void ConvolutionEngineT<float>::load_spectra(int index, const float* left, const float* right, FFTPlanCache& plans) {
+
+    for (int ear = 0; ear < 2; ear++) {
+        split_complex spectrum = get_hrtf_spectrum(index, ear);
+        transform_hrir(plans, k, (ear == 0) ? left : right, hrtfs->num_samples, spectrum);
+
+        // same scaling as the spectra of the set
+        if (!hrtfs->prescaled) {
+            for (int i = 0; i < k / 2 + 1; i++) {
+                spectrum.re[i] *= k;
+                spectrum.im[i] *= k;
+            }
+        }
+    }
+}
+
+template <>
+void ConvolutionEngineT<double>::load_spectra(int index, const float* left, const float* right, FFTPlanCache& plans) {
+
+    double* padded = fft_alloc<double>(k + 2);
+    fft_complex_d* scratch = fft_alloc<fft_complex_d>(k / 2 + 1);
+    int count = (hrtfs->num_samples < k) ? hrtfs->num_samples : k;
+
+    for (int ear = 0; ear < 2; ear++) {
+        const float* hrir = (ear == 0) ? left : right;
+        for (int j = 0; j < count; j++)
+            padded[j] = hrir[j];
+        memset(padded + count, 0, sizeof(double) * (k - count));
+
+        split_complex_d spectrum = get_hrtf_spectrum(index, ear);
+        plans.perform_fft(k, padded, scratch, spectrum);
+        prescale(k, spectrum);
+    }
+
+    fft_free(padded);
+    fft_free(scratch);
+}
+
+template class ConvolutionEngineT<float>;
+template class ConvolutionEngineT<double>;
@@ -0,0 +1,283 @@
+/*
+  ==============================================================================
+
+    ConvolutionEngine.h
+
+    Owns everything processBlock needs for the binaural convolution: overlap
+    buffers, spectral scratch and the partitioned convolvers. All memory is
+    allocated in prepare(), which runs in prepareToPlay or on the thread that
+    loads a HRTF set, so process() does no heap operations at all.
+    The engine is templated on the sample type: ConvolutionEngine is the float
+    engine, ConvolutionEngineT<double> the 64-bit one used by the double
+    precision processBlock, which runs on double precision FFTs throughout.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFTBackend.h"
+#include "FFTPlanCache.h"
+#include "UniformConvolver.h"
+#include "NonUniformConvolver.h"
+#include "DirectConvolver.h"
+#include "FractionalDelay.h"
+
+// a loaded set of HRTFs, one stereo filter per direction
+struct hrtf_buffer_sc {
+    // spectra of the zero padded HRIRs (k / 2 + 1 bins) in split layout, used by the overlap-add path
+    // one block for the whole set, [hrtf][ear][re | im] with spectrum_stride floats per part, see get_spectrum()
+    float* spectra = NULL;
+    int spectrum_stride = 0;
+    // time-domain HRIRs, kept for the partitioned convolvers
+    float** time_left = NULL;
+    float** time_right = NULL;
+    int num_hrtfs = 0;
+    int num_samples = 0;
+    int sel = 0;
+    // measurement direction of each HRTF in degrees (azimuth counter-clockwise, elevation up), NULL if the set does not say
+    float* azimuth = NULL;
+    float* elevation = NULL;
+    // delay of each ear in samples, applied after the convolution, for minimum phase HRIRs (see make_minimum_phase())
+    // NULL if the HRIRs carry their delay themselves
+    float* delay_left = NULL;
+    float* delay_right = NULL;
+    // the spectra already include the 1/k scale of the inverse FFT (see ConvolutionEngineBase::prescale),
+    // so the overlap-add path skips the normalize() pass over its output
+    bool prescaled = false;
+
+    // ear 0 is the left, 1 the right one
+    split_complex get_spectrum(int hrtf, int ear) const;
+    // room for num_hrtfs spectra of a k-point FFT (frees the previous ones)
+    void allocate_spectra(int k);
+    void free_spectra();
+    // frees the spectra, HRIRs, directions and delays and leaves an empty set
+    void release();
+};
+
+// modes, cost model and HRIR helpers shared by the float and double engines
+class ConvolutionEngineBase
+{
+public:
+    // convolution algorithm used by process()
+    enum conv_modes {
+        // k-point FFT of each zero padded block against the whole HRIR (overlap-add)
+        overlap_add = 0,
+        // uniformly partitioned overlap-save with partitions of block_size samples
+        uniform_partitioned,
+        // direct-form head plus growing FFT partitions, for long BRIRs
+        non_uniform_partitioned,
+        // time-domain FIR, for short HRIRs (up to max_direct_taps)
+        direct_form,
+        // direct_form or uniform_partitioned, whichever the cost model in prepare() expects to be cheaper
+        automatic,
+        // non_uniform_partitioned with the late partitions computed on a worker thread, applied in prepare()
+        time_distributed
+    };
+
+    // how the time-domain output of both ears is synthesized
+    enum synthesis_modes {
+        // one real inverse FFT per ear, the only one the plugin runs
+        separate_ifft = 0,
+        // both ear spectra packed into one complex inverse FFT (left = real part, right = imaginary part),
+        // only used by benchmark_packed_ifft: rebuilding the upper half costs more than FFTW's c2r transforms save
+        packed_ifft
+    };
+
+    static void normalize(int n, float* data);
+    static void normalize(int n, double* data);
+    // fold the 1/n normalization of an n-point inverse FFT into the n / 2 + 1 bins of a filter spectrum
+    static void prescale(int n, fft_complex* spectrum);
+    static void prescale(int n, split_complex spectrum);
+    static void prescale(int n, split_complex_d spectrum);
+    // zero pad length samples of a HRIR to k, transform and prescale them, for hrtf_buffer_sc::spectra
+    // false if plans could not be prepared for k, spectrum is not written then
+    static bool transform_hrir(FFTPlanCache& plans, int k, const float* hrir, int length, split_complex spectrum);
+
+    static const char* get_mode_name(int mode);
+
+    // estimated cost of one output sample (both ears) of the direct-form FIR and of uniformly partitioned
+    // convolution, in vector operations of the active SIMD kernel
+    static float estimate_direct_cost(int block_size, int ir_length);
+    static float estimate_fft_cost(int block_size, int ir_length);
+
+    // longer HRIRs are never convolved in the time domain, this also bounds the memory of the FIR taps
+    static constexpr int max_direct_taps = 1024;
+};
+
+// Sample is float or double
+template <typename Sample>
+class ConvolutionEngineT : public ConvolutionEngineBase
+{
+public:
+    typedef split_spectrum<Sample> spectrum_type;
+    typedef fft_bin<Sample> bin_type;
+
+    ConvolutionEngineT(FFTPlanCache& plans);
+    ~ConvolutionEngineT();
+
+    // allocate all buffers for blocks of block_size samples and HRTF spectra of size k, and partition the HRIRs
+    // hrtfs has to stay valid until the next prepare() or release()
+    // the HRIRs are transformed with transform_plans if given, so an engine can be prepared next to one the audio
+    // thread runs on the same fft_plans (the FFT backends share their scratch per size)
+    // false if one of the FFT sizes could not be prepared, the engine is left released then (see is_prepared())
+    bool prepare(int block_size, int k, const hrtf_buffer_sc& hrtfs, FFTPlanCache* transform_plans = NULL);
+    void release();
+    void reset();
+
+    // binauralize n input samples with HRTF sel, input may alias left
+    // right may be NULL for a mono output, only the left ear is written then
+    // returns false if the engine is not prepared for this block, nothing is written in this case
+    bool process(const Sample* input, Sample* left, Sample* right, int n, int sel);
+
+    // FFT convolution of size n using the preallocated scratch, n must not exceed the k given to prepare()
+    // and sizes other than k must have been prepared on fft_plans, they give zero output otherwise
+    void fftw_convolution(int n, Sample* input1, Sample* input2, Sample* output);
+    void fftw_convolution(int n, Sample* input1, bin_type* input2, Sample* output);
+    // prescaled: one of the spectra already includes the 1/n scale, the output is not normalized again
+    void fftw_convolution(int n, bin_type* input1, bin_type* input2, Sample* output, bool prescaled = false);
+    // one source, several outputs: spectrum is the forward FFT of the input and is shared by all filters
+    void fftw_convolution(int n, bin_type* spectrum, bin_type** filters, Sample** outputs, int num_outputs, bool prescaled = false);
+
+    bool is_prepared() const { return hrtfs != NULL; }
+
+    // filters after the ones of the HRTF set (index num_hrtfs on), silent until load_filter(), applied in prepare()
+    int extra_filters = 0;
+    int get_num_filters() const { return num_filters; }
+    // load a HRIR pair of hrtfs.num_samples into extra filter index while process() may run with other filters,
+    // on any thread: the transforms use plans (the backends keep per-size scratch, so not the engine's own plans)
+    // the delays are used if the HRTF set has them (clamped to the largest one of the set)
+    // false if plans could not be prepared for the FFT sizes of the engine, the filter is left as it was then
+    bool load_filter(int index, const float* left, const float* right, FFTPlanCache& plans,
+                     float delay_left = 0.f, float delay_right = 0.f);
+    // values of one filter as process() reads them in all modes, so a loaded extra filter can be kept and put back
+    // without transforming its HRIRs again (see HrtfCache); 0 before prepare()
+    int get_filter_values() const;
+    // copy extra filter index out, or back in from an engine prepared the same way (restore_filter() follows the
+    // rules of load_filter()); false for the filters of the set
+    bool save_filter(int index, Sample* values) const;
+    bool restore_filter(int index, const Sample* values);
+    // audio thread: the engine that rendered the last block fades from filter index on its next change of sel, or a
+    // late stage on the worker still renders with it, so load_filter() must not rewrite it yet
+    bool uses_filter(int index) const;
+    // the HRTF set has a delay per ear (minimum phase HRIRs), each output goes through a FractionalDelay
+    bool has_delays() const { return filter_delays != NULL; }
+
+    // mode used by process() when mode == automatic, decided by the cost model in prepare()
+    // or overridden with a measured choice (see ConvolutionTuner)
+    int get_auto_mode() const { return auto_mode; }
+    void set_auto_mode(int new_auto_mode) { auto_mode = new_auto_mode; }
+    // partition size of the uniform engine, block_size unless partition_size divides it
+    int get_partition_size() const { return uniform_conv.get_block_size(); }
+    // stages of the non-uniform engine on the worker thread and how often the audio thread had to wait for them
+    int get_num_threaded_stages() const { return nonuniform_conv.get_num_threaded_stages(); }
+    int get_deadline_misses() const { return nonuniform_conv.get_deadline_misses(); }
+    // true if the active mode only takes blocks of exactly block_size samples (overlap-add, uniform partitioned),
+    // the direct-form and non-uniform engines (also time_distributed) take any count up to block_size
+    bool needs_fixed_blocks() const;
+
+    // may be called at any time, both variants are prepared
+    void set_synthesis(int new_synthesis);
+    int get_synthesis() const { return synthesis; }
+
+    // crossfade the outputs of the old and the new HRTF on the block where sel changes, in every mode
+    // (the overlap-add path reuses the input spectrum and needs one more inverse FFT per ear on that block)
+    void set_crossfade(bool new_crossfade);
+    bool get_crossfade() const { return crossfade; }
+
+    int mode = automatic;
+    // skip all work on silent input once every buffer has decayed to zero (see bypass_length)
+    bool bypass_silence = true;
+    // the last process() call only wrote zeros
+    bool is_bypassed() const { return bypassed; }
+    // partition size for uniform_partitioned, applied in prepare(); 0 or any size that does not divide
+    // the block size means block_size. smaller partitions trade FFT work against fewer spectral MACs
+    int partition_size = 0;
+
+private:
+    // the convolution of process(), without the delays of minimum phase HRIRs
+    bool convolve(const Sample* input, Sample* left, Sample* right, int n, int sel);
+    // the engine of mode active renders the next block, one that takes over starts from silence with sel (no crossfade)
+    void switch_to(int active, int sel);
+    // silent: the input block is all zero, its FFT and product are skipped and only the ring is read
+    void process_overlap_add(const Sample* input, Sample* left, Sample* right, int sel, bool silent);
+    // tail_length samples of the inverse FFTs of result_left / result_right, normalized
+    void synthesize(Sample* out_left, Sample* out_right);
+    static void multiply(int m, spectrum_type input1, spectrum_type input2, spectrum_type output);
+
+    // overlap-add HRTF spectra: the float engine uses the ones of the HRTF set,
+    // the double engine transforms the HRIRs into hrtf_spectra in prepare()
+    void prepare_spectra(const hrtf_buffer_sc& new_hrtfs, FFTPlanCache& plans);
+    // overlap-add spectrum of an extra filter
+    void load_spectra(int index, const float* left, const float* right, FFTPlanCache& plans);
+    spectrum_type get_hrtf_spectrum(int hrtf, int ear) const;
+    bool spectra_prescaled() const;
+
+    FFTPlanCache& fft_plans;
+    const hrtf_buffer_sc* hrtfs = NULL;
+
+    int block_size = 0;
+    int k = 0;
+    // HRTFs of the set plus extra_filters
+    int num_filters = 0;
+    int synthesis = separate_ifft;
+    int auto_mode = uniform_partitioned;
+    bool crossfade = true;
+    // HRTF of the last overlap-add block, -1 after reset
+    int current_sel = -1;
+    // mode of the engine that rendered the last block (never automatic or time_distributed), -1 after reset
+    int last_active = -1;
+
+    // zero padded input block, the result of the k-point convolution is written back to it (left) and to conv_buffer_right
+    Sample* conv_buffer_left = NULL;
+    Sample* conv_buffer_right = NULL;
+    // result of the old HRTF on a transition block
+    Sample* fade_buffer_left = NULL;
+    Sample* fade_buffer_right = NULL;
+    // every block adds its convolution result at ring_head, the oldest n samples are read and cleared afterwards
+    // ring_size is a power of 2 >= k + block_size
+    Sample* ring_left = NULL;
+    Sample* ring_right = NULL;
+    int ring_size = 0;
+    int ring_head = 0;
+    // samples of a block result that can be non-zero (n + num_samples - 1, at most k)
+    int tail_length = 0;
+    // block_size samples, takes the right ear of the engines that always render both when right is NULL
+    Sample* discard = NULL;
+
+    // samples of silent input after which the ring, FDLs and FIR histories of all engines are zero,
+    // so the output is exactly zero until the input is not silent any more (no threshold, the resume stays bit-exact)
+    int bypass_length = 0;
+    // silent input samples in a row, up to bypass_length
+    int silent_samples = 0;
+    bool bypassed = false;
+
+    // input spectrum shared by both ears and the products with both HRTFs, [re | im] each
+    Sample* split_buffer = NULL;
+    spectrum_type input_spectrum = {};
+    spectrum_type result_left = {};
+    spectrum_type result_right = {};
+    // k / 2 + 1 interleaved bins each, for the FFT boundary and the fft_complex convolution API
+    bin_type* scratch_spec1 = NULL;
+    bin_type* scratch_spec2 = NULL;
+    bin_type* scratch_result = NULL;
+    // k bins each, for the packed inverse FFT
+    bin_type* packed = NULL;
+    bin_type* packed_result = NULL;
+
+    // [hrtf][ear][re | im] with hrtf_stride values per part, all filters in the double engine,
+    // only the extra filters in the float engine (the others are in the HRTF set)
+    Sample* hrtf_spectra = NULL;
+    int hrtf_stride = 0;
+
+    UniformConvolverT<Sample> uniform_conv;
+    NonUniformConvolverT<Sample> nonuniform_conv;
+    DirectConvolverT<Sample> direct_conv;
+
+    // [filter][ear] delays of minimum phase HRIRs, NULL without them
+    float* filter_delays = NULL;
+    FractionalDelayT<Sample> delay_line_left;
+    FractionalDelayT<Sample> delay_line_right;
+};
+
+typedef ConvolutionEngineT<float> ConvolutionEngine;
@@ -0,0 +1,232 @@
+/*
+  ==============================================================================
+
+    ConvolutionTuner.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "ConvolutionTuner.h"
+#include "ConvolutionEngine.h"
+#include "SpectralKernels.h"
+
+ConvolutionTuner::ConvolutionTuner() {
+}
+
+ConvolutionTuner::~ConvolutionTuner() {
+
+    cancel();
+}
+
+juce::PropertiesFile& ConvolutionTuner::get_cache() {
+
+    if (cache == nullptr) {
+        juce::PropertiesFile::Options options;
+        options.applicationName = "Binauralization";
+        options.folderName = "Binauralization";
+        options.filenameSuffix = ".tuning";
+        options.osxLibrarySubFolder = "Application Support";
+        cache.reset(new juce::PropertiesFile(options));
+    }
+
+    return *cache;
+}
+
+juce::String ConvolutionTuner::get_key(int block_size, int ir_length, int max_latency) const {
+
+    // a result is only valid for the same CPU, kernels and set of FFT backends
+    juce::String key = juce::SystemStats::getCpuModel() + "/" + get_kernel_name(get_kernel()) + "/";
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (is_fft_backend_available(i))
+            key += juce::String(get_fft_backend_name(i)) + "+";
+    }
+
+    // a stricter limit rules out candidates, a looser one may allow a faster winner
+    return key + "/" + juce::String(block_size) + "/" + juce::String(ir_length) + "/" + juce::String(max_latency);
+}
+
+bool ConvolutionTuner::lookup(int block_size, int ir_length, int max_latency, tuning_result& result) {
+
+    std::lock_guard<std::mutex> lock(cache_lock);
+
+    juce::String value = get_cache().getValue(get_key(block_size, ir_length, max_latency));
+    if (value.isEmpty())
+        return false;
+
+    // "mode partition_size backend time latency"
+    juce::StringArray tokens = juce::StringArray::fromTokens(value, " ", "");
+    if (tokens.size() != 5 || !is_fft_backend_available(tokens[2].getIntValue()) || tokens[4].getIntValue() > max_latency)
+        return false;
+
+    result.block_size = block_size;
+    result.ir_length = ir_length;
+    result.max_latency = max_latency;
+    result.mode = tokens[0].getIntValue();
+    result.partition_size = tokens[1].getIntValue();
+    result.backend = tokens[2].getIntValue();
+    result.time = tokens[3].getFloatValue();
+    result.latency = tokens[4].getIntValue();
+    result.valid = true;
+
+    return true;
+}
+
+tuning_result ConvolutionTuner::tune(int block_size, int k, int ir_length, const float* left, const float* right, int max_latency) {
+
+    tuning_result best;
+    best.block_size = block_size;
+    best.ir_length = ir_length;
+    best.max_latency = max_latency;
+
+    if (block_size <= 0 || k <= 0 || ir_length <= 0 || left == NULL || right == NULL)
+        return best;
+
+    struct candidate {
+        int mode;
+        int partition_size;
+        int backend;
+        // samples of latency the configuration adds: the fixed-block engines run behind a BlockFifo
+        // of block_size samples, the direct-form and non-uniform engines have none
+        int latency;
+    };
+
+    FFTPlanCache plans;
+    int default_backend = plans.get_backend();
+
+    candidate candidates[64];
+    int num_candidates = 0;
+
+    if (ir_length <= ConvolutionEngine::max_direct_taps)
+        candidates[num_candidates++] = { ConvolutionEngine::direct_form, 0, default_backend, 0 };
+
+    // every FFT based mode is tried on each backend
+    for (int b = 0; b < num_fft_backends; b++) {
+
+        if (!is_fft_backend_available(b))
+            continue;
+
+        // partitions smaller than the block are processed back to back within processBlock
+        for (int p = block_size; num_candidates < 48 && p > 0 && block_size % p == 0 && (p == block_size || p >= min_partition_size); p /= 2)
+            candidates[num_candidates++] = { ConvolutionEngine::uniform_partitioned, p, b, block_size };
+
+        if (ir_length > NonUniformConvolver::head_length)
+            candidates[num_candidates++] = { ConvolutionEngine::non_uniform_partitioned, 0, b, 0 };
+
+        if (block_size <= k)
+            candidates[num_candidates++] = { ConvolutionEngine::overlap_add, 0, b, block_size };
+    }
+
+    // a single HRTF is enough, the cost of a block does not depend on the number of directions
+    float* time_left = (float*)left;
+    float* time_right = (float*)right;
+    hrtf_buffer_sc set;
+    set.time_left = &time_left;
+    set.time_right = &time_right;
+    set.num_hrtfs = 1;
+    set.num_samples = ir_length;
+    set.allocate_spectra(k);
+    ConvolutionEngine::transform_hrir(plans, k, left, ir_length, set.get_spectrum(0, 0));
+    ConvolutionEngine::transform_hrir(plans, k, right, ir_length, set.get_spectrum(0, 1));
+    set.prescaled = true;
+
+    float* input = (float*)malloc(sizeof(float) * block_size);
+    float* out_left = (float*)malloc(sizeof(float) * block_size);
+    float* out_right = (float*)malloc(sizeof(float) * block_size);
+    juce::Random random(1234);
+    for (int i = 0; i < block_size; i++)
+        input[i] = random.nextFloat() - 0.5f;
+
+    ConvolutionEngine engine(plans);
+
+    for (int c = 0; c < num_candidates && !cancelled.load(); c++) {
+
+        if (candidates[c].latency > max_latency)
+            continue;
+
+        plans.set_backend(candidates[c].backend);
+        engine.mode = candidates[c].mode;
+        engine.partition_size = candidates[c].partition_size;
+        // an engine without all its FFT sizes would only be timed passing nothing through
+        if (!engine.prepare(block_size, k, set))
+            continue;
+
+        for (int i = 0; i < warmup_blocks; i++)
+            engine.process(input, out_left, out_right, block_size, 0);
+
+        juce::int64 start_ticks = juce::Time::getHighResolutionTicks();
+        for (int i = 0; i < timed_blocks; i++)
+            engine.process(input, out_left, out_right, block_size, 0);
+        juce::int64 stop_ticks = juce::Time::getHighResolutionTicks();
+
+        float time = (float)(1.e6 * juce::Time::highResolutionTicksToSeconds(stop_ticks - start_ticks) / timed_blocks);
+
+        if (!best.valid || time < best.time) {
+            best.mode = candidates[c].mode;
+            best.partition_size = candidates[c].partition_size;
+            best.backend = candidates[c].backend;
+            best.latency = candidates[c].latency;
+            best.time = time;
+            best.valid = true;
+        }
+    }
+
+    engine.release();
+    set.free_spectra();
+    free(input);
+    free(out_left);
+    free(out_right);
+
+    // a cancelled run has not seen every candidate
+    if (cancelled.load()) {
+        best.valid = false;
+        return best;
+    }
+
+    if (best.valid) {
+        std::lock_guard<std::mutex> lock(cache_lock);
+        get_cache().setValue(get_key(block_size, ir_length, max_latency),
+                             juce::String(best.mode) + " " + juce::String(best.partition_size) + " "
+                             + juce::String(best.backend) + " " + juce::String(best.time) + " " + juce::String(best.latency));
+        get_cache().saveIfNeeded();
+    }
+
+    return best;
+}
+
+void ConvolutionTuner::start(int block_size, int k, int ir_length, const float* left, const float* right, int max_latency,
+                             std::function<void(const tuning_result&)> on_done) {
+
+    cancel();
+
+    if (block_size <= 0 || k <= 0 || ir_length <= 0 || left == NULL || right == NULL)
+        return;
+
+    // the caller's HRIR may be freed while the worker runs
+    ir_left = (float*)malloc(sizeof(float) * ir_length);
+    ir_right = (float*)malloc(sizeof(float) * ir_length);
+    memcpy(ir_left, left, sizeof(float) * ir_length);
+    memcpy(ir_right, right, sizeof(float) * ir_length);
+
+    cancelled = false;
+
+    worker = std::thread([this, block_size, k, ir_length, max_latency, on_done] {
+        tuning_result result = tune(block_size, k, ir_length, ir_left, ir_right, max_latency);
+        if (result.valid && !cancelled.load() && on_done)
+            on_done(result);
+    });
+}
+
+void ConvolutionTuner::cancel() {
+
+    cancelled = true;
+
+    if (worker.joinable())
+        worker.join();
+
+    free(ir_left);
+    free(ir_right);
+    ir_left = NULL;
+    ir_right = NULL;
+}
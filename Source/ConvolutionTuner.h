@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    ConvolutionTuner.h
+
+    Measures the candidate engine configurations (direct-form FIR, overlap-add,
+    uniform partitioned with several partition sizes, non-uniform partitioned,
+    each FFT mode on every compiled-in FFT backend) on the host CPU for a given
+    block size and HRIR, and picks the fastest one that stays within the
+    allowed latency. Results are stored in a per-user file keyed by CPU model,
+    SIMD kernel, available FFT backends, block size, HRIR length and latency
+    limit, so the next prepareToPlay with the same setup skips the measuring.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <JuceHeader.h>
+
+struct tuning_result {
+    // configuration this result was measured for
+    int block_size = 0;
+    int ir_length = 0;
+    int max_latency = INT_MAX;
+    // winner: ConvolutionEngine::conv_modes and ConvolutionEngine::partition_size
+    int mode = 0;
+    int partition_size = 0;
+    // fft_backends
+    int backend = 0;
+    // samples of latency the winner adds
+    int latency = 0;
+    // CPU time of one block in microseconds
+    float time = 0.f;
+    bool valid = false;
+};
+
+class ConvolutionTuner
+{
+public:
+    ConvolutionTuner();
+    ~ConvolutionTuner();
+
+    // cached result for this CPU and configuration, returns false if there is none or it adds more than max_latency
+    bool lookup(int block_size, int ir_length, int max_latency, tuning_result& result);
+
+    // measure all candidates on the calling thread and store the winner in the cache
+    // k is the overlap-add FFT size, max_latency the latency in samples a candidate may add
+    tuning_result tune(int block_size, int k, int ir_length, const float* left, const float* right, int max_latency);
+
+    // run tune() on a background thread with a copy of the HRIR, on_done is called from that thread
+    // (not when cancelled before the measuring has finished)
+    void start(int block_size, int k, int ir_length, const float* left, const float* right, int max_latency,
+               std::function<void(const tuning_result&)> on_done);
+
+    // stop a running background tuning and wait for its thread
+    void cancel();
+    bool is_cancelled() const { return cancelled.load(); }
+
+    // blocks per candidate before / while measuring
+    static constexpr int warmup_blocks = 8;
+    static constexpr int timed_blocks = 32;
+    // smallest uniform partition size tried
+    static constexpr int min_partition_size = 16;
+
+private:
+    juce::String get_key(int block_size, int ir_length, int max_latency) const;
+    juce::PropertiesFile& get_cache();
+
+    std::thread worker;
+    std::atomic<bool> cancelled{ false };
+
+    // copy of the HRIR used by the background thread
+    float* ir_left = NULL;
+    float* ir_right = NULL;
+
+    // the cache file is shared by the audio setup thread and the worker
+    std::unique_ptr<juce::PropertiesFile> cache;
+    std::mutex cache_lock;
+};
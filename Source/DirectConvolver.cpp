@@ -0,0 +1,150 @@
+/*
+  ==============================================================================
+
+    DirectConvolver.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "DirectConvolver.h"
+#include "SpectralKernels.h"
+
+template <typename Sample>
+DirectConvolverT<Sample>::DirectConvolverT() {
+}
+
+template <typename Sample>
+DirectConvolverT<Sample>::~DirectConvolverT() {
+
+    release();
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::prepare(int new_max_block_size, int new_num_filters, int ir_length) {
+
+    release();
+
+    if (new_max_block_size <= 0 || new_num_filters <= 0 || ir_length <= 0)
+        return;
+
+    max_block_size = new_max_block_size;
+    num_filters = new_num_filters;
+    num_taps = ir_length;
+
+    taps_left = (Sample**)malloc(sizeof(Sample*) * num_filters);
+    taps_right = (Sample**)malloc(sizeof(Sample*) * num_filters);
+    for (int i = 0; i < num_filters; i++) {
+        taps_left[i] = (Sample*)calloc(num_taps, sizeof(Sample));
+        taps_right[i] = (Sample*)calloc(num_taps, sizeof(Sample));
+    }
+    history = (Sample*)calloc(num_taps - 1 + max_block_size, sizeof(Sample));
+    fade_left = (Sample*)malloc(sizeof(Sample) * max_block_size);
+    fade_right = (Sample*)malloc(sizeof(Sample) * max_block_size);
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::set_filter(int index, const float* left, const float* right, int length) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    load_filter(index, left, right, length);
+    reset();
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::load_filter(int index, const float* left, const float* right, int length) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    // tap j of the stored filter meets the input sample num_taps - 1 - j steps ago
+    for (int i = 0; i < num_taps; i++) {
+        taps_left[index][num_taps - 1 - i] = (i < length) ? (Sample)left[i] : 0;
+        taps_right[index][num_taps - 1 - i] = (i < length) ? (Sample)right[i] : 0;
+    }
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::save_filter(int index, Sample* values) const {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    memcpy(values, taps_left[index], sizeof(Sample) * num_taps);
+    memcpy(values + num_taps, taps_right[index], sizeof(Sample) * num_taps);
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::restore_filter(int index, const Sample* values) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    memcpy(taps_left[index], values, sizeof(Sample) * num_taps);
+    memcpy(taps_right[index], values + num_taps, sizeof(Sample) * num_taps);
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::reset() {
+
+    if (history != NULL)
+        memset(history, 0, sizeof(Sample) * (num_taps - 1 + max_block_size));
+
+    current_sel = -1;
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::process(const Sample* input, Sample* left, Sample* right, int count, int sel) {
+
+    if (history == NULL || sel < 0 || sel >= num_filters || count > max_block_size)
+        return;
+
+    // the FIR reads the input from history, so left/right may alias the input
+    memcpy(history + num_taps - 1, input, sizeof(Sample) * count);
+
+    fir_pair(history, taps_left[sel], taps_right[sel], num_taps, left, right, count);
+
+    // the old filter sees the same history, only its output fades out
+    if (crossfade && current_sel >= 0 && current_sel != sel && current_sel < num_filters) {
+        fir_pair(history, taps_left[current_sel], taps_right[current_sel], num_taps, fade_left, fade_right, count);
+        ::crossfade(fade_left, left, count);
+        ::crossfade(fade_right, right, count);
+    }
+    current_sel = sel;
+
+    // keep the last num_taps - 1 samples for the next block
+    memmove(history, history + count, sizeof(Sample) * (num_taps - 1));
+}
+
+template <typename Sample>
+void DirectConvolverT<Sample>::release() {
+
+    if (taps_left != NULL) {
+        for (int i = 0; i < num_filters; i++) {
+            free(taps_left[i]);
+            free(taps_right[i]);
+        }
+        free(taps_left);
+        free(taps_right);
+    }
+    free(history);
+    free(fade_left);
+    free(fade_right);
+
+    taps_left = NULL;
+    taps_right = NULL;
+    history = NULL;
+    fade_left = NULL;
+    fade_right = NULL;
+    current_sel = -1;
+
+    max_block_size = 0;
+    num_filters = 0;
+    num_taps = 0;
+}
+
+template class DirectConvolverT<float>;
+template class DirectConvolverT<double>;
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    DirectConvolver.h
+
+    Direct-form (time-domain) FIR convolution of one input with a stereo HRIR.
+    Costs num_taps multiply-adds per sample and ear, but has no latency, no
+    FFT round trip and accepts any block size, so it wins for short anechoic
+    HRIRs at small block sizes. Also used as the head of NonUniformConvolver.
+    When sel changes, the block is rendered with the old and the new filter
+    from the same input history and crossfaded.
+    Sample is float or double (64-bit engine), the HRIRs are always float.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+template <typename Sample>
+class DirectConvolverT
+{
+public:
+    DirectConvolverT();
+    ~DirectConvolverT();
+
+    // allocate taps for num_filters stereo HRIRs of up to ir_length samples and the input history
+    void prepare(int max_block_size, int num_filters, int ir_length);
+    void set_filter(int index, const float* left, const float* right, int length);
+    // same without the reset, for a filter process() does not use at the moment, on any thread
+    void load_filter(int index, const float* left, const float* right, int length);
+    // see UniformConvolver::save_filter
+    int get_filter_values() const { return (taps_left != NULL) ? 2 * num_taps : 0; }
+    void save_filter(int index, Sample* values) const;
+    void restore_filter(int index, const Sample* values);
+    void reset();
+
+    // convolve count <= max_block_size samples, input may alias one of the outputs
+    void process(const Sample* input, Sample* left, Sample* right, int count, int sel);
+
+    void release();
+
+    int get_max_block_size() const { return max_block_size; }
+    int get_num_taps() const { return num_taps; }
+
+    // crossfade from the previous filter on the block where sel changes, otherwise the switch is abrupt
+    bool crossfade = true;
+    // continue with filter sel without a crossfade, e.g. after silence
+    void set_current_filter(int sel) { current_sel = sel; }
+    // see UniformConvolver::uses_filter
+    bool uses_filter(int index) const { return current_sel == index; }
+
+private:
+    int max_block_size = 0;
+    int num_filters = 0;
+    int num_taps = 0;
+
+    // [filter][tap], stored time-reversed for fir_pair
+    Sample** taps_left = NULL;
+    Sample** taps_right = NULL;
+    // last num_taps - 1 input samples followed by the current block
+    Sample* history = NULL;
+    // filter of the last block (-1 after reset) and the output of the old filter on a transition block
+    int current_sel = -1;
+    Sample* fade_left = NULL;
+    Sample* fade_right = NULL;
+};
+
+typedef DirectConvolverT<float> DirectConvolver;
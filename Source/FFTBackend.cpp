@@ -0,0 +1,49 @@
+/*
+  ==============================================================================
+
+    FFTBackend.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include "FFTBackend.h"
+#include "FFTWBackend.h"
+#include "JuceFFTBackend.h"
+
+void FFTBackend::reset_stats() {
+
+    hits.store(0);
+    misses.store(0);
+}
+
+FFTBackend* create_fft_backend(int type) {
+
+    switch (type) {
+#if BINAURALIZATION_USE_FFTW
+    case fft_backend_fftw: return new FFTWBackend();
+#endif
+#if BINAURALIZATION_USE_JUCE_FFT
+    case fft_backend_juce: return new JuceFFTBackend();
+#endif
+    default: return NULL;
+    }
+}
+
+bool is_fft_backend_available(int type) {
+
+    switch (type) {
+    case fft_backend_fftw: return BINAURALIZATION_USE_FFTW != 0;
+    case fft_backend_juce: return BINAURALIZATION_USE_JUCE_FFT != 0;
+    default: return false;
+    }
+}
+
+const char* get_fft_backend_name(int type) {
+
+    switch (type) {
+    case fft_backend_fftw: return "FFTW";
+    case fft_backend_juce: return "JUCE";
+    default: return "unknown";
+    }
+}
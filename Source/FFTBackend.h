@@ -0,0 +1,205 @@
+/*
+  ==============================================================================
+
+    FFTBackend.h
+
+    Interface of the FFT libraries the convolution engines can run on.
+    Every backend works on the same spectral layout as FFTW: a real FFT of
+    size n yields n / 2 + 1 interleaved complex bins, and neither direction is
+    scaled. Which backends are compiled in is decided with the flags below,
+    which one is used can be changed at runtime (see FFTPlanCache).
+    Backends may also offer double precision transforms for the 64-bit
+    engine (see supports_double()), with the same layout.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <JuceHeader.h>
+#include "FFTTypes.h"
+
+// FFTW (GPL or commercial licence), needs libfftw3f
+#ifndef BINAURALIZATION_USE_FFTW
+ #define BINAURALIZATION_USE_FFTW 1
+#endif
+
+// double precision FFTW plans for the 64-bit processing path, needs libfftw3 next to libfftw3f (only the latter
+// ships with the project, so it is off by default and the plugin does not offer double precision processing)
+#ifndef BINAURALIZATION_USE_FFTW_DOUBLE
+ #define BINAURALIZATION_USE_FFTW_DOUBLE 0
+#endif
+
+// juce::dsp::FFT, needs the juce_dsp module
+#ifndef BINAURALIZATION_USE_JUCE_FFT
+ #if defined(JUCE_MODULE_AVAILABLE_juce_dsp) && JUCE_MODULE_AVAILABLE_juce_dsp
+  #define BINAURALIZATION_USE_JUCE_FFT 1
+ #else
+  #define BINAURALIZATION_USE_JUCE_FFT 0
+ #endif
+#endif
+
+// prepared state of the backends: entries are only appended (one writer at a time, under the backend's lock) into
+// blocks that never move, so the transforms can scan up to size() without taking the lock. grows as long as there
+// is memory, clear() empties it without freeing the blocks and must not run while anyone reads
+template <typename T>
+class append_table
+{
+public:
+    append_table() {}
+    ~append_table();
+
+    int size() const { return count.load(std::memory_order_acquire); }
+    T& operator[] (int i);
+    const T& operator[] (int i) const { return (*const_cast<append_table*>(this))[i]; }
+
+    // first entry of the published ones match() is true for, NULL if there is none
+    template <typename Match>
+    T* find(Match match);
+
+    // the entry after the published ones for the writer to fill in (it may hold a cleared entry),
+    // NULL if there is no memory for another block; push() publishes it
+    T* next();
+    void push() { count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    void clear() { count.store(0); }
+
+private:
+    static constexpr int block_size = 16;
+
+    struct block {
+        T entries[block_size];
+        std::atomic<block*> next{ NULL };
+    };
+
+    block first;
+    std::atomic<int> count{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(append_table)
+};
+
+template <typename T>
+append_table<T>::~append_table() {
+
+    block* b = first.next.load();
+    while (b != NULL) {
+        block* next = b->next.load();
+        delete b;
+        b = next;
+    }
+}
+
+template <typename T>
+T& append_table<T>::operator[] (int i) {
+
+    block* b = &first;
+    for (; i >= block_size; i -= block_size)
+        b = b->next.load(std::memory_order_acquire);
+
+    return b->entries[i];
+}
+
+template <typename T>
+template <typename Match>
+T* append_table<T>::find(Match match) {
+
+    int n = size();
+    block* b = &first;
+
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && i % block_size == 0)
+            b = b->next.load(std::memory_order_acquire);
+        if (match(b->entries[i % block_size]))
+            return &b->entries[i % block_size];
+    }
+
+    return NULL;
+}
+
+template <typename T>
+T* append_table<T>::next() {
+
+    int i = count.load(std::memory_order_relaxed);
+    block* b = &first;
+
+    for (; i >= block_size; i -= block_size) {
+        if (b->next.load() == NULL) {
+            block* added = new (std::nothrow) block();
+            if (added == NULL)
+                return NULL;
+            b->next.store(added, std::memory_order_release);
+        }
+        b = b->next.load();
+    }
+
+    return &b->entries[i];
+}
+
+// effort spent on planning, see FFTBackend::refine()
+enum fft_planning {
+    fft_planning_estimate = 0,
+    fft_planning_measure,
+    fft_planning_patient
+};
+
+enum fft_backends {
+    fft_backend_fftw = 0,
+    fft_backend_juce,
+    num_fft_backends
+};
+
+class FFTBackend
+{
+public:
+    virtual ~FFTBackend() {}
+
+    // real transforms of size n / complex transforms of size n are available
+    virtual bool supports_size(int n, bool complex) const = 0;
+
+    // set up everything needed for size n, call this off the audio thread; false if that failed (no memory, or
+    // the backend does not have the size), the transforms never set anything up, so they would give zero output
+    virtual bool prepare(int n) = 0;
+
+    // n real samples -> n / 2 + 1 bins, input is preserved
+    virtual void forward(int n, float* input, fft_complex* output) = 0;
+    // n / 2 + 1 bins -> n real samples, input may be destroyed
+    virtual void inverse(int n, fft_complex* input, float* output) = 0;
+    // complex backward transform of n bins
+    virtual void inverse_complex(int n, fft_complex* input, fft_complex* output) = 0;
+
+    // double precision versions of prepare() and the transforms above, only available if supports_double()
+    virtual bool supports_double() const { return false; }
+    virtual bool prepare_double(int) { return false; }
+    virtual void forward_double(int, double*, fft_complex_d*) {}
+    virtual void inverse_double(int, fft_complex_d*, double*) {}
+    virtual void inverse_complex_double(int, fft_complex_d*, fft_complex_d*) {}
+
+    // free everything set up by prepare() (must not be called while a transform runs)
+    virtual void clear() = 0;
+
+    // replace the prepared transforms of size n by ones planned with more effort (fft_planning),
+    // transforms running meanwhile are not disturbed. may take seconds, so call it from a background thread.
+    // returns true if anything was replaced, backends without a planner do nothing
+    virtual bool refine(int, int) { return false; }
+
+    // planning results worth keeping between sessions (FFTW wisdom), false if the backend has none
+    virtual bool load_wisdom(const juce::File&) { return false; }
+    virtual bool save_wisdom(const juce::File&) { return false; }
+
+    // transforms served by prepared state / transforms that found nothing prepared for their size or alignment
+    int get_hits() const { return hits.load(); }
+    int get_misses() const { return misses.load(); }
+    void reset_stats();
+
+protected:
+    std::atomic<int> hits{ 0 };
+    std::atomic<int> misses{ 0 };
+};
+
+// NULL for backends which are not compiled into this build
+FFTBackend* create_fft_backend(int type);
+bool is_fft_backend_available(int type);
+const char* get_fft_backend_name(int type);
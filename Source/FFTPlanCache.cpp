@@ -0,0 +1,391 @@
+/*
+  ==============================================================================
+
+    FFTPlanCache.cpp
+
+  ==============================================================================
+*/
+
+#include <cstring>
+#include "FFTPlanCache.h"
+#include "SpectralKernels.h"
+
+// Z = L + iR from two split spectra of n / 2 + 1 bins, see perform_ifft_pair()
+template <typename Sample>
+static void pack_pair(int n, split_spectrum<Sample> left, split_spectrum<Sample> right, fft_bin<Sample>* packed) {
+
+    int m = n / 2 + 1;
+
+    for (int i = 0; i < m; i++) {
+        packed[i][0] = left.re[i] - right.im[i];
+        packed[i][1] = left.im[i] + right.re[i];
+    }
+    // the upper half follows from the hermitian symmetry of both real signals: Z[i] = conj(L[n-i]) + i conj(R[n-i])
+    for (int i = m; i < n; i++) {
+        packed[i][0] = left.re[n - i] + right.im[n - i];
+        packed[i][1] = right.re[n - i] - left.im[n - i];
+    }
+}
+
+template <typename Sample>
+static void unpack_pair(const fft_bin<Sample>* result, Sample* out_left, Sample* out_right, int offset, int count, Sample scale) {
+
+    for (int i = 0; i < count; i++) {
+        out_left[i] = result[offset + i][0] * scale;
+        out_right[i] = result[offset + i][1] * scale;
+    }
+}
+
+FFTPlanCache::FFTPlanCache() {
+
+    for (int i = 0; i < num_fft_backends; i++)
+        backends[i] = create_fft_backend(i);
+
+    // the first compiled-in backend is the default (FFTW if available)
+    backend = 0;
+    while (backend < num_fft_backends - 1 && backends[backend] == NULL)
+        backend++;
+}
+
+FFTPlanCache::~FFTPlanCache() {
+
+    for (int i = 0; i < num_fft_backends; i++)
+        delete backends[i];
+}
+
+FFTBackend* FFTPlanCache::get_backend_for(int n, bool complex) const {
+
+    return get_backend_for(backend, n, complex);
+}
+
+FFTBackend* FFTPlanCache::get_backend_for(int type, int n, bool complex) const {
+
+    if (backends[type] != NULL && backends[type]->supports_size(n, complex))
+        return backends[type];
+
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL && backends[i]->supports_size(n, complex))
+            return backends[i];
+    }
+
+    return NULL;
+}
+
+FFTBackend* FFTPlanCache::get_double_backend_for(int n, bool complex) const {
+
+    if (backends[backend] != NULL && backends[backend]->supports_double() && backends[backend]->supports_size(n, complex))
+        return backends[backend];
+
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL && backends[i]->supports_double() && backends[i]->supports_size(n, complex))
+            return backends[i];
+    }
+
+    return NULL;
+}
+
+void FFTPlanCache::add_size(int n) {
+
+    std::lock_guard<std::mutex> lock(sizes_lock);
+
+    if (sizes.find([n](int size) { return size == n; }) != NULL)
+        return;
+
+    // without room for it, set_backend() and FFTPlanner skip the size, it stays prepared on the current backend
+    int* size = sizes.next();
+    if (size != NULL) {
+        *size = n;
+        sizes.push();
+    }
+}
+
+bool FFTPlanCache::prepare(int n) {
+
+    if (n <= 0)
+        return false;
+
+    add_size(n);
+
+    return prepare_on(backend, n);
+}
+
+bool FFTPlanCache::prepare_on(int type, int n) {
+
+    FFTBackend* real_backend = get_backend_for(type, n, false);
+    FFTBackend* complex_backend = get_backend_for(type, n, true);
+
+    if (real_backend == NULL || complex_backend == NULL)
+        return false;
+
+    bool prepared = real_backend->prepare(n);
+    if (complex_backend != real_backend)
+        prepared &= complex_backend->prepare(n);
+
+    return prepared;
+}
+
+void FFTPlanCache::perform_fft(int n, float* input, fft_complex* output) {
+
+    FFTBackend* b = get_backend_for(n, false);
+
+    if (b != NULL)
+        b->forward(n, input, output);
+    else
+        memset(output, 0, sizeof(fft_complex) * (n / 2 + 1));
+}
+
+void FFTPlanCache::perform_ifft(int n, fft_complex* input, float* output) {
+
+    FFTBackend* b = get_backend_for(n, false);
+
+    if (b != NULL)
+        b->inverse(n, input, output);
+    else
+        memset(output, 0, sizeof(float) * n);
+}
+
+void FFTPlanCache::perform_fft(int n, float* input, fft_complex* scratch, split_complex output) {
+
+    perform_fft(n, input, scratch);
+    deinterleave(scratch, output, n / 2 + 1);
+}
+
+void FFTPlanCache::perform_ifft(int n, split_complex input, fft_complex* scratch, float* output) {
+
+    interleave(input, scratch, n / 2 + 1);
+    perform_ifft(n, scratch, output);
+}
+
+void FFTPlanCache::perform_ifft_complex(int n, fft_complex* input, fft_complex* output) {
+
+    FFTBackend* b = get_backend_for(n, true);
+
+    if (b != NULL)
+        b->inverse_complex(n, input, output);
+    else
+        memset(output, 0, sizeof(fft_complex) * n);
+}
+
+void FFTPlanCache::perform_ifft_complex(int n, fft_complex_d* input, fft_complex_d* output) {
+
+    FFTBackend* b = get_double_backend_for(n, true);
+
+    if (b != NULL)
+        b->inverse_complex_double(n, input, output);
+    else
+        memset(output, 0, sizeof(fft_complex_d) * n);
+}
+
+template <typename Sample>
+void FFTPlanCache::perform_ifft_pair(int n, split_spectrum<Sample> left, split_spectrum<Sample> right, fft_bin<Sample>* packed,
+                                     fft_bin<Sample>* result, Sample* out_left, Sample* out_right, int offset, int count, Sample scale) {
+
+    pack_pair(n, left, right, packed);
+    perform_ifft_complex(n, packed, result);
+    unpack_pair(result, out_left, out_right, offset, count, scale);
+}
+
+template void FFTPlanCache::perform_ifft_pair<float>(int, split_complex, split_complex, fft_complex*, fft_complex*,
+                                                     float*, float*, int, int, float);
+template void FFTPlanCache::perform_ifft_pair<double>(int, split_complex_d, split_complex_d, fft_complex_d*, fft_complex_d*,
+                                                      double*, double*, int, int, double);
+
+bool FFTPlanCache::supports_double() const {
+
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL && backends[i]->supports_double())
+            return true;
+    }
+
+    return false;
+}
+
+bool FFTPlanCache::prepare_double(int n) {
+
+    if (n <= 0)
+        return false;
+
+    // recorded with the single precision sizes, so FFTPlanner refines the double plans as well
+    add_size(n);
+
+    FFTBackend* real_backend = get_double_backend_for(n, false);
+    FFTBackend* complex_backend = get_double_backend_for(n, true);
+
+    if (real_backend == NULL || complex_backend == NULL)
+        return false;
+
+    bool prepared = real_backend->prepare_double(n);
+    if (complex_backend != real_backend)
+        prepared &= complex_backend->prepare_double(n);
+
+    return prepared;
+}
+
+void FFTPlanCache::perform_fft(int n, double* input, fft_complex_d* output) {
+
+    FFTBackend* b = get_double_backend_for(n, false);
+
+    if (b != NULL)
+        b->forward_double(n, input, output);
+    else
+        memset(output, 0, sizeof(fft_complex_d) * (n / 2 + 1));
+}
+
+void FFTPlanCache::perform_ifft(int n, fft_complex_d* input, double* output) {
+
+    FFTBackend* b = get_double_backend_for(n, false);
+
+    if (b != NULL)
+        b->inverse_double(n, input, output);
+    else
+        memset(output, 0, sizeof(double) * n);
+}
+
+void FFTPlanCache::perform_fft(int n, double* input, fft_complex_d* scratch, split_complex_d output) {
+
+    perform_fft(n, input, scratch);
+    deinterleave(scratch, output, n / 2 + 1);
+}
+
+void FFTPlanCache::perform_ifft(int n, split_complex_d input, fft_complex_d* scratch, double* output) {
+
+    interleave(input, scratch, n / 2 + 1);
+    perform_ifft(n, scratch, output);
+}
+
+int FFTPlanCache::get_efficient_size(int min_size) const {
+
+    if (min_size < 1)
+        min_size = 1;
+
+    FFTBackend* b = backends[backend];
+
+    // every 2^a * 3^b * 5^c between min_size and the next power of 2 (at most 2 * min_size)
+    long long power_of_2 = 1;
+    while (power_of_2 < min_size)
+        power_of_2 *= 2;
+
+    long long best = power_of_2;
+
+    for (long long p5 = 1; p5 < best; p5 *= 5) {
+        for (long long p3 = p5; p3 < best; p3 *= 3) {
+            long long size = p3;
+            while (size < min_size)
+                size *= 2;
+            if (size < best && (b == NULL || (b->supports_size((int)size, false) && b->supports_size((int)size, true))))
+                best = size;
+        }
+    }
+
+    // a backend restricted to other sizes (juce::dsp::FFT only does powers of 2) still gets one it can handle
+    while (b != NULL && !(b->supports_size((int)best, false) && b->supports_size((int)best, true)) && best < (1 << 30))
+        best *= 2;
+
+    return (int)best;
+}
+
+bool FFTPlanCache::set_backend(int type) {
+
+    if (type < 0 || type >= num_fft_backends || backends[type] == NULL)
+        return false;
+
+    backend = type;
+
+    bool prepared = true;
+    for (int i = 0; i < sizes.size(); i++)
+        prepared &= prepare_on(type, sizes[i]);
+
+    return prepared;
+}
+
+bool FFTPlanCache::prepare_backend(int type) {
+
+    if (type < 0 || type >= num_fft_backends || backends[type] == NULL)
+        return false;
+
+    // the sizes type does not handle go to the same fallback as now, which has them already
+    bool prepared = true;
+    for (int i = 0; i < sizes.size(); i++)
+        prepared &= prepare_on(type, sizes[i]);
+
+    return prepared;
+}
+
+void FFTPlanCache::clear() {
+
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL)
+            backends[i]->clear();
+    }
+
+    sizes.clear();
+}
+
+bool FFTPlanCache::refine(int n, int planning) {
+
+    // goes through all backends instead of the selected one, so it does not race with set_backend()
+    bool refined = false;
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL && backends[i]->supports_size(n, false))
+            refined |= backends[i]->refine(n, planning);
+    }
+
+    return refined;
+}
+
+bool FFTPlanCache::load_wisdom(const juce::File& file) {
+
+    bool loaded = false;
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL)
+            loaded |= backends[i]->load_wisdom(file);
+    }
+
+    return loaded;
+}
+
+bool FFTPlanCache::save_wisdom(const juce::File& file) {
+
+    bool saved = false;
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL)
+            saved |= backends[i]->save_wisdom(file);
+    }
+
+    return saved;
+}
+
+int FFTPlanCache::get_sizes(int* out, int max_count) const {
+
+    int count = juce::jmin(sizes.size(), max_count);
+    for (int i = 0; i < count; i++)
+        out[i] = sizes[i];
+
+    return count;
+}
+
+int FFTPlanCache::get_hits() const {
+
+    int hits = 0;
+    for (int i = 0; i < num_fft_backends; i++)
+        hits += (backends[i] != NULL) ? backends[i]->get_hits() : 0;
+
+    return hits;
+}
+
+int FFTPlanCache::get_misses() const {
+
+    int misses = 0;
+    for (int i = 0; i < num_fft_backends; i++)
+        misses += (backends[i] != NULL) ? backends[i]->get_misses() : 0;
+
+    return misses;
+}
+
+void FFTPlanCache::reset_stats() {
+
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (backends[i] != NULL)
+            backends[i]->reset_stats();
+    }
+}
@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    FFTPlanCache.h
+
+    Front end of the FFT backends (see FFTBackend.h). Keeps the prepared state
+    of every backend alive between calls, so that planning does not happen on
+    the audio thread, and forwards each transform to the selected backend, or
+    to another compiled-in backend if the selected one cannot handle the size.
+    Double precision transforms go to the first backend that has them.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <mutex>
+#include "FFTBackend.h"
+
+class FFTPlanCache
+{
+public:
+    FFTPlanCache();
+    ~FFTPlanCache();
+
+    // set up forward, inverse and complex inverse transforms of size n
+    // call this off the audio thread whenever a new FFT size comes up, false if a backend could not set it up
+    // (the transforms of the size would only give zeros, so the configuration must not be used)
+    bool prepare(int n);
+
+    // sizes prepare() has not seen are not set up here, they give zero output (and are counted as miss)
+    void perform_fft(int n, float* input, fft_complex* output);
+    void perform_ifft(int n, fft_complex* input, float* output);
+
+    // split layout versions, scratch holds n / 2 + 1 interleaved bins for the backend
+    void perform_fft(int n, float* input, fft_complex* scratch, split_complex output);
+    void perform_ifft(int n, split_complex input, fft_complex* scratch, float* output);
+
+    // inverse FFT of two real signals with a single complex n-point transform, float or double:
+    // the left spectrum becomes the real part, the right one the imaginary part of the packed signal.
+    // left / right hold n / 2 + 1 bins, packed and result n bins of scratch each.
+    // count samples starting at offset are written to out_left / out_right, multiplied by scale
+    template <typename Sample>
+    void perform_ifft_pair(int n, split_spectrum<Sample> left, split_spectrum<Sample> right, fft_bin<Sample>* packed,
+                           fft_bin<Sample>* result, Sample* out_left, Sample* out_right, int offset, int count, Sample scale);
+
+    // double precision versions of the above for the 64-bit engine, served by the selected backend if it has them
+    // and by the first compiled-in one that does otherwise (FFTW); nothing happens if supports_double() is false
+    bool supports_double() const;
+    bool prepare_double(int n);
+    void perform_fft(int n, double* input, fft_complex_d* output);
+    void perform_ifft(int n, fft_complex_d* input, double* output);
+    void perform_fft(int n, double* input, fft_complex_d* scratch, split_complex_d output);
+    void perform_ifft(int n, split_complex_d input, fft_complex_d* scratch, double* output);
+
+    // prepare() or prepare_double(), for code templated on the sample type
+    template <typename Sample>
+    bool prepare_for(int n);
+
+    // smallest 2^a * 3^b * 5^c >= min_size the selected backend handles for real and complex transforms,
+    // the next power of 2 if it handles none of them
+    int get_efficient_size(int min_size) const;
+
+    // switch to another compiled-in backend and prepare all sizes prepared so far on it
+    // must not be called while another thread performs a transform, returns false if the backend is not available
+    // or one of the sizes could not be prepared on it
+    bool set_backend(int type);
+    // prepare all sizes prepared so far on backend type without selecting it, so that set_backend(type) finds them
+    // ready; may run while other threads perform transforms, false like set_backend()
+    bool prepare_backend(int type);
+    int get_backend() const { return backend; }
+
+    // free the prepared state of all backends (must not be called while another thread performs a transform)
+    void clear();
+
+    // plan size n again with more effort on every backend that can (see FFTBackend::refine), for FFTPlanner
+    bool refine(int n, int planning);
+    // planning results of earlier sessions (FFTW wisdom), see FFTPlanner
+    bool load_wisdom(const juce::File& file);
+    bool save_wisdom(const juce::File& file);
+
+    // copies up to max_count of the sizes passed to prepare() so far, returns how many
+    int get_sizes(int* out, int max_count) const;
+    int get_num_sizes() const { return sizes.size(); }
+
+    // number of transforms served from prepared state / transforms that found nothing prepared, over all backends
+    int get_hits() const;
+    int get_misses() const;
+    void reset_stats();
+
+private:
+    // selected backend if it supports n, else the first compiled-in backend that does, NULL if none
+    FFTBackend* get_backend_for(int n, bool complex) const;
+    // same as if type was selected
+    FFTBackend* get_backend_for(int type, int n, bool complex) const;
+    // prepare() of a recorded size as if type was selected
+    bool prepare_on(int type, int n);
+    // same for double precision
+    FFTBackend* get_double_backend_for(int n, bool complex) const;
+    void add_size(int n);
+    // complex backward transform of n bins on the backend for the precision, for perform_ifft_pair()
+    void perform_ifft_complex(int n, fft_complex* input, fft_complex* output);
+    void perform_ifft_complex(int n, fft_complex_d* input, fft_complex_d* output);
+
+    FFTBackend* backends[num_fft_backends];
+    int backend = 0;
+
+    // sizes passed to prepare(), prepared again on set_backend(); prepare() may run on several threads
+    append_table<int> sizes;
+    std::mutex sizes_lock;
+};
+
+template <>
+inline bool FFTPlanCache::prepare_for<float>(int n) { return prepare(n); }
+
+template <>
+inline bool FFTPlanCache::prepare_for<double>(int n) { return prepare_double(n); }
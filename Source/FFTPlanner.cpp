@@ -0,0 +1,83 @@
+/*
+  ==============================================================================
+
+    FFTPlanner.cpp
+
+  ==============================================================================
+*/
+
+#include <algorithm>
+#include "FFTPlanner.h"
+
+FFTPlanner::FFTPlanner(FFTPlanCache& plans) : plans(plans) {
+}
+
+FFTPlanner::~FFTPlanner() {
+
+    cancel();
+}
+
+juce::File FFTPlanner::get_wisdom_file() {
+
+    juce::File folder = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory);
+#if JUCE_MAC
+    folder = folder.getChildFile("Application Support");
+#endif
+
+    return folder.getChildFile("Binauralization")
+                 .getChildFile(juce::File::createLegalFileName(juce::SystemStats::getCpuModel()) + ".fftw_wisdom");
+}
+
+bool FFTPlanner::load_wisdom() {
+
+    return plans.load_wisdom(get_wisdom_file());
+}
+
+void FFTPlanner::start(int planning) {
+
+    const std::lock_guard<std::mutex> lock(control);
+
+    cancel_worker();
+
+    int capacity = plans.get_num_sizes();
+    sizes.realloc(juce::jmax(capacity, 1));
+    num_sizes = plans.get_sizes(sizes, capacity);
+
+    if (planning <= fft_planning_estimate || num_sizes == 0)
+        return;
+
+    cancelled = false;
+    done = false;
+
+    worker = std::thread([this, planning] {
+        bool refined = false;
+
+        // smallest sizes first, they are the ones running every block
+        std::sort(sizes.get(), sizes.get() + num_sizes);
+
+        for (int i = 0; i < num_sizes && !cancelled.load(); i++)
+            refined |= plans.refine(sizes[i], planning);
+
+        // keep what has been planned so far, even if cancelled
+        if (refined)
+            plans.save_wisdom(get_wisdom_file());
+
+        DBG("FFT planning " << (cancelled.load() ? "cancelled" : "done") << ", " << num_sizes << " sizes");
+        done = true;
+    });
+}
+
+void FFTPlanner::cancel() {
+
+    const std::lock_guard<std::mutex> lock(control);
+
+    cancel_worker();
+}
+
+void FFTPlanner::cancel_worker() {
+
+    cancelled = true;
+
+    if (worker.joinable())
+        worker.join();
+}
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    FFTPlanner.h
+
+    Plans the FFT sizes of a FFTPlanCache again with FFTW_MEASURE or
+    FFTW_PATIENT on a background thread. Processing keeps running on the
+    estimated plans and picks up each tuned plan as soon as it is swapped in.
+    The planning results (FFTW wisdom) are kept in a per-user file, so later
+    sessions get tuned plans straight from prepare() without planning again.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <JuceHeader.h>
+#include "FFTPlanCache.h"
+
+class FFTPlanner
+{
+public:
+    FFTPlanner(FFTPlanCache& plans);
+    ~FFTPlanner();
+
+    // read the wisdom of earlier sessions, call this before preparing the plans
+    bool load_wisdom();
+
+    // refine all sizes prepared so far with the given fft_planning on a background thread,
+    // then save the wisdom. a planning that is already running gets cancelled first
+    // start() and cancel() may block for seconds, never call them while holding a lock the audio thread takes
+    void start(int planning);
+
+    // stop after the plan that is being created (at most FFTWBackend::max_planning_time) and wait for the thread
+    void cancel();
+    bool is_cancelled() const { return cancelled.load(); }
+    bool is_done() const { return done.load(); }
+
+    // one file per CPU model, wisdom from another CPU would give slow plans
+    static juce::File get_wisdom_file();
+
+private:
+    void cancel_worker();
+
+    FFTPlanCache& plans;
+
+    // start() and cancel() are called from the message and the tuner thread
+    std::mutex control;
+
+    std::thread worker;
+    std::atomic<bool> cancelled{ false };
+    std::atomic<bool> done{ true };
+
+    // copied in start(), prepare() may add sizes while the worker runs
+    juce::HeapBlock<int> sizes;
+    int num_sizes = 0;
+};
@@ -0,0 +1,53 @@
+/*
+  ==============================================================================
+
+    FFTTypes.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include "FFTTypes.h"
+
+#if defined(_MSC_VER)
+ #include <malloc.h>
+#endif
+
+static void* aligned_malloc(size_t bytes) {
+
+    if (bytes == 0)
+        bytes = 1;
+
+#if defined(_MSC_VER)
+    return _aligned_malloc(bytes, 64);
+#else
+    void* p = NULL;
+    if (posix_memalign(&p, 64, bytes) != 0)
+        return NULL;
+    return p;
+#endif
+}
+
+float* fft_alloc_real(size_t n) {
+
+    return (float*)aligned_malloc(sizeof(float) * n);
+}
+
+fft_complex* fft_alloc_complex(size_t n) {
+
+    return (fft_complex*)aligned_malloc(sizeof(fft_complex) * n);
+}
+
+void* fft_alloc_bytes(size_t bytes) {
+
+    return aligned_malloc(bytes);
+}
+
+void fft_free(void* p) {
+
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
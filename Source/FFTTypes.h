@@ -0,0 +1,45 @@
+/*
+  ==============================================================================
+
+    FFTTypes.h
+
+    Spectrum layouts and aligned buffers shared by the FFT backends and the
+    SIMD kernels. Kept apart from FFTBackend.h, which needs JUCE, so the
+    kernels build on their own (see Tests/SpectralKernelsTest.cpp).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+// interleaved complex value, same memory layout as fftwf_complex / fftw_complex
+typedef float fft_complex[2];
+typedef double fft_complex_d[2];
+// for code templated on the sample type, fft_bin<float> is fft_complex
+template <typename Sample>
+using fft_bin = Sample[2];
+
+// split complex spectrum (structure of arrays): bin i is re[i] + j * im[i]
+// the engines keep both parts in one aligned block, im = re + split_stride(bins)
+template <typename Sample>
+struct split_spectrum {
+    Sample* re;
+    Sample* im;
+};
+typedef split_spectrum<float> split_complex;
+typedef split_spectrum<double> split_complex_d;
+
+// floats per part of a split spectrum, a multiple of 16 keeps every part 64 byte aligned
+inline int split_stride(int bins) { return (bins + 15) & ~15; }
+
+// 64 byte aligned buffers, suitable for every backend and the SIMD kernels
+float* fft_alloc_real(size_t n);
+fft_complex* fft_alloc_complex(size_t n);
+void* fft_alloc_bytes(size_t bytes);
+void fft_free(void* p);
+
+// n aligned values of any type, for code templated on the sample type
+template <typename T>
+T* fft_alloc(size_t n) { return (T*)fft_alloc_bytes(sizeof(T) * n); }
@@ -0,0 +1,496 @@
+/*
+  ==============================================================================
+
+    FFTWBackend.cpp
+
+  ==============================================================================
+*/
+
+#include <cstring>
+#include "FFTWBackend.h"
+
+#if BINAURALIZATION_USE_FFTW
+
+bool FFTWBackend::plan_key::operator== (const plan_key& other) const {
+
+    return n == other.n && in_alignment == other.in_alignment && out_alignment == other.out_alignment
+        && in_place == other.in_place && forward == other.forward && complex == other.complex;
+}
+
+FFTWBackend::FFTWBackend() {
+}
+
+FFTWBackend::~FFTWBackend() {
+
+    clear();
+}
+
+std::mutex& FFTWBackend::planner_lock() {
+
+    static std::mutex lock;
+    return lock;
+}
+
+template <>
+FFTWBackend::plan_table<float>& FFTWBackend::get_table<float>() {
+
+    return float_plans;
+}
+
+template <>
+FFTWBackend::plan_table<double>& FFTWBackend::get_table<double>() {
+
+    return double_plans;
+}
+
+bool FFTWBackend::prepare(int n) {
+
+    return prepare_plans<float>(n);
+}
+
+void FFTWBackend::forward(int n, float* input, fft_complex* output) {
+
+    forward_plan<float>(n, input, output);
+}
+
+void FFTWBackend::inverse(int n, fft_complex* input, float* output) {
+
+    inverse_plan<float>(n, input, output);
+}
+
+void FFTWBackend::inverse_complex(int n, fft_complex* input, fft_complex* output) {
+
+    inverse_complex_plan<float>(n, input, output);
+}
+
+#if BINAURALIZATION_USE_FFTW_DOUBLE
+bool FFTWBackend::prepare_double(int n) {
+
+    return prepare_plans<double>(n);
+}
+
+void FFTWBackend::forward_double(int n, double* input, fft_complex_d* output) {
+
+    forward_plan<double>(n, input, output);
+}
+
+void FFTWBackend::inverse_double(int n, fft_complex_d* input, double* output) {
+
+    inverse_plan<double>(n, input, output);
+}
+
+void FFTWBackend::inverse_complex_double(int n, fft_complex_d* input, fft_complex_d* output) {
+
+    inverse_complex_plan<double>(n, input, output);
+}
+#else
+// without libfftw3 the double versions do nothing, supports_double() is false then
+bool FFTWBackend::prepare_double(int) {
+
+    return false;
+}
+
+void FFTWBackend::forward_double(int, double*, fft_complex_d*) {}
+void FFTWBackend::inverse_double(int, fft_complex_d*, double*) {}
+void FFTWBackend::inverse_complex_double(int, fft_complex_d*, fft_complex_d*) {}
+#endif
+
+void FFTWBackend::clear() {
+
+    clear_plans<float>();
+#if BINAURALIZATION_USE_FFTW_DOUBLE
+    clear_plans<double>();
+#endif
+}
+
+bool FFTWBackend::refine(int n, int planning) {
+
+    bool refined = refine_plans<float>(n, planning);
+#if BINAURALIZATION_USE_FFTW_DOUBLE
+    refined |= refine_plans<double>(n, planning);
+#endif
+
+    return refined;
+}
+
+bool FFTWBackend::load_wisdom(const juce::File& file) {
+
+    bool loaded = load_wisdom_file<float>(file);
+#if BINAURALIZATION_USE_FFTW_DOUBLE
+    loaded |= load_wisdom_file<double>(get_double_wisdom_file(file));
+#endif
+
+    return loaded;
+}
+
+bool FFTWBackend::save_wisdom(const juce::File& file) {
+
+    bool saved = save_wisdom_file<float>(file);
+#if BINAURALIZATION_USE_FFTW_DOUBLE
+    // nothing to keep unless the 64-bit engine has been used
+    if (double_plans.plans.size() > 0)
+        saved &= save_wisdom_file<double>(get_double_wisdom_file(file));
+#endif
+
+    return saved;
+}
+
+juce::File FFTWBackend::get_double_wisdom_file(const juce::File& file) {
+
+    return file.getSiblingFile(file.getFileNameWithoutExtension() + ".double" + file.getFileExtension());
+}
+
+template <typename Sample>
+bool FFTWBackend::prepare_plans(int n) {
+
+    if (n <= 0)
+        return false;
+
+    bool prepared = true;
+
+    // fft_alloc buffers always have alignment 0, which is what the plugin uses for all its spectra
+    for (int forward = 0; forward < 2; forward++) {
+        for (int in_place = 0; in_place < 2; in_place++) {
+            plan_key key;
+            key.n = n;
+            key.forward = forward;
+            key.in_place = in_place;
+
+            if (find_plan<Sample>(key) == NULL)
+                prepared &= create_plan<Sample>(key) != NULL;
+        }
+    }
+
+    plan_key key;
+    key.n = n;
+    key.forward = false;
+    key.complex = true;
+
+    if (find_plan<Sample>(key) == NULL)
+        prepared &= create_plan<Sample>(key) != NULL;
+
+    if (find_scratch<Sample>(n) == NULL)
+        prepared &= create_scratch<Sample>(n);
+
+    return prepared;
+}
+
+template <typename Sample>
+void FFTWBackend::forward_plan(int n, Sample* input, fft_bin<Sample>* output) {
+
+    typedef fftw_api<Sample> api;
+
+    plan_key key;
+    key.n = n;
+    key.forward = true;
+    key.in_place = (void*)input == (void*)output;
+    key.in_alignment = api::alignment_of(input);
+    key.out_alignment = api::alignment_of((Sample*)output);
+
+    typename api::plan plan = get_plan<Sample>(key);
+
+    if (plan != NULL)
+        api::execute_r2c(plan, input, output);
+    else
+        execute_on_scratch<Sample>(key, input, n, output, n / 2 + 1, &api::execute_r2c);
+}
+
+template <typename Sample>
+void FFTWBackend::inverse_plan(int n, fft_bin<Sample>* input, Sample* output) {
+
+    typedef fftw_api<Sample> api;
+
+    plan_key key;
+    key.n = n;
+    key.forward = false;
+    key.in_place = (void*)input == (void*)output;
+    key.in_alignment = api::alignment_of((Sample*)input);
+    key.out_alignment = api::alignment_of(output);
+
+    typename api::plan plan = get_plan<Sample>(key);
+
+    if (plan != NULL)
+        api::execute_c2r(plan, input, output);
+    else
+        execute_on_scratch<Sample>(key, input, n / 2 + 1, output, n, &api::execute_c2r);
+}
+
+template <typename Sample>
+void FFTWBackend::inverse_complex_plan(int n, fft_bin<Sample>* input, fft_bin<Sample>* output) {
+
+    typedef fftw_api<Sample> api;
+
+    plan_key key;
+    key.n = n;
+    key.forward = false;
+    key.complex = true;
+    key.in_place = input == output;
+    key.in_alignment = api::alignment_of((Sample*)input);
+    key.out_alignment = api::alignment_of((Sample*)output);
+
+    typename api::plan plan = get_plan<Sample>(key);
+
+    if (plan != NULL)
+        api::execute_c2c(plan, input, output);
+    else
+        execute_on_scratch<Sample>(key, input, n, output, n, &api::execute_c2c);
+}
+
+template <typename Sample, typename In, typename Out>
+void FFTWBackend::execute_on_scratch(plan_key key, In* input, int in_count, Out* output, int out_count,
+                                     void (*execute)(typename fftw_api<Sample>::plan, In*, Out*)) {
+
+    // the plans prepare() made for fft_alloc buffers, the copies cost far less than planning here would
+    key.in_alignment = 0;
+    key.out_alignment = 0;
+    key.in_place = false;
+
+    typename fftw_api<Sample>::plan plan = find_plan<Sample>(key);
+    const typename plan_table<Sample>::scratch_entry* scratch = find_scratch<Sample>(key.n);
+
+    if (plan == NULL || scratch == NULL) {
+        memset(output, 0, sizeof(Out) * out_count);
+        return;
+    }
+
+    memcpy(scratch->in, input, sizeof(In) * in_count);
+    execute(plan, (In*)scratch->in, (Out*)scratch->out);
+    memcpy(output, scratch->out, sizeof(Out) * out_count);
+}
+
+template <typename Sample>
+void FFTWBackend::clear_plans() {
+
+    std::lock_guard<std::mutex> lock(planner_lock());
+
+    plan_table<Sample>& table = get_table<Sample>();
+
+    for (int i = 0; i < table.plans.size(); i++) {
+        fftw_api<Sample>::destroy(table.plans[i].plan.load());
+        table.plans[i].plan = NULL;
+        table.plans[i].planning = fft_planning_estimate;
+    }
+
+    for (int i = 0; i < table.retired.size(); i++)
+        fftw_api<Sample>::destroy(table.retired[i]);
+
+    for (int i = 0; i < table.scratch.size(); i++) {
+        fftw_api<Sample>::free(table.scratch[i].in);
+        fftw_api<Sample>::free(table.scratch[i].out);
+        table.scratch[i] = typename plan_table<Sample>::scratch_entry();
+    }
+
+    table.plans.clear();
+    table.retired.clear();
+    table.scratch.clear();
+}
+
+template <typename Sample>
+bool FFTWBackend::refine_plans(int n, int planning) {
+
+    plan_table<Sample>& table = get_table<Sample>();
+    bool refined = false;
+    int count = table.plans.size();
+
+    for (int i = 0; i < count; i++) {
+
+        // one plan at a time, so prepare() on another thread never waits longer than max_planning_time
+        std::lock_guard<std::mutex> lock(planner_lock());
+
+        // clear() might have run in between
+        if (i >= table.plans.size() || table.plans[i].key.n != n || table.plans[i].planning >= planning)
+            continue;
+
+        // a transform on the audio thread may still be using the old plan
+        typename plan_table<Sample>::plan_type* retired = table.retired.next();
+        if (retired == NULL)
+            continue;
+
+        fftw_api<Sample>::set_timelimit(max_planning_time);
+        typename fftw_api<Sample>::plan plan = plan_on_scratch<Sample>(table.plans[i].key, get_flags(planning));
+        fftw_api<Sample>::set_timelimit(FFTW_NO_TIMELIMIT);
+
+        if (plan == NULL)
+            continue;
+
+        *retired = table.plans[i].plan.load();
+        table.retired.push();
+        table.plans[i].plan.store(plan, std::memory_order_release);
+        table.plans[i].planning = planning;
+        refined = true;
+    }
+
+    return refined;
+}
+
+template <typename Sample>
+bool FFTWBackend::load_wisdom_file(const juce::File& file) {
+
+    std::lock_guard<std::mutex> lock(planner_lock());
+
+    // the wisdom stays in FFTW once imported, so read the file only once per process (and precision)
+    static bool loaded = false;
+
+    if (!loaded && file.existsAsFile())
+        loaded = fftw_api<Sample>::import_wisdom(file.getFullPathName().toRawUTF8()) != 0;
+
+    return loaded;
+}
+
+template <typename Sample>
+bool FFTWBackend::save_wisdom_file(const juce::File& file) {
+
+    std::lock_guard<std::mutex> lock(planner_lock());
+
+    // merge what other processes have saved meanwhile instead of overwriting it
+    if (file.existsAsFile())
+        fftw_api<Sample>::import_wisdom(file.getFullPathName().toRawUTF8());
+
+    if (!file.getParentDirectory().createDirectory())
+        return false;
+
+    // write next to the file and move it over, so readers never see half of it
+    juce::TemporaryFile temp(file);
+
+    if (fftw_api<Sample>::export_wisdom(temp.getFile().getFullPathName().toRawUTF8()) == 0)
+        return false;
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+template <typename Sample>
+typename fftw_api<Sample>::plan FFTWBackend::get_plan(const plan_key& key) {
+
+    typename fftw_api<Sample>::plan plan = find_plan<Sample>(key);
+
+    if (plan != NULL) {
+        hits++;
+        return plan;
+    }
+
+    misses++;
+    return NULL;
+}
+
+template <typename Sample>
+typename fftw_api<Sample>::plan FFTWBackend::find_plan(const plan_key& key) {
+
+    typename plan_table<Sample>::entry* e = get_table<Sample>().plans.find(
+        [&key](const typename plan_table<Sample>::entry& candidate) { return candidate.key == key; });
+
+    return (e != NULL) ? e->plan.load(std::memory_order_acquire) : NULL;
+}
+
+template <typename Sample>
+const typename FFTWBackend::plan_table<Sample>::scratch_entry* FFTWBackend::find_scratch(int n) {
+
+    return get_table<Sample>().scratch.find([n](const typename plan_table<Sample>::scratch_entry& e) { return e.n == n; });
+}
+
+template <typename Sample>
+bool FFTWBackend::create_scratch(int n) {
+
+    std::lock_guard<std::mutex> lock(planner_lock());
+
+    if (find_scratch<Sample>(n) != NULL)
+        return true;
+
+    typename plan_table<Sample>::scratch_entry* e = get_table<Sample>().scratch.next();
+    if (e == NULL)
+        return false;
+
+    // n complex values cover the real transforms in both directions as well
+    Sample* in = fftw_api<Sample>::alloc(2 * n);
+    Sample* out = fftw_api<Sample>::alloc(2 * n);
+
+    if (in == NULL || out == NULL) {
+        fftw_api<Sample>::free(in);
+        fftw_api<Sample>::free(out);
+        return false;
+    }
+
+    e->in = in;
+    e->out = out;
+    e->n = n;
+    get_table<Sample>().scratch.push();
+
+    return true;
+}
+
+template <typename Sample>
+typename fftw_api<Sample>::plan FFTWBackend::create_plan(const plan_key& key) {
+
+    std::lock_guard<std::mutex> lock(planner_lock());
+
+    // another thread might have created the same plan while we were waiting for the lock
+    typename fftw_api<Sample>::plan plan = find_plan<Sample>(key);
+    if (plan != NULL)
+        return plan;
+
+    typename plan_table<Sample>::entry* e = get_table<Sample>().plans.next();
+    if (e == NULL)
+        return NULL;
+
+    // measured plans cost nothing if the wisdom has them already, the rest is estimated until refine()
+    int planning = fft_planning_patient;
+    plan = plan_on_scratch<Sample>(key, get_flags(planning) | FFTW_WISDOM_ONLY);
+
+    if (plan == NULL) {
+        planning = fft_planning_measure;
+        plan = plan_on_scratch<Sample>(key, get_flags(planning) | FFTW_WISDOM_ONLY);
+    }
+    if (plan == NULL) {
+        planning = fft_planning_estimate;
+        plan = plan_on_scratch<Sample>(key, FFTW_ESTIMATE);
+    }
+
+    if (plan == NULL)
+        return NULL;
+
+    e->key = key;
+    e->plan = plan;
+    e->planning = planning;
+    get_table<Sample>().plans.push();
+
+    return plan;
+}
+
+template <typename Sample>
+typename fftw_api<Sample>::plan FFTWBackend::plan_on_scratch(const plan_key& key, unsigned flags) {
+
+    typedef fftw_api<Sample> api;
+
+    // plans can only be re-used on arrays with the same alignment, so plan on scratch buffers which are
+    // offset the same way as the arrays the plan will be executed on (FFTW_MEASURE overwrites them)
+    int m = key.complex ? key.n : key.n / 2 + 1;
+    Sample* scratch_in = api::alloc(2 * m + 16);
+    Sample* scratch_out = api::alloc(2 * m + 16);
+
+    Sample* in = scratch_in + key.in_alignment / sizeof(Sample);
+    Sample* out = key.in_place ? in : scratch_out + key.out_alignment / sizeof(Sample);
+
+    typename api::plan plan;
+
+    if (key.complex)
+        plan = api::plan_c2c(key.n, (typename api::complex*)in, (typename api::complex*)out, flags);
+    else if (key.forward)
+        plan = api::plan_r2c(key.n, in, (typename api::complex*)out, flags);
+    else
+        plan = api::plan_c2r(key.n, (typename api::complex*)in, out, flags);
+
+    api::free(scratch_in);
+    api::free(scratch_out);
+
+    return plan;
+}
+
+unsigned FFTWBackend::get_flags(int planning) {
+
+    switch (planning) {
+    case fft_planning_patient: return FFTW_PATIENT;
+    case fft_planning_measure: return FFTW_MEASURE;
+    default: return FFTW_ESTIMATE;
+    }
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    FFTWBackend.h
+
+    FFTW backend. Keeps r2c / c2r / complex plans alive between calls, so that
+    planning does not happen on the audio thread. Plans are stored per (size,
+    alignment, in-place) key and executed on arbitrary arrays with the
+    fftwf_execute_dft_* new-array functions.
+    prepare() takes measured plans from the wisdom if there are any and falls
+    back to FFTW_ESTIMATE, refine() swaps in FFTW_MEASURE / FFTW_PATIENT plans.
+    Single and double precision plans (libfftw3f / libfftw3) are kept in
+    separate tables, fftw_api below maps the calls of both libraries.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFTBackend.h"
+
+#if BINAURALIZATION_USE_FFTW
+
+#include <mutex>
+#include "fftw3.h"
+
+// the parts of the FFTW API the backend uses, for Sample = float (fftwf_*) and double (fftw_*)
+template <typename Sample>
+struct fftw_api;
+
+template <>
+struct fftw_api<float> {
+    typedef fftwf_plan plan;
+    typedef fftwf_complex complex;
+
+    static plan plan_r2c(int n, float* in, complex* out, unsigned flags) { return fftwf_plan_dft_r2c_1d(n, in, out, flags); }
+    static plan plan_c2r(int n, complex* in, float* out, unsigned flags) { return fftwf_plan_dft_c2r_1d(n, in, out, flags); }
+    static plan plan_c2c(int n, complex* in, complex* out, unsigned flags) { return fftwf_plan_dft_1d(n, in, out, FFTW_BACKWARD, flags); }
+    static void execute(plan p) { fftwf_execute(p); }
+    static void execute_r2c(plan p, float* in, complex* out) { fftwf_execute_dft_r2c(p, in, out); }
+    static void execute_c2r(plan p, complex* in, float* out) { fftwf_execute_dft_c2r(p, in, out); }
+    static void execute_c2c(plan p, complex* in, complex* out) { fftwf_execute_dft(p, in, out); }
+    static void destroy(plan p) { fftwf_destroy_plan(p); }
+    static float* alloc(size_t n) { return fftwf_alloc_real(n); }
+    static void free(void* p) { fftwf_free(p); }
+    static int alignment_of(float* p) { return fftwf_alignment_of(p); }
+    static void set_timelimit(double seconds) { fftwf_set_timelimit(seconds); }
+    static int import_wisdom(const char* file) { return fftwf_import_wisdom_from_filename(file); }
+    static int export_wisdom(const char* file) { return fftwf_export_wisdom_to_filename(file); }
+};
+
+template <>
+struct fftw_api<double> {
+    typedef fftw_plan plan;
+    typedef fftw_complex complex;
+
+    static plan plan_r2c(int n, double* in, complex* out, unsigned flags) { return fftw_plan_dft_r2c_1d(n, in, out, flags); }
+    static plan plan_c2r(int n, complex* in, double* out, unsigned flags) { return fftw_plan_dft_c2r_1d(n, in, out, flags); }
+    static plan plan_c2c(int n, complex* in, complex* out, unsigned flags) { return fftw_plan_dft_1d(n, in, out, FFTW_BACKWARD, flags); }
+    static void execute(plan p) { fftw_execute(p); }
+    static void execute_r2c(plan p, double* in, complex* out) { fftw_execute_dft_r2c(p, in, out); }
+    static void execute_c2r(plan p, complex* in, double* out) { fftw_execute_dft_c2r(p, in, out); }
+    static void execute_c2c(plan p, complex* in, complex* out) { fftw_execute_dft(p, in, out); }
+    static void destroy(plan p) { fftw_destroy_plan(p); }
+    static double* alloc(size_t n) { return fftw_alloc_real(n); }
+    static void free(void* p) { fftw_free(p); }
+    static int alignment_of(double* p) { return fftw_alignment_of(p); }
+    static void set_timelimit(double seconds) { fftw_set_timelimit(seconds); }
+    static int import_wisdom(const char* file) { return fftw_import_wisdom_from_filename(file); }
+    static int export_wisdom(const char* file) { return fftw_export_wisdom_to_filename(file); }
+};
+
+class FFTWBackend : public FFTBackend
+{
+public:
+    FFTWBackend();
+    ~FFTWBackend() override;
+
+    // FFTW handles every size, sizes with small prime factors are fastest
+    bool supports_size(int n, bool) const override { return n > 0; }
+
+    // create forward, inverse and complex inverse plans of size n for aligned buffers (in-place and out-of-place),
+    // false if FFTW could not plan one of them or there is no memory for them
+    bool prepare(int n) override;
+
+    // never plan or take the planner lock: arrays aligned differently from the prepared plans go through the
+    // aligned scratch of the size, a size prepare() has not seen gives zero output (both counted as miss)
+    void forward(int n, float* input, fft_complex* output) override;
+    void inverse(int n, fft_complex* input, float* output) override;
+    void inverse_complex(int n, fft_complex* input, fft_complex* output) override;
+
+    bool supports_double() const override { return BINAURALIZATION_USE_FFTW_DOUBLE != 0; }
+    bool prepare_double(int n) override;
+    void forward_double(int n, double* input, fft_complex_d* output) override;
+    void inverse_double(int n, fft_complex_d* input, double* output) override;
+    void inverse_complex_double(int n, fft_complex_d* input, fft_complex_d* output) override;
+
+    void clear() override;
+
+    bool refine(int n, int planning) override;
+
+    // FFTW wisdom is global to the process, so these cover all instances
+    // the double precision wisdom goes to a second file next to the given one (see get_double_wisdom_file)
+    bool load_wisdom(const juce::File& file) override;
+    bool save_wisdom(const juce::File& file) override;
+    static juce::File get_double_wisdom_file(const juce::File& file);
+
+    // upper bound for creating a single plan in refine(), in seconds
+    static constexpr double max_planning_time = 2.0;
+
+private:
+    struct plan_key {
+        int n = 0;
+        int in_alignment = 0;
+        int out_alignment = 0;
+        bool in_place = false;
+        bool forward = true;
+        // complex-to-complex backward transform (used by FFTPlanCache::perform_ifft_pair)
+        bool complex = false;
+
+        bool operator== (const plan_key& other) const;
+    };
+
+    // plans of one precision, Sample is float or double
+    template <typename Sample>
+    struct plan_table {
+        typedef typename fftw_api<Sample>::plan plan_type;
+
+        struct entry {
+            plan_key key;
+            // swapped by refine() while the audio thread may be executing it
+            std::atomic<plan_type> plan{ NULL };
+            // fft_planning the plan was created with
+            int planning = fft_planning_estimate;
+        };
+
+        // readers scan the plans without taking the lock, see append_table
+        append_table<entry> plans;
+
+        // plans replaced by refine() might still be running, they are destroyed in clear()
+        append_table<plan_type> retired;
+
+        // aligned in- and output of 2 * n values per prepared size
+        struct scratch_entry {
+            int n = 0;
+            Sample* in = NULL;
+            Sample* out = NULL;
+        };
+        append_table<scratch_entry> scratch;
+    };
+
+    template <typename Sample> plan_table<Sample>& get_table();
+    template <typename Sample> bool prepare_plans(int n);
+    template <typename Sample> void forward_plan(int n, Sample* input, fft_bin<Sample>* output);
+    template <typename Sample> void inverse_plan(int n, fft_bin<Sample>* input, Sample* output);
+    template <typename Sample> void inverse_complex_plan(int n, fft_bin<Sample>* input, fft_bin<Sample>* output);
+    template <typename Sample> void clear_plans();
+    template <typename Sample> bool refine_plans(int n, int planning);
+    template <typename Sample> bool load_wisdom_file(const juce::File& file);
+    template <typename Sample> bool save_wisdom_file(const juce::File& file);
+
+    // lock-free lookup for the transforms, counts hits and misses
+    template <typename Sample> typename fftw_api<Sample>::plan get_plan(const plan_key& key);
+    template <typename Sample> typename fftw_api<Sample>::plan find_plan(const plan_key& key);
+    template <typename Sample> const typename plan_table<Sample>::scratch_entry* find_scratch(int n);
+    template <typename Sample> bool create_scratch(int n);
+    // transform on arrays no prepared plan fits: copied through the scratch of key.n with the aligned plan
+    template <typename Sample, typename In, typename Out>
+    void execute_on_scratch(plan_key key, In* input, int in_count, Out* output, int out_count,
+                            void (*execute)(typename fftw_api<Sample>::plan, In*, Out*));
+    // NULL if FFTW could not plan it or the table could not grow, nothing is stored then
+    template <typename Sample> typename fftw_api<Sample>::plan create_plan(const plan_key& key);
+    // plan for key with the given flags, NULL if FFTW_WISDOM_ONLY is set and there is no wisdom (needs planner_lock)
+    template <typename Sample> static typename fftw_api<Sample>::plan plan_on_scratch(const plan_key& key, unsigned flags);
+    static unsigned get_flags(int planning);
+
+    plan_table<float> float_plans;
+    plan_table<double> double_plans;
+
+    // the FFTW planner is not thread safe, this lock is shared by all plugin instances
+    static std::mutex& planner_lock();
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+    FractionalDelay.cpp
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "FractionalDelay.h"
+#include "SpectralKernels.h"
+
+template <typename Sample>
+FractionalDelayT<Sample>::FractionalDelayT() {
+}
+
+template <typename Sample>
+FractionalDelayT<Sample>::~FractionalDelayT() {
+
+    release();
+}
+
+template <typename Sample>
+void FractionalDelayT<Sample>::prepare(int new_max_delay, int new_max_block_size) {
+
+    release();
+
+    if (new_max_delay < 0 || new_max_block_size <= 0)
+        return;
+
+    max_delay = new_max_delay;
+    max_block_size = new_max_block_size;
+    history = max_delay + 3;
+    buffer = (Sample*)calloc(history + max_block_size, sizeof(Sample));
+    current = -1.f;
+}
+
+template <typename Sample>
+void FractionalDelayT<Sample>::release() {
+
+    free(buffer);
+    buffer = NULL;
+    max_delay = 0;
+    max_block_size = 0;
+    history = 0;
+    current = -1.f;
+}
+
+template <typename Sample>
+void FractionalDelayT<Sample>::reset() {
+
+    if (buffer != NULL)
+        memset(buffer, 0, sizeof(Sample) * (history + max_block_size));
+    current = -1.f;
+}
+
+template <typename Sample>
+void FractionalDelayT<Sample>::set_delay(float delay) {
+
+    current = (delay < 0.f) ? 0.f : ((delay > max_delay) ? (float)max_delay : delay);
+}
+
+template <typename Sample>
+int FractionalDelayT<Sample>::get_taps(double delay, Sample* taps) {
+
+    // the four samples around the delay, d - 1 ... d + 2 with d >= 1 so that no tap lies ahead of the newest
+    // sample; below one sample the fraction becomes negative, which the polynomial handles the same way
+    int d = (int)delay;
+    if (d < 1)
+        d = 1;
+    double f = delay - d;
+
+    taps[0] = (Sample)((f + 1) * f * (f - 1) / 6);
+    taps[1] = (Sample)(-(f + 1) * f * (f - 2) / 2);
+    taps[2] = (Sample)((f + 1) * (f - 1) * (f - 2) / 2);
+    taps[3] = (Sample)(-f * (f - 1) * (f - 2) / 6);
+
+    return d + 2;
+}
+
+template <typename Sample>
+void FractionalDelayT<Sample>::process(Sample* data, int count, float delay) {
+
+    if (buffer == NULL)
+        return;
+
+    for (int i = 0; i < count; i += max_block_size)
+        process_block(data + i, (count - i < max_block_size) ? count - i : max_block_size, delay);
+}
+
+template <typename Sample>
+void FractionalDelayT<Sample>::process_block(Sample* data, int count, float delay) {
+
+    if (delay < 0.f)
+        delay = 0.f;
+    if (delay > max_delay)
+        delay = (float)max_delay;
+    if (current < 0.f)
+        current = delay;
+
+    memcpy(buffer + history, data, sizeof(Sample) * count);
+
+    Sample taps[4];
+
+    if (delay == current) {
+        // output i reads buffer[history + i - offset ... history + i - offset + 3]
+        int offset = get_taps(delay, taps);
+        fir_4(buffer + history - offset, taps, data, count);
+    }
+    else {
+        // ramp to the new delay, the taps change with every sample
+        for (int i = 0; i < count; i++) {
+            double d = current + (double)(delay - current) * (i + 1) / count;
+            int offset = get_taps(d, taps);
+            const Sample* x = buffer + history + i - offset;
+            data[i] = taps[0] * x[0] + taps[1] * x[1] + taps[2] * x[2] + taps[3] * x[3];
+        }
+        current = delay;
+    }
+
+    // the newest history samples move to the front for the next block
+    memmove(buffer, buffer + count, sizeof(Sample) * history);
+}
+
+template class FractionalDelayT<float>;
+template class FractionalDelayT<double>;
@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    FractionalDelay.h
+
+    Delay line for the interaural delay of minimum phase HRIRs (see
+    make_minimum_phase()). Delays of any fraction of a sample are read with
+    third order Lagrange interpolation, a 4-tap FIR over the contiguous
+    history that runs on the SIMD kernels as long as the delay stays the
+    same. A new delay is reached by a linear ramp over one block, so a
+    change of direction glides instead of clicking.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+template <typename Sample>
+class FractionalDelayT
+{
+public:
+    FractionalDelayT();
+    ~FractionalDelayT();
+
+    // delays up to max_delay samples on blocks of up to max_block_size samples
+    void prepare(int max_delay, int max_block_size);
+    void release();
+    // clear the history, the next process() starts at its delay without a ramp
+    void reset();
+
+    // delay count samples in place by delay samples (clamped to 0 ... max_delay)
+    void process(Sample* data, int count, float delay);
+    // jump to delay without a ramp, for blocks the caller skips (the history has to be silent)
+    void set_delay(float delay);
+
+    int get_max_delay() const { return max_delay; }
+    // samples after which a silent input gives a silent output
+    int get_history_length() const { return history; }
+
+private:
+    // taps of the delay in time-reversed order for fir_4(), and the offset of the first one behind the newest sample
+    static int get_taps(double delay, Sample* taps);
+    void process_block(Sample* data, int count, float delay);
+
+    int max_delay = 0;
+    int max_block_size = 0;
+    // max_delay + 3 samples before the block, the oldest tap of the largest delay
+    int history = 0;
+    // [history | block], the block is copied behind the history and the output is read from both
+    Sample* buffer = NULL;
+    // delay of the last block, -1 after reset()
+    float current = -1.f;
+};
+
+typedef FractionalDelayT<float> FractionalDelay;
@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+
+    HrtfCache.cpp
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "HrtfCache.h"
+
+// bits per quantized coordinate in the key
+static const int key_bits = 20;
+static const int64_t key_mask = ((int64_t)1 << key_bits) - 1;
+
+HrtfCache::HrtfCache() {}
+
+HrtfCache::~HrtfCache() {
+
+    release();
+}
+
+// relaxed word by word, the sequence of the entry tells whether the copy is whole
+static void copy_from(const std::atomic<uint32_t>* words, unsigned char* bytes, size_t size) {
+
+    size_t count = size / sizeof(uint32_t);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word = words[i].load(std::memory_order_relaxed);
+        memcpy(bytes + i * sizeof(uint32_t), &word, sizeof(uint32_t));
+    }
+    if (size > count * sizeof(uint32_t)) {
+        uint32_t word = words[count].load(std::memory_order_relaxed);
+        memcpy(bytes + count * sizeof(uint32_t), &word, size - count * sizeof(uint32_t));
+    }
+}
+
+static void copy_to(std::atomic<uint32_t>* words, const unsigned char* bytes, size_t size) {
+
+    size_t count = size / sizeof(uint32_t);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word;
+        memcpy(&word, bytes + i * sizeof(uint32_t), sizeof(uint32_t));
+        words[i].store(word, std::memory_order_relaxed);
+    }
+    if (size > count * sizeof(uint32_t)) {
+        uint32_t word = 0;
+        memcpy(&word, bytes + count * sizeof(uint32_t), size - count * sizeof(uint32_t));
+        words[count].store(word, std::memory_order_relaxed);
+    }
+}
+
+void HrtfCache::prepare(size_t entry_size, size_t memory_budget) {
+
+    release();
+
+    if (entry_size == 0)
+        return;
+
+    size_t words = (entry_size + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+    size_t capacity = memory_budget / (sizeof(entry) + words * sizeof(uint32_t));
+
+    // whole sets only, nothing fits below one
+    num_sets = (int)(capacity / num_ways);
+    if (num_sets <= 0) {
+        num_sets = 0;
+        return;
+    }
+
+    this->entry_size = entry_size;
+    num_words = words;
+    int count = num_sets * num_ways;
+
+    storage = (std::atomic<uint32_t>*)malloc((size_t)count * num_words * sizeof(std::atomic<uint32_t>));
+    for (size_t i = 0; i < (size_t)count * num_words; i++)
+        new (&storage[i]) std::atomic<uint32_t>(0);
+
+    entries = (entry*)malloc(count * sizeof(entry));
+    for (int i = 0; i < count; i++) {
+        new (&entries[i]) entry();
+        entries[i].data = storage + (size_t)i * num_words;
+    }
+
+    clear();
+}
+
+void HrtfCache::release() {
+
+    if (entries != NULL) {
+        for (int i = 0; i < num_sets * num_ways; i++)
+            entries[i].~entry();
+        free(entries);
+        entries = NULL;
+    }
+    if (storage != NULL) {
+        free(storage);
+        storage = NULL;
+    }
+
+    num_sets = 0;
+    entry_size = 0;
+    num_words = 0;
+}
+
+void HrtfCache::clear() {
+
+    std::lock_guard<std::mutex> lock(write_lock);
+
+    for (int i = 0; i < num_sets * num_ways; i++) {
+        entries[i].sequence.fetch_add(1, std::memory_order_relaxed);
+        entries[i].key.store(empty_key, std::memory_order_relaxed);
+        entries[i].last_used.store(0, std::memory_order_relaxed);
+        entries[i].sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    use_clock = 0;
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+void HrtfCache::quantize(float& azimuth, float& elevation, float& distance) const {
+
+    azimuth = azimuth_step * std::round(azimuth / azimuth_step);
+    elevation = elevation_step * std::round(elevation / elevation_step);
+    distance = distance_step * std::round(distance / distance_step);
+}
+
+uint64_t HrtfCache::make_key(float azimuth, float elevation, float distance) const {
+
+    // the azimuth wraps around, 0 and 360 degrees are the same entry
+    int64_t turn = (int64_t)std::lround(360.0 / azimuth_step);
+    int64_t az = (int64_t)std::llround(azimuth / azimuth_step) % turn;
+    if (az < 0)
+        az += turn;
+
+    // elevation and distance are offset to positive values
+    int64_t el = (int64_t)std::llround(elevation / elevation_step) + (key_mask >> 1);
+    int64_t dist = (int64_t)std::llround(distance / distance_step) + (key_mask >> 1);
+
+    return (uint64_t)((az & key_mask) << (2 * key_bits) | (el & key_mask) << key_bits | (dist & key_mask));
+}
+
+int HrtfCache::get_set(uint64_t key) const {
+
+    // fibonacci hashing, neighbouring directions land in different sets
+    return (int)(((key * 0x9E3779B97F4A7C15ull) >> 32) % (uint64_t)num_sets);
+}
+
+bool HrtfCache::lookup(float azimuth, float elevation, float distance, void* data) {
+
+    if (entries == NULL) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t key = make_key(azimuth, elevation, distance);
+    entry* set = entries + get_set(key) * num_ways;
+
+    for (int i = 0; i < num_ways; i++) {
+
+        entry& e = set[i];
+        unsigned before = e.sequence.load(std::memory_order_acquire);
+        if ((before & 1) || e.key.load(std::memory_order_relaxed) != key)
+            continue;
+
+        copy_from(e.data, (unsigned char*)data, entry_size);
+
+        // a writer has replaced the entry while it was copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e.sequence.load(std::memory_order_relaxed) != before)
+            break;
+
+        e.last_used.store(use_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void HrtfCache::insert(float azimuth, float elevation, float distance, const void* data) {
+
+    if (entries == NULL)
+        return;
+
+    std::lock_guard<std::mutex> lock(write_lock);
+
+    uint64_t key = make_key(azimuth, elevation, distance);
+    entry* set = entries + get_set(key) * num_ways;
+
+    // the same direction, else a free entry, else the least recently used one
+    entry* same = NULL;
+    entry* free_entry = NULL;
+    entry* oldest = set;
+    for (int i = 0; i < num_ways; i++) {
+        uint64_t k = set[i].key.load(std::memory_order_relaxed);
+        if (k == key)
+            same = set + i;
+        else if (k == empty_key && free_entry == NULL)
+            free_entry = set + i;
+        else if (set[i].last_used.load(std::memory_order_relaxed) < oldest->last_used.load(std::memory_order_relaxed))
+            oldest = set + i;
+    }
+
+    entry* target = (same != NULL) ? same : free_entry;
+    if (target == NULL) {
+        target = oldest;
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    target->sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    target->key.store(key, std::memory_order_relaxed);
+    copy_to(target->data, (const unsigned char*)data, entry_size);
+    target->last_used.store(use_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    target->sequence.fetch_add(1, std::memory_order_release);
+}
+
+int HrtfCache::get_num_entries() const {
+
+    int count = 0;
+    for (int i = 0; i < num_sets * num_ways; i++)
+        if (entries[i].key.load(std::memory_order_relaxed) != empty_key)
+            count++;
+
+    return count;
+}
+
+size_t HrtfCache::get_memory() const {
+
+    return (size_t)num_sets * num_ways * (sizeof(entry) + num_words * sizeof(uint32_t));
+}
+
+float HrtfCache::get_hit_rate() const {
+
+    unsigned long long h = hits.load(), m = misses.load();
+    return (h + m > 0) ? (float)h / (float)(h + m) : 0.f;
+}
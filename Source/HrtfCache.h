@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    HrtfCache.h
+
+    Bounded cache of synthesized filters (see HrtfInterpolator) keyed by the
+    direction quantized to azimuth_step / elevation_step / distance_step.
+    Head tracking and sources that hover around the same spot ask for the
+    same few directions over and over, a hit copies the filter as the
+    engines hold it (the spectra of all partitions, see
+    ConvolutionEngineT::save_filter) instead of interpolating and
+    transforming it again. Entries are blobs of entry_size bytes, the
+    caller decides what goes into them.
+    The entries are grouped in sets of num_ways, a direction can only live
+    in the set its key hashes to and a full set gives up its least recently
+    used entry. Lookups take no lock: every entry has a sequence counter that
+    is odd while it is written, a reader that sees it change treats the
+    lookup as a miss. The data is copied in and out through relaxed atomic
+    words, so a reader racing a writer gets torn data it throws away rather
+    than a data race. Writers are serialized by a mutex.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+class HrtfCache
+{
+public:
+    HrtfCache();
+    ~HrtfCache();
+
+    // as many entries of entry_size bytes as fit into memory_budget bytes, clears the cache
+    // not while another thread uses it
+    void prepare(size_t entry_size, size_t memory_budget);
+    void release();
+    // drop all entries and reset the counters, e.g. for a new HRTF set of the same length
+    void clear();
+
+    // direction the entries are stored for, the caller synthesizes its HRIRs for the quantized one
+    void quantize(float& azimuth, float& elevation, float& distance) const;
+
+    // any thread, lock-free: copy the entry_size bytes cached for the quantized direction to data, false on a miss
+    // (data may have been written then)
+    bool lookup(float azimuth, float elevation, float distance, void* data);
+    // any thread: store entry_size bytes for a quantized direction, replacing the least recently used entry of its set
+    void insert(float azimuth, float elevation, float distance, const void* data);
+
+    bool is_prepared() const { return entries != NULL; }
+    int get_capacity() const { return num_sets * num_ways; }
+    int get_num_entries() const;
+    size_t get_memory() const;
+    size_t get_entry_size() const { return entry_size; }
+
+    unsigned long long get_hits() const { return hits.load(); }
+    unsigned long long get_misses() const { return misses.load(); }
+    unsigned long long get_evictions() const { return evictions.load(); }
+    float get_hit_rate() const;
+
+    // quantization of the key in degrees and metres, set before prepare()
+    float azimuth_step = 1.f;
+    float elevation_step = 1.f;
+    float distance_step = 0.1f;
+
+    // entries per set
+    static constexpr int num_ways = 8;
+
+private:
+    struct entry {
+        // odd while the entry is written
+        std::atomic<unsigned> sequence{ 0 };
+        std::atomic<uint64_t> key{ empty_key };
+        // value of use_clock at the last lookup or insert
+        std::atomic<uint64_t> last_used{ 0 };
+        // entry_size bytes in num_words words
+        std::atomic<uint32_t>* data = NULL;
+    };
+
+    static constexpr uint64_t empty_key = ~(uint64_t)0;
+
+    uint64_t make_key(float azimuth, float elevation, float distance) const;
+    int get_set(uint64_t key) const;
+
+    entry* entries = NULL;
+    // one block for the data of all entries
+    std::atomic<uint32_t>* storage = NULL;
+    int num_sets = 0;
+    size_t entry_size = 0;
+    size_t num_words = 0;
+
+    std::atomic<uint64_t> use_clock{ 0 };
+    std::atomic<unsigned long long> hits{ 0 };
+    std::atomic<unsigned long long> misses{ 0 };
+    std::atomic<unsigned long long> evictions{ 0 };
+
+    std::mutex write_lock;
+};
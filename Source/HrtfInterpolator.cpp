@@ -0,0 +1,824 @@
+/*
+  ==============================================================================
+
+    HrtfInterpolator.cpp
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "HrtfInterpolator.h"
+
+static const double pi = 3.14159265358979323846;
+
+static double dot(const double* a, const double* b) {
+
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross(const double* a, const double* b, double* result) {
+
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static void subtract(const double* a, const double* b, double* result) {
+
+    result[0] = a[0] - b[0];
+    result[1] = a[1] - b[1];
+    result[2] = a[2] - b[2];
+}
+
+// normal of the triangle a, b, c (not normalized), pointing to the side it is counter-clockwise from
+static void face_normal(const double* a, const double* b, const double* c, double* normal) {
+
+    double ab[3], ac[3];
+    subtract(b, a, ab);
+    subtract(c, a, ac);
+    cross(ab, ac, normal);
+}
+
+HrtfInterpolator::HrtfInterpolator() {
+}
+
+HrtfInterpolator::~HrtfInterpolator() {
+
+    stop();
+    release();
+}
+
+void HrtfInterpolator::to_vector(float azimuth, float elevation, double* v) {
+
+    double az = azimuth * pi / 180.;
+    double el = elevation * pi / 180.;
+
+    v[0] = cos(el) * cos(az);
+    v[1] = cos(el) * sin(az);
+    v[2] = sin(el);
+}
+
+void HrtfInterpolator::prepare(const hrtf_buffer_sc& hrtfs) {
+
+    stop();
+    release();
+
+    if (hrtfs.num_hrtfs <= 0 || hrtfs.num_samples <= 0 || hrtfs.time_left == NULL)
+        return;
+
+    points = (double*)malloc(sizeof(double) * 3 * hrtfs.num_hrtfs);
+
+    for (int i = 0; i < hrtfs.num_hrtfs; i++) {
+        // a set without directions is taken as a circle in the horizontal plane, the way the HRTF slider steps through it
+        float azimuth = (hrtfs.azimuth != NULL) ? hrtfs.azimuth[i] : 360.f * i / hrtfs.num_hrtfs;
+        float elevation = (hrtfs.elevation != NULL) ? hrtfs.elevation[i] : 0.f;
+        to_vector(azimuth, elevation, points + 3 * i);
+    }
+
+    num_points = hrtfs.num_hrtfs;
+
+    triangulate();
+    if (!analyze(hrtfs)) {
+        release();
+        return;
+    }
+
+    if (sh_order >= 0 && !planar && hrtfs.azimuth != NULL && hrtfs.elevation != NULL)
+        fit_harmonics(hrtfs);
+}
+
+void HrtfInterpolator::triangulate() {
+
+    // directions measured twice (e.g. the poles of an azimuth / elevation grid) are left out of the triangulation
+    int* unique = (int*)malloc(sizeof(int) * num_points);
+    int count = 0;
+
+    for (int i = 0; i < num_points; i++) {
+        bool repeated = false;
+        for (int j = 0; j < count && !repeated; j++) {
+            double d[3];
+            subtract(points + 3 * i, points + 3 * unique[j], d);
+            repeated = dot(d, d) < 1e-10;
+        }
+        if (!repeated)
+            unique[count++] = i;
+    }
+
+    // initial tetrahedron: the point farthest from the first one, the one farthest from the line through both
+    // and the one farthest from the plane through all three
+    int a = unique[0];
+    int b = -1;
+    int c = -1;
+    int d = -1;
+    double best = 0;
+
+    for (int i = 1; i < count; i++) {
+        double v[3];
+        subtract(points + 3 * unique[i], points + 3 * a, v);
+        if (dot(v, v) > best) {
+            best = dot(v, v);
+            b = unique[i];
+        }
+    }
+
+    best = 0;
+    for (int i = 1; i < count && b >= 0; i++) {
+        double n[3];
+        face_normal(points + 3 * a, points + 3 * b, points + 3 * unique[i], n);
+        if (dot(n, n) > best) {
+            best = dot(n, n);
+            c = unique[i];
+        }
+    }
+
+    // less than three directions or all of them on one line: nearest neighbour
+    if (c < 0 || best < 1e-12) {
+        free(unique);
+        return;
+    }
+
+    double normal[3];
+    face_normal(points + 3 * a, points + 3 * b, points + 3 * c, normal);
+    double length = sqrt(dot(normal, normal));
+    for (int i = 0; i < 3; i++)
+        normal[i] /= length;
+
+    best = 0;
+    for (int i = 0; i < count; i++) {
+        double v[3];
+        subtract(points + 3 * unique[i], points + 3 * a, v);
+        if (fabs(dot(normal, v)) > best) {
+            best = fabs(dot(normal, v));
+            d = unique[i];
+        }
+    }
+
+    // all directions in one plane, e.g. a horizontal circle
+    if (best < 1e-6) {
+        sort_circle(unique, count, normal);
+        free(unique);
+        return;
+    }
+
+    // incremental convex hull, all directions are on the unit sphere, so each of them ends up as a vertex
+    // every point added removes the faces it sees and connects itself to their border (the horizon),
+    // on a hull of v vertices that leaves 2 v - 4 faces
+    int capacity = 2 * count + 8;
+    int* faces = (int*)malloc(sizeof(int) * 3 * capacity);
+    int* next_faces = (int*)malloc(sizeof(int) * 3 * capacity);
+    int* visible = (int*)malloc(sizeof(int) * capacity);
+    int* horizon = (int*)malloc(sizeof(int) * 2 * 3 * capacity);
+    int num_faces = 0;
+
+    // the faces of the tetrahedron, wound counter-clockwise seen from outside
+    int corners[4] = { a, b, c, d };
+    double centroid[3] = {};
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 3; j++)
+            centroid[j] += 0.25 * points[3 * corners[i] + j];
+
+    for (int i = 0; i < 4; i++) {
+        int f0 = corners[(i + 1) % 4];
+        int f1 = corners[(i + 2) % 4];
+        int f2 = corners[(i + 3) % 4];
+        double n[3], v[3];
+        face_normal(points + 3 * f0, points + 3 * f1, points + 3 * f2, n);
+        subtract(points + 3 * f0, centroid, v);
+        if (dot(n, v) < 0) {
+            int swap = f1;
+            f1 = f2;
+            f2 = swap;
+        }
+        faces[3 * num_faces] = f0;
+        faces[3 * num_faces + 1] = f1;
+        faces[3 * num_faces + 2] = f2;
+        num_faces++;
+    }
+
+    for (int i = 0; i < count; i++) {
+
+        int p = unique[i];
+        if (p == a || p == b || p == c || p == d)
+            continue;
+
+        const double* point = points + 3 * p;
+        int num_visible = 0;
+
+        // points in the plane of a face do not see it, the faces next to it take the point
+        for (int f = 0; f < num_faces; f++) {
+            const int* face = faces + 3 * f;
+            double n[3], v[3];
+            face_normal(points + 3 * face[0], points + 3 * face[1], points + 3 * face[2], n);
+            subtract(point, points + 3 * face[0], v);
+            if (dot(n, v) > 1e-10 * sqrt(dot(n, n)))
+                visible[num_visible++] = f;
+        }
+
+        if (num_visible == 0)
+            continue;
+
+        // the horizon is made of the edges of visible faces whose neighbour across the edge is not visible
+        int num_horizon = 0;
+        for (int j = 0; j < num_visible; j++) {
+            const int* face = faces + 3 * visible[j];
+            for (int e = 0; e < 3; e++) {
+                int from = face[e];
+                int to = face[(e + 1) % 3];
+                bool shared = false;
+                for (int l = 0; l < num_visible && !shared; l++) {
+                    const int* other = faces + 3 * visible[l];
+                    for (int o = 0; o < 3 && !shared; o++)
+                        shared = other[o] == to && other[(o + 1) % 3] == from;
+                }
+                if (!shared) {
+                    horizon[2 * num_horizon] = from;
+                    horizon[2 * num_horizon + 1] = to;
+                    num_horizon++;
+                }
+            }
+        }
+
+        // faces the point does not see stay, the horizon edges get a face to the point with the same winding
+        int num_next = 0;
+        int v = 0;
+        for (int f = 0; f < num_faces; f++) {
+            if (v < num_visible && visible[v] == f) {
+                v++;
+                continue;
+            }
+            memcpy(next_faces + 3 * num_next, faces + 3 * f, sizeof(int) * 3);
+            num_next++;
+        }
+
+        for (int j = 0; j < num_horizon && num_next < capacity; j++) {
+            next_faces[3 * num_next] = horizon[2 * j];
+            next_faces[3 * num_next + 1] = horizon[2 * j + 1];
+            next_faces[3 * num_next + 2] = p;
+            num_next++;
+        }
+
+        int* swap = faces;
+        faces = next_faces;
+        next_faces = swap;
+        num_faces = num_next;
+    }
+
+    // rows of the inverse of [a b c], so that d = w0 a + w1 b + w2 c is solved with three dot products
+    triangles = (int*)malloc(sizeof(int) * 3 * num_faces);
+    inverses = (double*)malloc(sizeof(double) * 9 * num_faces);
+    num_triangles = 0;
+
+    for (int f = 0; f < num_faces; f++) {
+        const double* pa = points + 3 * faces[3 * f];
+        const double* pb = points + 3 * faces[3 * f + 1];
+        const double* pc = points + 3 * faces[3 * f + 2];
+        double* inverse = inverses + 9 * num_triangles;
+
+        cross(pb, pc, inverse);
+        cross(pc, pa, inverse + 3);
+        cross(pa, pb, inverse + 6);
+
+        // a face through the centre (only a set that covers less than a hemisphere has one) never gets a direction
+        double det = dot(pa, inverse);
+        if (fabs(det) < 1e-12)
+            continue;
+        for (int j = 0; j < 9; j++)
+            inverse[j] /= det;
+
+        memcpy(triangles + 3 * num_triangles, faces + 3 * f, sizeof(int) * 3);
+        num_triangles++;
+    }
+
+    free(faces);
+    free(next_faces);
+    free(visible);
+    free(horizon);
+    free(unique);
+}
+
+void HrtfInterpolator::sort_circle(const int* unique, int count, const double* normal) {
+
+    // in-plane axes, u towards the first direction
+    const double* first = points + 3 * unique[0];
+    double along = dot(first, normal);
+    for (int i = 0; i < 3; i++)
+        axis_u[i] = first[i] - along * normal[i];
+    double length = sqrt(dot(axis_u, axis_u));
+    for (int i = 0; i < 3; i++)
+        axis_u[i] /= length;
+    cross(normal, axis_u, axis_v);
+
+    circle_order = (int*)malloc(sizeof(int) * count);
+    circle_angles = (double*)malloc(sizeof(double) * count);
+    num_circle = 0;
+
+    // insertion sort by angle, done once per HRTF set
+    for (int i = 0; i < count; i++) {
+        const double* p = points + 3 * unique[i];
+        double angle = atan2(dot(p, axis_v), dot(p, axis_u));
+        int j = num_circle;
+        while (j > 0 && circle_angles[j - 1] > angle) {
+            circle_angles[j] = circle_angles[j - 1];
+            circle_order[j] = circle_order[j - 1];
+            j--;
+        }
+        circle_angles[j] = angle;
+        circle_order[j] = unique[i];
+        num_circle++;
+    }
+
+    planar = true;
+}
+
+bool HrtfInterpolator::analyze(const hrtf_buffer_sc& hrtfs) {
+
+    num_samples = hrtfs.num_samples;
+    // zero padded to twice the length, so the interpolated delays do not wrap around into the HRIR
+    fft_size = plans.get_efficient_size(2 * num_samples);
+    num_bins = fft_size / 2 + 1;
+    if (!plans.prepare(fft_size))
+        return false;
+
+    int stride = split_stride(num_bins);
+    spectrum_buffer = fft_alloc<float>(2 * stride);
+    spectrum.re = spectrum_buffer;
+    spectrum.im = spectrum_buffer + stride;
+    bins = fft_alloc<fft_complex>(num_bins);
+    time_buffer = fft_alloc<float>(fft_size);
+    slot_left = (float*)malloc(sizeof(float) * num_samples);
+    slot_right = (float*)malloc(sizeof(float) * num_samples);
+
+    // minimum phase HRIRs interpolate without comb filtering, their delays are interpolated on their own
+    if (hrtfs.delay_left != NULL && hrtfs.delay_right != NULL) {
+        delays = (float*)malloc(sizeof(float) * 2 * num_points);
+        for (int i = 0; i < num_points; i++) {
+            delays[2 * i] = hrtfs.delay_left[i];
+            delays[2 * i + 1] = hrtfs.delay_right[i];
+        }
+    }
+
+    size_t values = (size_t)num_points * 2 * num_bins;
+    magnitudes = (float*)malloc(sizeof(float) * values);
+    phases = (float*)malloc(sizeof(float) * values);
+
+    for (int i = 0; i < num_points; i++) {
+        for (int ear = 0; ear < 2; ear++) {
+
+            memcpy(time_buffer, (ear == 0) ? hrtfs.time_left[i] : hrtfs.time_right[i], sizeof(float) * num_samples);
+            memset(time_buffer + num_samples, 0, sizeof(float) * (fft_size - num_samples));
+            plans.perform_fft(fft_size, time_buffer, bins, spectrum);
+
+            float* magnitude = magnitudes + ((size_t)i * 2 + ear) * num_bins;
+            float* phase = phases + ((size_t)i * 2 + ear) * num_bins;
+            double previous = 0;
+            double unwrapped = 0;
+
+            // phase unwrapped along the bins, so a weighted sum of two phases is a delay in between
+            for (int bin = 0; bin < num_bins; bin++) {
+                double re = spectrum.re[bin];
+                double im = spectrum.im[bin];
+                double wrapped = atan2(im, re);
+                double step = wrapped - previous;
+                if (bin > 0)
+                    step -= 2 * pi * floor((step + pi) / (2 * pi));
+                unwrapped += step;
+                previous = wrapped;
+
+                magnitude[bin] = (float)sqrt(re * re + im * im);
+                phase[bin] = (float)unwrapped;
+            }
+        }
+    }
+
+    return true;
+}
+
+void HrtfInterpolator::fit_harmonics(const hrtf_buffer_sc& hrtfs) {
+
+    int num_values = 4 * num_bins + 2;
+    float* values = (float*)malloc(sizeof(float) * (size_t)num_points * num_values);
+
+    for (int i = 0; i < num_points; i++) {
+        float* v = values + (size_t)i * num_values;
+        memcpy(v, magnitudes + (size_t)i * 2 * num_bins, sizeof(float) * 2 * num_bins);
+        memcpy(v + 2 * num_bins, phases + (size_t)i * 2 * num_bins, sizeof(float) * 2 * num_bins);
+        v[4 * num_bins] = (delays != NULL) ? delays[2 * i] : 0.f;
+        v[4 * num_bins + 1] = (delays != NULL) ? delays[2 * i + 1] : 0.f;
+    }
+
+    bool fitted = harmonics.fit(hrtfs.azimuth, hrtfs.elevation, num_points, values, num_values, sh_order, sh_regularization);
+    free(values);
+
+    // the table stays if the fit fails
+    if (!fitted)
+        return;
+
+    harmonic_values = fft_alloc<float>(num_values);
+    harmonic_delays = delays != NULL;
+
+    free(magnitudes);
+    free(phases);
+    free(delays);
+    magnitudes = NULL;
+    phases = NULL;
+    delays = NULL;
+}
+
+void HrtfInterpolator::release() {
+
+    free(points);
+    free(triangles);
+    free(inverses);
+    free(circle_order);
+    free(circle_angles);
+    free(magnitudes);
+    free(phases);
+    free(delays);
+    fft_free(spectrum_buffer);
+    fft_free(bins);
+    fft_free(time_buffer);
+    free(slot_left);
+    free(slot_right);
+    fft_free(harmonic_values);
+    harmonics.release();
+
+    points = NULL;
+    triangles = NULL;
+    inverses = NULL;
+    circle_order = NULL;
+    circle_angles = NULL;
+    magnitudes = NULL;
+    phases = NULL;
+    delays = NULL;
+    spectrum_buffer = NULL;
+    spectrum = split_complex();
+    bins = NULL;
+    time_buffer = NULL;
+    slot_left = NULL;
+    slot_right = NULL;
+    harmonic_values = NULL;
+    harmonic_delays = false;
+
+    num_points = 0;
+    num_triangles = 0;
+    num_circle = 0;
+    planar = false;
+    num_samples = 0;
+    fft_size = 0;
+    num_bins = 0;
+}
+
+size_t HrtfInterpolator::get_memory() const {
+
+    if (harmonics.is_fitted())
+        return harmonics.get_memory();
+
+    size_t bytes = sizeof(float) * (size_t)num_points * 4 * num_bins;
+    if (delays != NULL)
+        bytes += sizeof(float) * 2 * num_points;
+    return bytes;
+}
+
+int HrtfInterpolator::get_weights(float azimuth, float elevation, int* indices, float* weights) const {
+
+    if (num_points <= 0)
+        return 0;
+
+    double direction[3];
+    to_vector(azimuth, elevation, direction);
+
+    if (planar) {
+        // the two neighbours on the circle, weighted by the angle to each of them
+        double angle = atan2(dot(direction, axis_v), dot(direction, axis_u));
+        int next = 0;
+        while (next < num_circle && circle_angles[next] <= angle)
+            next++;
+        int previous = (next + num_circle - 1) % num_circle;
+        next %= num_circle;
+
+        double gap = circle_angles[next] - circle_angles[previous];
+        double offset = angle - circle_angles[previous];
+        if (gap <= 0)
+            gap += 2 * pi;
+        if (offset < 0)
+            offset += 2 * pi;
+
+        double t = (gap > 0) ? offset / gap : 0;
+        indices[0] = circle_order[previous];
+        weights[0] = (float)(1 - t);
+        indices[1] = circle_order[next];
+        weights[1] = (float)t;
+        return 2;
+    }
+
+    if (num_triangles > 0) {
+        // the triangle the direction points through has three positive weights, the best one is taken
+        // so that rounding on an edge or a gap in the set (a missing bottom cap) still finds one
+        int best = -1;
+        double best_min = -1e30;
+        double best_weights[3] = {};
+
+        for (int t = 0; t < num_triangles; t++) {
+            const double* inverse = inverses + 9 * t;
+            double w[3] = { dot(inverse, direction), dot(inverse + 3, direction), dot(inverse + 6, direction) };
+            double sum = w[0] + w[1] + w[2];
+            if (sum <= 0)
+                continue;
+            double low = fmin(w[0], fmin(w[1], w[2])) / sum;
+            if (low > best_min) {
+                best_min = low;
+                best = t;
+                memcpy(best_weights, w, sizeof(w));
+            }
+        }
+
+        if (best >= 0) {
+            double sum = 0;
+            for (int i = 0; i < 3; i++) {
+                if (best_weights[i] < 0)
+                    best_weights[i] = 0;
+                sum += best_weights[i];
+            }
+
+            int count = 0;
+            for (int i = 0; i < 3; i++) {
+                if (best_weights[i] <= 0)
+                    continue;
+                indices[count] = triangles[3 * best + i];
+                weights[count] = (float)(best_weights[i] / sum);
+                count++;
+            }
+            return count;
+        }
+    }
+
+    // too few directions to triangulate
+    int nearest = 0;
+    double closest = -2;
+    for (int i = 0; i < num_points; i++) {
+        if (dot(points + 3 * i, direction) > closest) {
+            closest = dot(points + 3 * i, direction);
+            nearest = i;
+        }
+    }
+
+    indices[0] = nearest;
+    weights[0] = 1.f;
+    return 1;
+}
+
+void HrtfInterpolator::interpolate(float azimuth, float elevation, float* left, float* right, float* delay_out) {
+
+    if (num_points <= 0)
+        return;
+
+    int indices[3];
+    float weights[3];
+    int count = 0;
+
+    if (harmonics.is_fitted())
+        harmonics.evaluate(azimuth, elevation, harmonic_values);
+    else
+        count = get_weights(azimuth, elevation, indices, weights);
+
+    if (delay_out != NULL) {
+        delay_out[0] = 0.f;
+        delay_out[1] = 0.f;
+        if (harmonic_delays) {
+            delay_out[0] = fmaxf(0.f, harmonic_values[4 * num_bins]);
+            delay_out[1] = fmaxf(0.f, harmonic_values[4 * num_bins + 1]);
+        }
+        for (int j = 0; j < count && delays != NULL; j++) {
+            delay_out[0] += weights[j] * delays[2 * indices[j]];
+            delay_out[1] += weights[j] * delays[2 * indices[j] + 1];
+        }
+    }
+
+    float scale = 1.f / fft_size;
+
+    for (int ear = 0; ear < 2; ear++) {
+
+        // re collects the magnitude and im the phase before they are turned into a spectrum
+        memset(spectrum.re, 0, sizeof(float) * num_bins);
+        memset(spectrum.im, 0, sizeof(float) * num_bins);
+
+        if (harmonics.is_fitted()) {
+            // the fit can undershoot a little below zero where the measured magnitude is close to it
+            for (int bin = 0; bin < num_bins; bin++)
+                spectrum.re[bin] = fmaxf(0.f, harmonic_values[ear * num_bins + bin]);
+            memcpy(spectrum.im, harmonic_values + (2 + ear) * num_bins, sizeof(float) * num_bins);
+        }
+
+        for (int j = 0; j < count; j++) {
+            const float* magnitude = magnitudes + ((size_t)indices[j] * 2 + ear) * num_bins;
+            const float* phase = phases + ((size_t)indices[j] * 2 + ear) * num_bins;
+            float w = weights[j];
+            for (int bin = 0; bin < num_bins; bin++) {
+                spectrum.re[bin] += w * magnitude[bin];
+                spectrum.im[bin] += w * phase[bin];
+            }
+        }
+
+        for (int bin = 0; bin < num_bins; bin++) {
+            float magnitude = spectrum.re[bin];
+            float phase = spectrum.im[bin];
+            spectrum.re[bin] = magnitude * cosf(phase);
+            spectrum.im[bin] = magnitude * sinf(phase);
+        }
+
+        // DC and Nyquist of a real signal
+        spectrum.im[0] = 0.f;
+        spectrum.im[num_bins - 1] = 0.f;
+
+        plans.perform_ifft(fft_size, spectrum, bins, time_buffer);
+
+        float* output = (ear == 0) ? left : right;
+        for (int i = 0; i < num_samples; i++)
+            output[i] = time_buffer[i] * scale;
+    }
+}
+
+// the double values of a cache entry start at a multiple of their size
+static size_t get_double_offset(const ConvolutionEngine& engine) {
+
+    size_t size = engine.get_filter_values() * sizeof(float);
+    return (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+size_t HrtfInterpolator::get_cache_entry_size(const ConvolutionEngine& engine, const ConvolutionEngineT<double>* engine_double) {
+
+    if (engine.get_filter_values() <= 0)
+        return 0;
+
+    size_t size = get_double_offset(engine);
+    if (engine_double != NULL)
+        size += engine_double->get_filter_values() * sizeof(double);
+
+    return size;
+}
+
+void HrtfInterpolator::start(ConvolutionEngine* new_engine, ConvolutionEngineT<double>* new_engine_double, int new_first_filter) {
+
+    stop();
+
+    if (!is_prepared() || new_engine == NULL || new_engine->get_num_filters() < new_first_filter + num_slots)
+        return;
+    if (new_engine_double != NULL && new_engine_double->get_num_filters() < new_first_filter + num_slots)
+        new_engine_double = NULL;
+
+    engine = new_engine;
+    engine_double = new_engine_double;
+    first_filter = new_first_filter;
+
+    published = -1;
+    consumed = -1;
+    wake_pending = false;
+    worker_quit = false;
+    worker = std::thread([this] { worker_loop(); });
+}
+
+void HrtfInterpolator::stop() {
+
+    {
+        const std::lock_guard<std::mutex> lock(wake_lock);
+        worker_quit = true;
+    }
+    wake.notify_one();
+
+    if (worker.joinable())
+        worker.join();
+
+    engine = NULL;
+    engine_double = NULL;
+    published = -1;
+    consumed = -1;
+}
+
+void HrtfInterpolator::set_direction(float azimuth, float elevation, float distance) {
+
+    target_azimuth.store(azimuth, std::memory_order_relaxed);
+    target_elevation.store(elevation, std::memory_order_relaxed);
+    target_distance.store(distance, std::memory_order_relaxed);
+    {
+        // the worker either has not checked the version yet or is already waiting
+        const std::lock_guard<std::mutex> lock(wake_lock);
+        target_version.fetch_add(1, std::memory_order_release);
+    }
+    wake.notify_one();
+}
+
+int HrtfInterpolator::begin_block() const {
+
+    int slot = published.load(std::memory_order_acquire);
+    return (slot < 0) ? -1 : first_filter + slot;
+}
+
+template <typename Sample>
+void HrtfInterpolator::end_block(const ConvolutionEngineT<Sample>& engine, int filter) {
+
+    if (filter < first_filter || filter >= first_filter + num_slots)
+        return;
+
+    // a crossfade or a late stage of the non-uniform engine can still read the slot of the direction before
+    for (int slot = 0; slot < num_slots; slot++) {
+        if (first_filter + slot != filter && engine.uses_filter(first_filter + slot))
+            return;
+    }
+
+    int slot = filter - first_filter;
+    if (consumed.exchange(slot, std::memory_order_acq_rel) == slot && !wake_pending)
+        return;
+
+    // never block the audio thread on wake_lock: if the worker holds it, it may have checked consumed before the
+    // store above and be about to wait, so the wakeup is tried again on the next block
+    wake_pending = !wake_lock.try_lock();
+    if (wake_pending)
+        return;
+    wake_lock.unlock();
+    wake.notify_one();
+}
+
+template void HrtfInterpolator::end_block<float>(const ConvolutionEngineT<float>&, int);
+template void HrtfInterpolator::end_block<double>(const ConvolutionEngineT<double>&, int);
+
+void HrtfInterpolator::worker_loop() {
+
+    // the direction set before start() is loaded right away
+    unsigned done = target_version.load() - 1;
+
+    // filters of both engines as the cache holds them, only if it was prepared for these engines
+    size_t entry_size = get_cache_entry_size(*engine, engine_double);
+    size_t double_offset = get_double_offset(*engine);
+    unsigned char* cache_data = NULL;
+    if (cache != NULL && entry_size > 0 && cache->get_entry_size() == entry_size)
+        cache_data = (unsigned char*)malloc(entry_size);
+
+    while (true) {
+
+        unsigned version = done;
+        int last = -1;
+        {
+            // set_direction(), end_block() and stop() change what the predicate reads before they notify, and take
+            // wake_lock in between, so a wakeup cannot fall between the check and the wait
+            std::unique_lock<std::mutex> lock(wake_lock);
+            wake.wait(lock, [&] {
+                version = target_version.load(std::memory_order_acquire);
+                last = published.load(std::memory_order_relaxed);
+
+                // the other slot is only rewritten once the audio thread has rendered with the last one and the engine
+                // neither fades from the other any more nor has a late stage running with it (see end_block)
+                bool slot_free = last < 0 || consumed.load(std::memory_order_acquire) == last;
+
+                return worker_quit.load() || (version != done && slot_free);
+            });
+        }
+
+        if (worker_quit.load())
+            break;
+
+        int slot = (last < 0) ? 0 : (last + 1) % num_slots;
+        int filter = first_filter + slot;
+
+        float azimuth = target_azimuth.load(std::memory_order_relaxed);
+        float elevation = target_elevation.load(std::memory_order_relaxed);
+        float distance = target_distance.load(std::memory_order_relaxed);
+
+        // a cached entry is exact for its key, so a miss synthesizes the quantized direction as well
+        if (cache_data != NULL)
+            cache->quantize(azimuth, elevation, distance);
+
+        bool loaded;
+        if (cache_data != NULL && cache->lookup(azimuth, elevation, distance, cache_data)) {
+            // a hit is a copy, no interpolation and no transforms
+            loaded = engine->restore_filter(filter, (const float*)cache_data);
+            if (loaded && engine_double != NULL)
+                loaded = engine_double->restore_filter(filter, (const double*)(cache_data + double_offset));
+        }
+        else {
+            float slot_delays[2];
+            interpolate(azimuth, elevation, slot_left, slot_right, slot_delays);
+
+            // the direction is dropped if the FFT sizes of the engines could not be prepared on plans, the audio
+            // thread stays on the last slot then
+            loaded = engine->load_filter(filter, slot_left, slot_right, plans, slot_delays[0], slot_delays[1]);
+            if (loaded && engine_double != NULL)
+                loaded = engine_double->load_filter(filter, slot_left, slot_right, plans, slot_delays[0], slot_delays[1]);
+
+            if (loaded && cache_data != NULL) {
+                engine->save_filter(filter, (float*)cache_data);
+                if (engine_double != NULL)
+                    engine_double->save_filter(filter, (double*)(cache_data + double_offset));
+                cache->insert(azimuth, elevation, distance, cache_data);
+            }
+        }
+
+        if (loaded)
+            published.store(slot, std::memory_order_release);
+        done = version;
+    }
+
+    if (cache_data != NULL)
+        free(cache_data);
+}
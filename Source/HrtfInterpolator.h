@@ -0,0 +1,170 @@
+/*
+  ==============================================================================
+
+    HrtfInterpolator.h
+
+    HRIR pair for any direction from the measured HRTFs around it.
+    The measurement directions are triangulated on the unit sphere (their
+    convex hull), and a direction takes the three HRTFs of the triangle it
+    points through with barycentric weights. A set in one plane (e.g. only
+    the horizontal circle) is interpolated between the two neighbours by
+    angle instead. Magnitude and unwrapped phase are interpolated separately,
+    so the interaural delay moves instead of comb filtering like a complex
+    average would.
+    With sh_order set, magnitude, phase and delays are instead fitted to
+    spherical harmonics of that order (see SphericalHarmonics.h) and the
+    table of measured HRTFs is dropped, any direction is then evaluated
+    from the coefficients.
+    A worker thread synthesizes the HRIRs for the direction set by the editor
+    and loads them into one of two extra filters of the engines. The audio
+    thread picks up the newest one with an atomic load and the engine
+    crossfades to it like to any other HRTF, so a moving source costs the
+    audio thread no more than a static one.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "FFTBackend.h"
+#include "FFTPlanCache.h"
+#include "ConvolutionEngine.h"
+#include "HrtfCache.h"
+#include "SphericalHarmonics.h"
+
+class HrtfInterpolator
+{
+public:
+    HrtfInterpolator();
+    ~HrtfInterpolator();
+
+    // triangulate the directions of the set and take magnitude and phase of its HRIRs, stops the worker
+    // without directions (hrtfs.azimuth == NULL) the HRTFs are spread evenly over the horizontal circle
+    // is_prepared() is false afterwards if the FFT size of the analysis could not be prepared
+    void prepare(const hrtf_buffer_sc& hrtfs);
+    void release();
+
+    // up to 3 HRTFs and their weights (summing up to 1) for a direction in degrees, returns how many
+    int get_weights(float azimuth, float elevation, int* indices, float* weights) const;
+    // HRIR pair of num_samples for a direction, uses the scratch of the worker, so only while it is stopped
+    // delay_out (2 values, may be NULL) gets the weighted delays of both ears if the set has them
+    void interpolate(float azimuth, float elevation, float* left, float* right, float* delay_out = NULL);
+
+    // load the interpolated HRIRs into the extra filters first_filter ... first_filter + num_slots - 1 of the engines
+    // (engine_double may be NULL) on a worker thread, the engines must not be prepared again before stop()
+    void start(ConvolutionEngine* engine, ConvolutionEngineT<double>* engine_double, int first_filter);
+    void stop();
+
+    // any thread, the worker picks it up after the filter it is working on
+    // the distance in metres only tells cache entries apart, the HRTFs of the set are far field
+    void set_direction(float azimuth, float elevation, float distance = 1.f);
+    // take the filters from cache (may be NULL) and store the ones the worker loads there, the direction is
+    // quantized to its steps then; only while the worker is stopped, the cache is only used if it was prepared for
+    // get_cache_entry_size() of the engines given to start()
+    void set_cache(HrtfCache* cache) { this->cache = cache; }
+    // bytes of one filter of the engines as the cache holds it (see ConvolutionEngineT::save_filter): the float values,
+    // then those of engine_double (may be NULL) from the next multiple of 8 bytes; 0 if engine is not prepared
+    static size_t get_cache_entry_size(const ConvolutionEngine& engine, const ConvolutionEngineT<double>* engine_double);
+
+    // audio thread: filter to render the next block with, -1 until the first one is loaded
+    int begin_block() const;
+    // audio thread: engine has rendered a block with filter, the other slot is free for the worker again once
+    // engine does not use it any more (see ConvolutionEngine::uses_filter), wakes the worker without blocking
+    template <typename Sample>
+    void end_block(const ConvolutionEngineT<Sample>& engine, int filter);
+
+    bool is_prepared() const { return num_points > 0; }
+    // the set was fitted to spherical harmonics
+    bool is_spherical() const { return harmonics.is_fitted(); }
+    // bytes of the measured magnitudes, phases and delays, or of the harmonic coefficients that replace them
+    size_t get_memory() const;
+    bool is_planar() const { return planar; }
+    int get_num_triangles() const { return num_triangles; }
+    // extra filters the engines need
+    static constexpr int num_slots = 2;
+
+    // order of the spherical harmonic fit, -1 interpolates between the measured HRTFs; set before prepare()
+    // sets in one plane are always interpolated, the harmonics are not determined by them
+    int sh_order = -1;
+    // weight of the l * (l + 1) smoothness term of the fit (see SphericalHarmonicFit::fit)
+    float sh_regularization = 1e-4f;
+
+private:
+    static void to_vector(float azimuth, float elevation, double* v);
+    void triangulate();
+    void sort_circle(const int* unique, int count, const double* normal);
+    // false if plans could not be prepared for fft_size
+    bool analyze(const hrtf_buffer_sc& hrtfs);
+    void fit_harmonics(const hrtf_buffer_sc& hrtfs);
+    void worker_loop();
+
+    // unit vectors of the measurement directions, [point][xyz]
+    double* points = NULL;
+    int num_points = 0;
+
+    // convex hull: [triangle][3] vertex indices and [triangle][3][xyz] rows of the inverse of the vertex matrix,
+    // so the barycentric weights of a direction d are three dot products with d
+    int* triangles = NULL;
+    double* inverses = NULL;
+    int num_triangles = 0;
+
+    // all directions in one plane: ordered by their angle around the plane normal
+    bool planar = false;
+    double axis_u[3] = {};
+    double axis_v[3] = {};
+    int* circle_order = NULL;
+    double* circle_angles = NULL;
+    int num_circle = 0;
+
+    // [hrtf][ear][bin] magnitude and unwrapped phase of the HRIRs zero padded to fft_size
+    float* magnitudes = NULL;
+    float* phases = NULL;
+    int num_samples = 0;
+    int fft_size = 0;
+    int num_bins = 0;
+    // [hrtf][ear] delays of a minimum phase set, interpolated like the phase, NULL without them
+    float* delays = NULL;
+
+    // replaces magnitudes, phases and delays when fitted, each direction is a vector of
+    // [magnitude left | magnitude right | phase left | phase right] num_bins each, followed by the 2 delays
+    SphericalHarmonicFit harmonics;
+    float* harmonic_values = NULL;
+    bool harmonic_delays = false;
+
+    // scratch of interpolate()
+    float* spectrum_buffer = NULL;
+    split_complex spectrum = {};
+    fft_complex* bins = NULL;
+    float* time_buffer = NULL;
+    float* slot_left = NULL;
+    float* slot_right = NULL;
+
+    // only used by the worker (and interpolate()), the engines' plans belong to the audio thread
+    FFTPlanCache plans;
+
+    ConvolutionEngine* engine = NULL;
+    ConvolutionEngineT<double>* engine_double = NULL;
+    int first_filter = 0;
+    HrtfCache* cache = NULL;
+
+    std::atomic<float> target_azimuth{ 0.f };
+    std::atomic<float> target_elevation{ 0.f };
+    std::atomic<float> target_distance{ 1.f };
+    std::atomic<unsigned> target_version{ 0 };
+    // slot the worker has loaded last and the one the audio thread has rendered with while the engine did not
+    // use the other slot any more, -1 for none
+    std::atomic<int> published{ -1 };
+    std::atomic<int> consumed{ -1 };
+
+    std::thread worker;
+    std::atomic<bool> worker_quit{ false };
+    // the worker sleeps on wake until the direction changes, its slot is free again or it has to quit
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    // audio thread only: end_block() could not take wake_lock to wake the worker, it tries again on the next block
+    bool wake_pending = false;
+};
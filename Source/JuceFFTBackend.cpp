@@ -0,0 +1,141 @@
+/*
+  ==============================================================================
+
+    JuceFFTBackend.cpp
+
+  ==============================================================================
+*/
+
+#include <cstring>
+#include "JuceFFTBackend.h"
+
+#if BINAURALIZATION_USE_JUCE_FFT
+
+JuceFFTBackend::JuceFFTBackend() {
+
+    for (int i = 0; i <= max_order; i++)
+        ready[i] = false;
+}
+
+JuceFFTBackend::~JuceFFTBackend() {
+
+    clear();
+}
+
+int JuceFFTBackend::get_order(int n) {
+
+    int order = 0;
+    while ((1 << order) < n && order < max_order)
+        order++;
+
+    return ((1 << order) == n) ? order : -1;
+}
+
+bool JuceFFTBackend::supports_size(int n, bool) const {
+
+    return n > 1 && get_order(n) >= 0;
+}
+
+bool JuceFFTBackend::prepare(int n) {
+
+    return supports_size(n, false) && create_entry(n) != NULL;
+}
+
+void JuceFFTBackend::forward(int n, float* input, fft_complex* output) {
+
+    size_entry* e = get_entry(n);
+    if (e == NULL) {
+        memset(output, 0, sizeof(fft_complex) * (n / 2 + 1));
+        return;
+    }
+
+    memcpy(e->scratch, input, sizeof(float) * n);
+    e->fft->performRealOnlyForwardTransform(e->scratch, true);
+    memcpy(output, e->scratch, sizeof(fft_complex) * (n / 2 + 1));
+}
+
+void JuceFFTBackend::inverse(int n, fft_complex* input, float* output) {
+
+    size_entry* e = get_entry(n);
+    if (e == NULL) {
+        memset(output, 0, sizeof(float) * n);
+        return;
+    }
+
+    // JUCE rebuilds the upper half of the spectrum itself
+    memcpy(e->scratch, input, sizeof(fft_complex) * (n / 2 + 1));
+    e->fft->performRealOnlyInverseTransform(e->scratch);
+
+    float scale = (float)n;
+    for (int i = 0; i < n; i++)
+        output[i] = e->scratch[i] * scale;
+}
+
+void JuceFFTBackend::inverse_complex(int n, fft_complex* input, fft_complex* output) {
+
+    size_entry* e = get_entry(n);
+    if (e == NULL) {
+        memset(output, 0, sizeof(fft_complex) * n);
+        return;
+    }
+
+    // juce::dsp::Complex<float> is std::complex<float>, which has the layout of fft_complex
+    juce::dsp::Complex<float>* result = (juce::dsp::Complex<float>*)e->scratch;
+    e->fft->perform((const juce::dsp::Complex<float>*)input, result, true);
+
+    float scale = (float)n;
+    for (int i = 0; i < n; i++) {
+        output[i][0] = result[i].real() * scale;
+        output[i][1] = result[i].imag() * scale;
+    }
+}
+
+void JuceFFTBackend::clear() {
+
+    std::lock_guard<std::mutex> lock(setup_lock);
+
+    for (int i = 0; i <= max_order; i++) {
+        ready[i] = false;
+        delete entries[i].fft;
+        fft_free(entries[i].scratch);
+        entries[i] = size_entry();
+    }
+}
+
+JuceFFTBackend::size_entry* JuceFFTBackend::get_entry(int n) {
+
+    int order = get_order(n);
+    if (order < 0)
+        return NULL;
+
+    if (ready[order].load(std::memory_order_acquire)) {
+        hits++;
+        return &entries[order];
+    }
+
+    misses++;
+    return NULL;
+}
+
+JuceFFTBackend::size_entry* JuceFFTBackend::create_entry(int n) {
+
+    int order = get_order(n);
+    if (order < 0)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock(setup_lock);
+
+    if (!ready[order].load()) {
+        if (entries[order].fft == NULL)
+            entries[order].fft = new juce::dsp::FFT(order);
+        if (entries[order].scratch == NULL)
+            entries[order].scratch = fft_alloc_real(2 * n);
+        if (entries[order].scratch == NULL)
+            return NULL;
+        ready[order].store(true, std::memory_order_release);
+    }
+
+    return &entries[order];
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+  ==============================================================================
+
+    JuceFFTBackend.h
+
+    juce::dsp::FFT backend, power of 2 sizes only. JUCE transforms in place on
+    2 * n floats and scales its inverse transforms by 1 / n, so data goes
+    through a scratch buffer and the inverse result is scaled back by n.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFTBackend.h"
+
+#if BINAURALIZATION_USE_JUCE_FFT
+
+#include <mutex>
+
+class JuceFFTBackend : public FFTBackend
+{
+public:
+    JuceFFTBackend();
+    ~JuceFFTBackend() override;
+
+    bool supports_size(int n, bool complex) const override;
+    bool prepare(int n) override;
+
+    void forward(int n, float* input, fft_complex* output) override;
+    void inverse(int n, fft_complex* input, float* output) override;
+    void inverse_complex(int n, fft_complex* input, fft_complex* output) override;
+
+    void clear() override;
+
+private:
+    struct size_entry {
+        juce::dsp::FFT* fft = NULL;
+        // 2 * n floats
+        float* scratch = NULL;
+    };
+
+    static int get_order(int n);
+    // lock-free lookup for the transforms, counts hits and misses (NULL if prepare() has not seen n)
+    size_entry* get_entry(int n);
+    size_entry* create_entry(int n);
+
+    // one entry per order, published through the ready flags so readers do not need the lock
+    static constexpr int max_order = 24;
+    size_entry entries[max_order + 1];
+    std::atomic<bool> ready[max_order + 1];
+    std::mutex setup_lock;
+};
+
+#endif
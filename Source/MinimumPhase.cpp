@@ -0,0 +1,179 @@
+/*
+  ==============================================================================
+
+    MinimumPhase.cpp
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "MinimumPhase.h"
+
+// scratch of one n-point decomposition
+struct minimum_phase_buffers {
+
+    minimum_phase_buffers(int n) : n(n) {
+
+        int stride = split_stride(n / 2 + 1);
+        split = fft_alloc<float>(4 * stride);
+        spectrum = { split, split + stride };
+        work = { split + 2 * stride, split + 3 * stride };
+        bins = fft_alloc<fft_complex>(n / 2 + 1);
+        time = fft_alloc<float>(n);
+    }
+
+    ~minimum_phase_buffers() {
+
+        fft_free(split);
+        fft_free(bins);
+        fft_free(time);
+    }
+
+    int n;
+    float* split = NULL;
+    // spectrum of the HRIR and the one being worked on
+    split_complex spectrum = {};
+    split_complex work = {};
+    fft_complex* bins = NULL;
+    float* time = NULL;
+};
+
+static float decompose(FFTPlanCache& plans, minimum_phase_buffers& b, const float* hrir, int length, float* output) {
+
+    int n = b.n;
+    int num_bins = n / 2 + 1;
+    float scale = 1.f / n;
+
+    memcpy(b.time, hrir, sizeof(float) * length);
+    memset(b.time + length, 0, sizeof(float) * (n - length));
+    plans.perform_fft(n, b.time, b.bins, b.spectrum);
+
+    // log magnitude, with a floor 180 dB below the peak for the zeros of the spectrum
+    float peak = 0.f;
+    for (int i = 0; i < num_bins; i++)
+        peak = fmaxf(peak, b.spectrum.re[i] * b.spectrum.re[i] + b.spectrum.im[i] * b.spectrum.im[i]);
+    float floor = peak * 1e-18f + 1e-30f;
+
+    for (int i = 0; i < num_bins; i++) {
+        float power = b.spectrum.re[i] * b.spectrum.re[i] + b.spectrum.im[i] * b.spectrum.im[i];
+        b.work.re[i] = 0.5f * logf(fmaxf(power, floor));
+        b.work.im[i] = 0.f;
+    }
+
+    // real cepstrum, folded onto positive time: c[0], 2 c[i] up to n / 2, c[n / 2], nothing after
+    plans.perform_ifft(n, b.work, b.bins, b.time);
+    b.time[0] *= scale;
+    for (int i = 1; i < n / 2; i++)
+        b.time[i] *= 2.f * scale;
+    b.time[n / 2] *= scale;
+    memset(b.time + n / 2 + 1, 0, sizeof(float) * (n / 2 - 1));
+
+    // its spectrum is log magnitude + j minimum phase
+    plans.perform_fft(n, b.time, b.bins, b.work);
+    for (int i = 0; i < num_bins; i++) {
+        float magnitude = expf(b.work.re[i]);
+        float phase = b.work.im[i];
+        b.work.re[i] = magnitude * cosf(phase);
+        b.work.im[i] = magnitude * sinf(phase);
+    }
+
+    plans.perform_ifft(n, b.work, b.bins, b.time);
+    for (int i = 0; i < length; i++)
+        output[i] = b.time[i] * scale;
+
+    // the lag of the cross correlation peak is the delay, X * conj(X_min) transformed back
+    for (int i = 0; i < num_bins; i++) {
+        float re = b.spectrum.re[i] * b.work.re[i] + b.spectrum.im[i] * b.work.im[i];
+        float im = b.spectrum.im[i] * b.work.re[i] - b.spectrum.re[i] * b.work.im[i];
+        b.work.re[i] = re;
+        b.work.im[i] = im;
+    }
+    plans.perform_ifft(n, b.work, b.bins, b.time);
+
+    int lag = 0;
+    for (int i = 1; i < length; i++) {
+        if (b.time[i] > b.time[lag])
+            lag = i;
+    }
+
+    // parabola through the peak and its neighbours for the fraction
+    float fraction = 0.f;
+    if (lag > 0 && lag < length - 1) {
+        float before = b.time[lag - 1];
+        float at = b.time[lag];
+        float after = b.time[lag + 1];
+        float curvature = before - 2.f * at + after;
+        if (curvature < 0.f)
+            fraction = 0.5f * (before - after) / curvature;
+    }
+
+    return lag + fraction;
+}
+
+float minimum_phase(FFTPlanCache& plans, int n, const float* hrir, int length, float* output) {
+
+    if (!plans.prepare(n)) {
+        memcpy(output, hrir, sizeof(float) * length);
+        return 0.f;
+    }
+    minimum_phase_buffers buffers(n);
+    return decompose(plans, buffers, hrir, length, output);
+}
+
+// samples of hrir that hold at least energy of its total energy
+static int energy_length(const float* hrir, int length, double energy) {
+
+    double total = 0;
+    for (int i = 0; i < length; i++)
+        total += (double)hrir[i] * hrir[i];
+
+    double sum = 0;
+    for (int i = 0; i < length; i++) {
+        sum += (double)hrir[i] * hrir[i];
+        if (sum >= energy * total)
+            return i + 1;
+    }
+    return length;
+}
+
+int make_minimum_phase(hrtf_buffer_sc& hrtfs, FFTPlanCache& plans, double energy) {
+
+    if (hrtfs.num_hrtfs <= 0 || hrtfs.num_samples <= 0 || hrtfs.time_left == NULL)
+        return hrtfs.num_samples;
+
+    int m = hrtfs.num_samples;
+    // 4 times the HRIR keeps the cepstral aliasing of the measured responses far below the truncation
+    int n = plans.get_efficient_size(4 * m);
+    if (!plans.prepare(n))
+        return hrtfs.num_samples;
+    minimum_phase_buffers buffers(n);
+    float* output = (float*)malloc(sizeof(float) * m);
+
+    free(hrtfs.delay_left);
+    free(hrtfs.delay_right);
+    hrtfs.delay_left = (float*)malloc(sizeof(float) * hrtfs.num_hrtfs);
+    hrtfs.delay_right = (float*)malloc(sizeof(float) * hrtfs.num_hrtfs);
+
+    int length = 1;
+
+    for (int i = 0; i < hrtfs.num_hrtfs; i++) {
+        for (int ear = 0; ear < 2; ear++) {
+            float* hrir = (ear == 0) ? hrtfs.time_left[i] : hrtfs.time_right[i];
+            float delay = decompose(plans, buffers, hrir, m, output);
+            memcpy(hrir, output, sizeof(float) * m);
+            ((ear == 0) ? hrtfs.delay_left : hrtfs.delay_right)[i] = delay;
+
+            int needed = energy_length(hrir, m, energy);
+            if (needed > length)
+                length = needed;
+        }
+    }
+
+    free(output);
+
+    // the rest of each buffer stays allocated but is not read any more
+    hrtfs.num_samples = length;
+    return length;
+}
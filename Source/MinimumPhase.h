@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    MinimumPhase.h
+
+    Load-time split of HRIRs into a minimum phase filter and a delay per
+    ear. The leading zeros that carry the interaural delay make up a good
+    part of a measured HRIR, and with them num_samples and the FFT size k.
+    The minimum phase version (real cepstrum, folded onto positive time)
+    has the same magnitude response and its energy right at the start, so
+    it can be cut much shorter; the delay, estimated from the cross
+    correlation of both versions to a fraction of a sample, is applied
+    after the convolution by a FractionalDelay per ear.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFTPlanCache.h"
+#include "ConvolutionEngine.h"
+
+// replace the HRIRs of hrtfs by their minimum phase versions, cut to the shortest length that keeps at least
+// energy of every HRIR, and store the delay of each ear in hrtfs.delay_left / delay_right (reallocated)
+// the time-domain buffers keep their size, num_samples is set to the new length and returned
+// if plans cannot be prepared for the FFT size, hrtfs is left as it was
+int make_minimum_phase(hrtf_buffer_sc& hrtfs, FFTPlanCache& plans, double energy = 0.9999);
+
+// minimum phase version of length samples of hrir, zero padded to an n-point FFT (n >= 2 * length, larger n
+// means less cepstral aliasing), output holds length samples; returns the delay of hrir against it in samples
+// (a copy of hrir and no delay if plans cannot be prepared for n)
+float minimum_phase(FFTPlanCache& plans, int n, const float* hrir, int length, float* output);
@@ -0,0 +1,572 @@
+/*
+  ==============================================================================
+
+    NonUniformConvolver.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "NonUniformConvolver.h"
+
+template <typename Sample>
+NonUniformConvolverT<Sample>::NonUniformConvolverT(FFTPlanCache& plans) : fft_plans(plans) {
+
+    for (int i = 0; i < max_stages; i++)
+        job_state[i] = job_idle;
+}
+
+template <typename Sample>
+NonUniformConvolverT<Sample>::~NonUniformConvolverT() {
+
+    release();
+}
+
+template <typename Sample>
+bool NonUniformConvolverT<Sample>::prepare(int new_max_block_size, int new_num_filters, int ir_length, bool threaded) {
+
+    release();
+
+    if (new_max_block_size <= 0 || new_num_filters <= 0 || ir_length <= 0)
+        return false;
+
+    max_block_size = new_max_block_size;
+    num_filters = new_num_filters;
+    head_taps = (ir_length < head_length) ? ir_length : head_length;
+
+    head.prepare(max_block_size, num_filters, head_taps);
+
+    // stage i uses partitions of head_length * 2^i samples and starts at an offset of at least one partition
+    int offset = head_length;
+    int partition_size = head_length;
+    int largest_partition = 0;
+
+    while (offset < ir_length && num_stages < max_stages) {
+
+        int remaining = ir_length - offset;
+        int length = partitions_per_stage * partition_size;
+
+        // the last possible stage takes the rest of the IR with uniform partitions
+        if (remaining < length || partition_size == max_partition_size || num_stages == max_stages - 1)
+            length = remaining;
+
+        stage& s = stages[num_stages];
+        s.conv = new UniformConvolverT<Sample>(fft_plans);
+        if (!s.conv->prepare(partition_size, num_filters, length)) {
+            delete s.conv;
+            s.conv = NULL;
+            release();
+            return false;
+        }
+        s.conv->packed_ifft = packed_ifft;
+        s.partition_size = partition_size;
+        s.offset = offset;
+        s.length = length;
+        s.input = (Sample*)calloc(partition_size, sizeof(Sample));
+        s.fill = 0;
+
+        largest_partition = partition_size;
+        num_stages++;
+
+        offset += length;
+        if (partition_size < max_partition_size)
+            partition_size *= 2;
+    }
+
+    // results of the last stage reach up to max_block_size + offset samples ahead of the read position
+    int last_offset = (num_stages > 0) ? stages[num_stages - 1].offset : 0;
+    ring_size = 1;
+    while (ring_size <= max_block_size + last_offset)
+        ring_size <<= 1;
+
+    ring_left = (Sample*)calloc(ring_size, sizeof(Sample));
+    ring_right = (Sample*)calloc(ring_size, sizeof(Sample));
+    ring_pos = 0;
+    position = 0;
+
+    if (largest_partition > 0) {
+        scratch_left = (Sample*)malloc(sizeof(Sample) * largest_partition);
+        scratch_right = (Sample*)malloc(sizeof(Sample) * largest_partition);
+    }
+
+    // a stage goes to the worker if its result is due at least one block after its input is complete
+    // (the slack offset - P only grows with the stage index), and if its partition size is new
+    first_threaded = num_stages;
+    for (int i = 0; threaded && i < num_stages; i++) {
+        stage& s = stages[i];
+        if (s.offset - s.partition_size >= max_block_size && (i == 0 || s.partition_size > stages[i - 1].partition_size)) {
+            first_threaded = i;
+            break;
+        }
+    }
+
+    for (int i = first_threaded; i < num_stages; i++) {
+        stage& s = stages[i];
+        s.job_input = (Sample*)calloc(s.partition_size, sizeof(Sample));
+        s.job_left = (Sample*)calloc(s.partition_size, sizeof(Sample));
+        s.job_right = (Sample*)calloc(s.partition_size, sizeof(Sample));
+    }
+
+    deadline_misses = 0;
+
+    if (first_threaded < num_stages)
+        start_worker();
+
+    return true;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::set_filter(int index, const float* left, const float* right, int length) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    load_filter(index, left, right, length, fft_plans);
+    reset();
+}
+
+template <typename Sample>
+bool NonUniformConvolverT<Sample>::prepare_plans(FFTPlanCache& plans) const {
+
+    for (int i = 0; i < num_stages; i++) {
+        if (!stages[i].conv->prepare_plans(plans))
+            return false;
+    }
+
+    return true;
+}
+
+template <typename Sample>
+bool NonUniformConvolverT<Sample>::load_filter(int index, const float* left, const float* right, int length, FFTPlanCache& plans) {
+
+    if (index < 0 || index >= num_filters)
+        return false;
+
+    // every size first, so a failure leaves the whole filter as it was
+    if (!prepare_plans(plans))
+        return false;
+
+    head.load_filter(index, left, right, (length < head_taps) ? length : head_taps);
+
+    for (int i = 0; i < num_stages; i++) {
+        stage& s = stages[i];
+        int count = length - s.offset;
+        if (count > s.length)
+            count = s.length;
+
+        if (count > 0)
+            s.conv->load_filter(index, left + s.offset, right + s.offset, count, plans);
+        else
+            s.conv->load_filter(index, left, right, 0, plans);
+    }
+
+    return true;
+}
+
+template <typename Sample>
+int NonUniformConvolverT<Sample>::get_filter_values() const {
+
+    int values = head.get_filter_values();
+    for (int i = 0; i < num_stages; i++)
+        values += stages[i].conv->get_filter_values();
+
+    return values;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::save_filter(int index, Sample* values) const {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    head.save_filter(index, values);
+    values += head.get_filter_values();
+
+    for (int i = 0; i < num_stages; i++) {
+        stages[i].conv->save_filter(index, values);
+        values += stages[i].conv->get_filter_values();
+    }
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::restore_filter(int index, const Sample* values) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    head.restore_filter(index, values);
+    values += head.get_filter_values();
+
+    for (int i = 0; i < num_stages; i++) {
+        stages[i].conv->restore_filter(index, values);
+        values += stages[i].conv->get_filter_values();
+    }
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::set_packed_ifft(bool packed) {
+
+    packed_ifft = packed;
+
+    for (int i = 0; i < num_stages; i++)
+        stages[i].conv->packed_ifft = packed;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::set_crossfade(bool crossfade) {
+
+    head.crossfade = crossfade;
+
+    for (int i = 0; i < num_stages; i++)
+        stages[i].conv->crossfade = crossfade;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::set_current_filter(int sel) {
+
+    // the stages of the worker are only touched while it has nothing of them
+    for (int i = first_threaded; i < num_stages; i++) {
+        if (job_state[i].load(std::memory_order_acquire) != job_idle)
+            collect_job(i, true);
+    }
+
+    head.set_current_filter(sel);
+
+    for (int i = 0; i < num_stages; i++) {
+        stages[i].conv->set_current_filter(sel);
+        stages[i].job_sel = sel;
+        stages[i].fade_sel = sel;
+    }
+}
+
+template <typename Sample>
+bool NonUniformConvolverT<Sample>::uses_filter(int index) const {
+
+    if (head.uses_filter(index))
+        return true;
+
+    for (int i = 0; i < first_threaded; i++) {
+        if (stages[i].conv->uses_filter(index))
+            return true;
+    }
+
+    // the worker owns the convolver of a threaded stage, the filters it runs with are tracked on this side
+    for (int i = first_threaded; i < num_stages; i++) {
+        const stage& s = stages[i];
+        if (s.job_sel == index || (job_state[i].load(std::memory_order_acquire) != job_idle && s.fade_sel == index))
+            return true;
+    }
+
+    return false;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::reset() {
+
+    if (ring_left == NULL)
+        return;
+
+    // jobs in flight still write to their stage, let them finish and drop the results
+    for (int i = first_threaded; i < num_stages; i++) {
+        while (job_state[i].load(std::memory_order_acquire) == job_queued)
+            std::this_thread::yield();
+        job_state[i] = job_idle;
+    }
+
+    head.reset();
+    memset(ring_left, 0, sizeof(Sample) * ring_size);
+    memset(ring_right, 0, sizeof(Sample) * ring_size);
+    ring_pos = 0;
+    position = 0;
+
+    for (int i = 0; i < num_stages; i++) {
+        stages[i].conv->reset();
+        memset(stages[i].input, 0, sizeof(Sample) * stages[i].partition_size);
+        stages[i].fill = 0;
+        stages[i].job_sel = -1;
+        stages[i].fade_sel = -1;
+    }
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::process(const Sample* input, Sample* left, Sample* right, int count, int sel) {
+
+    if (ring_left == NULL || sel < 0 || sel >= num_filters || count > max_block_size)
+        return;
+
+    // the stages consume the input before the head overwrites left/right, which may alias it
+    process_stages(input, count, sel);
+    head.process(input, left, right, count, sel);
+
+    // a job submitted while the worker held wake_lock
+    if (wake_pending)
+        wake_worker();
+
+    // worker results are added as soon as they are done, and waited for if this block needs them
+    for (int i = first_threaded; i < num_stages; i++) {
+        if (job_state[i].load(std::memory_order_acquire) != job_idle)
+            collect_job(i, stages[i].job_start < position + count);
+    }
+
+    // add what the stages have computed for this block and free the ring slots again
+    int mask = ring_size - 1;
+    for (int i = 0; i < count; i++) {
+        int pos = (ring_pos + i) & mask;
+        left[i] += ring_left[pos];
+        right[i] += ring_right[pos];
+        ring_left[pos] = 0;
+        ring_right[pos] = 0;
+    }
+    ring_pos = (ring_pos + count) & mask;
+    position += count;
+}
+
+template <typename Sample>
+int NonUniformConvolverT<Sample>::get_history_length() const {
+
+    // a sample reaches the last stage at most one partition late, and its result lasts offset + length samples
+    int history = head_taps + max_block_size;
+    for (int i = 0; i < num_stages; i++) {
+        const stage& s = stages[i];
+        int length = s.offset + s.length + 2 * s.partition_size + max_block_size;
+        if (length > history)
+            history = length;
+    }
+
+    return history;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::skip(int count) {
+
+    if (ring_left == NULL)
+        return;
+
+    // the worker results are zero by now, but their buffers still belong to the worker until collected
+    for (int i = first_threaded; i < num_stages; i++) {
+        if (job_state[i].load(std::memory_order_acquire) != job_idle)
+            collect_job(i, true);
+    }
+
+    // the partially filled partitions get the zeros process_stages would have copied, a completed one is the
+    // FFT of silence against an FDL of silence and adds nothing
+    for (int i = 0; i < num_stages; i++) {
+        stage& s = stages[i];
+        int pos = 0;
+
+        while (pos < count) {
+            int take = s.partition_size - s.fill;
+            if (take > count - pos)
+                take = count - pos;
+
+            memset(s.input + s.fill, 0, sizeof(Sample) * take);
+            s.fill += take;
+            pos += take;
+
+            if (s.fill == s.partition_size)
+                s.fill = 0;
+        }
+    }
+
+    // the ring is clear, the head FIR only holds silence
+    ring_pos = (ring_pos + count) & (ring_size - 1);
+    position += count;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::process_stages(const Sample* input, int count, int sel) {
+
+    int mask = ring_size - 1;
+
+    for (int i = 0; i < num_stages; i++) {
+        stage& s = stages[i];
+        int pos = 0;
+
+        while (pos < count) {
+            int take = s.partition_size - s.fill;
+            if (take > count - pos)
+                take = count - pos;
+
+            memcpy(s.input + s.fill, input + pos, sizeof(Sample) * take);
+            s.fill += take;
+            pos += take;
+
+            if (s.fill < s.partition_size)
+                break;
+
+            if (i >= first_threaded) {
+                submit_job(i, position + pos - s.partition_size + s.offset, sel);
+                continue;
+            }
+
+            // the partition ending at time t yields output for t - P + offset ... t + offset - 1, which is never in the past
+            s.conv->process(s.input, scratch_left, scratch_right, sel);
+            s.fill = 0;
+
+            int start = ring_pos + pos - s.partition_size + s.offset;
+            for (int j = 0; j < s.partition_size; j++) {
+                ring_left[(start + j) & mask] += scratch_left[j];
+                ring_right[(start + j) & mask] += scratch_right[j];
+            }
+        }
+    }
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::submit_job(int s, long long start, int sel) {
+
+    stage& st = stages[s];
+
+    // the previous result is only still pending if its deadline is later than this partition (slack > P)
+    if (job_state[s].load(std::memory_order_acquire) != job_idle)
+        collect_job(s, true);
+
+    // the completed partition becomes the job, the old job buffer collects the next one
+    Sample* completed = st.input;
+    st.input = st.job_input;
+    st.job_input = completed;
+    st.fill = 0;
+    st.job_start = start;
+    st.fade_sel = st.job_sel;
+    st.job_sel = sel;
+
+    job_state[s].store(job_queued, std::memory_order_release);
+
+    unsigned tail = queue_tail.load(std::memory_order_relaxed);
+    queue[tail % max_stages] = s;
+    queue_tail.store(tail + 1, std::memory_order_release);
+    wake_worker();
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::wake_worker() {
+
+    // never block the audio thread on wake_lock: if the worker holds it, it may have checked the queue before the
+    // new job and be about to wait, so the wakeup is tried again on the next block or while waiting for the job
+    wake_pending = !wake_lock.try_lock();
+    if (wake_pending)
+        return;
+    wake_lock.unlock();
+    wake.notify_one();
+}
+
+template <typename Sample>
+bool NonUniformConvolverT<Sample>::collect_job(int s, bool wait) {
+
+    int state = job_state[s].load(std::memory_order_acquire);
+
+    if (state == job_queued) {
+        if (!wait)
+            return false;
+
+        deadline_misses++;
+        while ((state = job_state[s].load(std::memory_order_acquire)) == job_queued) {
+            if (wake_pending)
+                wake_worker();
+            std::this_thread::yield();
+        }
+    }
+
+    if (state == job_done) {
+        stage& st = stages[s];
+        int mask = ring_size - 1;
+        for (int j = 0; j < st.partition_size; j++) {
+            ring_left[(st.job_start + j) & mask] += st.job_left[j];
+            ring_right[(st.job_start + j) & mask] += st.job_right[j];
+        }
+    }
+
+    job_state[s].store(job_idle, std::memory_order_relaxed);
+    return true;
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::worker_loop() {
+
+    while (true) {
+
+        unsigned head_index = queue_head.load(std::memory_order_relaxed);
+        {
+            // submit_job() and stop_worker() change the queue or worker_quit before they take wake_lock to notify,
+            // so a wakeup cannot fall between the check and the wait (see wake_worker())
+            std::unique_lock<std::mutex> lock(wake_lock);
+            wake.wait(lock, [&] { return worker_quit.load() || head_index != queue_tail.load(std::memory_order_acquire); });
+        }
+
+        if (worker_quit.load())
+            break;
+
+        int s = queue[head_index % max_stages];
+        queue_head.store(head_index + 1, std::memory_order_release);
+
+        stage& st = stages[s];
+        st.conv->process(st.job_input, st.job_left, st.job_right, st.job_sel);
+        job_state[s].store(job_done, std::memory_order_release);
+    }
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::start_worker() {
+
+    stop_worker();
+
+    queue_head = 0;
+    queue_tail = 0;
+    wake_pending = false;
+    worker_quit = false;
+    worker = std::thread([this] { worker_loop(); });
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::stop_worker() {
+
+    {
+        const std::lock_guard<std::mutex> lock(wake_lock);
+        worker_quit = true;
+    }
+    wake.notify_one();
+
+    if (worker.joinable())
+        worker.join();
+}
+
+template <typename Sample>
+void NonUniformConvolverT<Sample>::release() {
+
+    stop_worker();
+
+    head.release();
+
+    for (int i = 0; i < num_stages; i++) {
+        delete stages[i].conv;
+        free(stages[i].input);
+        free(stages[i].job_input);
+        free(stages[i].job_left);
+        free(stages[i].job_right);
+        stages[i] = stage();
+        job_state[i] = job_idle;
+    }
+
+    free(ring_left);
+    free(ring_right);
+    free(scratch_left);
+    free(scratch_right);
+
+    ring_left = NULL;
+    ring_right = NULL;
+    scratch_left = NULL;
+    scratch_right = NULL;
+
+    max_block_size = 0;
+    num_filters = 0;
+    head_taps = 0;
+    num_stages = 0;
+    first_threaded = 0;
+    ring_size = 0;
+    ring_pos = 0;
+    position = 0;
+}
+
+template class NonUniformConvolverT<float>;
+template class NonUniformConvolverT<double>;
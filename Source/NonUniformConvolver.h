@@ -0,0 +1,181 @@
+/*
+  ==============================================================================
+
+    NonUniformConvolver.h
+
+    Non-uniformly partitioned convolution for long BRIRs.
+    The first head_length taps are convolved in the time domain (direct-form FIR),
+    so the output has no latency. The tail is split into stages with
+    geometrically growing partition sizes, each stage being a UniformConvolver
+    whose results are written ahead into an output ring. A stage with partition
+    size P starts at an IR offset >= P, so its result is always ready in time.
+    Sample is float or double (64-bit engine), the HRIRs are always float.
+    With prepare(..., threaded = true) the late stages, whose results are due
+    at least max_block_size samples after their input is complete, are handed
+    to a worker thread through a lock-free queue (time-distributed
+    convolution). The audio thread only runs the head and the early stages,
+    and adds a worker result to the ring once it is done, at the latest in
+    the block that needs it (waiting there counts as a deadline miss).
+    Threaded stages never share a partition size, and therefore FFT size,
+    with the stages of the audio thread.
+    A change of sel is crossfaded by the head and by every stage on its next
+    partition, so each part of the IR fades over its own partition length.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "FFTBackend.h"
+#include "FFTPlanCache.h"
+#include "UniformConvolver.h"
+#include "DirectConvolver.h"
+
+template <typename Sample>
+class NonUniformConvolverT
+{
+public:
+    NonUniformConvolverT(FFTPlanCache& plans);
+    ~NonUniformConvolverT();
+
+    // max_block_size is the largest number of samples passed to process()
+    // threaded starts a worker thread for the late stages, if there are any
+    // false (and released) if the FFT size of a stage could not be prepared
+    bool prepare(int max_block_size, int num_filters, int ir_length, bool threaded = false);
+    void set_filter(int index, const float* left, const float* right, int length);
+    // same without the reset, for a filter process() does not use at the moment, on any thread
+    // (see UniformConvolver::load_filter), false if plans could not be prepared, nothing is written then
+    bool load_filter(int index, const float* left, const float* right, int length, FFTPlanCache& plans);
+    // set up the FFT sizes of all stages on plans
+    bool prepare_plans(FFTPlanCache& plans) const;
+    // see UniformConvolver::save_filter, the head followed by all stages
+    int get_filter_values() const;
+    void save_filter(int index, Sample* values) const;
+    void restore_filter(int index, const Sample* values);
+    void reset();
+
+    // convolve count <= max_block_size samples, input may alias one of the outputs
+    void process(const Sample* input, Sample* left, Sample* right, int count, int sel);
+
+    // samples of silent input after which every buffer is zero and the output stays silent
+    int get_history_length() const;
+    // advance by count silent samples without computing anything, only valid after get_history_length()
+    // silent samples; keeps the partition boundaries where process() would have them, so the output stays bit-exact
+    void skip(int count);
+
+    void release();
+
+    int get_max_block_size() const { return max_block_size; }
+    int get_num_stages() const { return num_stages; }
+    // stages computed by the worker thread, 0 if not threaded
+    int get_num_threaded_stages() const { return num_stages - first_threaded; }
+    // worker results that were not done when the audio thread needed them, since prepare()
+    int get_deadline_misses() const { return deadline_misses.load(); }
+
+    // see UniformConvolver::packed_ifft, applies to all stages
+    void set_packed_ifft(bool packed);
+    // see UniformConvolver::crossfade, applies to the head and all stages
+    void set_crossfade(bool crossfade);
+    // continue with filter sel without a crossfade, e.g. after silence
+    void set_current_filter(int sel);
+    // audio thread: the head or a stage fades from filter index on its next change of sel, or a job of the worker
+    // still renders with it (see UniformConvolver::uses_filter)
+    bool uses_filter(int index) const;
+
+    // taps handled by the direct-form head, should be a power of 2
+    static constexpr int head_length = 256;
+    // partitions per stage before the partition size doubles, and the largest partition size
+    static constexpr int partitions_per_stage = 2;
+    static constexpr int max_partition_size = 8192;
+    static constexpr int max_stages = 16;
+
+private:
+    struct stage {
+        UniformConvolverT<Sample>* conv = NULL;
+        int partition_size = 0;
+        // first IR sample covered by this stage and number of samples covered
+        int offset = 0;
+        int length = 0;
+        // input collected for the next partition
+        Sample* input = NULL;
+        int fill = 0;
+
+        // threaded stages: the last complete partition and its result, owned by the worker while job_state
+        // is job_queued. the result goes to the ring from job_start (absolute sample position) on
+        Sample* job_input = NULL;
+        Sample* job_left = NULL;
+        Sample* job_right = NULL;
+        long long job_start = 0;
+        int job_sel = -1;
+        // filter the job fades from, the one of the job before (job_sel is the one the stage fades from once idle)
+        int fade_sel = -1;
+    };
+
+    enum job_states {
+        job_idle = 0,
+        job_queued,
+        job_done
+    };
+
+    void process_stages(const Sample* input, int count, int sel);
+    // hand the partition stage s has just completed to the worker, start is where its result begins
+    void submit_job(int s, long long start, int sel);
+    // add the result of stage s to the ring, waits for the worker if wait is set and the job is not done yet
+    bool collect_job(int s, bool wait);
+    // notify the worker if wake_lock is free, sets wake_pending otherwise
+    void wake_worker();
+    void worker_loop();
+    void start_worker();
+    void stop_worker();
+
+    FFTPlanCache& fft_plans;
+
+    int max_block_size = 0;
+    int num_filters = 0;
+    bool packed_ifft = false;
+    int head_taps = 0;
+
+    // direct-form FIR over the first head_taps samples of every HRIR
+    DirectConvolverT<Sample> head;
+
+    stage stages[max_stages];
+    int num_stages = 0;
+
+    // stage results are added ahead of time into these rings, ring_size is a power of 2
+    Sample* ring_left = NULL;
+    Sample* ring_right = NULL;
+    int ring_size = 0;
+    // number of samples processed so far (mod ring_size)
+    int ring_pos = 0;
+    // same without the modulo, for the deadlines of the worker results
+    long long position = 0;
+
+    // stages from first_threaded on run on the worker (num_stages if none)
+    int first_threaded = 0;
+    std::atomic<int> job_state[max_stages];
+    std::atomic<int> deadline_misses{ 0 };
+
+    // single producer (audio thread) / single consumer (worker) queue of stage indices,
+    // each stage has at most one job in flight, so max_stages slots are enough
+    int queue[max_stages];
+    std::atomic<unsigned> queue_head{ 0 };
+    std::atomic<unsigned> queue_tail{ 0 };
+
+    std::thread worker;
+    std::atomic<bool> worker_quit{ false };
+    // the worker sleeps on wake until a job is queued or it has to quit, the audio thread only tries to take
+    // wake_lock so it never blocks on it
+    std::mutex wake_lock;
+    std::condition_variable wake;
+    // audio thread only: wake_worker() could not take wake_lock, it tries again on the next block
+    bool wake_pending = false;
+
+    Sample* scratch_left = NULL;
+    Sample* scratch_right = NULL;
+};
+
+typedef NonUniformConvolverT<float> NonUniformConvolver;
@@ -8,6 +8,57 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#if BINAURALIZATION_BENCHMARKS
+#include "Benchmarks.h"
+#endif
+
+// angle after key in name (e.g. "azi_30" or "ele-10,5"), skipping the letters and separators in between
+static bool read_angle(const char* name, const char* key, float& angle) {
+
+    const char* p = strstr(name, key);
+    if (p == NULL)
+        return false;
+
+    p += strlen(key);
+    while (*p == '_' || *p == '=' || (*p >= 'a' && *p <= 'z'))
+        p++;
+
+    char* end = NULL;
+    angle = (float)strtod(p, &end);
+    return end != p;
+}
+
+// measurement direction from the file name of a HRIR, for the naming schemes of the common databases
+static bool parse_direction(const String& file_name, float& azimuth, float& elevation) {
+
+    char name[256];
+    strncpy(name, file_name.toLowerCase().toRawUTF8(), sizeof(name) - 1);
+    name[sizeof(name) - 1] = 0;
+
+    // decimal commas, e.g. "azi_22,5_ele_0,0"
+    for (char* c = name; *c != 0; c++)
+        if (*c == ',')
+            *c = '.';
+
+    // "azi30_ele0", "azimuth_30_elevation_0"
+    if (read_angle(name, "azi", azimuth) && read_angle(name, "ele", elevation))
+        return true;
+
+    // "IRC_1002_C_R0195_T030_P000" (theta is the azimuth, phi the elevation)
+    if (read_angle(name, "_t", azimuth) && read_angle(name, "_p", elevation))
+        return true;
+
+    // "H0e030a" (elevation first)
+    int el = 0;
+    int az = 0;
+    if (sscanf(name, "h%de%da", &el, &az) == 2 || sscanf(name, "l%de%da", &el, &az) == 2) {
+        elevation = el;
+        azimuth = az;
+        return true;
+    }
+
+    return false;
+}
 
 //==============================================================================
 BinauralizationAudioProcessorEditor::BinauralizationAudioProcessorEditor (BinauralizationAudioProcessor& p)
@@ -27,15 +78,84 @@ BinauralizationAudioProcessorEditor::BinauralizationAudioProcessorEditor (Binaur
     ConvButton.setColour(TextButton::textColourOffId, Colours::black);
     addAndMakeVisible(ConvButton);
 
-    // onDrag only changes slider value after releasing the slider
-    // for a continuous filter change a different approach has to be chosen, but this would also require
-    // are more complex filter transition process
-    HRTF_Slider.onDragEnd = [this] {audioProcessor.hrtf_buffer.sel = HRTF_Slider.getValue(); };
+    // the engines crossfade between the old and the new HRTF, so the direction can follow the slider while dragging
+    HRTF_Slider.onValueChange = [this] {
+        audioProcessor.hrtf_buffer->sel = roundToInt(HRTF_Slider.getValue());
+        audioProcessor.interpolator.set_direction(HRTF_Slider.getValue(), Elevation_Slider.getValue());
+    };
     HRTF_Slider.setSliderStyle(Slider::Rotary);
-    HRTF_Slider.setRange(0, 359, 1);
     HRTF_Slider.setTextBoxStyle(Slider::TextBoxBelow, 1, 50, 20);
     addAndMakeVisible(HRTF_Slider);
 
+    // item ids are mode + 1, since ComboBox reserves id 0 for "nothing selected"
+    ModeBox.addItem("Overlap-add", ConvolutionEngine::overlap_add + 1);
+    ModeBox.addItem("Uniform partitioned", ConvolutionEngine::uniform_partitioned + 1);
+    ModeBox.addItem("Non-uniform partitioned", ConvolutionEngine::non_uniform_partitioned + 1);
+    ModeBox.addItem("Direct-form FIR", ConvolutionEngine::direct_form + 1);
+    ModeBox.addItem("Automatic (FIR / FFT)", ConvolutionEngine::automatic + 1);
+    ModeBox.addItem("Time-distributed (worker)", ConvolutionEngine::time_distributed + 1);
+    ModeBox.setSelectedId(audioProcessor.engine->mode + 1);
+    ModeBox.onChange = [this] {audioProcessor.set_mode(ModeBox.getSelectedId() - 1); };
+    addAndMakeVisible(ModeBox);
+
+    // item ids are backend + 2, id 1 lets the tuner pick
+    BackendBox.addItem("Tuned FFT", 1);
+    for (int i = 0; i < num_fft_backends; i++) {
+        if (is_fft_backend_available(i))
+            BackendBox.addItem(get_fft_backend_name(i), i + 2);
+    }
+    BackendBox.setSelectedId(audioProcessor.fft_backend + 2);
+    BackendBox.onChange = [this] {audioProcessor.set_fft_backend(BackendBox.getSelectedId() - 2); };
+    addAndMakeVisible(BackendBox);
+
+    // the engines add either no latency or one block, id 1 allows the block
+    LatencyBox.addItem("Any latency", 1);
+    LatencyBox.addItem("No latency", 2);
+    LatencyBox.setSelectedId(audioProcessor.max_latency > 0 ? 1 : 2);
+    LatencyBox.onChange = [this] {audioProcessor.set_max_latency(LatencyBox.getSelectedId() == 1 ? INT_MAX : 0); };
+    addAndMakeVisible(LatencyBox);
+
+    // only matters while the host processes in double precision
+    PrecisionButton.onClick = [this] {togglePrecision(); };
+    PrecisionButton.setColour(TextButton::buttonColourId, Colour(0xff79ed7f));
+    PrecisionButton.setColour(TextButton::textColourOffId, Colours::black);
+    PrecisionButton.setButtonText(audioProcessor.double_engine ? "64-bit engine" : "32-bit engine");
+    PrecisionButton.setEnabled(audioProcessor.supportsDoublePrecisionProcessing());
+    addAndMakeVisible(PrecisionButton);
+
+    // interpolate the HRTFs for the direction of both sliders instead of stepping through the measured ones
+    InterpolationButton.onClick = [this] {toggleInterpolation(); };
+    InterpolationButton.setColour(TextButton::buttonColourId, Colour(0xff79ed7f));
+    InterpolationButton.setColour(TextButton::textColourOffId, Colours::black);
+    addAndMakeVisible(InterpolationButton);
+
+    Elevation_Slider.onValueChange = [this] {audioProcessor.interpolator.set_direction(HRTF_Slider.getValue(), Elevation_Slider.getValue()); };
+    Elevation_Slider.setSliderStyle(Slider::LinearVertical);
+    updateSliderRanges();
+    Elevation_Slider.setTextBoxStyle(Slider::TextBoxBelow, 1, 50, 20);
+    addAndMakeVisible(Elevation_Slider);
+
+    // the HRIRs are decomposed while loading, so this takes effect with the next HRTF set
+    MinimumPhaseButton.onClick = [this] {toggleMinimumPhase(); };
+    MinimumPhaseButton.setColour(TextButton::buttonColourId, Colour(0xff79ed7f));
+    MinimumPhaseButton.setColour(TextButton::textColourOffId, Colours::black);
+    MinimumPhaseButton.setButtonText(audioProcessor.minimum_phase ? "Min. Phase On" : "Min. Phase Off");
+    addAndMakeVisible(MinimumPhaseButton);
+
+    // item ids are order + 2, id 1 interpolates between the measured HRTFs
+    HarmonicsBox.addItem("Triangles", 1);
+    for (int order = 1; order <= 8; order++)
+        HarmonicsBox.addItem("SH order " + String(order), order + 2);
+    HarmonicsBox.setSelectedId(audioProcessor.sh_order + 2);
+    HarmonicsBox.onChange = [this] {audioProcessor.sh_order = HarmonicsBox.getSelectedId() - 2; };
+    addAndMakeVisible(HarmonicsBox);
+
+#if BINAURALIZATION_BENCHMARKS
+    // runs synchronously on the message thread, the results are written to the log
+    BenchButton.onClick = [] {run_benchmarks(); };
+    addAndMakeVisible(BenchButton);
+#endif
+
     SineButton.onClick = [this] {toggleSine(); };
     SineButton.setColour(TextButton::buttonColourId, Colour(0xff79ed7f));
     SineButton.setColour(TextButton::textColourOffId, Colours::black);
@@ -72,6 +192,17 @@ void BinauralizationAudioProcessorEditor::resized()
     HRTF_Slider.setBounds(150, 125, 100, 100);
     SineButton.setBounds(100, 230, 100, 50);
     NoiseButton.setBounds(200, 230, 100, 50);
+    ModeBox.setBounds(100, 40, 200, 25);
+    BackendBox.setBounds(300, 40, 90, 25);
+    LatencyBox.setBounds(10, 40, 90, 25);
+    PrecisionButton.setBounds(10, 230, 90, 50);
+    InterpolationButton.setBounds(10, 75, 90, 50);
+    Elevation_Slider.setBounds(300, 125, 90, 100);
+    MinimumPhaseButton.setBounds(10, 130, 90, 45);
+    HarmonicsBox.setBounds(10, 185, 90, 25);
+#if BINAURALIZATION_BENCHMARKS
+    BenchButton.setBounds(300, 230, 90, 50);
+#endif
 
 }
 
@@ -104,33 +235,22 @@ void BinauralizationAudioProcessorEditor::openIRdirectory() {
             return;
         }
 
-        // only set flag, after it has been verified, that a file has been selected and the format is supported.
-        // usage of FFT is deactivated in ProcessBlock during loading of new HRTF, so new collisons occur
-        audioProcessor.ir_ready = false;
-
-        audioProcessor.hrtf_buffer.num_samples = ir_reader->lengthInSamples;
-        audioProcessor.hrtf_buffer.num_hrtfs = files.size();
-        
-        // free allocated space for hrtf_buffer
-        if (audioProcessor.hrtf_buffer.left != NULL) {
-            free(audioProcessor.hrtf_buffer.left);
-            free(audioProcessor.hrtf_buffer.right);
-        }
+        // the files are read into a new set next to the one processBlock is running on, load_hrtfs() swaps them
+        hrtf_buffer_sc* hrtfs = new hrtf_buffer_sc();
 
-        // set k to a power of 2 while fulfilling k >= M + N - 1 
-        audioProcessor.set_padding_size(audioProcessor.n, audioProcessor.hrtf_buffer.num_samples);
+        hrtfs->num_samples = ir_reader->lengthInSamples;
+        hrtfs->num_hrtfs = files.size();
 
-        // allocate space for x HRFT spectra
-        audioProcessor.hrtf_buffer.left = (fftwf_complex**)malloc(sizeof(fftwf_complex*) * files.size());
-        audioProcessor.hrtf_buffer.right = (fftwf_complex**)malloc(sizeof(fftwf_complex*) * files.size());
-        for (int i = 0; i < audioProcessor.hrtf_buffer.num_hrtfs; i++) {
-            audioProcessor.hrtf_buffer.left[i] = fftwf_alloc_complex(audioProcessor.k);
-            audioProcessor.hrtf_buffer.right[i] = fftwf_alloc_complex(audioProcessor.k);
-        }       
-      
+        // time-domain copies for the partitioned convolvers
+        hrtfs->time_left = (float**)malloc(sizeof(float*) * files.size());
+        hrtfs->time_right = (float**)malloc(sizeof(float*) * files.size());
+        for (int i = 0; i < hrtfs->num_hrtfs; i++) {
+            hrtfs->time_left[i] = (float*)malloc(sizeof(float) * hrtfs->num_samples);
+            hrtfs->time_right[i] = (float*)malloc(sizeof(float) * hrtfs->num_samples);
+        }
 
         // create temporary AudioBuffer of approriate size
-        AudioBuffer<float> tmp_buffer(2, audioProcessor.k);
+        AudioBuffer<float> tmp_buffer(2, hrtfs->num_samples);
         tmp_buffer.clear();
         
         // iterate through array of files
@@ -140,19 +260,38 @@ void BinauralizationAudioProcessorEditor::openIRdirectory() {
             // first reader gets written twice, which isn't pretty but ok
             ir_reader = ir_manager.createReaderFor(currentFile);
 
-            // copy reader data to float AudioBuffer
-            ir_reader->read(&tmp_buffer, 0, ir_reader->lengthInSamples, 0, 1, 1);
+            // copy reader data to float AudioBuffer (past the end of a shorter file the reader gives zeros)
+            ir_reader->read(&tmp_buffer, 0, hrtfs->num_samples, 0, 1, 1);
 
-            // perform fft on both channels for each HRTF file and store result in hrtf_buffer
-            audioProcessor.perform_fft(audioProcessor.k, tmp_buffer.getWritePointer(0), audioProcessor.hrtf_buffer.left[i]);
-            audioProcessor.perform_fft(audioProcessor.k, tmp_buffer.getWritePointer(1), audioProcessor.hrtf_buffer.right[i]);
+            memcpy(hrtfs->time_left[i], tmp_buffer.getReadPointer(0), sizeof(float) * hrtfs->num_samples);
+            memcpy(hrtfs->time_right[i], tmp_buffer.getReadPointer(1), sizeof(float) * hrtfs->num_samples);
 
         }
 
-        DBG("Dir loaded");
+        // measurement directions from the file names, the interpolator takes the set as a horizontal circle without them
+        hrtfs->azimuth = (float*)malloc(sizeof(float) * files.size());
+        hrtfs->elevation = (float*)malloc(sizeof(float) * files.size());
+
+        bool named = true;
+        for (int i = 0; i < files.size() && named; i++)
+            named = parse_direction(files.getReference(i).getFileNameWithoutExtension(), hrtfs->azimuth[i], hrtfs->elevation[i]);
+
+        if (!named) {
+            free(hrtfs->azimuth);
+            free(hrtfs->elevation);
+            hrtfs->azimuth = NULL;
+            hrtfs->elevation = NULL;
+        }
 
-        audioProcessor.ir_ready = true;
-        audioProcessor.ir_update = true;
+        // minimum phase, spectra, interpolator and engines for the new set, processBlock only passes audio through
+        // while they are swapped in
+        if (!audioProcessor.load_hrtfs(hrtfs)) {
+            DBG("Loading failed, the FFT sizes of the set could not be prepared");
+            return;
+        }
+        updateSliderRanges();
+
+        DBG("Dir loaded");
 
         return;
     }
@@ -209,4 +348,34 @@ void BinauralizationAudioProcessorEditor::toggleNoise() {
         SineButton.setButtonText("Sine Inactive");
     }
 
-}
\ No newline at end of file
+}
+
+void BinauralizationAudioProcessorEditor::togglePrecision() {
+
+    audioProcessor.double_engine = !audioProcessor.double_engine;
+    PrecisionButton.setButtonText(audioProcessor.double_engine ? "64-bit engine" : "32-bit engine");
+}
+
+void BinauralizationAudioProcessorEditor::toggleInterpolation() {
+
+    // the worker starts from the direction of the sliders
+    audioProcessor.interpolator.set_direction(HRTF_Slider.getValue(), Elevation_Slider.getValue());
+    audioProcessor.set_interpolation(!audioProcessor.interpolation);
+    InterpolationButton.setButtonText(audioProcessor.interpolation ? "Interpolation On" : "Interpolation Off");
+    updateSliderRanges();
+}
+
+void BinauralizationAudioProcessorEditor::updateSliderRanges() {
+
+    // interpolated HRTFs exist for any direction, the measured set is indexed by whole steps up to its last HRTF
+    double interval = audioProcessor.interpolation ? 0.1 : 1.;
+    int last_hrtf = (audioProcessor.hrtf_buffer->num_hrtfs > 0) ? audioProcessor.hrtf_buffer->num_hrtfs - 1 : 359;
+    HRTF_Slider.setRange(0, audioProcessor.interpolation ? 359.9 : last_hrtf, interval);
+    Elevation_Slider.setRange(-90, 90, interval);
+}
+
+void BinauralizationAudioProcessorEditor::toggleMinimumPhase() {
+
+    audioProcessor.minimum_phase = !audioProcessor.minimum_phase;
+    MinimumPhaseButton.setButtonText(audioProcessor.minimum_phase ? "Min. Phase On" : "Min. Phase Off");
+}
@@ -36,11 +36,31 @@ private:
     TextButton SineButton{ "Sine Inactive" };
     TextButton NoiseButton{ "Noise Inactive" };
     Slider     HRTF_Slider;
+    ComboBox   ModeBox;
+    ComboBox   BackendBox;
+    // latency the automatic mode may add
+    ComboBox   LatencyBox;
+    TextButton PrecisionButton{ "64-bit engine" };
+    TextButton InterpolationButton{ "Interpolation Off" };
+    // elevation of the interpolated direction, the HRTF slider gives its azimuth
+    Slider     Elevation_Slider;
+    // minimum phase HRIRs and a delay per ear for the next HRTF set loaded
+    TextButton MinimumPhaseButton{ "Min. Phase Off" };
+    // triangles or spherical harmonics of some order for the interpolator of the next HRTF set loaded
+    ComboBox   HarmonicsBox;
+#if BINAURALIZATION_BENCHMARKS
+    TextButton BenchButton{ "Benchmark" };
+#endif
 
     void openIRdirectory();
     void toggleConvolution();
     void toggleSine();
     void toggleNoise();
+    void togglePrecision();
+    void toggleInterpolation();
+    void toggleMinimumPhase();
+    // whole steps for the measured HRTFs, tenths of a degree with interpolation
+    void updateSliderRanges();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BinauralizationAudioProcessorEditor)
 
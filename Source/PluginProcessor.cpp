@@ -22,10 +22,29 @@ BinauralizationAudioProcessor::BinauralizationAudioProcessor()
                        )
 #endif
 {
+    // measured plans of earlier sessions, so prepare() does not have to start from estimated ones
+    fft_planner.load_wisdom();
+
+    hrtf_buffer = new hrtf_buffer_sc();
+    engine = new ConvolutionEngine(fft_plans);
+    engine_double = new ConvolutionEngineT<double>(fft_plans);
+
+    // room for the HRIRs of the interpolator next to the HRTF set
+    engine->extra_filters = HrtfInterpolator::num_slots;
 }
 
 BinauralizationAudioProcessor::~BinauralizationAudioProcessor()
 {
+    // the tuner thread calls back into this processor
+    tuner.cancel();
+    fft_planner.cancel();
+    interpolator.stop();
+    delete engine;
+    delete engine_double;
+    hrtf_buffer->release();
+    delete hrtf_buffer;
+    free(sine);
+    free(convert_buffer);
 }
 
 //==============================================================================
@@ -95,12 +114,61 @@ void BinauralizationAudioProcessor::prepareToPlay (double sampleRate, int sample
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock);
+
+    // measured planning waits for the current plan and writes the wisdom file, so not while holding engine_lock
+    fft_planner.cancel();
+
+    {
+        const juce::SpinLock::ScopedLockType lock(engine_lock);
+
+        block_size = samplesPerBlock;
+
+        // the test tone used to be allocated inside processBlock
+        free(sine);
+        sine = (float*)malloc(sizeof(float) * block_size);
+        // set f to n * 93.75 to have a complete wave inside sine
+        double f = 375;
+        for (int i = 0; i < block_size; i++) {
+            sine[i] = 0.5 * cos(2 * juce::double_Pi * f * i / 48000.);
+        }
+
+        free(convert_buffer);
+        convert_buffer = (float*)malloc(sizeof(float) * 2 * block_size);
+
+        // host blocks may be shorter, longer or of odd length, the FIFOs cut them into blocks of block_size
+        fifo.prepare(block_size);
+        fifo_double.prepare(block_size);
+
+        // k follows the block size, so a HRTF set loaded before the first prepareToPlay or at another block size gets
+        // its overlap-add spectra again
+        if (hrtf_buffer->num_hrtfs > 0 && hrtf_buffer->time_left != NULL) {
+            int old_k = k;
+            set_padding_size(block_size, hrtf_buffer->num_samples);
+            // the engines are not prepared without the spectra, see update_convolvers()
+            if ((k != old_k || hrtf_buffer->spectra == NULL) && !transform_hrtfs(*hrtf_buffer, k, fft_plans))
+                DBG("FFT size " << k << " could not be prepared, passing audio through");
+        }
+        else if (k > 0)
+            fft_plans.prepare(k);
+
+        update_convolvers();
+    }
+
+    // the estimated plans are replaced one by one while processing goes on
+    fft_planner.start(fft_planning);
+
+    fft_plans.reset_stats();
 }
 
 void BinauralizationAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+
+    // every miss during playback means a plan was created on the audio thread
+    DBG("FFT plan cache hits: " << fft_plans.get_hits() << ", misses: " << fft_plans.get_misses());
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -127,6 +195,18 @@ bool BinauralizationAudioProcessor::isBusesLayoutSupported (const BusesLayout& l
 }
 #endif
 
+template <>
+ConvolutionEngine& BinauralizationAudioProcessor::get_engine<float>()
+{
+    return *engine;
+}
+
+template <>
+ConvolutionEngineT<double>& BinauralizationAudioProcessor::get_engine<double>()
+{
+    return *engine_double;
+}
+
 void BinauralizationAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
@@ -134,114 +214,127 @@ void BinauralizationAudioProcessor::processBlock (juce::AudioBuffer<float>& buff
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
 
-    static int filter_sel = 0;
-
     
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
      // number of samples inside each buffer
      n = buffer.getNumSamples();
-     // input data
-     auto* channelData = buffer.getWritePointer (0); 
-     // output left
-     auto* channelLeft = buffer.getWritePointer(0);
-     // outpur right
-     auto* channelRight = buffer.getWritePointer(1);
 
+     // input data and output left, outpur right (a mono output only gets the left ear)
+     render(fifo, buffer.getWritePointer(0), buffer.getWritePointer(0),
+            (totalNumOutputChannels > 1) ? buffer.getWritePointer(1) : nullptr, n);
+}
+
+void BinauralizationAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ScopedNoDenormals noDenormals;
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+
+    n = buffer.getNumSamples();
+
+    auto* channelData = buffer.getWritePointer(0);
+    auto* channelRight = (totalNumOutputChannels > 1) ? buffer.getWritePointer(1) : nullptr;
+
+    if (double_engine || convert_buffer == NULL) {
+        render(fifo_double, channelData, channelData, channelRight, n);
+        return;
+    }
+
+    // what the host would do for a float-only plugin, kept for comparison. blocks longer than block_size go through
+    // the same FIFO and engine in pieces, switching to engine_double for them would jump between two histories
+    float* left = convert_buffer;
+    float* right = convert_buffer + block_size;
+
+    for (int offset = 0; offset < n; offset += block_size) {
+        int count = (n - offset < block_size) ? n - offset : block_size;
+
+        for (int i = 0; i < count; i++)
+            left[i] = (float)channelData[offset + i];
+
+        render(fifo, left, left, (channelRight != nullptr) ? right : nullptr, count);
+
+        for (int i = 0; i < count; i++)
+            channelData[offset + i] = left[i];
+        if (channelRight != nullptr) {
+            for (int i = 0; i < count; i++)
+                channelRight[offset + i] = right[i];
+        }
+    }
+}
+
+bool BinauralizationAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return fft_plans.supports_double();
+}
+
+template <typename Sample>
+void BinauralizationAudioProcessor::render(BlockFifoT<Sample>& block_fifo, Sample* channelData, Sample* channelLeft, Sample* channelRight, int num_samples)
+{
      // use sine test-tone
-     if (sineFlag) {
-         if (!sineInit) {
-             sine = (float*)malloc(sizeof(float) * n);
-             // set f to n * 93.75 to have a complete wave inside sine
-             double f = 375;
-             for (int i = 0; i < n; i++) {
-                 sine[i] = 0.5 * cos(2 * juce::double_Pi * f * i / 48000.);   
-             }
-             sineInit = true;
-         }
-         memcpy(channelData, sine, sizeof(float) * n);
+     if (sineFlag && sine != NULL) {
+         for (int i = 0; i < ((num_samples < block_size) ? num_samples : block_size); i++)
+             channelData[i] = sine[i];
      }
      // use noise as test signal
      if (noiseFlag) {
-         for (int i = 0; i < n; i++) {
+         for (int i = 0; i < num_samples; i++) {
              // 20: num. steps (normalized), 0.5 for level matching
              channelData[i] = 0.5 * (rand() % 20)/20;
          }
      }
 
-    // when a new set of IRs is loaded, the overlap_add_buffer has to be allocated accordingly
-    if (ir_update) {
-        // free previously allocated memory (not really efficient but ok for this case, since this should only occur rarely)
-        if (overlap_buffer_left != NULL) {
-            for (int i = 0; i < MEM; i++) {
-                free(overlap_buffer_left[i]);
-                free(overlap_buffer_right[i]);
-            }
-            free(overlap_buffer_left);
-            free(overlap_buffer_right);
-        }
-
-        // MEM holds the number of iterations, for which an old convolution result has to be hold to perform the overlap add convolution
-        MEM = (k / n > 2) ? k / n : 2;
-
-        // allocate space for overlap add buffer
-        overlap_buffer_left = (float**)malloc(sizeof(float*) * MEM);
-        overlap_buffer_right = (float**)malloc(sizeof(float*) * MEM);
-
-        for (int i = 0; i < MEM; i++) {
-             overlap_buffer_left[i] = (float*)malloc(sizeof(float) * (k+2));
-             overlap_buffer_right[i] = (float*)malloc(sizeof(float) * (k+2));
-        }
-
-        DBG("IR UPDATE DONE");
-        ir_update = false;
+    // the FIFOs start from silence whenever they come into the signal path, see update_latency()
+    if (fifo_reset.exchange(false)) {
+        fifo.reset();
+        fifo_double.reset();
     }
-            
+
     // perform convolution with loaded impulse response
-    if (!ir_update && ir_ready && performConv) {
+    // no heap operations past this point, everything the engine needs has been allocated in prepareToPlay or by the loader
+    // the loader swaps the engines and the HRTF set while holding engine_lock, so they are only touched with it
+    const juce::SpinLock::ScopedTryLockType lock(engine_lock);
+    bool convolve = lock.isLocked() && ir_ready && performConv;
+
+    // get current HRTF selection from UI-Slider, limited to the set: the filters after it belong to the interpolator
+    int filter_sel = convolve ? juce::jlimit(0, hrtf_buffer->num_hrtfs - 1, hrtf_buffer->sel) : 0;
+
+    // or the newest HRIRs of the interpolator, once it has loaded the first ones
+    int interpolated = (convolve && interpolation) ? interpolator.begin_block() : -1;
+    if (interpolated >= 0)
+        filter_sel = interpolated;
+
+    if (latency > 0) {
+        // the dry signal is delayed as well, so toggling the convolution or a rebuild holding engine_lock does not
+        // shift the output, and the FIFO stays in step for when the engine is back
+        block_fifo.process(convolve ? &get_engine<Sample>() : NULL, channelData, channelLeft, channelRight, num_samples, filter_sel);
+        // filter_sel is only in use once the FIFO has completed an internal block with it
+        if (convolve && block_fifo.get_convolved_blocks() > 0)
+            interpolator.end_block(get_engine<Sample>(), interpolated);
+        return;
+    }
 
-        // get current HRTF selection from UI-Slider
-        if (filter_sel != hrtf_buffer.sel) {
-            filter_sel = hrtf_buffer.sel;
-            DBG("Change HRTF to:");
-            DBG(hrtf_buffer.sel);
+    // the zero latency engines take every host block as it is, in pieces of at most block_size samples
+    if (convolve) {
+        ConvolutionEngineT<Sample>& conv = get_engine<Sample>();
+        bool processed = true;
+        for (int i = 0; i < num_samples && processed; i += block_size) {
+            int count = (num_samples - i < block_size) ? num_samples - i : block_size;
+            processed = conv.process(channelData + i, channelLeft + i, (channelRight != nullptr) ? channelRight + i : nullptr, count, filter_sel);
         }
-           
-        // perform fft-based convolution
-        // write inputData into overlap_buffers
-        memcpy(overlap_buffer_left[0], channelData, (sizeof(float) * n));
-        memcpy(overlap_buffer_right[0], channelData, (sizeof(float) * n));
-
-        // fill space from n to k with zeroes
-        for (int i = n; i < k; i++) {
-            overlap_buffer_left[0][i] = 0.;
-            overlap_buffer_right[0][i] = 0.;
+        if (processed) {
+            interpolator.end_block(conv, interpolated);
+            return;
         }
-        
-        // perform fft-based convolution
-        fftw_convolution(k, overlap_buffer_left[0], hrtf_buffer.left[filter_sel], overlap_buffer_left[0]);
-        fftw_convolution(k, overlap_buffer_right[0], hrtf_buffer.right[filter_sel], overlap_buffer_right[0]);
-        
-        // write first block into channel Data
-        memcpy(channelLeft, overlap_buffer_left[0], (sizeof(float) * n));
-        memcpy(channelRight, overlap_buffer_right[0], (sizeof(float) * n));
-                
-        // overlap and add
-        for (int i = 1; i < MEM; i++) {
-            for (int j = 0; j < k-n; j++) {
-                channelLeft[j] += overlap_buffer_left[i][j + (n * i)];
-                channelRight[j] += overlap_buffer_right[i][j + (n * i)];
-            }
-            // shuffle through overlap_buffer
-            memcpy(overlap_buffer_left[i], overlap_buffer_left[i - 1], sizeof(float) * k);
-            memcpy(overlap_buffer_right[i], overlap_buffer_right[i - 1], sizeof(float) * k);
-        }    
-    }
-    else {
-        memcpy(channelLeft, channelData, sizeof(float) * n);
-        memcpy(channelRight, channelData, sizeof(float) * n);
     }
+
+    memcpy(channelLeft, channelData, sizeof(Sample) * num_samples);
+    if (channelRight != nullptr)
+        memcpy(channelRight, channelData, sizeof(Sample) * num_samples);
     
 }
 
@@ -278,111 +371,525 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 }
 
 
-void BinauralizationAudioProcessor::perform_fft(int n, float* input, fftwf_complex* output) {
-
-    // faster if one plan of this param set (no input/output) already exists?
-    fftwf_plan plan = fftwf_plan_dft_r2c_1d(n, input, output, FFTW_ESTIMATE);  
-    fftwf_execute(plan);
-    fftwf_destroy_plan(plan);
-    fftwf_cleanup();
+void BinauralizationAudioProcessor::perform_fft(int n, float* input, fft_complex* output) {
 
+    // plans are looked up in fft_plans, set_padding_size has prepared them
+    fft_plans.perform_fft(n, input, output);
 
 }
-void BinauralizationAudioProcessor::perform_ifft(int n, fftwf_complex* input, float* output) {
+void BinauralizationAudioProcessor::perform_ifft(int n, fft_complex* input, float* output) {
 
-    fftwf_plan plan = fftwf_plan_dft_c2r_1d(n, input, output, FFTW_ESTIMATE);
-    fftwf_execute(plan);
-    fftwf_destroy_plan(plan);
-    fftwf_cleanup();
+    fft_plans.perform_ifft(n, input, output);
 
 }
 
 void BinauralizationAudioProcessor::normalize(int n, float* data) {
 
-    for (int i = 0; i < n; i++) {
-        data[i] /= n;
+    ConvolutionEngine::normalize(n, data);
+}
+
+void BinauralizationAudioProcessor::update_convolvers() {
+
+    // buffers and partitions depend on both the block size and the HRIRs, so this runs whenever one of them changes
+    // the caller has to hold rebuild_lock and engine_lock, cancel fft_planner before taking them and start it again after
+    // releasing them; only prepareToPlay builds the engines under engine_lock, everything else goes through rebuild_engines()
+    // the interpolator loads filters into the engines from its own thread, update_interpolator() starts it again
+    interpolator.stop();
+
+    if (block_size <= 0 || k <= 0 || hrtf_buffer->num_hrtfs <= 0 || hrtf_buffer->time_left == NULL || hrtf_buffer->spectra == NULL) {
+        engine->release();
+        engine_double->release();
+        update_latency();
+        return;
+    }
+
+    bool measure = find_tuning(*hrtf_buffer, k, tuned);
+
+    select_fft_backend();
+    // released engines only pass audio through, which beats rendering with transforms that give zeros
+    if (!prepare_engines(*engine, *engine_double, *hrtf_buffer, k, tuned)) {
+        DBG("the FFT sizes for block size " << block_size << " could not be prepared, passing audio through");
+        measure = false;
     }
+
+    prepare_cache(*engine, *engine_double);
+    update_latency();
+    update_interpolator();
+
+    if (measure)
+        start_tuner();
 }
 
-int BinauralizationAudioProcessor::set_padding_size(int n, int m) {
+bool BinauralizationAudioProcessor::load_hrtfs(hrtf_buffer_sc* hrtfs) {
+
+    // the new set, its interpolator tables and engines are built while processBlock keeps running on the current
+    // ones, engine_lock is only taken to swap them in
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock);
+
+    // the tuner measures with the HRIRs of the current set, and a result it hands to apply_tuning() would rebuild the
+    // engines and start the planner again
+    tuner.cancel();
+    // measured planning waits for the current plan and writes the wisdom file, see prepareToPlay()
+    fft_planner.cancel();
+    // the audio thread renders hrtf_buffer->sel until the interpolator runs on the new engines
+    interpolator.stop();
+
+    // shorter HRIRs and a delay per ear, then the overlap-add spectra with k for the final length
+    decompose_hrtfs(*hrtfs);
+    int new_k = get_padding_size(block_size, hrtfs->num_samples);
+    bool prepared = transform_hrtfs(*hrtfs, new_k, load_plans);
+
+    tuning_result new_tuning = tuned;
+    bool measure = false;
+    if (prepared && block_size > 0 && new_k > 0 && hrtfs->num_hrtfs > 0)
+        measure = find_tuning(*hrtfs, new_k, new_tuning);
+
+    ConvolutionEngine* new_engine = NULL;
+    ConvolutionEngineT<double>* new_engine_double = NULL;
+    if (prepared)
+        prepared = build_engines(*hrtfs, new_k, engine->mode, new_tuning, new_engine, new_engine_double);
+
+    // the transforms of a size that is not prepared only give zeros, so such a set is not taken over; the current
+    // one goes on with the interpolator stopped until the next configuration change
+    if (!prepared) {
+        DBG("the FFT sizes of the HRTF set could not be prepared, keeping the current set");
+        hrtfs->release();
+        delete hrtfs;
+        fft_planner.start(fft_planning);
+        return false;
+    }
 
-    // FFTW is more efficient with a power of 2, 3, 5, ... (using 2 for simplicity)
-    int p = log2(m + n - 1);
+    // triangulate the directions and take magnitude and phase of the new HRIRs (or fit them to harmonics of sh_order)
+    interpolator.sh_order = sh_order;
+    interpolator.prepare(*hrtfs);
+    prepare_cache(*new_engine, *new_engine_double);
 
-    k = 1 << (p + 1);
-    
-    return k;
+    hrtfs->sel = juce::jmax(0, juce::jmin(hrtfs->num_hrtfs - 1, hrtf_buffer->sel));
+
+    {
+        const juce::SpinLock::ScopedLockType lock(engine_lock);
+
+        std::swap(hrtf_buffer, hrtfs);
+        std::swap(engine, new_engine);
+        std::swap(engine_double, new_engine_double);
+        k = new_k;
+        tuned = new_tuning;
+
+        select_fft_backend();
+        update_latency();
+        update_interpolator();
+
+        ir_ready = true;
+    }
+
+    // the previous set and engines, nothing refers to them anymore
+    delete new_engine;
+    delete new_engine_double;
+    hrtfs->release();
+    delete hrtfs;
+
+    // the estimated plans of the new sizes are replaced one by one while processing goes on
+    fft_planner.start(fft_planning);
+
+    if (measure)
+        start_tuner();
+
+    return true;
+}
+
+bool BinauralizationAudioProcessor::find_tuning(const hrtf_buffer_sc& hrtfs, int new_k, tuning_result& tuning) {
+
+    int m = hrtfs.num_samples;
+
+    if (tuning.valid && tuning.block_size == block_size && tuning.ir_length == m && tuning.max_latency == max_latency)
+        return false;
+
+    // a measured configuration from an earlier session is used right away,
+    // otherwise the cost model decides until the tuner is done
+    tuner.cancel();
+    if (tuner.lookup(block_size, m, max_latency, tuning))
+        return false;
+
+    tuning = tuning_result();
+    if (tune_in_background)
+        return true;
+
+    tuning = tuner.tune(block_size, new_k, m, hrtfs.time_left[0], hrtfs.time_right[0], max_latency);
+    return false;
+}
+
+void BinauralizationAudioProcessor::start_tuner() {
+
+    tuner.start(block_size, k, hrtf_buffer->num_samples, hrtf_buffer->time_left[0], hrtf_buffer->time_right[0], max_latency,
+                [this](const tuning_result& result) { apply_tuning(result); });
+}
+
+void BinauralizationAudioProcessor::select_fft_backend() {
+
+    if (fft_backend >= 0)
+        fft_plans.set_backend(fft_backend);
+    else if (tuned.valid)
+        fft_plans.set_backend(tuned.backend);
+}
+
+bool BinauralizationAudioProcessor::prepare_engines(ConvolutionEngine& conv, ConvolutionEngineT<double>& conv_double,
+                                                    const hrtf_buffer_sc& hrtfs, int new_k, const tuning_result& tuning,
+                                                    FFTPlanCache* transform_plans) {
+
+    int m = hrtfs.num_samples;
+
+    conv.partition_size = tuning.valid ? tuning.partition_size : 0;
+    if (!conv.prepare(block_size, new_k, hrtfs, transform_plans)) {
+        conv_double.release();
+        return false;
+    }
+
+    if (tuning.valid) {
+        conv.set_auto_mode(tuning.mode);
+        DBG("automatic convolution mode: " << ConvolutionEngine::get_mode_name(tuning.mode) << ", partition size "
+            << conv.get_partition_size() << ", " << get_fft_backend_name((fft_backend >= 0) ? fft_backend : tuning.backend)
+            << " (measured " << tuning.time << " us per block)");
+    }
+    else {
+        // the fixed-block engines add block_size behind the FIFO, the non-uniform one renders any block without it
+        if (conv.mode == ConvolutionEngine::automatic && conv.needs_fixed_blocks() && block_size > max_latency)
+            conv.set_auto_mode(ConvolutionEngine::non_uniform_partitioned);
+
+        // report what the FIR / FFT cost model has chosen for mode == automatic
+        DBG("automatic convolution mode: " << ConvolutionEngine::get_mode_name(conv.get_auto_mode())
+            << " (block size " << block_size << ", " << m << " taps, estimated cost FIR "
+            << ConvolutionEngine::estimate_direct_cost(block_size, m) << " / FFT "
+            << ConvolutionEngine::estimate_fft_cost(block_size, m) << ")");
+    }
+
+    if (!update_double_engine(conv, conv_double, hrtfs, new_k, transform_plans)) {
+        conv.release();
+        return false;
+    }
+
+    return true;
+}
+
+bool BinauralizationAudioProcessor::build_engines(const hrtf_buffer_sc& hrtfs, int new_k, int mode, const tuning_result& tuning,
+                                                  ConvolutionEngine*& conv, ConvolutionEngineT<double>*& conv_double) {
+
+    // only the holder of rebuild_lock changes the settings of the current engines, so they can be read here
+    conv = new ConvolutionEngine(fft_plans);
+    conv_double = new ConvolutionEngineT<double>(fft_plans);
+    conv->mode = mode;
+    conv->extra_filters = engine->extra_filters;
+    conv->bypass_silence = engine->bypass_silence;
+    conv->set_crossfade(engine->get_crossfade());
+    conv_double->mode = mode;
+    conv_double->bypass_silence = engine_double->bypass_silence;
+
+    // before prepareToPlay or without HRIRs the released engines pass audio through, see update_convolvers()
+    if (block_size <= 0 || new_k <= 0 || hrtfs.num_hrtfs <= 0 || hrtfs.time_left == NULL || hrtfs.spectra == NULL)
+        return true;
+
+    if (prepare_engines(*conv, *conv_double, hrtfs, new_k, tuning, &load_plans))
+        return true;
+
+    delete conv;
+    delete conv_double;
+    conv = NULL;
+    conv_double = NULL;
+    return false;
 }
 
-void BinauralizationAudioProcessor::fftw_convolution(int n ,float* input1, float* input2, float* output) {
+bool BinauralizationAudioProcessor::rebuild_engines(int mode, int backend, const tuning_result& tuning) {
 
-    // FFTW gives N/2+1 complex values as a result of a N-sized real-valued FFT
-    int m = n / 2 + 1;
+    // processBlock keeps rendering with the current engines meanwhile, the interpolator starts again on the new ones
+    interpolator.stop();
 
-    fftwf_complex* spec1 = fftwf_alloc_complex(m);
-    fftwf_complex* spec2 = fftwf_alloc_complex(m);
-    fftwf_complex* result = fftwf_alloc_complex(m);
+    ConvolutionEngine* new_engine = NULL;
+    ConvolutionEngineT<double>* new_engine_double = NULL;
+    bool prepared = build_engines(*hrtf_buffer, k, mode, tuning, new_engine, new_engine_double);
 
-    perform_fft(n, input1, spec1);
-    perform_fft(n, input2, spec2);
+    // the new engines share their sizes with the current backend; another one gets them set up here, so that
+    // select_fft_backend() only finds prepared transforms under engine_lock
+    int new_backend = (backend >= 0) ? backend : (tuning.valid ? tuning.backend : fft_plans.get_backend());
+    if (prepared && new_backend != fft_plans.get_backend())
+        prepared = fft_plans.prepare_backend(new_backend);
+    // the cached filters have the partitions of the current engines
+    if (prepared)
+        prepare_cache(*new_engine, *new_engine_double);
 
-    for (int i = 0; i < m; i++) {
-        result[i][REAL] = spec1[i][REAL] * spec2[i][REAL] - spec1[i][IMAG] * spec2[i][IMAG];
-        result[i][IMAG] = spec1[i][REAL] * spec2[i][IMAG] + spec1[i][IMAG] * spec2[i][REAL];
+    {
+        const juce::SpinLock::ScopedLockType lock(engine_lock);
+
+        if (prepared) {
+            std::swap(engine, new_engine);
+            std::swap(engine_double, new_engine_double);
+            fft_backend = backend;
+            tuned = tuning;
+
+            select_fft_backend();
+            update_latency();
+        }
+
+        update_interpolator();
     }
 
-    perform_ifft(n, result, output);
+    // the previous engines, or the new ones if they are not taken over
+    delete new_engine;
+    delete new_engine_double;
+
+    return prepared;
+}
 
-    normalize(n, output);
+void BinauralizationAudioProcessor::apply_tuning(const tuning_result& result) {
 
-    fftwf_free(spec1);
-    fftwf_free(spec2);
-    fftwf_free(result);
+    // whoever holds rebuild_lock may wait for the tuner thread in tuner.cancel(), so never block on it here
+    while (!rebuild_lock.try_lock()) {
+        if (tuner.is_cancelled())
+            return;
+        std::this_thread::yield();
+    }
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock, std::adopt_lock);
+
+    // a cancelled result belongs to a configuration its canceller has replaced
+    if (tuner.is_cancelled() || result.block_size != block_size || result.ir_length != hrtf_buffer->num_samples
+        || result.max_latency != max_latency || !engine->is_prepared())
+        return;
+
+    bool new_backend = fft_backend < 0 && result.backend != fft_plans.get_backend();
+    bool new_partitions = result.mode == ConvolutionEngine::uniform_partitioned && result.partition_size != engine->get_partition_size();
+
+    if (new_backend || new_partitions) {
+        // only a new partition size or FFT backend needs new engines, processBlock goes on with the current ones
+        // a rebuild prepares plans, which would wait for the one the planner is measuring, see prepareToPlay()
+        fft_planner.cancel();
+        if (!rebuild_engines(engine->mode, fft_backend, result))
+            DBG("the tuned configuration could not be prepared, keeping the current one");
+        fft_planner.start(fft_planning);
+    }
+    else {
+        const juce::SpinLock::ScopedLockType lock(engine_lock);
 
+        tuned = result;
+        // the measurement is done on the float engine, the double one follows its choice
+        engine->set_auto_mode(result.mode);
+        engine_double->set_auto_mode(result.mode);
+        update_latency();
+    }
+
+    DBG("tuned convolution mode: " << ConvolutionEngine::get_mode_name(engine->get_auto_mode()) << ", partition size "
+        << engine->get_partition_size() << ", " << get_fft_backend_name(fft_plans.get_backend())
+        << " (" << result.time << " us per block)");
 }
 
-void BinauralizationAudioProcessor::fftw_convolution(int n ,float* input1, fftwf_complex* input2, float* output) {
+bool BinauralizationAudioProcessor::update_double_engine(const ConvolutionEngine& conv, ConvolutionEngineT<double>& conv_double,
+                                                         const hrtf_buffer_sc& hrtfs, int new_k, FFTPlanCache* transform_plans) {
 
-    // FFTW gives N/2+1 complex values as a result of a N-sized real-valued FFT
-    int m = n / 2 + 1;
+    // the caller has to hold engine_lock unless conv_double is not in use yet
+    if (!isUsingDoublePrecision() || !fft_plans.supports_double() || !conv.is_prepared()) {
+        conv_double.release();
+        return true;
+    }
 
-    fftwf_complex* spec1 = fftwf_alloc_complex(m);
-    fftwf_complex* result = fftwf_alloc_complex(m);
+    conv_double.partition_size = conv.partition_size;
+    conv_double.set_crossfade(conv.get_crossfade());
+    conv_double.extra_filters = conv.extra_filters;
+    if (!conv_double.prepare(block_size, new_k, hrtfs, transform_plans))
+        return false;
+    conv_double.set_auto_mode(conv.get_auto_mode());
 
-    perform_fft(n, input1, spec1);
-    
-    for (int i = 0; i < m; i++) {       
-        result[i][REAL] = spec1[i][REAL] * input2[i][REAL] - spec1[i][IMAG] * input2[i][IMAG];
-        result[i][IMAG] = spec1[i][REAL] * input2[i][IMAG] + spec1[i][IMAG] * input2[i][REAL];
+    return true;
+}
+
+void BinauralizationAudioProcessor::update_latency() {
+
+    int new_latency = (engine->is_prepared() && engine->needs_fixed_blocks()) ? fifo.get_latency() : 0;
+
+    if (new_latency == latency)
+        return;
+
+    // the FIFOs start from silence whenever they come into the signal path, the audio thread resets them
+    latency = new_latency;
+    fifo_reset = true;
+    setLatencySamples(new_latency);
+}
+
+void BinauralizationAudioProcessor::update_interpolator() {
+
+    interpolator.stop();
+
+    // the filters after the HRTF set, engine_double only while the host processes in 64 bit
+    if (interpolation && engine->is_prepared() && interpolator.is_prepared())
+        interpolator.start(engine, engine_double->is_prepared() ? engine_double : NULL, hrtf_buffer->num_hrtfs);
+}
+
+void BinauralizationAudioProcessor::prepare_cache(const ConvolutionEngine& conv, const ConvolutionEngineT<double>& conv_double) {
+
+    // the interpolator only uses the cache with engines of the same entry size, see HrtfInterpolator::set_cache()
+    hrtf_cache.prepare(HrtfInterpolator::get_cache_entry_size(conv, conv_double.is_prepared() ? &conv_double : NULL), cache_budget);
+    interpolator.set_cache(hrtf_cache.is_prepared() ? &hrtf_cache : NULL);
+}
+
+void BinauralizationAudioProcessor::set_interpolation(bool on) {
+
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock);
+    const juce::SpinLock::ScopedLockType lock(engine_lock);
+
+    interpolation = on;
+    update_interpolator();
+}
+
+void BinauralizationAudioProcessor::set_mode(int mode) {
+
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock);
+
+    // the non-uniform engine starts or stops its worker thread in prepare(), so that takes new engines
+    bool threads_changed = (mode == ConvolutionEngine::time_distributed) != (engine->mode == ConvolutionEngine::time_distributed);
+
+    if (threads_changed && engine->is_prepared()) {
+        // see prepareToPlay()
+        fft_planner.cancel();
+        if (!rebuild_engines(mode, fft_backend, tuned))
+            DBG("the engines could not be prepared for " << ConvolutionEngine::get_mode_name(mode) << ", keeping the current mode");
+        fft_planner.start(fft_planning);
+        return;
     }
 
-    
-    perform_ifft(n, result, output);
+    const juce::SpinLock::ScopedLockType lock(engine_lock);
+
+    engine->mode = mode;
+    engine_double->mode = mode;
+    update_latency();
+}
+
+void BinauralizationAudioProcessor::decompose_hrtfs(hrtf_buffer_sc& hrtfs) {
+
+    // the delays of a previous decomposition
+    free(hrtfs.delay_left);
+    free(hrtfs.delay_right);
+    hrtfs.delay_left = NULL;
+    hrtfs.delay_right = NULL;
+
+    if (!minimum_phase || hrtfs.num_hrtfs <= 0 || hrtfs.time_left == NULL)
+        return;
+
+    int m = hrtfs.num_samples;
+
+    make_minimum_phase(hrtfs, load_plans);
+
+    DBG("minimum phase HRIRs: " << m << " -> " << hrtfs.num_samples << " samples");
+}
+
+bool BinauralizationAudioProcessor::transform_hrtfs(hrtf_buffer_sc& hrtfs, int new_k, FFTPlanCache& plans) {
 
-    normalize(n, output);
+    if (new_k <= 0 || hrtfs.num_hrtfs <= 0 || hrtfs.time_left == NULL)
+        return false;
+
+    if (!plans.prepare(new_k)) {
+        hrtfs.free_spectra();
+        return false;
+    }
+
+    // allocate space for all HRTF spectra (frees the previous ones)
+    hrtfs.allocate_spectra(new_k);
+
+    // the 1/k scale of the inverse FFT is applied here once instead of after every block
+    for (int i = 0; i < hrtfs.num_hrtfs; i++) {
+        ConvolutionEngine::transform_hrir(plans, new_k, hrtfs.time_left[i], hrtfs.num_samples, hrtfs.get_spectrum(i, 0));
+        ConvolutionEngine::transform_hrir(plans, new_k, hrtfs.time_right[i], hrtfs.num_samples, hrtfs.get_spectrum(i, 1));
+    }
 
-    fftwf_free(spec1);
-    fftwf_free(result);
+    hrtfs.prescaled = true;
 
+    return true;
 }
 
-void BinauralizationAudioProcessor::fftw_convolution(int n, fftwf_complex* input1, fftwf_complex* input2, float* output) {
+void BinauralizationAudioProcessor::set_max_latency(int samples) {
+
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock);
+
+    // a running measurement still compares against the previous limit
+    tuner.cancel();
+    max_latency = juce::jmax(0, samples);
 
-    // FFTW gives N/2+1 complex values as a result of a N-sized real-valued FFT
-    int m = n / 2 + 1;
+    if (!engine->is_prepared())
+        return;
 
-    fftwf_complex* result = fftwf_alloc_complex(m);
+    // an earlier measurement for the limit, otherwise the cost model within it until the tuner is done
+    tuning_result tuning = tuned;
+    bool measure = find_tuning(*hrtf_buffer, k, tuning);
 
-    for (int i = 0; i < m; i++) {
-        result[i][REAL] = input1[i][REAL] * input2[i][REAL] - input1[i][IMAG] * input2[i][IMAG];
-        result[i][IMAG] = input1[i][REAL] * input2[i][IMAG] + input1[i][IMAG] * input2[i][REAL];
+    // see prepareToPlay()
+    fft_planner.cancel();
+    if (!rebuild_engines(engine->mode, fft_backend, tuning)) {
+        DBG("the engines could not be prepared for a latency of " << max_latency << " samples, keeping the current ones");
+        measure = false;
     }
+    fft_planner.start(fft_planning);
+
+    if (measure)
+        start_tuner();
+}
+
+void BinauralizationAudioProcessor::set_fft_backend(int type) {
 
-    perform_ifft(n, result, output);
+    if (type >= 0 && !is_fft_backend_available(type))
+        return;
 
-    normalize(n, output);
+    const std::lock_guard<std::mutex> rebuild(rebuild_lock);
 
-    fftwf_free(result);
+    // see prepareToPlay()
+    fft_planner.cancel();
+
+    // the spectra of all backends share one layout and scaling, so the HRTF set stays valid
+    if (engine->is_prepared()) {
+        if (!rebuild_engines(engine->mode, type, tuned))
+            DBG("the engines could not be prepared on " << get_fft_backend_name((type >= 0) ? type : tuned.backend)
+                << ", keeping " << get_fft_backend_name(fft_plans.get_backend()));
+    }
+    else {
+        // nothing runs on the plans of the other backend yet, they are set up before it is selected all the same
+        int new_backend = (type >= 0) ? type : (tuned.valid ? tuned.backend : fft_plans.get_backend());
+        fft_plans.prepare_backend(new_backend);
+
+        const juce::SpinLock::ScopedLockType lock(engine_lock);
+
+        fft_backend = type;
+        select_fft_backend();
+    }
+
+    fft_planner.start(fft_planning);
+}
+
+int BinauralizationAudioProcessor::set_padding_size(int n, int m) {
+
+    // n is the internal block size, which is 0 until the first prepareToPlay; prepareToPlay calls this again then
+    k = get_padding_size(n, m);
+
+    return k;
+}
+
+int BinauralizationAudioProcessor::get_padding_size(int n, int m) {
+
+    // smallest 2^a * 3^b * 5^c >= n + m - 1 the active backend can do, FFTW is nearly as fast on those as on a power of 2,
+    // while rounding up to a power of 2 could almost double the transform size
+    int padded = fft_plans.get_efficient_size(m + juce::jmax(n, 1) - 1);
+
+    // create the plans for the new size now, so processBlock never has to plan
+    fft_plans.prepare(padded);
+
+    return padded;
+}
+
+void BinauralizationAudioProcessor::fftw_convolution(int n, float* input1, float* input2, float* output) {
+
+    // uses the engine's preallocated scratch, so n must not exceed k
+    engine->fftw_convolution(n, input1, input2, output);
+}
+
+void BinauralizationAudioProcessor::fftw_convolution(int n, float* input1, fft_complex* input2, float* output) {
+
+    engine->fftw_convolution(n, input1, input2, output);
+}
 
+void BinauralizationAudioProcessor::fftw_convolution(int n, fft_complex* input1, fft_complex* input2, float* output) {
 
+    engine->fftw_convolution(n, input1, input2, output);
 }
@@ -8,8 +8,18 @@
 
 #pragma once
 
+#include <atomic>
+#include <climits>
+#include <mutex>
 #include <JuceHeader.h>
-#include "fftw3.h"
+#include "FFTBackend.h"
+#include "FFTPlanCache.h"
+#include "FFTPlanner.h"
+#include "ConvolutionEngine.h"
+#include "BlockFifo.h"
+#include "ConvolutionTuner.h"
+#include "HrtfInterpolator.h"
+#include "MinimumPhase.h"
 
 #define REAL 0
 #define IMAG 1
@@ -33,6 +43,10 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    // 64-bit hosts call this one, it runs engine_double or converts to the float engine (see double_engine)
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    // only with double precision FFTs (FFTW built with libfftw3)
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -60,34 +74,60 @@ public:
 
     //---------- Binauralization --------------------------------------------------
     void fftw_convolution(int n, float* input1, float* input2, float* output);
-    void fftw_convolution(int n, float* input1, fftwf_complex* input2, float* output);
-    void fftw_convolution(int n, fftwf_complex* input1, fftwf_complex* input2, float* output);
-    void perform_fft(int n, float* input, fftwf_complex* output);
-    void perform_ifft(int n, fftwf_complex* input, float* output);
+    void fftw_convolution(int n, float* input1, fft_complex* input2, float* output);
+    void fftw_convolution(int n, fft_complex* input1, fft_complex* input2, float* output);
+    void perform_fft(int n, float* input, fft_complex* output);
+    void perform_ifft(int n, fft_complex* input, float* output);
     void normalize(int n, float* data);
     int set_padding_size(int n, int m);
+    // padding size for blocks of n samples and HRIRs of m samples, with its plans prepared (k stays as it is)
+    int get_padding_size(int n, int m);
+    // spectra of all HRIRs of hrtfs for the overlap-add path, zero padded to new_k (reallocates hrtfs.spectra)
+    // false if plans could not be prepared for new_k, hrtfs has no spectra then
+    bool transform_hrtfs(hrtf_buffer_sc& hrtfs, int new_k, FFTPlanCache& plans);
+    // split freshly loaded HRIRs into minimum phase filters and delays if minimum_phase is set, shortens
+    // hrtfs.num_samples (call before transform_hrtfs())
+    void decompose_hrtfs(hrtf_buffer_sc& hrtfs);
+    void update_convolvers();
+    // take over a set of freshly read HRIRs (allocated with new): decompose and transform it, prepare the interpolator
+    // and new engines for it while processBlock goes on with the current ones, then swap them in
+    // false if the FFT sizes of the set could not be prepared, the set is deleted and the current one stays
+    bool load_hrtfs(hrtf_buffer_sc* hrtfs);
+    // convolution mode for both engines (ConvolutionEngine::conv_modes), updates the reported latency
+    void set_mode(int mode);
+    // called by the tuner thread with the measured configuration
+    void apply_tuning(const tuning_result& result);
+    // FFT backend chosen by the user (fft_backends), or -1 to use the tuned one
+    void set_fft_backend(int type);
+    // latency in samples the engines may add (see max_latency), tunes again for it
+    void set_max_latency(int samples);
+    // render with HRTFs interpolated for the direction given to interpolator instead of the measured one of hrtf_buffer.sel
+    void set_interpolation(bool on);
 
 
-    bool ir_update = false;
     bool ir_ready = false;
     bool performConv = false;
+    // see decompose_hrtfs(), applies to the next HRTF set loaded (off by default, the rebuild is lossy near Nyquist,
+    // see benchmark_minimum_phase())
+    bool minimum_phase = false;
     bool sineFlag = false;
     bool noiseFlag = false;
 
+    // samples in the current host block, anything from 1 to block_size and beyond
     int n = 0;
     int k = 0;
+    // internal block size of the engines, samplesPerBlock of prepareToPlay
+    int block_size = 0;
+    // latency reported to the host: block_size while a fixed-block engine runs behind the FIFOs, 0 otherwise
+    // (written under engine_lock, read by the audio thread also when it does not get the lock)
+    std::atomic<int> latency{ 0 };
 
-    struct hrtf_buffer_sc {
-        fftwf_complex** left = NULL;
-        fftwf_complex** right = NULL;
-        int num_hrtfs = 0;
-        int num_samples = 0;
-        int sel = 0;
-    } hrtf_buffer;
+    // the HRTF set the engines run on, replaced by load_hrtfs()
+    hrtf_buffer_sc* hrtf_buffer = NULL;
 
     juce::AudioBuffer<float> ir_buffer;
-    fftwf_complex* ir_left;
-    fftwf_complex* ir_right;
+    fft_complex* ir_left;
+    fft_complex* ir_right;
     bool ir_flag = false;
     bool conv_flag = false;
     float* current_left = NULL;
@@ -95,17 +135,103 @@ public:
     float* previous_left = NULL;
     float* previous_right = NULL;
 
+    // test tone of block_size samples, generated in prepareToPlay
     float* sine = NULL;
-    bool sineInit = false;
+
+    // r2c / c2r plans, created outside of processBlock
+    FFTPlanCache fft_plans;
+    // swaps measured plans into fft_plans on a background thread whenever update_convolvers() has prepared new sizes
+    FFTPlanner fft_planner{ fft_plans };
+    // fft_planning used by fft_planner (fft_planning_estimate turns it off)
+    int fft_planning = fft_planning_measure;
+    // transforms of load_hrtfs(), which runs next to the audio thread (see ConvolutionEngineT::prepare)
+    FFTPlanCache load_plans;
+    // all buffers used by processBlock, allocated in prepareToPlay or when a HRTF set is loaded
+    ConvolutionEngine* engine = NULL;
+    // held while the engine or hrtf_buffer get rebuilt or swapped, processBlock only tries to take it and passes audio
+    // through otherwise
+    juce::SpinLock engine_lock;
+    // held by whoever builds new engines or swaps them in (taken before engine_lock), so the loader, the editor and
+    // the tuner thread do not build on top of each other; the tuner thread only tries to take it, see apply_tuning()
+    std::mutex rebuild_lock;
+
+    // measures the engine configurations for the current block size and HRIR length, see update_convolvers()
+    ConvolutionTuner tuner;
+    // last tuning result, only used while it matches block_size and hrtf_buffer.num_samples
+    tuning_result tuned;
+    // measure on a background thread (the cost model decides until it is done) or right away in update_convolvers()
+    bool tune_in_background = true;
+    // latency in samples the automatic mode may add (the FIFO of the fixed-block engines adds block_size), for the
+    // tuner and the cost model; set through set_max_latency()
+    int max_latency = INT_MAX;
+    // see set_fft_backend()
+    int fft_backend = -1;
+
+    // the same engine in double precision, prepared by update_convolvers() while the host processes in 64 bit
+    ConvolutionEngineT<double>* engine_double = NULL;
+    // 64-bit blocks go through engine_double, otherwise they are converted to float and back around engine
+    // (see benchmark_precision() for what each one costs)
+    bool double_engine = true;
+    // 2 * block_size samples, the float copy of a 64-bit block (in pieces of block_size) when double_engine is off
+    float* convert_buffer = NULL;
+
+    // host blocks of any length go through these to the fixed-block engines, see update_latency()
+    // only the audio thread touches them after prepareToPlay, other threads ask for a reset through fifo_reset
+    BlockFifoT<float> fifo;
+    BlockFifoT<double> fifo_double;
+    std::atomic<bool> fifo_reset{ false };
+
+    // HRIRs for any direction, prepared by the loader for each HRTF set and loaded into the extra filters of the engines
+    HrtfInterpolator interpolator;
+    // filters of recent directions as the engines hold them, emptied whenever the engines are built again
+    // (see benchmark_hrtf_cache())
+    HrtfCache hrtf_cache;
+    // bytes hrtf_cache may take, 0 turns it off (an entry takes tens of kilobytes, all partitions of both engines)
+    size_t cache_budget = 16 << 20;
+    // see set_interpolation()
+    bool interpolation = false;
+    // order of the spherical harmonic fit of the interpolator (HrtfInterpolator::sh_order), -1 for triangles,
+    // applies to the next HRTF set loaded (see benchmark_spherical_harmonics() for memory and accuracy per order)
+    int sh_order = -1;
     
 private:
+    // test signals and convolution of num_samples, shared by both processBlock versions
+    template <typename Sample>
+    void render(BlockFifoT<Sample>& block_fifo, Sample* channelData, Sample* channelLeft, Sample* channelRight, int num_samples);
+    // engine or engine_double, only while holding engine_lock
+    template <typename Sample>
+    ConvolutionEngineT<Sample>& get_engine();
+    // prepare conv_double like conv, or release it if the host does not process in double precision
+    // false if conv_double is needed but could not be prepared
+    bool update_double_engine(const ConvolutionEngine& conv, ConvolutionEngineT<double>& conv_double, const hrtf_buffer_sc& hrtfs,
+                              int new_k, FFTPlanCache* transform_plans = NULL);
+    // prepare conv for hrtfs with the tuned configuration or the cost model, and conv_double like it
+    // false if one of them could not be prepared (see ConvolutionEngineT::prepare), both are released then
+    bool prepare_engines(ConvolutionEngine& conv, ConvolutionEngineT<double>& conv_double, const hrtf_buffer_sc& hrtfs,
+                         int new_k, const tuning_result& tuning, FFTPlanCache* transform_plans = NULL);
+    // new engines with the settings of the current ones and mode, prepared for hrtfs next to the ones processBlock
+    // is running on (transforms through load_plans); false if they could not be prepared, conv and conv_double are NULL then
+    bool build_engines(const hrtf_buffer_sc& hrtfs, int new_k, int mode, const tuning_result& tuning,
+                       ConvolutionEngine*& conv, ConvolutionEngineT<double>*& conv_double);
+    // build engines for hrtf_buffer with mode, the FFT backend choice (see set_fft_backend()) and tuning, and swap them
+    // in under engine_lock; the caller holds rebuild_lock and has cancelled fft_planner
+    // false if they could not be prepared, the current engines and settings stay then
+    bool rebuild_engines(int mode, int backend, const tuning_result& tuning);
+    // keep tuning if it was measured for block_size and the HRIR length of hrtfs, otherwise look up an earlier
+    // measurement or measure right away (tune_in_background off); true if the tuner still has to run, see start_tuner()
+    bool find_tuning(const hrtf_buffer_sc& hrtfs, int new_k, tuning_result& tuning);
+    // measure the configurations for hrtf_buffer in the background, apply_tuning() gets the result
+    void start_tuner();
+    // the FFT backend chosen by the user or the tuned one (caller holds engine_lock)
+    void select_fft_backend();
+    // set latency for the active engine mode and report it to the host (caller holds engine_lock)
+    void update_latency();
+    // (re)start the interpolator on the engines after they have been prepared, stop it before (caller holds engine_lock)
+    void update_interpolator();
+    // empty hrtf_cache for filters of conv and conv_double and hand it to the stopped interpolator
+    void prepare_cache(const ConvolutionEngine& conv, const ConvolutionEngineT<double>& conv_double);
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(BinauralizationAudioProcessor)
-
-   // [MEM][SAMPLES]
-   float** overlap_buffer_left = NULL;
-   float** overlap_buffer_right = NULL;
-
-   int MEM = 0;
     
 };
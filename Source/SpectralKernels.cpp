@@ -0,0 +1,1469 @@
+/*
+  ==============================================================================
+
+    SpectralKernels.cpp
+
+  ==============================================================================
+*/
+
+#include <atomic>
+#include <cmath>
+#include "SpectralKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define SPECTRAL_KERNELS_X86 1
+ #include <immintrin.h>
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+  // MSVC compiles intrinsics of any instruction set without extra flags
+  #define KERNEL_TARGET(isa)
+ #else
+  // GCC / Clang: enable the instruction set per function, the rest of the plugin stays at the baseline
+  #define KERNEL_TARGET(isa) __attribute__((target(isa)))
+ #endif
+#else
+ #define SPECTRAL_KERNELS_X86 0
+#endif
+
+#define REAL 0
+#define IMAG 1
+
+typedef void (*kernel_function)(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins);
+typedef void (*split_function)(split_complex a, split_complex b, split_complex result, int bins);
+typedef void (*fir_function)(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count);
+typedef void (*fir_4_function)(const float* x, const float* taps, float* y, int count);
+typedef void (*weighted_sum_function)(const float* rows, int stride, const float* weights, int num_rows, float* result, int count);
+
+//---------- scalar -------------------------------------------------------------
+
+static void mac_scalar(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        result[i][REAL] += a[i][REAL] * b[i][REAL] - a[i][IMAG] * b[i][IMAG];
+        result[i][IMAG] += a[i][REAL] * b[i][IMAG] + a[i][IMAG] * b[i][REAL];
+    }
+}
+
+static void multiply_scalar(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        float re = a[i][REAL] * b[i][REAL] - a[i][IMAG] * b[i][IMAG];
+        float im = a[i][REAL] * b[i][IMAG] + a[i][IMAG] * b[i][REAL];
+        result[i][REAL] = re;
+        result[i][IMAG] = im;
+    }
+}
+
+static void mac_split_scalar(split_complex a, split_complex b, split_complex result, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        result.re[i] += a.re[i] * b.re[i] - a.im[i] * b.im[i];
+        result.im[i] += a.re[i] * b.im[i] + a.im[i] * b.re[i];
+    }
+}
+
+static void multiply_split_scalar(split_complex a, split_complex b, split_complex result, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        float re = a.re[i] * b.re[i] - a.im[i] * b.im[i];
+        float im = a.re[i] * b.im[i] + a.im[i] * b.re[i];
+        result.re[i] = re;
+        result.im[i] = im;
+    }
+}
+
+static split_complex offset(split_complex x, int i) {
+
+    return { x.re + i, x.im + i };
+}
+
+static void mac_sum_scalar(const split_complex* a, const split_complex* b, int count, split_complex result, int bins, int first) {
+
+    for (int i = first; i < bins; i++) {
+        float re = 0.f;
+        float im = 0.f;
+
+        for (int p = 0; p < count; p++) {
+            re += a[p].re[i] * b[p].re[i] - a[p].im[i] * b[p].im[i];
+            im += a[p].re[i] * b[p].im[i] + a[p].im[i] * b[p].re[i];
+        }
+
+        result.re[i] = re;
+        result.im[i] = im;
+    }
+}
+
+static void mac_sum_scalar(const split_complex* a, const split_complex* b, int count, split_complex result, int bins) {
+
+    mac_sum_scalar(a, b, count, result, bins, 0);
+}
+
+static void fir_scalar(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count) {
+
+    for (int i = 0; i < count; i++) {
+        float sum_left = 0.f;
+        float sum_right = 0.f;
+
+        for (int j = 0; j < num_taps; j++) {
+            sum_left += taps_left[j] * x[i + j];
+            sum_right += taps_right[j] * x[i + j];
+        }
+
+        left[i] = sum_left;
+        right[i] = sum_right;
+    }
+}
+
+static void fir_4_scalar(const float* x, const float* taps, float* y, int count) {
+
+    for (int i = 0; i < count; i++)
+        y[i] = taps[0] * x[i] + taps[1] * x[i + 1] + taps[2] * x[i + 2] + taps[3] * x[i + 3];
+}
+
+static void weighted_sum_scalar(const float* rows, int stride, const float* weights, int num_rows, float* result, int count) {
+
+    for (int i = 0; i < count; i++) {
+        float sum = 0.f;
+        for (int r = 0; r < num_rows; r++)
+            sum += weights[r] * rows[(size_t)r * stride + i];
+        result[i] = sum;
+    }
+}
+
+#if SPECTRAL_KERNELS_X86
+
+//---------- SSE2, 2 bins per register ------------------------------------------
+
+// [ar ai] * [br bi] = [ar*br - ai*bi, ai*br + ar*bi] = a * br + swap(a) * bi * [-1 +1]
+KERNEL_TARGET("sse2")
+static inline __m128 product_sse2(__m128 a, __m128 b) {
+
+    const __m128 sign = _mm_castsi128_ps(_mm_set_epi32(0, (int)0x80000000, 0, (int)0x80000000));
+
+    __m128 b_re = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 b_im = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128 a_swap = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+
+    return _mm_add_ps(_mm_mul_ps(a, b_re), _mm_xor_ps(_mm_mul_ps(a_swap, b_im), sign));
+}
+
+KERNEL_TARGET("sse2")
+static void mac_sse2(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    int i = 0;
+    for (; i + 2 <= bins; i += 2) {
+        __m128 p = product_sse2(_mm_loadu_ps(a[i]), _mm_loadu_ps(b[i]));
+        _mm_storeu_ps(result[i], _mm_add_ps(_mm_loadu_ps(result[i]), p));
+    }
+    mac_scalar(a + i, b + i, result + i, bins - i);
+}
+
+KERNEL_TARGET("sse2")
+static void multiply_sse2(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    int i = 0;
+    for (; i + 2 <= bins; i += 2)
+        _mm_storeu_ps(result[i], product_sse2(_mm_loadu_ps(a[i]), _mm_loadu_ps(b[i])));
+    multiply_scalar(a + i, b + i, result + i, bins - i);
+}
+
+// split layout: no shuffles, 4 bins per register
+KERNEL_TARGET("sse2")
+static void mac_split_sse2(split_complex a, split_complex b, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4) {
+        __m128 a_re = _mm_loadu_ps(a.re + i), a_im = _mm_loadu_ps(a.im + i);
+        __m128 b_re = _mm_loadu_ps(b.re + i), b_im = _mm_loadu_ps(b.im + i);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(a_re, b_re), _mm_mul_ps(a_im, b_im));
+        __m128 im = _mm_add_ps(_mm_mul_ps(a_re, b_im), _mm_mul_ps(a_im, b_re));
+        _mm_storeu_ps(result.re + i, _mm_add_ps(_mm_loadu_ps(result.re + i), re));
+        _mm_storeu_ps(result.im + i, _mm_add_ps(_mm_loadu_ps(result.im + i), im));
+    }
+    mac_split_scalar(offset(a, i), offset(b, i), offset(result, i), bins - i);
+}
+
+KERNEL_TARGET("sse2")
+static void multiply_split_sse2(split_complex a, split_complex b, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4) {
+        __m128 a_re = _mm_loadu_ps(a.re + i), a_im = _mm_loadu_ps(a.im + i);
+        __m128 b_re = _mm_loadu_ps(b.re + i), b_im = _mm_loadu_ps(b.im + i);
+        _mm_storeu_ps(result.re + i, _mm_sub_ps(_mm_mul_ps(a_re, b_re), _mm_mul_ps(a_im, b_im)));
+        _mm_storeu_ps(result.im + i, _mm_add_ps(_mm_mul_ps(a_re, b_im), _mm_mul_ps(a_im, b_re)));
+    }
+    multiply_split_scalar(offset(a, i), offset(b, i), offset(result, i), bins - i);
+}
+
+// the sums keep the four partial products in separate registers, so consecutive partitions do not wait for each other
+KERNEL_TARGET("sse2")
+static void mac_sum_sse2(const split_complex* a, const split_complex* b, int count, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4) {
+        __m128 re0 = _mm_setzero_ps(), re1 = _mm_setzero_ps();
+        __m128 im0 = _mm_setzero_ps(), im1 = _mm_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m128 a_re = _mm_loadu_ps(a[p].re + i), a_im = _mm_loadu_ps(a[p].im + i);
+            __m128 b_re = _mm_loadu_ps(b[p].re + i), b_im = _mm_loadu_ps(b[p].im + i);
+            re0 = _mm_add_ps(re0, _mm_mul_ps(a_re, b_re));
+            re1 = _mm_add_ps(re1, _mm_mul_ps(a_im, b_im));
+            im0 = _mm_add_ps(im0, _mm_mul_ps(a_re, b_im));
+            im1 = _mm_add_ps(im1, _mm_mul_ps(a_im, b_re));
+        }
+
+        _mm_storeu_ps(result.re + i, _mm_sub_ps(re0, re1));
+        _mm_storeu_ps(result.im + i, _mm_add_ps(im0, im1));
+    }
+    mac_sum_scalar(a, b, count, result, bins, i);
+}
+
+// the FIR kernels run over output samples, one tap is broadcast and both ears share the input load
+KERNEL_TARGET("sse2")
+static void fir_sse2(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count) {
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 left0 = _mm_setzero_ps(), left1 = _mm_setzero_ps();
+        __m128 right0 = _mm_setzero_ps(), right1 = _mm_setzero_ps();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m128 h_left = _mm_set1_ps(taps_left[j]);
+            __m128 h_right = _mm_set1_ps(taps_right[j]);
+            __m128 x0 = _mm_loadu_ps(x + i + j);
+            __m128 x1 = _mm_loadu_ps(x + i + j + 4);
+            left0 = _mm_add_ps(left0, _mm_mul_ps(h_left, x0));
+            left1 = _mm_add_ps(left1, _mm_mul_ps(h_left, x1));
+            right0 = _mm_add_ps(right0, _mm_mul_ps(h_right, x0));
+            right1 = _mm_add_ps(right1, _mm_mul_ps(h_right, x1));
+        }
+
+        _mm_storeu_ps(left + i, left0);
+        _mm_storeu_ps(left + i + 4, left1);
+        _mm_storeu_ps(right + i, right0);
+        _mm_storeu_ps(right + i + 4, right1);
+    }
+    fir_scalar(x + i, taps_left, taps_right, num_taps, left + i, right + i, count - i);
+}
+
+// all four taps stay in registers, every output vector takes four unaligned loads of the shifted input
+KERNEL_TARGET("sse2")
+static void fir_4_sse2(const float* x, const float* taps, float* y, int count) {
+
+    __m128 h0 = _mm_set1_ps(taps[0]), h1 = _mm_set1_ps(taps[1]), h2 = _mm_set1_ps(taps[2]), h3 = _mm_set1_ps(taps[3]);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum0 = _mm_add_ps(_mm_mul_ps(h0, _mm_loadu_ps(x + i)), _mm_mul_ps(h1, _mm_loadu_ps(x + i + 1)));
+        __m128 sum1 = _mm_add_ps(_mm_mul_ps(h2, _mm_loadu_ps(x + i + 2)), _mm_mul_ps(h3, _mm_loadu_ps(x + i + 3)));
+        _mm_storeu_ps(y + i, _mm_add_ps(sum0, sum1));
+    }
+    fir_4_scalar(x + i, taps, y + i, count - i);
+}
+
+// 4 registers of columns accumulate over all rows before they are stored
+KERNEL_TARGET("sse2")
+static void weighted_sum_sse2(const float* rows, int stride, const float* weights, int num_rows, float* result, int count) {
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+        for (int r = 0; r < num_rows; r++) {
+            const float* row = rows + (size_t)r * stride + i;
+            __m128 w = _mm_set1_ps(weights[r]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(w, _mm_loadu_ps(row)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(w, _mm_loadu_ps(row + 4)));
+            sum2 = _mm_add_ps(sum2, _mm_mul_ps(w, _mm_loadu_ps(row + 8)));
+            sum3 = _mm_add_ps(sum3, _mm_mul_ps(w, _mm_loadu_ps(row + 12)));
+        }
+        _mm_storeu_ps(result + i, sum0);
+        _mm_storeu_ps(result + i + 4, sum1);
+        _mm_storeu_ps(result + i + 8, sum2);
+        _mm_storeu_ps(result + i + 12, sum3);
+    }
+    weighted_sum_scalar(rows + i, stride, weights, num_rows, result + i, count - i);
+}
+
+//---------- AVX2 + FMA, 4 bins per register ------------------------------------
+
+// the scalar tails are compiled for the baseline (SSE) and GCC does not clear the upper register halves before
+// calling them, which costs a state transition on every SSE instruction until the next vzeroupper on many CPUs
+// (the FFT backends included), so every kernel clears them itself before handing over
+
+KERNEL_TARGET("avx2,fma")
+static inline __m256 product_avx2(__m256 a, __m256 b) {
+
+    __m256 b_re = _mm256_moveldup_ps(b);
+    __m256 b_im = _mm256_movehdup_ps(b);
+    __m256 a_swap = _mm256_permute_ps(a, 0xB1);
+
+    // even lanes: a*br - swap(a)*bi, odd lanes: a*br + swap(a)*bi
+    return _mm256_fmaddsub_ps(a, b_re, _mm256_mul_ps(a_swap, b_im));
+}
+
+KERNEL_TARGET("avx2,fma")
+static void mac_avx2(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4) {
+        __m256 p = product_avx2(_mm256_loadu_ps(a[i]), _mm256_loadu_ps(b[i]));
+        _mm256_storeu_ps(result[i], _mm256_add_ps(_mm256_loadu_ps(result[i]), p));
+    }
+    _mm256_zeroupper();
+    mac_scalar(a + i, b + i, result + i, bins - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void multiply_avx2(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4)
+        _mm256_storeu_ps(result[i], product_avx2(_mm256_loadu_ps(a[i]), _mm256_loadu_ps(b[i])));
+    _mm256_zeroupper();
+    multiply_scalar(a + i, b + i, result + i, bins - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void mac_split_avx2(split_complex a, split_complex b, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        __m256 a_re = _mm256_loadu_ps(a.re + i), a_im = _mm256_loadu_ps(a.im + i);
+        __m256 b_re = _mm256_loadu_ps(b.re + i), b_im = _mm256_loadu_ps(b.im + i);
+        // re += ar*br - ai*bi, im += ar*bi + ai*br, four FMAs per 8 bins
+        __m256 re = _mm256_fnmadd_ps(a_im, b_im, _mm256_fmadd_ps(a_re, b_re, _mm256_loadu_ps(result.re + i)));
+        __m256 im = _mm256_fmadd_ps(a_im, b_re, _mm256_fmadd_ps(a_re, b_im, _mm256_loadu_ps(result.im + i)));
+        _mm256_storeu_ps(result.re + i, re);
+        _mm256_storeu_ps(result.im + i, im);
+    }
+    _mm256_zeroupper();
+    mac_split_scalar(offset(a, i), offset(b, i), offset(result, i), bins - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void multiply_split_avx2(split_complex a, split_complex b, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        __m256 a_re = _mm256_loadu_ps(a.re + i), a_im = _mm256_loadu_ps(a.im + i);
+        __m256 b_re = _mm256_loadu_ps(b.re + i), b_im = _mm256_loadu_ps(b.im + i);
+        _mm256_storeu_ps(result.re + i, _mm256_fmsub_ps(a_re, b_re, _mm256_mul_ps(a_im, b_im)));
+        _mm256_storeu_ps(result.im + i, _mm256_fmadd_ps(a_re, b_im, _mm256_mul_ps(a_im, b_re)));
+    }
+    _mm256_zeroupper();
+    multiply_split_scalar(offset(a, i), offset(b, i), offset(result, i), bins - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void mac_sum_avx2(const split_complex* a, const split_complex* b, int count, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        __m256 re0 = _mm256_setzero_ps(), re1 = _mm256_setzero_ps();
+        __m256 im0 = _mm256_setzero_ps(), im1 = _mm256_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m256 a_re = _mm256_loadu_ps(a[p].re + i), a_im = _mm256_loadu_ps(a[p].im + i);
+            __m256 b_re = _mm256_loadu_ps(b[p].re + i), b_im = _mm256_loadu_ps(b[p].im + i);
+            re0 = _mm256_fmadd_ps(a_re, b_re, re0);
+            re1 = _mm256_fmadd_ps(a_im, b_im, re1);
+            im0 = _mm256_fmadd_ps(a_re, b_im, im0);
+            im1 = _mm256_fmadd_ps(a_im, b_re, im1);
+        }
+
+        _mm256_storeu_ps(result.re + i, _mm256_sub_ps(re0, re1));
+        _mm256_storeu_ps(result.im + i, _mm256_add_ps(im0, im1));
+    }
+    _mm256_zeroupper();
+    mac_sum_scalar(a, b, count, result, bins, i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void fir_avx2(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count) {
+
+    int i = 0;
+    // 16 outputs per pass give 4 independent FMA chains
+    for (; i + 16 <= count; i += 16) {
+        __m256 left0 = _mm256_setzero_ps(), left1 = _mm256_setzero_ps();
+        __m256 right0 = _mm256_setzero_ps(), right1 = _mm256_setzero_ps();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m256 h_left = _mm256_set1_ps(taps_left[j]);
+            __m256 h_right = _mm256_set1_ps(taps_right[j]);
+            __m256 x0 = _mm256_loadu_ps(x + i + j);
+            __m256 x1 = _mm256_loadu_ps(x + i + j + 8);
+            left0 = _mm256_fmadd_ps(h_left, x0, left0);
+            left1 = _mm256_fmadd_ps(h_left, x1, left1);
+            right0 = _mm256_fmadd_ps(h_right, x0, right0);
+            right1 = _mm256_fmadd_ps(h_right, x1, right1);
+        }
+
+        _mm256_storeu_ps(left + i, left0);
+        _mm256_storeu_ps(left + i + 8, left1);
+        _mm256_storeu_ps(right + i, right0);
+        _mm256_storeu_ps(right + i + 8, right1);
+    }
+    for (; i + 8 <= count; i += 8) {
+        __m256 left0 = _mm256_setzero_ps();
+        __m256 right0 = _mm256_setzero_ps();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m256 x0 = _mm256_loadu_ps(x + i + j);
+            left0 = _mm256_fmadd_ps(_mm256_set1_ps(taps_left[j]), x0, left0);
+            right0 = _mm256_fmadd_ps(_mm256_set1_ps(taps_right[j]), x0, right0);
+        }
+
+        _mm256_storeu_ps(left + i, left0);
+        _mm256_storeu_ps(right + i, right0);
+    }
+    _mm256_zeroupper();
+    fir_scalar(x + i, taps_left, taps_right, num_taps, left + i, right + i, count - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void fir_4_avx2(const float* x, const float* taps, float* y, int count) {
+
+    __m256 h0 = _mm256_set1_ps(taps[0]), h1 = _mm256_set1_ps(taps[1]), h2 = _mm256_set1_ps(taps[2]), h3 = _mm256_set1_ps(taps[3]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum0 = _mm256_fmadd_ps(h1, _mm256_loadu_ps(x + i + 1), _mm256_mul_ps(h0, _mm256_loadu_ps(x + i)));
+        __m256 sum1 = _mm256_fmadd_ps(h3, _mm256_loadu_ps(x + i + 3), _mm256_mul_ps(h2, _mm256_loadu_ps(x + i + 2)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(sum0, sum1));
+    }
+    _mm256_zeroupper();
+    fir_4_scalar(x + i, taps, y + i, count - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void weighted_sum_avx2(const float* rows, int stride, const float* weights, int num_rows, float* result, int count) {
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+        for (int r = 0; r < num_rows; r++) {
+            const float* row = rows + (size_t)r * stride + i;
+            __m256 w = _mm256_set1_ps(weights[r]);
+            sum0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(row), sum0);
+            sum1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(row + 8), sum1);
+            sum2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(row + 16), sum2);
+            sum3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(row + 24), sum3);
+        }
+        _mm256_storeu_ps(result + i, sum0);
+        _mm256_storeu_ps(result + i + 8, sum1);
+        _mm256_storeu_ps(result + i + 16, sum2);
+        _mm256_storeu_ps(result + i + 24, sum3);
+    }
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int r = 0; r < num_rows; r++)
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[r]), _mm256_loadu_ps(rows + (size_t)r * stride + i), sum);
+        _mm256_storeu_ps(result + i, sum);
+    }
+    _mm256_zeroupper();
+    weighted_sum_scalar(rows + i, stride, weights, num_rows, result + i, count - i);
+}
+
+//---------- AVX-512, 8 bins per register ---------------------------------------
+
+KERNEL_TARGET("avx512f")
+static inline __m512 product_avx512(__m512 a, __m512 b) {
+
+    __m512 b_re = _mm512_moveldup_ps(b);
+    __m512 b_im = _mm512_movehdup_ps(b);
+    __m512 a_swap = _mm512_permute_ps(a, 0xB1);
+
+    return _mm512_fmaddsub_ps(a, b_re, _mm512_mul_ps(a_swap, b_im));
+}
+
+KERNEL_TARGET("avx512f")
+static void mac_avx512(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    int i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        __m512 p = product_avx512(_mm512_loadu_ps(a[i]), _mm512_loadu_ps(b[i]));
+        _mm512_storeu_ps(result[i], _mm512_add_ps(_mm512_loadu_ps(result[i]), p));
+    }
+    _mm256_zeroupper();
+    mac_scalar(a + i, b + i, result + i, bins - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void multiply_avx512(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    int i = 0;
+    for (; i + 8 <= bins; i += 8)
+        _mm512_storeu_ps(result[i], product_avx512(_mm512_loadu_ps(a[i]), _mm512_loadu_ps(b[i])));
+    _mm256_zeroupper();
+    multiply_scalar(a + i, b + i, result + i, bins - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void mac_split_avx512(split_complex a, split_complex b, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 16 <= bins; i += 16) {
+        __m512 a_re = _mm512_loadu_ps(a.re + i), a_im = _mm512_loadu_ps(a.im + i);
+        __m512 b_re = _mm512_loadu_ps(b.re + i), b_im = _mm512_loadu_ps(b.im + i);
+        __m512 re = _mm512_fnmadd_ps(a_im, b_im, _mm512_fmadd_ps(a_re, b_re, _mm512_loadu_ps(result.re + i)));
+        __m512 im = _mm512_fmadd_ps(a_im, b_re, _mm512_fmadd_ps(a_re, b_im, _mm512_loadu_ps(result.im + i)));
+        _mm512_storeu_ps(result.re + i, re);
+        _mm512_storeu_ps(result.im + i, im);
+    }
+    mac_split_avx2(offset(a, i), offset(b, i), offset(result, i), bins - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void multiply_split_avx512(split_complex a, split_complex b, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 16 <= bins; i += 16) {
+        __m512 a_re = _mm512_loadu_ps(a.re + i), a_im = _mm512_loadu_ps(a.im + i);
+        __m512 b_re = _mm512_loadu_ps(b.re + i), b_im = _mm512_loadu_ps(b.im + i);
+        _mm512_storeu_ps(result.re + i, _mm512_fmsub_ps(a_re, b_re, _mm512_mul_ps(a_im, b_im)));
+        _mm512_storeu_ps(result.im + i, _mm512_fmadd_ps(a_re, b_im, _mm512_mul_ps(a_im, b_re)));
+    }
+    multiply_split_avx2(offset(a, i), offset(b, i), offset(result, i), bins - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void mac_sum_avx512(const split_complex* a, const split_complex* b, int count, split_complex result, int bins) {
+
+    int i = 0;
+    for (; i + 16 <= bins; i += 16) {
+        __m512 re0 = _mm512_setzero_ps(), re1 = _mm512_setzero_ps();
+        __m512 im0 = _mm512_setzero_ps(), im1 = _mm512_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m512 a_re = _mm512_loadu_ps(a[p].re + i), a_im = _mm512_loadu_ps(a[p].im + i);
+            __m512 b_re = _mm512_loadu_ps(b[p].re + i), b_im = _mm512_loadu_ps(b[p].im + i);
+            re0 = _mm512_fmadd_ps(a_re, b_re, re0);
+            re1 = _mm512_fmadd_ps(a_im, b_im, re1);
+            im0 = _mm512_fmadd_ps(a_re, b_im, im0);
+            im1 = _mm512_fmadd_ps(a_im, b_re, im1);
+        }
+
+        _mm512_storeu_ps(result.re + i, _mm512_sub_ps(re0, re1));
+        _mm512_storeu_ps(result.im + i, _mm512_add_ps(im0, im1));
+    }
+    _mm256_zeroupper();
+    mac_sum_scalar(a, b, count, result, bins, i);
+}
+
+KERNEL_TARGET("avx512f")
+static void fir_avx512(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count) {
+
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m512 left0 = _mm512_setzero_ps(), left1 = _mm512_setzero_ps();
+        __m512 right0 = _mm512_setzero_ps(), right1 = _mm512_setzero_ps();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m512 h_left = _mm512_set1_ps(taps_left[j]);
+            __m512 h_right = _mm512_set1_ps(taps_right[j]);
+            __m512 x0 = _mm512_loadu_ps(x + i + j);
+            __m512 x1 = _mm512_loadu_ps(x + i + j + 16);
+            left0 = _mm512_fmadd_ps(h_left, x0, left0);
+            left1 = _mm512_fmadd_ps(h_left, x1, left1);
+            right0 = _mm512_fmadd_ps(h_right, x0, right0);
+            right1 = _mm512_fmadd_ps(h_right, x1, right1);
+        }
+
+        _mm512_storeu_ps(left + i, left0);
+        _mm512_storeu_ps(left + i + 16, left1);
+        _mm512_storeu_ps(right + i, right0);
+        _mm512_storeu_ps(right + i + 16, right1);
+    }
+    // AVX-512 implies AVX2 and FMA, the AVX2 kernel takes the rest
+    fir_avx2(x + i, taps_left, taps_right, num_taps, left + i, right + i, count - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void fir_4_avx512(const float* x, const float* taps, float* y, int count) {
+
+    __m512 h0 = _mm512_set1_ps(taps[0]), h1 = _mm512_set1_ps(taps[1]), h2 = _mm512_set1_ps(taps[2]), h3 = _mm512_set1_ps(taps[3]);
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 sum0 = _mm512_fmadd_ps(h1, _mm512_loadu_ps(x + i + 1), _mm512_mul_ps(h0, _mm512_loadu_ps(x + i)));
+        __m512 sum1 = _mm512_fmadd_ps(h3, _mm512_loadu_ps(x + i + 3), _mm512_mul_ps(h2, _mm512_loadu_ps(x + i + 2)));
+        _mm512_storeu_ps(y + i, _mm512_add_ps(sum0, sum1));
+    }
+    fir_4_avx2(x + i, taps, y + i, count - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void weighted_sum_avx512(const float* rows, int stride, const float* weights, int num_rows, float* result, int count) {
+
+    int i = 0;
+    for (; i + 64 <= count; i += 64) {
+        __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps(), sum2 = _mm512_setzero_ps(), sum3 = _mm512_setzero_ps();
+        for (int r = 0; r < num_rows; r++) {
+            const float* row = rows + (size_t)r * stride + i;
+            __m512 w = _mm512_set1_ps(weights[r]);
+            sum0 = _mm512_fmadd_ps(w, _mm512_loadu_ps(row), sum0);
+            sum1 = _mm512_fmadd_ps(w, _mm512_loadu_ps(row + 16), sum1);
+            sum2 = _mm512_fmadd_ps(w, _mm512_loadu_ps(row + 32), sum2);
+            sum3 = _mm512_fmadd_ps(w, _mm512_loadu_ps(row + 48), sum3);
+        }
+        _mm512_storeu_ps(result + i, sum0);
+        _mm512_storeu_ps(result + i + 16, sum1);
+        _mm512_storeu_ps(result + i + 32, sum2);
+        _mm512_storeu_ps(result + i + 48, sum3);
+    }
+    weighted_sum_avx2(rows + i, stride, weights, num_rows, result + i, count - i);
+}
+
+//---------- CPU detection ------------------------------------------------------
+
+static bool cpu_supports(int type) {
+
+    if (type == kernel_scalar)
+        return true;
+
+ #if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    // the OS has to save the ymm (and zmm) registers on context switches
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool os_avx = (xcr0 & 0x6) == 0x6;
+    bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    bool avx512f = (info[1] & (1 << 16)) != 0;
+
+    switch (type) {
+    case kernel_sse2: return sse2;
+    case kernel_avx2: return avx2 && fma && os_avx;
+    case kernel_avx512: return avx512f && os_avx512;
+    default: return false;
+    }
+ #else
+    // libgcc / compiler-rt also check that the OS enabled the register state
+    __builtin_cpu_init();
+
+    switch (type) {
+    case kernel_sse2: return __builtin_cpu_supports("sse2");
+    case kernel_avx2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    case kernel_avx512: return __builtin_cpu_supports("avx512f");
+    default: return false;
+    }
+ #endif
+}
+
+#else
+
+static bool cpu_supports(int type) {
+
+    return type == kernel_scalar;
+}
+
+#endif
+
+//---------- fixed sizes --------------------------------------------------------
+
+// bins is a compile-time constant here: the loops round it up to whole vectors and read into the zeroed padding
+// instead of running a tail, AVX2 and AVX-512 take pairs of vectors, twice as many independent sums as the generic kernels
+
+template <int bins>
+static void mac_sum_fixed_scalar(const split_complex* a, const split_complex* b, int count, split_complex result, int) {
+
+    mac_sum_scalar(a, b, count, result, bins, 0);
+}
+
+#if SPECTRAL_KERNELS_X86
+
+// SSE2 has only 16 registers, so a pair of vectors per pass would spill
+template <int bins>
+KERNEL_TARGET("sse2")
+static void mac_sum_fixed_sse2(const split_complex* a, const split_complex* b, int count, split_complex result, int) {
+
+    const int padded = (bins + 3) & ~3;
+
+    for (int i = 0; i < padded; i += 4) {
+        __m128 re0 = _mm_setzero_ps(), re1 = _mm_setzero_ps();
+        __m128 im0 = _mm_setzero_ps(), im1 = _mm_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m128 a_re = _mm_load_ps(a[p].re + i), a_im = _mm_load_ps(a[p].im + i);
+            __m128 b_re = _mm_load_ps(b[p].re + i), b_im = _mm_load_ps(b[p].im + i);
+            re0 = _mm_add_ps(re0, _mm_mul_ps(a_re, b_re));
+            re1 = _mm_add_ps(re1, _mm_mul_ps(a_im, b_im));
+            im0 = _mm_add_ps(im0, _mm_mul_ps(a_re, b_im));
+            im1 = _mm_add_ps(im1, _mm_mul_ps(a_im, b_re));
+        }
+
+        _mm_store_ps(result.re + i, _mm_sub_ps(re0, re1));
+        _mm_store_ps(result.im + i, _mm_add_ps(im0, im1));
+    }
+}
+
+template <int bins>
+KERNEL_TARGET("avx2,fma")
+static void mac_sum_fixed_avx2(const split_complex* a, const split_complex* b, int count, split_complex result, int) {
+
+    const int padded = (bins + 7) & ~7;
+
+    int i = 0;
+    for (; i + 16 <= padded; i += 16) {
+        __m256 re0 = _mm256_setzero_ps(), re1 = _mm256_setzero_ps(), re2 = _mm256_setzero_ps(), re3 = _mm256_setzero_ps();
+        __m256 im0 = _mm256_setzero_ps(), im1 = _mm256_setzero_ps(), im2 = _mm256_setzero_ps(), im3 = _mm256_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m256 a_re0 = _mm256_load_ps(a[p].re + i), a_im0 = _mm256_load_ps(a[p].im + i);
+            __m256 b_re0 = _mm256_load_ps(b[p].re + i), b_im0 = _mm256_load_ps(b[p].im + i);
+            __m256 a_re1 = _mm256_load_ps(a[p].re + i + 8), a_im1 = _mm256_load_ps(a[p].im + i + 8);
+            __m256 b_re1 = _mm256_load_ps(b[p].re + i + 8), b_im1 = _mm256_load_ps(b[p].im + i + 8);
+            re0 = _mm256_fmadd_ps(a_re0, b_re0, re0);
+            re1 = _mm256_fmadd_ps(a_im0, b_im0, re1);
+            im0 = _mm256_fmadd_ps(a_re0, b_im0, im0);
+            im1 = _mm256_fmadd_ps(a_im0, b_re0, im1);
+            re2 = _mm256_fmadd_ps(a_re1, b_re1, re2);
+            re3 = _mm256_fmadd_ps(a_im1, b_im1, re3);
+            im2 = _mm256_fmadd_ps(a_re1, b_im1, im2);
+            im3 = _mm256_fmadd_ps(a_im1, b_re1, im3);
+        }
+
+        _mm256_store_ps(result.re + i, _mm256_sub_ps(re0, re1));
+        _mm256_store_ps(result.im + i, _mm256_add_ps(im0, im1));
+        _mm256_store_ps(result.re + i + 8, _mm256_sub_ps(re2, re3));
+        _mm256_store_ps(result.im + i + 8, _mm256_add_ps(im2, im3));
+    }
+
+    if (i < padded) {
+        __m256 re0 = _mm256_setzero_ps(), re1 = _mm256_setzero_ps();
+        __m256 im0 = _mm256_setzero_ps(), im1 = _mm256_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m256 a_re = _mm256_load_ps(a[p].re + i), a_im = _mm256_load_ps(a[p].im + i);
+            __m256 b_re = _mm256_load_ps(b[p].re + i), b_im = _mm256_load_ps(b[p].im + i);
+            re0 = _mm256_fmadd_ps(a_re, b_re, re0);
+            re1 = _mm256_fmadd_ps(a_im, b_im, re1);
+            im0 = _mm256_fmadd_ps(a_re, b_im, im0);
+            im1 = _mm256_fmadd_ps(a_im, b_re, im1);
+        }
+
+        _mm256_store_ps(result.re + i, _mm256_sub_ps(re0, re1));
+        _mm256_store_ps(result.im + i, _mm256_add_ps(im0, im1));
+    }
+}
+
+template <int bins>
+KERNEL_TARGET("avx512f")
+static void mac_sum_fixed_avx512(const split_complex* a, const split_complex* b, int count, split_complex result, int) {
+
+    const int padded = (bins + 15) & ~15;
+
+    int i = 0;
+    for (; i + 32 <= padded; i += 32) {
+        __m512 re0 = _mm512_setzero_ps(), re1 = _mm512_setzero_ps(), re2 = _mm512_setzero_ps(), re3 = _mm512_setzero_ps();
+        __m512 im0 = _mm512_setzero_ps(), im1 = _mm512_setzero_ps(), im2 = _mm512_setzero_ps(), im3 = _mm512_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m512 a_re0 = _mm512_load_ps(a[p].re + i), a_im0 = _mm512_load_ps(a[p].im + i);
+            __m512 b_re0 = _mm512_load_ps(b[p].re + i), b_im0 = _mm512_load_ps(b[p].im + i);
+            __m512 a_re1 = _mm512_load_ps(a[p].re + i + 16), a_im1 = _mm512_load_ps(a[p].im + i + 16);
+            __m512 b_re1 = _mm512_load_ps(b[p].re + i + 16), b_im1 = _mm512_load_ps(b[p].im + i + 16);
+            re0 = _mm512_fmadd_ps(a_re0, b_re0, re0);
+            re1 = _mm512_fmadd_ps(a_im0, b_im0, re1);
+            im0 = _mm512_fmadd_ps(a_re0, b_im0, im0);
+            im1 = _mm512_fmadd_ps(a_im0, b_re0, im1);
+            re2 = _mm512_fmadd_ps(a_re1, b_re1, re2);
+            re3 = _mm512_fmadd_ps(a_im1, b_im1, re3);
+            im2 = _mm512_fmadd_ps(a_re1, b_im1, im2);
+            im3 = _mm512_fmadd_ps(a_im1, b_re1, im3);
+        }
+
+        _mm512_store_ps(result.re + i, _mm512_sub_ps(re0, re1));
+        _mm512_store_ps(result.im + i, _mm512_add_ps(im0, im1));
+        _mm512_store_ps(result.re + i + 16, _mm512_sub_ps(re2, re3));
+        _mm512_store_ps(result.im + i + 16, _mm512_add_ps(im2, im3));
+    }
+
+    // at most one vector is left
+    if (i < padded) {
+        __m512 re0 = _mm512_setzero_ps(), re1 = _mm512_setzero_ps();
+        __m512 im0 = _mm512_setzero_ps(), im1 = _mm512_setzero_ps();
+
+        for (int p = 0; p < count; p++) {
+            __m512 a_re = _mm512_load_ps(a[p].re + i), a_im = _mm512_load_ps(a[p].im + i);
+            __m512 b_re = _mm512_load_ps(b[p].re + i), b_im = _mm512_load_ps(b[p].im + i);
+            re0 = _mm512_fmadd_ps(a_re, b_re, re0);
+            re1 = _mm512_fmadd_ps(a_im, b_im, re1);
+            im0 = _mm512_fmadd_ps(a_re, b_im, im0);
+            im1 = _mm512_fmadd_ps(a_im, b_re, im1);
+        }
+
+        _mm512_store_ps(result.re + i, _mm512_sub_ps(re0, re1));
+        _mm512_store_ps(result.im + i, _mm512_add_ps(im0, im1));
+    }
+}
+
+ #define MAC_SUM_FIXED(block_size) { block_size, { mac_sum_fixed_scalar<block_size + 1>, mac_sum_fixed_sse2<block_size + 1>, \
+                                                   mac_sum_fixed_avx2<block_size + 1>, mac_sum_fixed_avx512<block_size + 1> } }
+#else
+ #define MAC_SUM_FIXED(block_size) { block_size, { mac_sum_fixed_scalar<block_size + 1>, mac_sum_fixed_scalar<block_size + 1>, \
+                                                   mac_sum_fixed_scalar<block_size + 1>, mac_sum_fixed_scalar<block_size + 1> } }
+#endif
+
+//---------- double precision ---------------------------------------------------
+
+// kernels of the 64-bit engine, half as many values per register as the float ones
+// only the loops that run over every partition or tap have SIMD versions, the others are scalar
+
+typedef void (*mac_sum_function_d)(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins);
+typedef void (*multiply_function_d)(split_complex_d a, split_complex_d b, split_complex_d result, int bins);
+typedef void (*fir_function_d)(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count);
+typedef void (*fir_4_function_d)(const double* x, const double* taps, double* y, int count);
+
+static void mac_sum_scalar_d(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins, int first) {
+
+    for (int i = first; i < bins; i++) {
+        double re = 0.;
+        double im = 0.;
+
+        for (int p = 0; p < count; p++) {
+            re += a[p].re[i] * b[p].re[i] - a[p].im[i] * b[p].im[i];
+            im += a[p].re[i] * b[p].im[i] + a[p].im[i] * b[p].re[i];
+        }
+
+        result.re[i] = re;
+        result.im[i] = im;
+    }
+}
+
+static void mac_sum_scalar_d(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins) {
+
+    mac_sum_scalar_d(a, b, count, result, bins, 0);
+}
+
+static void multiply_split_scalar_d(split_complex_d a, split_complex_d b, split_complex_d result, int bins, int first) {
+
+    for (int i = first; i < bins; i++) {
+        double re = a.re[i] * b.re[i] - a.im[i] * b.im[i];
+        double im = a.re[i] * b.im[i] + a.im[i] * b.re[i];
+        result.re[i] = re;
+        result.im[i] = im;
+    }
+}
+
+static void multiply_split_scalar_d(split_complex_d a, split_complex_d b, split_complex_d result, int bins) {
+
+    multiply_split_scalar_d(a, b, result, bins, 0);
+}
+
+static void fir_scalar_d(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count) {
+
+    for (int i = 0; i < count; i++) {
+        double sum_left = 0.;
+        double sum_right = 0.;
+
+        for (int j = 0; j < num_taps; j++) {
+            sum_left += taps_left[j] * x[i + j];
+            sum_right += taps_right[j] * x[i + j];
+        }
+
+        left[i] = sum_left;
+        right[i] = sum_right;
+    }
+}
+
+static void fir_4_scalar_d(const double* x, const double* taps, double* y, int count) {
+
+    for (int i = 0; i < count; i++)
+        y[i] = taps[0] * x[i] + taps[1] * x[i + 1] + taps[2] * x[i + 2] + taps[3] * x[i + 3];
+}
+
+#if SPECTRAL_KERNELS_X86
+
+KERNEL_TARGET("sse2")
+static void mac_sum_sse2_d(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins) {
+
+    int i = 0;
+    for (; i + 2 <= bins; i += 2) {
+        __m128d re0 = _mm_setzero_pd(), re1 = _mm_setzero_pd();
+        __m128d im0 = _mm_setzero_pd(), im1 = _mm_setzero_pd();
+
+        for (int p = 0; p < count; p++) {
+            __m128d a_re = _mm_loadu_pd(a[p].re + i), a_im = _mm_loadu_pd(a[p].im + i);
+            __m128d b_re = _mm_loadu_pd(b[p].re + i), b_im = _mm_loadu_pd(b[p].im + i);
+            re0 = _mm_add_pd(re0, _mm_mul_pd(a_re, b_re));
+            re1 = _mm_add_pd(re1, _mm_mul_pd(a_im, b_im));
+            im0 = _mm_add_pd(im0, _mm_mul_pd(a_re, b_im));
+            im1 = _mm_add_pd(im1, _mm_mul_pd(a_im, b_re));
+        }
+
+        _mm_storeu_pd(result.re + i, _mm_sub_pd(re0, re1));
+        _mm_storeu_pd(result.im + i, _mm_add_pd(im0, im1));
+    }
+    mac_sum_scalar_d(a, b, count, result, bins, i);
+}
+
+KERNEL_TARGET("sse2")
+static void fir_sse2_d(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count) {
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128d left0 = _mm_setzero_pd(), left1 = _mm_setzero_pd();
+        __m128d right0 = _mm_setzero_pd(), right1 = _mm_setzero_pd();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m128d h_left = _mm_set1_pd(taps_left[j]);
+            __m128d h_right = _mm_set1_pd(taps_right[j]);
+            __m128d x0 = _mm_loadu_pd(x + i + j);
+            __m128d x1 = _mm_loadu_pd(x + i + j + 2);
+            left0 = _mm_add_pd(left0, _mm_mul_pd(h_left, x0));
+            left1 = _mm_add_pd(left1, _mm_mul_pd(h_left, x1));
+            right0 = _mm_add_pd(right0, _mm_mul_pd(h_right, x0));
+            right1 = _mm_add_pd(right1, _mm_mul_pd(h_right, x1));
+        }
+
+        _mm_storeu_pd(left + i, left0);
+        _mm_storeu_pd(left + i + 2, left1);
+        _mm_storeu_pd(right + i, right0);
+        _mm_storeu_pd(right + i + 2, right1);
+    }
+    fir_scalar_d(x + i, taps_left, taps_right, num_taps, left + i, right + i, count - i);
+}
+
+KERNEL_TARGET("sse2")
+static void fir_4_sse2_d(const double* x, const double* taps, double* y, int count) {
+
+    __m128d h0 = _mm_set1_pd(taps[0]), h1 = _mm_set1_pd(taps[1]), h2 = _mm_set1_pd(taps[2]), h3 = _mm_set1_pd(taps[3]);
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d sum0 = _mm_add_pd(_mm_mul_pd(h0, _mm_loadu_pd(x + i)), _mm_mul_pd(h1, _mm_loadu_pd(x + i + 1)));
+        __m128d sum1 = _mm_add_pd(_mm_mul_pd(h2, _mm_loadu_pd(x + i + 2)), _mm_mul_pd(h3, _mm_loadu_pd(x + i + 3)));
+        _mm_storeu_pd(y + i, _mm_add_pd(sum0, sum1));
+    }
+    fir_4_scalar_d(x + i, taps, y + i, count - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void mac_sum_avx2_d(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4) {
+        __m256d re0 = _mm256_setzero_pd(), re1 = _mm256_setzero_pd();
+        __m256d im0 = _mm256_setzero_pd(), im1 = _mm256_setzero_pd();
+
+        for (int p = 0; p < count; p++) {
+            __m256d a_re = _mm256_loadu_pd(a[p].re + i), a_im = _mm256_loadu_pd(a[p].im + i);
+            __m256d b_re = _mm256_loadu_pd(b[p].re + i), b_im = _mm256_loadu_pd(b[p].im + i);
+            re0 = _mm256_fmadd_pd(a_re, b_re, re0);
+            re1 = _mm256_fmadd_pd(a_im, b_im, re1);
+            im0 = _mm256_fmadd_pd(a_re, b_im, im0);
+            im1 = _mm256_fmadd_pd(a_im, b_re, im1);
+        }
+
+        _mm256_storeu_pd(result.re + i, _mm256_sub_pd(re0, re1));
+        _mm256_storeu_pd(result.im + i, _mm256_add_pd(im0, im1));
+    }
+    _mm256_zeroupper();
+    mac_sum_scalar_d(a, b, count, result, bins, i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void multiply_split_avx2_d(split_complex_d a, split_complex_d b, split_complex_d result, int bins) {
+
+    int i = 0;
+    for (; i + 4 <= bins; i += 4) {
+        __m256d a_re = _mm256_loadu_pd(a.re + i), a_im = _mm256_loadu_pd(a.im + i);
+        __m256d b_re = _mm256_loadu_pd(b.re + i), b_im = _mm256_loadu_pd(b.im + i);
+        _mm256_storeu_pd(result.re + i, _mm256_fmsub_pd(a_re, b_re, _mm256_mul_pd(a_im, b_im)));
+        _mm256_storeu_pd(result.im + i, _mm256_fmadd_pd(a_re, b_im, _mm256_mul_pd(a_im, b_re)));
+    }
+    _mm256_zeroupper();
+    multiply_split_scalar_d(a, b, result, bins, i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void fir_avx2_d(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count) {
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256d left0 = _mm256_setzero_pd(), left1 = _mm256_setzero_pd();
+        __m256d right0 = _mm256_setzero_pd(), right1 = _mm256_setzero_pd();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m256d h_left = _mm256_set1_pd(taps_left[j]);
+            __m256d h_right = _mm256_set1_pd(taps_right[j]);
+            __m256d x0 = _mm256_loadu_pd(x + i + j);
+            __m256d x1 = _mm256_loadu_pd(x + i + j + 4);
+            left0 = _mm256_fmadd_pd(h_left, x0, left0);
+            left1 = _mm256_fmadd_pd(h_left, x1, left1);
+            right0 = _mm256_fmadd_pd(h_right, x0, right0);
+            right1 = _mm256_fmadd_pd(h_right, x1, right1);
+        }
+
+        _mm256_storeu_pd(left + i, left0);
+        _mm256_storeu_pd(left + i + 4, left1);
+        _mm256_storeu_pd(right + i, right0);
+        _mm256_storeu_pd(right + i + 4, right1);
+    }
+    _mm256_zeroupper();
+    fir_scalar_d(x + i, taps_left, taps_right, num_taps, left + i, right + i, count - i);
+}
+
+KERNEL_TARGET("avx2,fma")
+static void fir_4_avx2_d(const double* x, const double* taps, double* y, int count) {
+
+    __m256d h0 = _mm256_set1_pd(taps[0]), h1 = _mm256_set1_pd(taps[1]), h2 = _mm256_set1_pd(taps[2]), h3 = _mm256_set1_pd(taps[3]);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d sum0 = _mm256_fmadd_pd(h1, _mm256_loadu_pd(x + i + 1), _mm256_mul_pd(h0, _mm256_loadu_pd(x + i)));
+        __m256d sum1 = _mm256_fmadd_pd(h3, _mm256_loadu_pd(x + i + 3), _mm256_mul_pd(h2, _mm256_loadu_pd(x + i + 2)));
+        _mm256_storeu_pd(y + i, _mm256_add_pd(sum0, sum1));
+    }
+    _mm256_zeroupper();
+    fir_4_scalar_d(x + i, taps, y + i, count - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void mac_sum_avx512_d(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins) {
+
+    int i = 0;
+    for (; i + 8 <= bins; i += 8) {
+        __m512d re0 = _mm512_setzero_pd(), re1 = _mm512_setzero_pd();
+        __m512d im0 = _mm512_setzero_pd(), im1 = _mm512_setzero_pd();
+
+        for (int p = 0; p < count; p++) {
+            __m512d a_re = _mm512_loadu_pd(a[p].re + i), a_im = _mm512_loadu_pd(a[p].im + i);
+            __m512d b_re = _mm512_loadu_pd(b[p].re + i), b_im = _mm512_loadu_pd(b[p].im + i);
+            re0 = _mm512_fmadd_pd(a_re, b_re, re0);
+            re1 = _mm512_fmadd_pd(a_im, b_im, re1);
+            im0 = _mm512_fmadd_pd(a_re, b_im, im0);
+            im1 = _mm512_fmadd_pd(a_im, b_re, im1);
+        }
+
+        _mm512_storeu_pd(result.re + i, _mm512_sub_pd(re0, re1));
+        _mm512_storeu_pd(result.im + i, _mm512_add_pd(im0, im1));
+    }
+    _mm256_zeroupper();
+    mac_sum_scalar_d(a, b, count, result, bins, i);
+}
+
+KERNEL_TARGET("avx512f")
+static void fir_avx512_d(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count) {
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512d left0 = _mm512_setzero_pd(), left1 = _mm512_setzero_pd();
+        __m512d right0 = _mm512_setzero_pd(), right1 = _mm512_setzero_pd();
+
+        for (int j = 0; j < num_taps; j++) {
+            __m512d h_left = _mm512_set1_pd(taps_left[j]);
+            __m512d h_right = _mm512_set1_pd(taps_right[j]);
+            __m512d x0 = _mm512_loadu_pd(x + i + j);
+            __m512d x1 = _mm512_loadu_pd(x + i + j + 8);
+            left0 = _mm512_fmadd_pd(h_left, x0, left0);
+            left1 = _mm512_fmadd_pd(h_left, x1, left1);
+            right0 = _mm512_fmadd_pd(h_right, x0, right0);
+            right1 = _mm512_fmadd_pd(h_right, x1, right1);
+        }
+
+        _mm512_storeu_pd(left + i, left0);
+        _mm512_storeu_pd(left + i + 8, left1);
+        _mm512_storeu_pd(right + i, right0);
+        _mm512_storeu_pd(right + i + 8, right1);
+    }
+    fir_avx2_d(x + i, taps_left, taps_right, num_taps, left + i, right + i, count - i);
+}
+
+KERNEL_TARGET("avx512f")
+static void fir_4_avx512_d(const double* x, const double* taps, double* y, int count) {
+
+    __m512d h0 = _mm512_set1_pd(taps[0]), h1 = _mm512_set1_pd(taps[1]), h2 = _mm512_set1_pd(taps[2]), h3 = _mm512_set1_pd(taps[3]);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d sum0 = _mm512_fmadd_pd(h1, _mm512_loadu_pd(x + i + 1), _mm512_mul_pd(h0, _mm512_loadu_pd(x + i)));
+        __m512d sum1 = _mm512_fmadd_pd(h3, _mm512_loadu_pd(x + i + 3), _mm512_mul_pd(h2, _mm512_loadu_pd(x + i + 2)));
+        _mm512_storeu_pd(y + i, _mm512_add_pd(sum0, sum1));
+    }
+    fir_4_avx2_d(x + i, taps, y + i, count - i);
+}
+
+static const mac_sum_function_d mac_sum_kernels_d[num_kernel_types] = {
+    mac_sum_scalar_d, mac_sum_sse2_d, mac_sum_avx2_d, mac_sum_avx512_d
+};
+
+static const multiply_function_d multiply_split_kernels_d[num_kernel_types] = {
+    multiply_split_scalar_d, multiply_split_scalar_d, multiply_split_avx2_d, multiply_split_avx2_d
+};
+
+static const fir_function_d fir_kernels_d[num_kernel_types] = {
+    fir_scalar_d, fir_sse2_d, fir_avx2_d, fir_avx512_d
+};
+
+static const fir_4_function_d fir_4_kernels_d[num_kernel_types] = {
+    fir_4_scalar_d, fir_4_sse2_d, fir_4_avx2_d, fir_4_avx512_d
+};
+
+#else
+
+static const mac_sum_function_d mac_sum_kernels_d[num_kernel_types] = {
+    mac_sum_scalar_d, mac_sum_scalar_d, mac_sum_scalar_d, mac_sum_scalar_d
+};
+
+static const multiply_function_d multiply_split_kernels_d[num_kernel_types] = {
+    multiply_split_scalar_d, multiply_split_scalar_d, multiply_split_scalar_d, multiply_split_scalar_d
+};
+
+static const fir_function_d fir_kernels_d[num_kernel_types] = {
+    fir_scalar_d, fir_scalar_d, fir_scalar_d, fir_scalar_d
+};
+
+static const fir_4_function_d fir_4_kernels_d[num_kernel_types] = {
+    fir_4_scalar_d, fir_4_scalar_d, fir_4_scalar_d, fir_4_scalar_d
+};
+
+#endif
+
+//---------- dispatch -----------------------------------------------------------
+
+static const kernel_function mac_kernels[num_kernel_types] = {
+    mac_scalar,
+#if SPECTRAL_KERNELS_X86
+    mac_sse2, mac_avx2, mac_avx512
+#else
+    mac_scalar, mac_scalar, mac_scalar
+#endif
+};
+
+static const kernel_function multiply_kernels[num_kernel_types] = {
+    multiply_scalar,
+#if SPECTRAL_KERNELS_X86
+    multiply_sse2, multiply_avx2, multiply_avx512
+#else
+    multiply_scalar, multiply_scalar, multiply_scalar
+#endif
+};
+
+static const split_function mac_split_kernels[num_kernel_types] = {
+    mac_split_scalar,
+#if SPECTRAL_KERNELS_X86
+    mac_split_sse2, mac_split_avx2, mac_split_avx512
+#else
+    mac_split_scalar, mac_split_scalar, mac_split_scalar
+#endif
+};
+
+static const split_function multiply_split_kernels[num_kernel_types] = {
+    multiply_split_scalar,
+#if SPECTRAL_KERNELS_X86
+    multiply_split_sse2, multiply_split_avx2, multiply_split_avx512
+#else
+    multiply_split_scalar, multiply_split_scalar, multiply_split_scalar
+#endif
+};
+
+static const mac_sum_function mac_sum_kernels[num_kernel_types] = {
+    mac_sum_scalar,
+#if SPECTRAL_KERNELS_X86
+    mac_sum_sse2, mac_sum_avx2, mac_sum_avx512
+#else
+    mac_sum_scalar, mac_sum_scalar, mac_sum_scalar
+#endif
+};
+
+static const struct {
+    int block_size;
+    mac_sum_function kernels[num_kernel_types];
+} mac_sum_fixed_kernels[] = {
+    MAC_SUM_FIXED(32), MAC_SUM_FIXED(64), MAC_SUM_FIXED(128), MAC_SUM_FIXED(256), MAC_SUM_FIXED(512), MAC_SUM_FIXED(1024)
+};
+
+static const fir_function fir_kernels[num_kernel_types] = {
+    fir_scalar,
+#if SPECTRAL_KERNELS_X86
+    fir_sse2, fir_avx2, fir_avx512
+#else
+    fir_scalar, fir_scalar, fir_scalar
+#endif
+};
+
+static const fir_4_function fir_4_kernels[num_kernel_types] = {
+    fir_4_scalar,
+#if SPECTRAL_KERNELS_X86
+    fir_4_sse2, fir_4_avx2, fir_4_avx512
+#else
+    fir_4_scalar, fir_4_scalar, fir_4_scalar
+#endif
+};
+
+static const weighted_sum_function weighted_sum_kernels[num_kernel_types] = {
+    weighted_sum_scalar,
+#if SPECTRAL_KERNELS_X86
+    weighted_sum_sse2, weighted_sum_avx2, weighted_sum_avx512
+#else
+    weighted_sum_scalar, weighted_sum_scalar, weighted_sum_scalar
+#endif
+};
+
+int get_best_kernel() {
+
+    static const int best = [] {
+        for (int type = num_kernel_types - 1; type > kernel_scalar; type--) {
+            if (cpu_supports(type))
+                return type;
+        }
+        return (int)kernel_scalar;
+    }();
+
+    return best;
+}
+
+bool is_kernel_supported(int type) {
+
+    return type >= 0 && type < num_kernel_types && type <= get_best_kernel() && cpu_supports(type);
+}
+
+static std::atomic<int>& active_kernel() {
+
+    static std::atomic<int> type{ get_best_kernel() };
+    return type;
+}
+
+int get_kernel() {
+
+    return active_kernel().load(std::memory_order_relaxed);
+}
+
+void set_kernel(int type) {
+
+    if (is_kernel_supported(type))
+        active_kernel().store(type);
+}
+
+const char* get_kernel_name(int type) {
+
+    switch (type) {
+    case kernel_scalar: return "scalar";
+    case kernel_sse2: return "SSE2";
+    case kernel_avx2: return "AVX2/FMA";
+    case kernel_avx512: return "AVX-512";
+    default: return "unknown";
+    }
+}
+
+int get_kernel_width(int type) {
+
+    switch (type) {
+    case kernel_sse2: return 4;
+    case kernel_avx2: return 8;
+    case kernel_avx512: return 16;
+    default: return 1;
+    }
+}
+
+void complex_mac(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    mac_kernels[get_kernel()](a, b, result, bins);
+}
+
+void complex_multiply(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    multiply_kernels[get_kernel()](a, b, result, bins);
+}
+
+void complex_mac(int type, const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    mac_kernels[type](a, b, result, bins);
+}
+
+void complex_multiply(int type, const fft_complex* a, const fft_complex* b, fft_complex* result, int bins) {
+
+    multiply_kernels[type](a, b, result, bins);
+}
+
+void complex_mac(split_complex a, split_complex b, split_complex result, int bins) {
+
+    mac_split_kernels[get_kernel()](a, b, result, bins);
+}
+
+void complex_multiply(split_complex a, split_complex b, split_complex result, int bins) {
+
+    multiply_split_kernels[get_kernel()](a, b, result, bins);
+}
+
+void complex_mac(int type, split_complex a, split_complex b, split_complex result, int bins) {
+
+    mac_split_kernels[type](a, b, result, bins);
+}
+
+void complex_multiply(int type, split_complex a, split_complex b, split_complex result, int bins) {
+
+    multiply_split_kernels[type](a, b, result, bins);
+}
+
+void complex_mac_sum(const split_complex* a, const split_complex* b, int count, split_complex result, int bins) {
+
+    mac_sum_kernels[get_kernel()](a, b, count, result, bins);
+}
+
+void complex_mac_sum(int type, const split_complex* a, const split_complex* b, int count, split_complex result, int bins) {
+
+    mac_sum_kernels[type](a, b, count, result, bins);
+}
+
+mac_sum_function get_mac_sum_kernel(int type, int bins) {
+
+    for (const auto& entry : mac_sum_fixed_kernels) {
+        if (entry.block_size + 1 == bins)
+            return entry.kernels[type];
+    }
+
+    return mac_sum_kernels[type];
+}
+
+void deinterleave(const fft_complex* input, split_complex output, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        output.re[i] = input[i][REAL];
+        output.im[i] = input[i][IMAG];
+    }
+}
+
+void interleave(split_complex input, fft_complex* output, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        output[i][REAL] = input.re[i];
+        output[i][IMAG] = input.im[i];
+    }
+}
+
+void fir_pair(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count) {
+
+    fir_kernels[get_kernel()](x, taps_left, taps_right, num_taps, left, right, count);
+}
+
+void fir_4(const float* x, const float* taps, float* y, int count) {
+
+    fir_4_kernels[get_kernel()](x, taps, y, count);
+}
+
+void weighted_sum(const float* rows, int stride, const float* weights, int num_rows, float* result, int count) {
+
+    weighted_sum_kernels[get_kernel()](rows, stride, weights, num_rows, result, count);
+}
+
+void complex_multiply(const fft_complex_d* a, const fft_complex_d* b, fft_complex_d* result, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        double re = a[i][REAL] * b[i][REAL] - a[i][IMAG] * b[i][IMAG];
+        double im = a[i][REAL] * b[i][IMAG] + a[i][IMAG] * b[i][REAL];
+        result[i][REAL] = re;
+        result[i][IMAG] = im;
+    }
+}
+
+void complex_multiply(split_complex_d a, split_complex_d b, split_complex_d result, int bins) {
+
+    multiply_split_kernels_d[get_kernel()](a, b, result, bins);
+}
+
+void complex_mac_sum(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins) {
+
+    mac_sum_kernels_d[get_kernel()](a, b, count, result, bins);
+}
+
+void deinterleave(const fft_complex_d* input, split_complex_d output, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        output.re[i] = input[i][REAL];
+        output.im[i] = input[i][IMAG];
+    }
+}
+
+void interleave(split_complex_d input, fft_complex_d* output, int bins) {
+
+    for (int i = 0; i < bins; i++) {
+        output[i][REAL] = input.re[i];
+        output[i][IMAG] = input.im[i];
+    }
+}
+
+void fir_pair(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count) {
+
+    fir_kernels_d[get_kernel()](x, taps_left, taps_right, num_taps, left, right, count);
+}
+
+void fir_4(const double* x, const double* taps, double* y, int count) {
+
+    fir_4_kernels_d[get_kernel()](x, taps, y, count);
+}
+
+// the comparisons of a whole group are or-ed without branches, so the loop vectorizes; the first signal ends it
+template <typename Sample>
+static bool all_zero(const Sample* x, int count) {
+
+    const int group = 16;
+    int i = 0;
+
+    for (; i + group <= count; i += group) {
+        bool any = false;
+        for (int j = 0; j < group; j++)
+            any |= (x[i + j] != 0);
+        if (any)
+            return false;
+    }
+
+    for (; i < count; i++) {
+        if (x[i] != 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool is_silent(const float* x, int count) {
+
+    return all_zero(x, count);
+}
+
+bool is_silent(const double* x, int count) {
+
+    return all_zero(x, count);
+}
+
+// only used on the blocks where the filter changes, so the weights are not tabulated
+template <typename Sample>
+static void raised_cosine_crossfade(const Sample* from, Sample* to, int count) {
+
+    const double pi = 3.14159265358979323846;
+
+    for (int i = 0; i < count; i++) {
+        Sample w = (Sample)(0.5 - 0.5 * cos(pi * (i + 0.5) / count));
+        to[i] = from[i] + (to[i] - from[i]) * w;
+    }
+}
+
+void crossfade(const float* from, float* to, int count) {
+
+    raised_cosine_crossfade(from, to, count);
+}
+
+void crossfade(const double* from, double* to, int count) {
+
+    raised_cosine_crossfade(from, to, count);
+}
+
+void fir_pair(int type, const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count) {
+
+    fir_kernels[type](x, taps_left, taps_right, num_taps, left, right, count);
+}
+
+void weighted_sum(int type, const float* rows, int stride, const float* weights, int num_rows, float* result, int count) {
+
+    weighted_sum_kernels[type](rows, stride, weights, num_rows, result, count);
+}
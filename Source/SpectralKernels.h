@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    SpectralKernels.h
+
+    Complex multiply and multiply-accumulate over many bins, the innermost loop
+    of every FFT convolution in the plugin, and the stereo direct-form FIR.
+    The engines keep their spectra split (see split_complex), which lets every
+    vector lane hold one bin; the interleaved kernels remain for the
+    fft_complex API and for comparison. The 64-bit engine has double precision
+    versions of the kernels it needs.
+    SSE2, AVX2/FMA and AVX-512 versions are compiled into the same binary and
+    picked at runtime from CPUID, with a scalar fallback for other CPUs.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFTTypes.h"
+
+enum kernel_types {
+    kernel_scalar = 0,
+    kernel_sse2,
+    kernel_avx2,
+    kernel_avx512,
+    num_kernel_types
+};
+
+// result[i] += a[i] * b[i]
+void complex_mac(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins);
+// result[i] = a[i] * b[i], result may alias a or b
+void complex_multiply(const fft_complex* a, const fft_complex* b, fft_complex* result, int bins);
+
+// split layout versions of the above, same aliasing rules
+void complex_mac(split_complex a, split_complex b, split_complex result, int bins);
+void complex_multiply(split_complex a, split_complex b, split_complex result, int bins);
+
+// result[i] = sum_p a[p][i] * b[p][i] over count spectra pairs, kept in registers across all p,
+// so the accumulator is written once instead of being loaded and stored for every partition
+void complex_mac_sum(const split_complex* a, const split_complex* b, int count, split_complex result, int bins);
+
+// complex_mac_sum of a given kernel type, specialized at compile time for bins = block_size + 1 of the common
+// block sizes (32, 64, ... 1024), the generic one for every other size
+// the specialized kernels run over whole vectors without a tail loop, so a, b and result need the padding of
+// split_stride(bins), 64 byte alignment, and zeros in the padding of a and b (result gets zeros there)
+typedef void (*mac_sum_function)(const split_complex* a, const split_complex* b, int count, split_complex result, int bins);
+mac_sum_function get_mac_sum_kernel(int type, int bins);
+
+// conversion at the FFT boundary, the backends all produce interleaved bins
+void deinterleave(const fft_complex* input, split_complex output, int bins);
+void interleave(split_complex input, fft_complex* output, int bins);
+
+// left[i] = sum_j taps_left[j] * x[i + j] (same for right), i < count
+// the taps are stored time-reversed, x holds count + num_taps - 1 samples, oldest first
+void fir_pair(const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count);
+
+// y[i] = sum_j taps[j] * x[i + j], j < 4, i < count: the interpolation of the fractional delay lines
+// x holds count + 3 samples, y must not alias x
+void fir_4(const float* x, const float* taps, float* y, int count);
+
+// result[i] = sum_r weights[r] * rows[r * stride + i], i < count: the dot product of every column with the same
+// weights, e.g. the spherical harmonic basis of a direction, with one column per vector lane
+void weighted_sum(const float* rows, int stride, const float* weights, int num_rows, float* result, int count);
+
+// double precision versions for the 64-bit engine, same contracts as above and the same kernel selection
+void complex_multiply(const fft_complex_d* a, const fft_complex_d* b, fft_complex_d* result, int bins);
+void complex_multiply(split_complex_d a, split_complex_d b, split_complex_d result, int bins);
+void complex_mac_sum(const split_complex_d* a, const split_complex_d* b, int count, split_complex_d result, int bins);
+void deinterleave(const fft_complex_d* input, split_complex_d output, int bins);
+void interleave(split_complex_d input, fft_complex_d* output, int bins);
+void fir_pair(const double* x, const double* taps_left, const double* taps_right, int num_taps, double* left, double* right, int count);
+void fir_4(const double* x, const double* taps, double* y, int count);
+
+// true if all count samples are zero (of either sign), the convolution of such a block is exactly zero
+bool is_silent(const float* x, int count);
+bool is_silent(const double* x, int count);
+
+// to[i] = from[i] + (to[i] - from[i]) * w[i], with w a raised cosine rising from 0 to 1 over count samples
+// (the gains of both signals add up to 1), for switching filters without a click
+void crossfade(const float* from, float* to, int count);
+void crossfade(const double* from, double* to, int count);
+
+// best kernel supported by this CPU, and the one currently used by complex_mac / complex_multiply
+int get_best_kernel();
+int get_kernel();
+const char* get_kernel_name(int type);
+// floats per vector register of a kernel type
+int get_kernel_width(int type);
+bool is_kernel_supported(int type);
+
+// force a kernel (for benchmarks), unsupported types are ignored
+void set_kernel(int type);
+
+// call a specific kernel directly, type has to be supported
+void complex_mac(int type, const fft_complex* a, const fft_complex* b, fft_complex* result, int bins);
+void complex_multiply(int type, const fft_complex* a, const fft_complex* b, fft_complex* result, int bins);
+void complex_mac(int type, split_complex a, split_complex b, split_complex result, int bins);
+void complex_multiply(int type, split_complex a, split_complex b, split_complex result, int bins);
+void complex_mac_sum(int type, const split_complex* a, const split_complex* b, int count, split_complex result, int bins);
+void fir_pair(int type, const float* x, const float* taps_left, const float* taps_right, int num_taps, float* left, float* right, int count);
+void weighted_sum(int type, const float* rows, int stride, const float* weights, int num_rows, float* result, int count);
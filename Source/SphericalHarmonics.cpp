@@ -0,0 +1,211 @@
+/*
+  ==============================================================================
+
+    SphericalHarmonics.cpp
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "SphericalHarmonics.h"
+#include "FFTBackend.h"
+#include "SpectralKernels.h"
+
+static const double pi = 3.14159265358979323846;
+
+// sh_basis in double precision for the fit
+static void sh_basis_d(int order, double azimuth, double elevation, double* basis) {
+
+    double x = sin(elevation * pi / 180.);
+    double s = sqrt(fmax(0., 1. - x * x));
+    double phi = azimuth * pi / 180.;
+
+    // associated Legendre functions without the Condon-Shortley phase, P(m, m) first and then up in l
+    double p_mm = 1.;
+    for (int m = 0; m <= order; m++) {
+
+        if (m > 0)
+            p_mm *= (2 * m - 1) * s;
+
+        double p_prev = 0.;
+        double p = p_mm;
+
+        for (int l = m; l <= order; l++) {
+
+            if (l == m + 1) {
+                p_prev = p;
+                p = x * (2 * m + 1) * p_mm;
+            }
+            else if (l > m + 1) {
+                double next = ((2 * l - 1) * x * p - (l + m - 1) * p_prev) / (l - m);
+                p_prev = p;
+                p = next;
+            }
+
+            // sqrt((2l + 1) / 4pi * (l - m)! / (l + m)!), times sqrt(2) for the cos / sin pairs
+            double factorial_ratio = 1.;
+            for (int k = l - m + 1; k <= l + m; k++)
+                factorial_ratio /= k;
+            double norm = sqrt((2 * l + 1) / (4 * pi) * factorial_ratio);
+
+            if (m == 0) {
+                basis[l * l + l] = norm * p;
+            }
+            else {
+                basis[l * l + l + m] = sqrt(2.) * norm * p * cos(m * phi);
+                basis[l * l + l - m] = sqrt(2.) * norm * p * sin(m * phi);
+            }
+        }
+    }
+}
+
+void sh_basis(int order, float azimuth, float elevation, float* basis) {
+
+    // order is small, the double scratch fits on the stack up to order 31
+    double values[1024];
+    int count = sh_num_coefficients(order);
+    if (count > 1024)
+        return;
+
+    sh_basis_d(order, azimuth, elevation, values);
+    for (int i = 0; i < count; i++)
+        basis[i] = (float)values[i];
+}
+
+SphericalHarmonicFit::SphericalHarmonicFit() {}
+
+SphericalHarmonicFit::~SphericalHarmonicFit() {
+
+    release();
+}
+
+bool SphericalHarmonicFit::fit(const float* azimuth, const float* elevation, int num_points, const float* values, int num_values,
+                               int order, float regularization) {
+
+    release();
+
+    if (order < 0 || order > 31 || num_points <= 0 || num_values <= 0)
+        return false;
+
+    int c = sh_num_coefficients(order);
+
+    // [point][coefficient] harmonics of the measured directions
+    double* y = (double*)malloc(sizeof(double) * num_points * c);
+    for (int p = 0; p < num_points; p++)
+        sh_basis_d(order, azimuth[p], elevation[p], y + (size_t)p * c);
+
+    // normal equations (Y^T Y / P + regularization * l (l + 1)) x = Y^T v / P, scaled by the number of points so the
+    // regularization means the same for small and large sets
+    double* a = (double*)calloc((size_t)c * c, sizeof(double));
+    for (int p = 0; p < num_points; p++) {
+        const double* row = y + (size_t)p * c;
+        for (int i = 0; i < c; i++)
+            for (int j = 0; j <= i; j++)
+                a[i * c + j] += row[i] * row[j] / num_points;
+    }
+    for (int l = 0; l <= order; l++)
+        for (int m = -l; m <= l; m++)
+            a[(l * l + l + m) * (c + 1)] += regularization * l * (l + 1);
+
+    // Cholesky factor in the lower triangle
+    bool solvable = true;
+    for (int j = 0; j < c && solvable; j++) {
+        double d = a[j * c + j];
+        for (int k = 0; k < j; k++)
+            d -= a[j * c + k] * a[j * c + k];
+        if (d <= 1e-12) {
+            solvable = false;
+            break;
+        }
+        a[j * c + j] = sqrt(d);
+        for (int i = j + 1; i < c; i++) {
+            double sum = a[i * c + j];
+            for (int k = 0; k < j; k++)
+                sum -= a[i * c + k] * a[j * c + k];
+            a[i * c + j] = sum / a[j * c + j];
+        }
+    }
+
+    if (!solvable) {
+        free(y);
+        free(a);
+        return false;
+    }
+
+    // the weights of each measured direction in each coefficient, (A^-1 Y^T / P)[coefficient][point]
+    double* projection = (double*)malloc(sizeof(double) * c * num_points);
+    double* column = (double*)malloc(sizeof(double) * c);
+    for (int p = 0; p < num_points; p++) {
+        for (int i = 0; i < c; i++) {
+            double sum = y[(size_t)p * c + i] / num_points;
+            for (int k = 0; k < i; k++)
+                sum -= a[i * c + k] * column[k];
+            column[i] = sum / a[i * c + i];
+        }
+        for (int i = c - 1; i >= 0; i--) {
+            double sum = column[i];
+            for (int k = i + 1; k < c; k++)
+                sum -= a[k * c + i] * column[k];
+            column[i] = sum / a[i * c + i];
+        }
+        for (int i = 0; i < c; i++)
+            projection[(size_t)i * num_points + p] = column[i];
+    }
+
+    this->order = order;
+    this->num_values = num_values;
+    num_coefficients = c;
+    stride = split_stride(num_values);
+    coefficients = fft_alloc<float>((size_t)c * stride);
+    basis = (float*)malloc(sizeof(float) * c);
+    memset(coefficients, 0, sizeof(float) * c * stride);
+
+    double* sum = (double*)malloc(sizeof(double) * num_values);
+    for (int i = 0; i < c; i++) {
+        memset(sum, 0, sizeof(double) * num_values);
+        for (int p = 0; p < num_points; p++) {
+            double w = projection[(size_t)i * num_points + p];
+            const float* v = values + (size_t)p * num_values;
+            for (int j = 0; j < num_values; j++)
+                sum[j] += w * v[j];
+        }
+        for (int j = 0; j < num_values; j++)
+            coefficients[(size_t)i * stride + j] = (float)sum[j];
+    }
+
+    free(sum);
+    free(column);
+    free(projection);
+    free(a);
+    free(y);
+
+    return true;
+}
+
+void SphericalHarmonicFit::release() {
+
+    fft_free(coefficients);
+    free(basis);
+    coefficients = NULL;
+    basis = NULL;
+    order = -1;
+    num_coefficients = 0;
+    num_values = 0;
+    stride = 0;
+}
+
+void SphericalHarmonicFit::evaluate(float azimuth, float elevation, float* values) {
+
+    if (coefficients == NULL)
+        return;
+
+    sh_basis(order, azimuth, elevation, basis);
+    weighted_sum(coefficients, stride, basis, num_coefficients, values, num_values);
+}
+
+size_t SphericalHarmonicFit::get_memory() const {
+
+    return sizeof(float) * (size_t)num_coefficients * stride;
+}
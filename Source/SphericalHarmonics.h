@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    SphericalHarmonics.h
+
+    Least squares fit of values measured over a set of directions (e.g. the
+    magnitude and phase of every bin of an HRTF set) to real spherical
+    harmonics up to some order. Instead of a table with a row per measured
+    direction, the fit keeps (order + 1)^2 coefficients per value, and the
+    values of any direction are a dot product of the coefficients with the
+    harmonics of that direction, done for all values at once by
+    weighted_sum(). Higher orders follow the measurements more closely and
+    cost more memory and time; the fit is regularized towards smooth
+    (low order) solutions, so gaps in the set do not blow up.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstddef>
+
+// number of harmonics up to order
+inline int sh_num_coefficients(int order) { return (order + 1) * (order + 1); }
+
+// real orthonormal spherical harmonics up to order of a direction in degrees, in ACN order (index l * l + l + m)
+void sh_basis(int order, float azimuth, float elevation, float* basis);
+
+class SphericalHarmonicFit
+{
+public:
+    SphericalHarmonicFit();
+    ~SphericalHarmonicFit();
+
+    // fit num_values values per direction, values[point * num_values + value], with harmonics up to order
+    // regularization weights the energy of each harmonic by l * (l + 1), 0 is plain least squares
+    // returns false if the normal equations cannot be solved (e.g. too few directions without regularization)
+    bool fit(const float* azimuth, const float* elevation, int num_points, const float* values, int num_values,
+             int order, float regularization);
+    void release();
+
+    // the num_values values of a direction, uses the basis scratch, so one thread at a time
+    void evaluate(float azimuth, float elevation, float* values);
+
+    bool is_fitted() const { return coefficients != NULL; }
+    int get_order() const { return order; }
+    int get_num_coefficients() const { return num_coefficients; }
+    int get_num_values() const { return num_values; }
+    // bytes of the coefficients
+    size_t get_memory() const;
+
+private:
+    // [coefficient][stride], stride = split_stride(num_values) with zeros in the padding
+    float* coefficients = NULL;
+    float* basis = NULL;
+    int order = -1;
+    int num_coefficients = 0;
+    int num_values = 0;
+    int stride = 0;
+};
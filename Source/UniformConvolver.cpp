@@ -0,0 +1,472 @@
+/*
+  ==============================================================================
+
+    UniformConvolver.cpp
+
+  ==============================================================================
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "UniformConvolver.h"
+#include "SpectralKernels.h"
+
+// MAC kernel of the current kernel type specialized for bins, false for double precision, which has no fixed-size
+// kernels, so the 64-bit engine keeps the generic process()
+static bool select_mac_sum(mac_sum_function& kernel, int bins) {
+
+    kernel = get_mac_sum_kernel(get_kernel(), bins);
+    return kernel != NULL;
+}
+
+static bool select_mac_sum(void (*&kernel)(const split_complex_d*, const split_complex_d*, int, split_complex_d, int), int) {
+
+    kernel = NULL;
+    return false;
+}
+
+template <typename Sample>
+UniformConvolverT<Sample>::UniformConvolverT(FFTPlanCache& plans) : fft_plans(plans) {
+}
+
+template <typename Sample>
+UniformConvolverT<Sample>::~UniformConvolverT() {
+
+    release();
+}
+
+template <typename Sample>
+bool UniformConvolverT<Sample>::prepare(int new_block_size, int new_num_filters, int ir_length) {
+
+    release();
+
+    if (new_block_size <= 0 || new_num_filters <= 0 || ir_length <= 0)
+        return false;
+
+    block_size = new_block_size;
+    fft_size = 2 * block_size;
+    // FFTW gives N/2+1 complex values as a result of a N-sized real-valued FFT
+    num_bins = fft_size / 2 + 1;
+    stride = split_stride(num_bins);
+    num_partitions = (ir_length + block_size - 1) / block_size;
+    num_filters = new_num_filters;
+
+    size_t filter_values = (size_t)num_filters * 2 * num_partitions * 2 * stride;
+    filters = fft_alloc<Sample>(filter_values);
+    memset(filters, 0, sizeof(Sample) * filter_values);
+
+    fdl = fft_alloc<Sample>(num_partitions * 2 * stride);
+    accumulators = fft_alloc<Sample>(4 * stride);
+    accumulator_left = { accumulators, accumulators + stride };
+    accumulator_right = { accumulators + 2 * stride, accumulators + 3 * stride };
+    slot_active = (bool*)malloc(sizeof(bool) * num_partitions);
+    active_partitions = (int*)malloc(sizeof(int) * num_partitions);
+    input_order = (spectrum_type*)malloc(sizeof(spectrum_type) * num_partitions);
+    filter_order = (spectrum_type*)malloc(sizeof(spectrum_type) * num_partitions);
+    spectrum = fft_alloc<fft_bin<Sample>>(num_bins);
+    packed = fft_alloc<fft_bin<Sample>>(fft_size);
+    packed_result = fft_alloc<fft_bin<Sample>>(fft_size);
+    // 2 extra values allow an in-place r2c transform on this buffer
+    input_buffer = fft_alloc<Sample>(fft_size + 2);
+    output_buffer = fft_alloc<Sample>(fft_size + 2);
+
+    if (!fft_plans.prepare_for<Sample>(fft_size)) {
+        release();
+        return false;
+    }
+
+    select_process();
+    reset();
+
+    return true;
+}
+
+template <typename Sample>
+bool UniformConvolverT<Sample>::prepare_plans(FFTPlanCache& plans) const {
+
+    return fft_size > 0 && plans.prepare_for<Sample>(fft_size);
+}
+
+template <typename Sample>
+typename UniformConvolverT<Sample>::spectrum_type UniformConvolverT<Sample>::get_filter(int index, int ear, int p) const {
+
+    Sample* re = filters + (((size_t)index * 2 + ear) * num_partitions + p) * 2 * stride;
+    return { re, re + stride };
+}
+
+template <typename Sample>
+typename UniformConvolverT<Sample>::spectrum_type UniformConvolverT<Sample>::get_fdl_slot(int slot) const {
+
+    Sample* re = fdl + (size_t)slot * 2 * stride;
+    return { re, re + stride };
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::set_filter(int index, const float* left, const float* right, int length) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    load_filter(index, left, right, length, fft_plans);
+    reset();
+}
+
+template <typename Sample>
+bool UniformConvolverT<Sample>::load_filter(int index, const float* left, const float* right, int length, FFTPlanCache& plans) {
+
+    if (index < 0 || index >= num_filters)
+        return false;
+
+    // only prepare() has set up fft_size on the convolver's own plans
+    if (!prepare_plans(plans))
+        return false;
+
+    Sample* buffer = fft_alloc<Sample>(fft_size + 2);
+    fft_bin<Sample>* bins = fft_alloc<fft_bin<Sample>>(num_bins);
+
+    for (int p = 0; p < num_partitions; p++) {
+
+        int offset = p * block_size;
+        int count = (length - offset < block_size) ? length - offset : block_size;
+        if (count < 0)
+            count = 0;
+
+        // the 1/N scaling of the inverse FFT is folded into the filter, so process() needs no normalize pass
+        Sample scale = (Sample)1 / fft_size;
+
+        for (int i = 0; i < count; i++)
+            buffer[i] = left[offset + i] * scale;
+        memset(buffer + count, 0, sizeof(Sample) * (fft_size - count));
+        plans.perform_fft(fft_size, buffer, bins, get_filter(index, 0, p));
+
+        for (int i = 0; i < count; i++)
+            buffer[i] = right[offset + i] * scale;
+        memset(buffer + count, 0, sizeof(Sample) * (fft_size - count));
+        plans.perform_fft(fft_size, buffer, bins, get_filter(index, 1, p));
+    }
+
+    fft_free(buffer);
+    fft_free(bins);
+
+    return true;
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::save_filter(int index, Sample* values) const {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    // the partitions of both ears follow each other, see get_filter()
+    memcpy(values, get_filter(index, 0, 0).re, sizeof(Sample) * get_filter_values());
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::restore_filter(int index, const Sample* values) {
+
+    if (index < 0 || index >= num_filters)
+        return;
+
+    memcpy(get_filter(index, 0, 0).re, values, sizeof(Sample) * get_filter_values());
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::reset() {
+
+    if (fdl == NULL)
+        return;
+
+    memset(fdl, 0, sizeof(Sample) * num_partitions * 2 * stride);
+    memset(input_buffer, 0, sizeof(Sample) * (fft_size + 2));
+    fdl_head = 0;
+
+    // cleared slots are the spectra of silence
+    memset(slot_active, 0, sizeof(bool) * num_partitions);
+    previous_silent = true;
+    current_sel = -1;
+}
+
+template <typename Sample>
+int UniformConvolverT<Sample>::get_num_active_partitions() const {
+
+    int count = 0;
+    for (int i = 0; i < num_partitions; i++)
+        count += slot_active[i] ? 1 : 0;
+
+    return count;
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::transform_window(bool silent, int size) {
+
+    // newest input spectrum goes to the head of the FDL, the oldest one gets overwritten
+    fdl_head = (fdl_head == 0) ? num_partitions - 1 : fdl_head - 1;
+
+    // the FFT of an all-zero window is zero, the slot is cleared once and marked instead
+    if (!silent || !previous_silent) {
+        fft_plans.perform_fft(size, input_buffer, spectrum, get_fdl_slot(fdl_head));
+        slot_active[fdl_head] = true;
+    }
+    else if (slot_active[fdl_head]) {
+        memset(fdl + (size_t)fdl_head * 2 * stride, 0, sizeof(Sample) * 2 * stride);
+        slot_active[fdl_head] = false;
+    }
+
+    previous_silent = silent;
+}
+
+template <typename Sample>
+int UniformConvolverT<Sample>::gather_active_slots() {
+
+    // partition p of the filter meets the input spectrum from p blocks ago, silent ones contribute exact zeros
+    int count = 0;
+    for (int p = 0; p < num_partitions; p++) {
+        int slot = fdl_head + p;
+        if (slot >= num_partitions)
+            slot -= num_partitions;
+        if (!slot_active[slot] && skip_silence)
+            continue;
+        input_order[count] = get_fdl_slot(slot);
+        active_partitions[count++] = p;
+    }
+
+    return count;
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::process(const Sample* input, Sample* left, Sample* right, int sel) {
+
+    if (fdl == NULL || sel < 0 || sel >= num_filters)
+        return;
+
+    // the steady state keeps the specialized functions, only the switching block takes the generic transition
+    if (crossfade && current_sel >= 0 && current_sel != sel && current_sel < num_filters)
+        process_transition(input, left, right, sel);
+    else
+        (this->*(right != NULL ? process_stereo : process_mono))(input, left, right, sel);
+
+    current_sel = sel;
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::process_transition(const Sample* input, Sample* left, Sample* right, int sel) {
+
+    bool silent = skip_silence && is_silent(input, block_size);
+
+    memmove(input_buffer, input_buffer + block_size, sizeof(Sample) * block_size);
+    memcpy(input_buffer + block_size, input, sizeof(Sample) * block_size);
+
+    transform_window(silent, fft_size);
+
+    int count = gather_active_slots();
+    if (count == 0) {
+        memset(left, 0, sizeof(Sample) * block_size);
+        if (right != NULL)
+            memset(right, 0, sizeof(Sample) * block_size);
+        return;
+    }
+
+    // the old filter's output of both ears goes to output_buffer (left half, right half)
+    if (packed_ifft && right != NULL) {
+        multiply_accumulate(current_sel, 0, count, accumulator_left);
+        multiply_accumulate(current_sel, 1, count, accumulator_right);
+        fft_plans.perform_ifft_pair(fft_size, accumulator_left, accumulator_right, packed, packed_result,
+                                    output_buffer, output_buffer + block_size, block_size, block_size, (Sample)1);
+
+        multiply_accumulate(sel, 0, count, accumulator_left);
+        multiply_accumulate(sel, 1, count, accumulator_right);
+        fft_plans.perform_ifft_pair(fft_size, accumulator_left, accumulator_right, packed, packed_result,
+                                    left, right, block_size, block_size, (Sample)1);
+
+        ::crossfade(output_buffer, left, block_size);
+        ::crossfade(output_buffer + block_size, right, block_size);
+        return;
+    }
+
+    Sample* outputs[2] = { left, right };
+
+    for (int ear = 0; ear < (right != NULL ? 2 : 1); ear++) {
+        multiply_accumulate(sel, ear, count, accumulator_left);
+        fft_plans.perform_ifft(fft_size, accumulator_left, spectrum, output_buffer);
+        memcpy(outputs[ear], output_buffer + block_size, sizeof(Sample) * block_size);
+
+        multiply_accumulate(current_sel, ear, count, accumulator_left);
+        fft_plans.perform_ifft(fft_size, accumulator_left, spectrum, output_buffer);
+        ::crossfade(output_buffer + block_size, outputs[ear], block_size);
+    }
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::process_generic(const Sample* input, Sample* left, Sample* right, int sel) {
+
+    bool silent = skip_silence && is_silent(input, block_size);
+
+    // slide the overlap-save window by one block and append the new input
+    memmove(input_buffer, input_buffer + block_size, sizeof(Sample) * block_size);
+    memcpy(input_buffer + block_size, input, sizeof(Sample) * block_size);
+
+    transform_window(silent, fft_size);
+
+    // the whole FDL is silent, so is the output
+    int count = gather_active_slots();
+    if (count == 0) {
+        memset(left, 0, sizeof(Sample) * block_size);
+        if (right != NULL)
+            memset(right, 0, sizeof(Sample) * block_size);
+        return;
+    }
+
+    multiply_accumulate(sel, 0, count, accumulator_left);
+
+    if (packed_ifft && right != NULL) {
+        multiply_accumulate(sel, 1, count, accumulator_right);
+        // the last block_size samples are valid, see below
+        fft_plans.perform_ifft_pair(fft_size, accumulator_left, accumulator_right, packed, packed_result,
+                                    left, right, block_size, block_size, (Sample)1);
+        return;
+    }
+
+    // left ear
+    fft_plans.perform_ifft(fft_size, accumulator_left, spectrum, output_buffer);
+    // the first half of the inverse FFT is circular aliasing, the last block_size samples are valid
+    memcpy(left, output_buffer + block_size, sizeof(Sample) * block_size);
+
+    if (right == NULL)
+        return;
+
+    // right ear
+    multiply_accumulate(sel, 1, count, accumulator_right);
+    fft_plans.perform_ifft(fft_size, accumulator_right, spectrum, output_buffer);
+    memcpy(right, output_buffer + block_size, sizeof(Sample) * block_size);
+}
+
+template <typename Sample>
+template <int block, int ears>
+void UniformConvolverT<Sample>::process_fixed(const Sample* input, Sample* left, Sample* right, int sel) {
+
+    const int size = 2 * block;
+    const int bins = block + 1;
+
+    bool silent = skip_silence && is_silent(input, block);
+
+    // slide the overlap-save window, both halves are disjoint and the copies are inlined for a known length
+    memcpy(input_buffer, input_buffer + block, sizeof(Sample) * block);
+    memcpy(input_buffer + block, input, sizeof(Sample) * block);
+
+    transform_window(silent, size);
+
+    spectrum_type results[2] = { accumulator_left, accumulator_right };
+    Sample* outputs[2] = { left, right };
+
+    // the FDL order is the same for both ears
+    int count = gather_active_slots();
+    if (count == 0) {
+        for (int ear = 0; ear < ears; ear++)
+            memset(outputs[ear], 0, sizeof(Sample) * block);
+        return;
+    }
+
+    for (int ear = 0; ear < ears; ear++) {
+        for (int i = 0; i < count; i++)
+            filter_order[i] = get_filter(sel, ear, active_partitions[i]);
+        mac_sum(input_order, filter_order, count, results[ear], bins);
+    }
+
+    if (ears == 2 && packed_ifft) {
+        fft_plans.perform_ifft_pair(size, results[0], results[1], packed, packed_result, left, right, block, block, (Sample)1);
+        return;
+    }
+
+    for (int ear = 0; ear < ears; ear++) {
+        fft_plans.perform_ifft(size, results[ear], spectrum, output_buffer);
+        memcpy(outputs[ear], output_buffer + block, sizeof(Sample) * block);
+    }
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::select_process() {
+
+    static const struct {
+        int block_size;
+        process_function mono;
+        process_function stereo;
+    } specializations[] = {
+        { 32, &UniformConvolverT::process_fixed<32, 1>, &UniformConvolverT::process_fixed<32, 2> },
+        { 64, &UniformConvolverT::process_fixed<64, 1>, &UniformConvolverT::process_fixed<64, 2> },
+        { 128, &UniformConvolverT::process_fixed<128, 1>, &UniformConvolverT::process_fixed<128, 2> },
+        { 256, &UniformConvolverT::process_fixed<256, 1>, &UniformConvolverT::process_fixed<256, 2> },
+        { 512, &UniformConvolverT::process_fixed<512, 1>, &UniformConvolverT::process_fixed<512, 2> },
+        { 1024, &UniformConvolverT::process_fixed<1024, 1>, &UniformConvolverT::process_fixed<1024, 2> }
+    };
+
+    process_mono = &UniformConvolverT::process_generic;
+    process_stereo = &UniformConvolverT::process_generic;
+
+    if (!specialized || !select_mac_sum(mac_sum, num_bins))
+        return;
+
+    for (const auto& entry : specializations) {
+        if (entry.block_size == block_size) {
+            process_mono = entry.mono;
+            process_stereo = entry.stereo;
+        }
+    }
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::multiply_accumulate(int sel, int ear, int count, spectrum_type result) {
+
+    // input_order holds the count active slots from gather_active_slots()
+    for (int i = 0; i < count; i++)
+        filter_order[i] = get_filter(sel, ear, active_partitions[i]);
+
+    // each group of bins is summed over all partitions in registers
+    complex_mac_sum(input_order, filter_order, count, result, num_bins);
+}
+
+template <typename Sample>
+void UniformConvolverT<Sample>::release() {
+
+    fft_free(filters);
+    fft_free(fdl);
+    fft_free(accumulators);
+    free(slot_active);
+    free(active_partitions);
+    free(input_order);
+    free(filter_order);
+    fft_free(spectrum);
+    fft_free(packed);
+    fft_free(packed_result);
+    fft_free(input_buffer);
+    fft_free(output_buffer);
+
+    filters = NULL;
+    fdl = NULL;
+    accumulators = NULL;
+    accumulator_left = {};
+    accumulator_right = {};
+    slot_active = NULL;
+    active_partitions = NULL;
+    input_order = NULL;
+    filter_order = NULL;
+    spectrum = NULL;
+    packed = NULL;
+    packed_result = NULL;
+    input_buffer = NULL;
+    output_buffer = NULL;
+
+    block_size = 0;
+    fft_size = 0;
+    num_bins = 0;
+    stride = 0;
+    num_partitions = 0;
+    num_filters = 0;
+    fdl_head = 0;
+
+    process_mono = &UniformConvolverT::process_generic;
+    process_stereo = &UniformConvolverT::process_generic;
+    current_sel = -1;
+}
+
+template class UniformConvolverT<float>;
+template class UniformConvolverT<double>;
@@ -0,0 +1,163 @@
+/*
+  ==============================================================================
+
+    UniformConvolver.h
+
+    Uniformly partitioned overlap-save convolution (UPOLS).
+    Every HRIR is split into partitions of block_size samples, which are
+    transformed with a FFT of size 2 * block_size. The spectra of the last
+    num_partitions input blocks are kept in a frequency-domain delay line (FDL),
+    so every output block costs one forward FFT, a spectral multiply-accumulate
+    and one inverse FFT per ear, independent of the HRIR length.
+    Silent input is tracked per FDL slot: a window of two silent blocks has
+    an all-zero spectrum, so its FFT is skipped and the slot is left out of
+    the multiply-accumulate, and once every slot is silent the inverse FFTs
+    are skipped too. Leaving out zero products does not change the sums, so
+    the output stays bit-exact when the signal returns.
+    On a block where sel changes, the FDL is multiplied with the partitions
+    of both filters and the two outputs are crossfaded, which costs one more
+    MAC and inverse FFT per ear on that block only.
+    The common block sizes (32 ... 1024) run through versions of process()
+    specialized at compile time for block size and number of ears, which are
+    picked from a table in prepare() together with the MAC kernel for the
+    size; all other sizes and double precision use the generic one.
+    Sample is float or double (64-bit engine, double precision FFTs), the
+    HRIRs are always float.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "FFTBackend.h"
+#include "FFTPlanCache.h"
+
+template <typename Sample>
+class UniformConvolverT
+{
+public:
+    typedef split_spectrum<Sample> spectrum_type;
+
+    UniformConvolverT(FFTPlanCache& plans);
+    ~UniformConvolverT();
+
+    // allocate filter storage for num_filters stereo HRIRs of up to ir_length samples and the FDL
+    // must not be called while process() is running, false (and released) if the FFT size could not be prepared
+    bool prepare(int block_size, int num_filters, int ir_length);
+
+    // partition and transform one stereo HRIR, length may be shorter than the ir_length given to prepare()
+    void set_filter(int index, const float* left, const float* right, int length);
+    // same without the reset, for a filter process() does not use at the moment, on any thread:
+    // only the partitions of index are written, the transforms use plans (prepared for the size here) and their own scratch
+    // false if plans could not be prepared, nothing is written then
+    bool load_filter(int index, const float* left, const float* right, int length, FFTPlanCache& plans);
+    // set up the FFT size of the partitions on plans, for callers that must not write anything unless it succeeds
+    bool prepare_plans(FFTPlanCache& plans) const;
+    // values of one filter as process() reads them, to keep a loaded filter and put it back later (see HrtfCache)
+    int get_filter_values() const { return (filters != NULL) ? 4 * num_partitions * stride : 0; }
+    void save_filter(int index, Sample* values) const;
+    // same rules as load_filter(), values saved from a convolver prepared the same way
+    void restore_filter(int index, const Sample* values);
+
+    // clear FDL and input history
+    void reset();
+
+    // convolve exactly block_size input samples with filter sel, input may alias one of the outputs
+    // right may be NULL, only the left ear is rendered then
+    void process(const Sample* input, Sample* left, Sample* right, int sel);
+
+    void release();
+
+    int get_block_size() const { return block_size; }
+    int get_num_partitions() const { return num_partitions; }
+    int get_num_filters() const { return num_filters; }
+
+    // synthesize both ears with one complex inverse FFT instead of two real ones
+    bool packed_ifft = false;
+
+    // use the specialized process functions where there are some for the block size (float only), applied in prepare()
+    bool specialized = true;
+
+    // skip the FFTs and MACs of silent input (see above)
+    bool skip_silence = true;
+
+    // crossfade from the previous filter on the block where sel changes, otherwise the switch is abrupt
+    bool crossfade = true;
+    // continue with filter sel without a crossfade, e.g. after silence
+    void set_current_filter(int sel) { current_sel = sel; }
+    // the next change of sel fades from filter index, so it must not be loaded again before that
+    bool uses_filter(int index) const { return current_sel == index; }
+    // FDL slots that hold the spectrum of a non-silent window
+    int get_num_active_partitions() const;
+    bool is_specialized() const { return process_stereo != &UniformConvolverT::process_generic; }
+
+private:
+    typedef void (UniformConvolverT::*process_function)(const Sample* input, Sample* left, Sample* right, int sel);
+    typedef void (*mac_sum_kernel)(const spectrum_type* a, const spectrum_type* b, int count, spectrum_type result, int bins);
+
+    // set process_mono / process_stereo and mac_sum for block_size
+    void select_process();
+    // runtime block size, checks for right == NULL
+    void process_generic(const Sample* input, Sample* left, Sample* right, int sel);
+    // block size and number of ears are compile-time constants, ears == 1 only renders the left ear
+    template <int block, int ears>
+    void process_fixed(const Sample* input, Sample* left, Sample* right, int sel);
+    // block where the filter changes from current_sel to sel, runs for every block size
+    void process_transition(const Sample* input, Sample* left, Sample* right, int sel);
+
+    // partition p of one ear (0 = left, 1 = right) of filter index
+    spectrum_type get_filter(int index, int ear, int p) const;
+    spectrum_type get_fdl_slot(int slot) const;
+    // transform the overlap-save window into the new FDL head, unless it is silent (silent: the newest block is)
+    void transform_window(bool silent, int size);
+    // collect the active FDL slots into input_order and their partition numbers into active_partitions, returns the count
+    int gather_active_slots();
+    void multiply_accumulate(int sel, int ear, int count, spectrum_type result);
+
+    FFTPlanCache& fft_plans;
+
+    process_function process_mono = &UniformConvolverT::process_generic;
+    process_function process_stereo = &UniformConvolverT::process_generic;
+    // complex_mac_sum specialized for block_size + 1 bins with the kernel type of prepare(), used by process_fixed()
+    mac_sum_kernel mac_sum = NULL;
+
+    int block_size = 0;
+    int fft_size = 0;
+    int num_bins = 0;
+    // values per real / imaginary part of a spectrum, see split_stride()
+    int stride = 0;
+    int num_partitions = 0;
+    int num_filters = 0;
+
+    // all filter spectra in one block, [filter][ear][partition][re | im]
+    Sample* filters = NULL;
+
+    // frequency-domain delay line, [partition][re | im], fdl_head marks the newest input spectrum
+    Sample* fdl = NULL;
+    int fdl_head = 0;
+
+    // last two input blocks (overlap-save window)
+    Sample* input_buffer = NULL;
+    // per FDL slot: false if the slot holds the (all-zero) spectrum of a silent window
+    bool* slot_active = NULL;
+    // the newest block in input_buffer was silent
+    bool previous_silent = true;
+    int* active_partitions = NULL;
+    // filter of the last block, -1 after reset
+    int current_sel = -1;
+    // spectral accumulators of both ears, [ear][re | im]
+    Sample* accumulators = NULL;
+    spectrum_type accumulator_left = {};
+    spectrum_type accumulator_right = {};
+    // FDL slots and filter partitions in the order they meet in multiply_accumulate(), num_partitions each
+    spectrum_type* input_order = NULL;
+    spectrum_type* filter_order = NULL;
+    // interleaved bins at the FFT boundary, and time-domain result of the inverse FFT
+    fft_bin<Sample>* spectrum = NULL;
+    Sample* output_buffer = NULL;
+    // fft_size bins each, used when packed_ifft is set
+    fft_bin<Sample>* packed = NULL;
+    fft_bin<Sample>* packed_result = NULL;
+};
+
+typedef UniformConvolverT<float> UniformConvolver;
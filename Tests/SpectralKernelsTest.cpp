@@ -0,0 +1,369 @@
+/*
+  ==============================================================================
+
+    SpectralKernelsTest.cpp
+
+    Every SIMD kernel this CPU supports against the scalar one, and the
+    runtime dispatch between them. Needs no JUCE and no FFT library, so it
+    runs headless, e.g. on x86-64 Linux:
+
+        c++ -std=c++17 -O2 -I../Source SpectralKernelsTest.cpp \
+            ../Source/SpectralKernels.cpp ../Source/FFTTypes.cpp -o spectral_kernels_test
+        ./spectral_kernels_test
+
+    Prints one line per failed check and exits with the number of failures.
+    The timing of the kernels is in benchmark_complex_mac().
+
+  ==============================================================================
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "SpectralKernels.h"
+
+// relative error of float results that are only summed in another order or with fused multiply-adds
+static const double float_tolerance = 1e-5;
+// same for double precision
+static const double double_tolerance = 1e-12;
+
+static int failed_checks = 0;
+
+static void check(bool passed, const char* what, const char* kernel) {
+
+    if (!passed) {
+        failed_checks++;
+        printf("check failed: %s, %s kernel\n", what, kernel);
+    }
+}
+
+// largest difference of results to their reference values, checked relative to the largest reference value
+struct max_error {
+
+    void add(double value, double reference) {
+
+        error = std::fmax(error, std::fabs(value - reference));
+        magnitude = std::fmax(magnitude, std::fabs(reference));
+    }
+
+    bool within(double tolerance) const { return error <= tolerance * magnitude; }
+
+    double error = 0.;
+    double magnitude = 0.;
+};
+
+// the same values in every run, uniform in [-0.5, 0.5)
+static unsigned random_state = 1234;
+
+static double next_random() {
+
+    random_state = random_state * 1664525u + 1013904223u;
+    return (random_state >> 8) / 16777216. - 0.5;
+}
+
+template <typename Sample>
+static void fill_random(Sample* data, int count) {
+
+    for (int i = 0; i < count; i++)
+        data[i] = (Sample)next_random();
+}
+
+static const int max_bins = 4097;
+static const int partitions = 16;
+static const int test_bins[] = { 1, 2, 3, 5, 7, 8, 9, 15, 17, 65, 257, 1025, 4097 };
+// bins = block_size + 1 of the block sizes with fixed-size MAC kernels, see get_mac_sum_kernel()
+static const int fixed_bins[] = { 33, 65, 129, 257, 513, 1025 };
+// filter lengths of the direct-form FIR, short and long
+static const int max_taps = 128;
+static const int test_taps[] = { 1, 7, max_taps };
+
+// split spectra of max_bins per partition, zero padded to split_stride() like the engines keep them
+template <typename Sample>
+struct split_buffer {
+
+    split_buffer(int count) : stride(split_stride(max_bins)), count(count) {
+
+        data = fft_alloc<Sample>((size_t)2 * stride * count);
+        memset(data, 0, sizeof(Sample) * 2 * stride * count);
+    }
+
+    ~split_buffer() { fft_free(data); }
+
+    split_spectrum<Sample> at(int p) const { return { data + 2 * p * stride, data + (2 * p + 1) * stride }; }
+
+    // random values in the first bins of every partition, zeros in the padding
+    void fill(int bins) {
+
+        memset(data, 0, sizeof(Sample) * 2 * stride * count);
+        for (int p = 0; p < count; p++) {
+            fill_random(at(p).re, bins);
+            fill_random(at(p).im, bins);
+        }
+    }
+
+    Sample* data;
+    int stride;
+    int count;
+};
+
+static void test_kernel(int type) {
+
+    const char* name = get_kernel_name(type);
+
+    fft_complex* a = fft_alloc_complex(max_bins * partitions);
+    fft_complex* b = fft_alloc_complex(max_bins * partitions);
+    fft_complex* ref = fft_alloc_complex(max_bins);
+    fft_complex* out = fft_alloc_complex(max_bins);
+    fill_random((float*)a, 2 * max_bins * partitions);
+    fill_random((float*)b, 2 * max_bins * partitions);
+
+    split_buffer<float> split_a(partitions), split_b(partitions), split_out(1);
+    split_complex inputs[partitions], filters[partitions];
+    for (int p = 0; p < partitions; p++) {
+        inputs[p] = split_a.at(p);
+        filters[p] = split_b.at(p);
+    }
+
+    max_error mac_error, multiply_error, split_mac_error, split_multiply_error, sum_error, fixed_error, fir_error, weighted_error;
+
+    for (int bins : test_bins) {
+
+        // start from the same non-zero accumulator, so the "+=" is checked too
+        fill_random((float*)ref, 2 * bins);
+        memcpy(out, ref, sizeof(fft_complex) * bins);
+        complex_mac(kernel_scalar, a, b, ref, bins);
+        complex_mac(type, a, b, out, bins);
+        for (int i = 0; i < bins; i++) {
+            mac_error.add(out[i][0], ref[i][0]);
+            mac_error.add(out[i][1], ref[i][1]);
+        }
+
+        // in-place: the result overwrites the first operand
+        complex_multiply(kernel_scalar, a, b, ref, bins);
+        memcpy(out, a, sizeof(fft_complex) * bins);
+        complex_multiply(type, out, b, out, bins);
+        for (int i = 0; i < bins; i++) {
+            multiply_error.add(out[i][0], ref[i][0]);
+            multiply_error.add(out[i][1], ref[i][1]);
+        }
+
+        // split kernels against the interleaved scalar ones
+        for (int p = 0; p < partitions; p++) {
+            deinterleave(a + p * max_bins, split_a.at(p), bins);
+            deinterleave(b + p * max_bins, split_b.at(p), bins);
+        }
+        split_complex result = split_out.at(0);
+
+        fill_random((float*)ref, 2 * bins);
+        deinterleave(ref, result, bins);
+        complex_mac(kernel_scalar, a, b, ref, bins);
+        complex_mac(type, split_a.at(0), split_b.at(0), result, bins);
+        for (int i = 0; i < bins; i++) {
+            split_mac_error.add(result.re[i], ref[i][0]);
+            split_mac_error.add(result.im[i], ref[i][1]);
+        }
+
+        complex_multiply(kernel_scalar, a, b, ref, bins);
+        deinterleave(a, result, bins);
+        complex_multiply(type, result, split_b.at(0), result, bins);
+        for (int i = 0; i < bins; i++) {
+            split_multiply_error.add(result.re[i], ref[i][0]);
+            split_multiply_error.add(result.im[i], ref[i][1]);
+        }
+
+        // sum over all partitions against the scalar multiply-accumulate of the same partitions
+        memset(ref, 0, sizeof(fft_complex) * bins);
+        for (int p = 0; p < partitions; p++)
+            complex_mac(kernel_scalar, a + p * max_bins, b + p * max_bins, ref, bins);
+        complex_mac_sum(type, inputs, filters, partitions, result, bins);
+        for (int i = 0; i < bins; i++) {
+            sum_error.add(result.re[i], ref[i][0]);
+            sum_error.add(result.im[i], ref[i][1]);
+        }
+
+        // direct-form FIR with bins output samples
+        for (int taps : test_taps) {
+            const float* x = (const float*)a;
+            const float* taps_left = (const float*)b;
+            const float* taps_right = taps_left + 2 * max_bins;
+            float* ref_left = (float*)ref;
+            float* out_left = (float*)out;
+
+            fir_pair(kernel_scalar, x, taps_left, taps_right, taps, ref_left, ref_left + max_bins, bins);
+            fir_pair(type, x, taps_left, taps_right, taps, out_left, out_left + max_bins, bins);
+            for (int i = 0; i < bins; i++) {
+                fir_error.add(out_left[i], ref_left[i]);
+                fir_error.add(out_left[max_bins + i], ref_left[max_bins + i]);
+            }
+        }
+
+        // dot products of every column with the same weights, against the sum in double precision
+        const int num_rows = 9;
+        float weights[num_rows];
+        fill_random(weights, num_rows);
+        const float* rows = (const float*)a;
+        float* weighted = (float*)out;
+        weighted_sum(type, rows, max_bins, weights, num_rows, weighted, bins);
+        for (int i = 0; i < bins; i++) {
+            double sum = 0.;
+            for (int r = 0; r < num_rows; r++)
+                sum += (double)weights[r] * rows[r * max_bins + i];
+            weighted_error.add(weighted[i], sum);
+        }
+    }
+
+    // the fixed-size MAC kernels need the padding of split_stride(), which the split buffers have
+    for (int bins : fixed_bins) {
+        split_a.fill(bins);
+        split_b.fill(bins);
+        split_buffer<float> expected(1);
+        complex_mac_sum(kernel_scalar, inputs, filters, partitions, expected.at(0), bins);
+        split_complex result = split_out.at(0);
+        get_mac_sum_kernel(type, bins)(inputs, filters, partitions, result, bins);
+        for (int i = 0; i < bins; i++) {
+            fixed_error.add(result.re[i], expected.at(0).re[i]);
+            fixed_error.add(result.im[i], expected.at(0).im[i]);
+        }
+    }
+
+    check(mac_error.within(float_tolerance), "complex_mac differs from the scalar kernel", name);
+    check(multiply_error.within(float_tolerance), "complex_multiply differs from the scalar kernel", name);
+    check(split_mac_error.within(float_tolerance), "split complex_mac differs from the scalar kernel", name);
+    check(split_multiply_error.within(float_tolerance), "split complex_multiply differs from the scalar kernel", name);
+    check(sum_error.within(float_tolerance), "complex_mac_sum differs from the scalar kernel", name);
+    check(fixed_error.within(float_tolerance), "fixed-size complex_mac_sum differs from the scalar kernel", name);
+    check(fir_error.within(float_tolerance), "fir_pair differs from the scalar kernel", name);
+    check(weighted_error.within(float_tolerance), "weighted_sum differs from the sum in double precision", name);
+
+    printf("%s: mac %.3g, multiply %.3g, split mac %.3g, split multiply %.3g, sum %.3g, fixed sum %.3g, fir %.3g, weighted %.3g\n",
+           name, mac_error.error, multiply_error.error, split_mac_error.error, split_multiply_error.error, sum_error.error,
+           fixed_error.error, fir_error.error, weighted_error.error);
+
+    fft_free(a);
+    fft_free(b);
+    fft_free(ref);
+    fft_free(out);
+}
+
+// the double precision kernels have no type argument, they follow set_kernel()
+static void test_double_kernels(int type) {
+
+    const char* name = get_kernel_name(type);
+    set_kernel(type);
+
+    split_buffer<double> a(partitions), b(partitions), result(1);
+    split_complex_d inputs[partitions], filters[partitions];
+    for (int p = 0; p < partitions; p++) {
+        inputs[p] = a.at(p);
+        filters[p] = b.at(p);
+    }
+
+    double* x = fft_alloc<double>(max_bins + max_taps);
+    double* taps = fft_alloc<double>(2 * max_taps);
+    double* left = fft_alloc<double>(max_bins);
+    double* right = fft_alloc<double>(max_bins);
+    fill_random(x, max_bins + max_taps);
+    fill_random(taps, 2 * max_taps);
+
+    max_error sum_error, fir_error;
+
+    for (int bins : test_bins) {
+
+        a.fill(bins);
+        b.fill(bins);
+        complex_mac_sum(inputs, filters, partitions, result.at(0), bins);
+        for (int i = 0; i < bins; i++) {
+            double re = 0., im = 0.;
+            for (int p = 0; p < partitions; p++) {
+                re += inputs[p].re[i] * filters[p].re[i] - inputs[p].im[i] * filters[p].im[i];
+                im += inputs[p].re[i] * filters[p].im[i] + inputs[p].im[i] * filters[p].re[i];
+            }
+            sum_error.add(result.at(0).re[i], re);
+            sum_error.add(result.at(0).im[i], im);
+        }
+
+        for (int num_taps : test_taps) {
+            fir_pair(x, taps, taps + max_taps, num_taps, left, right, bins);
+            for (int i = 0; i < bins; i++) {
+                double sum_left = 0., sum_right = 0.;
+                for (int j = 0; j < num_taps; j++) {
+                    sum_left += taps[j] * x[i + j];
+                    sum_right += taps[max_taps + j] * x[i + j];
+                }
+                fir_error.add(left[i], sum_left);
+                fir_error.add(right[i], sum_right);
+            }
+        }
+    }
+
+    check(sum_error.within(double_tolerance), "double complex_mac_sum differs from the plain sum", name);
+    check(fir_error.within(double_tolerance), "double fir_pair differs from the plain sum", name);
+
+    fft_free(x);
+    fft_free(taps);
+    fft_free(left);
+    fft_free(right);
+}
+
+// set_kernel() switches what the functions without a type argument run, unsupported types are ignored
+static void test_dispatch() {
+
+    int best = get_best_kernel();
+    check(is_kernel_supported(best), "the best kernel is not supported", get_kernel_name(best));
+    check(is_kernel_supported(kernel_scalar), "the scalar kernel is not supported", get_kernel_name(kernel_scalar));
+    check(get_kernel() == best, "the best kernel is not the default one", get_kernel_name(best));
+
+    const int bins = 257;
+    fft_complex* a = fft_alloc_complex(bins);
+    fft_complex* b = fft_alloc_complex(bins);
+    fft_complex* direct = fft_alloc_complex(bins);
+    fft_complex* dispatched = fft_alloc_complex(bins);
+    fill_random((float*)a, 2 * bins);
+    fill_random((float*)b, 2 * bins);
+
+    for (int type = 0; type < num_kernel_types; type++) {
+
+        int before = get_kernel();
+        set_kernel(type);
+
+        if (!is_kernel_supported(type)) {
+            check(get_kernel() == before, "set_kernel() took an unsupported kernel", get_kernel_name(type));
+            continue;
+        }
+        check(get_kernel() == type, "set_kernel() did not take a supported kernel", get_kernel_name(type));
+
+        // the dispatched call runs exactly the selected kernel
+        memset(direct, 0, sizeof(fft_complex) * bins);
+        memset(dispatched, 0, sizeof(fft_complex) * bins);
+        complex_mac(type, a, b, direct, bins);
+        complex_mac(a, b, dispatched, bins);
+        check(memcmp(direct, dispatched, sizeof(fft_complex) * bins) == 0, "complex_mac does not dispatch to the selected kernel",
+              get_kernel_name(type));
+    }
+
+    set_kernel(best);
+
+    fft_free(a);
+    fft_free(b);
+    fft_free(direct);
+    fft_free(dispatched);
+}
+
+int main() {
+
+    printf("best kernel on this CPU: %s\n", get_kernel_name(get_best_kernel()));
+
+    test_dispatch();
+
+    int best = get_best_kernel();
+    for (int type = 0; type < num_kernel_types; type++) {
+        if (!is_kernel_supported(type))
+            continue;
+        test_kernel(type);
+        test_double_kernels(type);
+    }
+    set_kernel(best);
+
+    printf("%d failed checks\n", failed_checks);
+    return failed_checks;
+}